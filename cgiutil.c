@@ -285,17 +285,22 @@ void getword(char *word, char *line, char stop)
   while((line[y++] = line[x++]));
 }
 
+/*
+** The words returned by makeword() and makeword_skip() have request
+** lifetime (see msRequestMalloc()) and must be freed with msRequestFree().
+*/
 char *makeword_skip(char *line, char stop, char skip)
 {
   int x = 0,y,offset=0;
-  char *word = (char *) msSmallMalloc(sizeof(char) * (strlen(line) + 1));
+  char *word;
 
   for(x=0; ((line[x]) && (line[x] == skip)); x++);
   offset = x;
 
-  for(x=offset; ((line[x]) && (line[x] != stop)); x++)
-    word[x-offset] = line[x];
+  for(x=offset; ((line[x]) && (line[x] != stop)); x++);
 
+  word = (char *) msRequestMalloc(sizeof(char) * (x - offset + 1));
+  memcpy(word, line + offset, x - offset);
   word[x-offset] = '\0';
   if(line[x]) ++x;
   y=0;
@@ -307,11 +312,12 @@ char *makeword_skip(char *line, char stop, char skip)
 char *makeword(char *line, char stop)
 {
   int x = 0,y;
-  char *word = (char *) msSmallMalloc(sizeof(char) * (strlen(line) + 1));
+  char *word;
 
-  for(x=0; ((line[x]) && (line[x] != stop)); x++)
-    word[x] = line[x];
+  for(x=0; ((line[x]) && (line[x] != stop)); x++);
 
+  word = (char *) msRequestMalloc(sizeof(char) * (x + 1));
+  memcpy(word, line, x);
   word[x] = '\0';
   if(line[x]) ++x;
   y=0;
@@ -468,8 +474,14 @@ cgiRequestObj *msAllocCgiObj()
 
 void msFreeCgiObj(cgiRequestObj *request)
 {
-  msFreeCharArray(request->ParamNames, request->NumParams);
-  msFreeCharArray(request->ParamValues, request->NumParams);
+  int i;
+
+  for(i=0; i<request->NumParams; i++) {
+    msRequestFree(request->ParamNames[i]);
+    msRequestFree(request->ParamValues[i]);
+  }
+  msFree(request->ParamNames);
+  msFree(request->ParamValues);
   request->ParamNames = NULL;
   request->ParamValues = NULL;
   request->NumParams = 0;
@@ -979,6 +979,18 @@ int msDrawVectorLayer(mapObj *map, layerObj *layer, imageObj *image)
   if(layer->minfeaturesize > 0)
     minfeaturesize = Pix2LayerGeoref(map, layer, layer->minfeaturesize);
 
+#ifdef USE_PROJ
+  /* rendering only: interpolate vertices from a grid of exact transforms */
+  if(layer->transform == MS_TRUE && layer->project && msProjectionsDiffer(&(layer->projection), &(map->projection))) {
+    const char *approx = msLayerGetProcessingKey(layer, "APPROXIMATE_REPROJECTION");
+    if(approx && strcasecmp(approx, "OFF") != 0 && strcasecmp(approx, "FALSE") != 0) {
+      double maxerror = atof(approx); /* in pixels, ON means a quarter pixel */
+      if(maxerror <= 0) maxerror = 0.25;
+      layer->reprojectiongrid = msCreateProjectionGrid(&(layer->projection), &(map->projection), &searchrect, maxerror*map->cellsize);
+    }
+  }
+#endif
+
   while((status = msLayerNextShape(layer, &shape)) == MS_SUCCESS) {
 
     /* Check if the shape size is ok to be drawn */
@@ -1117,6 +1129,9 @@ int msDrawVectorLayer(mapObj *map, layerObj *layer, imageObj *image)
   if (classgroup)
     msFree(classgroup);
 
+  msFreeProjectionGrid(layer->reprojectiongrid);
+  layer->reprojectiongrid = NULL;
+
   if(status != MS_DONE || retcode == MS_FAILURE) {
     msLayerClose(layer);
     if(shpcache) {
@@ -1742,7 +1757,7 @@ int pointLayerDrawShape(mapObj *map, imageObj *image, layerObj *layer, shapeObj
 
 #ifdef USE_PROJ
   if (layer->project && layer->transform == MS_TRUE && msProjectionsDiffer(&(layer->projection), &(map->projection)))
-    msProjectShape(&layer->projection, &map->projection, shape);
+    msProjectShapeGrid(&layer->projection, &map->projection, layer->reprojectiongrid, shape);
   else
     layer->project = MS_FALSE;
 #endif
@@ -2014,7 +2029,7 @@ int msDrawShape(mapObj *map, layerObj *layer, shapeObj *shape, imageObj *image,
 
 #ifdef USE_PROJ
   if (layer->project && layer->transform == MS_TRUE && msProjectionsDiffer(&(layer->projection), &(map->projection)))
-    msProjectShape(&layer->projection, &map->projection, shape);
+    msProjectShapeGrid(&layer->projection, &map->projection, layer->reprojectiongrid, shape);
   else
     layer->project = MS_FALSE;
 #endif
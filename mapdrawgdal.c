@@ -1314,6 +1314,22 @@ static int ApplyLUT( int iColorIndex, layerObj *layer,
   return 0;
 }
 
+/************************************************************************/
+/*                     msGDALUseDatasetScaleStats()                     */
+/*                                                                      */
+/*      PROCESSING "SCALE_STATS=DATASET" makes automatic scaling use    */
+/*      the (cached) min/max of the whole band rather than of the       */
+/*      window being drawn.  The default is WINDOW.                     */
+/************************************************************************/
+
+static int msGDALUseDatasetScaleStats( layerObj *layer )
+
+{
+  const char *pszStats = CSLFetchNameValue( layer->processing, "SCALE_STATS" );
+
+  return pszStats != NULL && EQUAL(pszStats,"DATASET");
+}
+
 /************************************************************************/
 /*                           LoadGDALImages()                           */
 /*                                                                      */
@@ -1335,6 +1351,7 @@ LoadGDALImages( GDALDatasetH hDS, int band_numbers[4], int band_count,
   int    iColorIndex, result_code=0;
   CPLErr eErr;
   float *pafWholeRawData;
+  int    bDatasetStats = msGDALUseDatasetScaleStats( layer );
 
   /* -------------------------------------------------------------------- */
   /*      If we have no alpha band, but we do have three input            */
@@ -1483,14 +1500,20 @@ LoadGDALImages( GDALDatasetH hDS, int band_numbers[4], int band_count,
 
     /* -------------------------------------------------------------------- */
     /*      If we are using autoscaling, then compute the max and min       */
-    /*      now.  Perhaps we should eventually honour the offsite value     */
-    /*      as a nodata value, or get it from GDAL.                         */
+    /*      now, from the dataset statistics if SCALE_STATS=DATASET or     */
+    /*      else from the window we have read.  Perhaps we should           */
+    /*      eventually honour the offsite value as a nodata value.          */
     /* -------------------------------------------------------------------- */
     pafRawData = pafWholeRawData + iColorIndex * dst_xsize * dst_ysize;
 
     dfNoDataValue = msGetGDALNoDataValue( layer, hBand, &bGotNoData );
 
-    if( dfScaleMin == dfScaleMax ) {
+    if( dfScaleMin == dfScaleMax && bDatasetStats
+        && msGDALGetBandScaleRange( layer, hDS, band_numbers[iColorIndex],
+                                    &dfScaleMin, &dfScaleMax ) == MS_SUCCESS ) {
+      if( dfScaleMin == dfScaleMax )
+        dfScaleMax = dfScaleMin + 1.0;
+    } else if( dfScaleMin == dfScaleMax ) {
       int bMinMaxSet = 0;
 
       /* we force assignment to a float rather than letting pafRawData[i]
@@ -2090,6 +2113,299 @@ msDrawRasterLayerGDAL_RawMode(
   return 0;
 }
 
+/************************************************************************/
+/* ==================================================================== */
+/*      Raster classification lookup tables.                            */
+/*                                                                      */
+/*      Classifying through SCALE_BUCKETS evaluates the class           */
+/*      expressions once per bucket, up to 65536 times a request.       */
+/*      For RGBA output the resulting table only depends on the         */
+/*      classes and the scaling, so it is kept per process, keyed by    */
+/*      a description of both, and shared by later requests.  Tables    */
+/*      are reference counted while in use and the least recently       */
+/*      used idle one is dropped when the cache is full.  The list is   */
+/*      protected by TLOCK_POOL.                                        */
+/* ==================================================================== */
+/************************************************************************/
+
+#define MS_GDAL_CLASS_LUT_CACHE_SIZE 8
+
+typedef struct {
+  char *key;
+  int bucket_count;
+  int refcount;
+  int cached;
+  unsigned long last_used;
+
+  /* class colors per bucket: red, green, blue, alpha, then red, green */
+  /* and blue premultiplied by alpha, bucket_count entries each.       */
+  unsigned char *cmap;
+} gdalClassLUT;
+
+static gdalClassLUT *gdalClassLUTCache[MS_GDAL_CLASS_LUT_CACHE_SIZE];
+static int gdalClassLUTCount = 0;
+static unsigned long gdalClassLUTTick = 0;
+
+/************************************************************************/
+/*                       msGDALBuildClassLUT()                          */
+/*                                                                      */
+/*      Classify the value at the center of each bucket, filling        */
+/*      either the GD pen table or the RGBA color tables.               */
+/************************************************************************/
+
+static void msGDALBuildClassLUT( layerObj *layer, rasterBufferObj *rb,
+                                 double dfScaleMin, double dfScaleRatio,
+                                 int nBucketCount, int *cmap,
+                                 unsigned char *rb_cmap[4] )
+
+{
+  int i, c;
+
+  for(i=0; i < nBucketCount; i++) {
+    double dfOriginalValue;
+
+    if( cmap != NULL )
+      cmap[i] = -1;
+
+    dfOriginalValue = (i+0.5) / dfScaleRatio + dfScaleMin;
+
+    c = msGetClass_FloatRGB(layer, (float) dfOriginalValue, -1, -1, -1);
+    if( c != -1 ) {
+      int s;
+
+      /* change colour based on colour range? */
+      for(s=0; s<layer->class[c]->numstyles; s++) {
+        if( MS_VALID_COLOR(layer->class[c]->styles[s]->mincolor)
+            && MS_VALID_COLOR(layer->class[c]->styles[s]->maxcolor) )
+          msValueToRange(layer->class[c]->styles[s],dfOriginalValue);
+      }
+#ifdef USE_GD
+      if(rb->type == MS_BUFFER_GD) {
+        RESOLVE_PEN_GD(rb->data.gd_img, layer->class[c]->styles[0]->color);
+        if( MS_TRANSPARENT_COLOR(layer->class[c]->styles[0]->color) )
+          cmap[i] = -1;
+        else if( MS_VALID_COLOR(layer->class[c]->styles[0]->color)) {
+          /* use class color */
+          cmap[i] = layer->class[c]->styles[0]->color.pen;
+        }
+      } else
+#endif
+        if( rb->type == MS_BUFFER_BYTE_RGBA ) {
+          if( MS_TRANSPARENT_COLOR(layer->class[c]->styles[0]->color) ) {
+            /* leave it transparent */
+          } else if( MS_VALID_COLOR(layer->class[c]->styles[0]->color)) {
+            /* use class color */
+            rb_cmap[0][i] = layer->class[c]->styles[0]->color.red;
+            rb_cmap[1][i] = layer->class[c]->styles[0]->color.green;
+            rb_cmap[2][i] = layer->class[c]->styles[0]->color.blue;
+            rb_cmap[3][i] = (255*layer->class[c]->styles[0]->opacity / 100);
+          }
+        }
+    }
+  }
+}
+
+/************************************************************************/
+/*                       msGDALClassLUTKey()                            */
+/*                                                                      */
+/*      Describe everything msGDALBuildClassLUT() depends on for        */
+/*      RGBA output.  Style colors set by msValueToRange() for color    */
+/*      ranges are left out as they are overwritten.                    */
+/************************************************************************/
+
+static void msGDALClassLUTKeyString( bufferObj *key, const char *value )
+
+{
+  char szLen[32];
+
+  snprintf( szLen, sizeof(szLen), "%d:", value ? (int) strlen(value) : -1 );
+  msBufferAppend( key, szLen, strlen(szLen) );
+  if( value )
+    msBufferAppend( key, (char *) value, strlen(value) );
+}
+
+static char *msGDALClassLUTKey( layerObj *layer, double dfScaleMin,
+                                double dfScaleMax, int nBucketCount )
+
+{
+  bufferObj key;
+  char szItem[512];
+  int i, s;
+
+  msBufferInit( &key );
+  snprintf( szItem, sizeof(szItem), "%.17g,%.17g,%d,%d|",
+            dfScaleMin, dfScaleMax, nBucketCount, layer->numclasses );
+  msBufferAppend( &key, szItem, strlen(szItem) );
+  msGDALClassLUTKeyString( &key, layer->classgroup );
+
+  for( i = 0; i < layer->numclasses; i++ ) {
+    classObj *class_obj = layer->class[i];
+
+    snprintf( szItem, sizeof(szItem), "|%d,%d,%d,",
+              class_obj->expression.type, class_obj->expression.flags,
+              class_obj->numstyles );
+    msBufferAppend( &key, szItem, strlen(szItem) );
+    msGDALClassLUTKeyString( &key, class_obj->group );
+    msGDALClassLUTKeyString( &key, class_obj->expression.string );
+
+    for( s = 0; s < class_obj->numstyles; s++ ) {
+      styleObj *style = class_obj->styles[s];
+      int bRange = MS_VALID_COLOR(style->mincolor)
+                   && MS_VALID_COLOR(style->maxcolor);
+
+      if( s > 0 && !bRange )
+        continue;
+
+      snprintf( szItem, sizeof(szItem),
+                ";%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%d,%.17g,%.17g",
+                s, bRange ? 0 : style->color.red,
+                bRange ? 0 : style->color.green,
+                bRange ? 0 : style->color.blue,
+                style->color.alpha, style->opacity,
+                style->mincolor.red, style->mincolor.green, style->mincolor.blue,
+                style->maxcolor.red, style->maxcolor.green, style->maxcolor.blue,
+                style->minvalue, style->maxvalue );
+      msBufferAppend( &key, szItem, strlen(szItem) );
+    }
+  }
+  msBufferAppend( &key, "", 1 );
+
+  return (char *) key.data;
+}
+
+/************************************************************************/
+/*                      msGDALFreeClassLUT()                            */
+/************************************************************************/
+
+static void msGDALFreeClassLUT( gdalClassLUT *lut )
+
+{
+  free( lut->key );
+  free( lut->cmap );
+  free( lut );
+}
+
+/************************************************************************/
+/*                     msGDALAcquireClassLUT()                          */
+/*                                                                      */
+/*      Return the RGBA classification table for this layer and         */
+/*      scaling, built now or shared from the cache.  Release it        */
+/*      with msGDALReleaseClassLUT().                                   */
+/************************************************************************/
+
+static gdalClassLUT *msGDALAcquireClassLUT( layerObj *layer,
+    rasterBufferObj *rb, double dfScaleMin, double dfScaleMax,
+    double dfScaleRatio, int nBucketCount )
+
+{
+  char *key = msGDALClassLUTKey( layer, dfScaleMin, dfScaleMax, nBucketCount );
+  gdalClassLUT *lut;
+  unsigned char *rb_cmap[4];
+  int i, lru = -1;
+
+  msAcquireLock( TLOCK_POOL );
+  for( i = 0; i < gdalClassLUTCount; i++ ) {
+    lut = gdalClassLUTCache[i];
+    if( strcmp( lut->key, key ) == 0 ) {
+      lut->refcount++;
+      lut->last_used = ++gdalClassLUTTick;
+      msReleaseLock( TLOCK_POOL );
+      free( key );
+      if( layer->debug > 0 )
+        msDebug( "msGDALAcquireClassLUT(%s): using cached table.\n",
+                 layer->name );
+      return lut;
+    }
+  }
+  msReleaseLock( TLOCK_POOL );
+
+  /* -------------------------------------------------------------------- */
+  /*      Build a new table.                                              */
+  /* -------------------------------------------------------------------- */
+  lut = (gdalClassLUT *) msSmallCalloc( 1, sizeof(gdalClassLUT) );
+  lut->key = key;
+  lut->bucket_count = nBucketCount;
+  lut->refcount = 1;
+  lut->cmap = (unsigned char *) msSmallCalloc( 7, nBucketCount );
+
+  for( i = 0; i < 4; i++ )
+    rb_cmap[i] = lut->cmap + i * nBucketCount;
+  msGDALBuildClassLUT( layer, rb, dfScaleMin, dfScaleRatio, nBucketCount,
+                       NULL, rb_cmap );
+
+  /* same arithmetic as RB_SET_PIXEL() */
+  for( i = 0; i < nBucketCount; i++ ) {
+    double a = rb_cmap[3][i] / 255.0;
+    lut->cmap[4*nBucketCount + i] = rb_cmap[0][i] * a;
+    lut->cmap[5*nBucketCount + i] = rb_cmap[1][i] * a;
+    lut->cmap[6*nBucketCount + i] = rb_cmap[2][i] * a;
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Keep it, unless every cached table is in use.                   */
+  /* -------------------------------------------------------------------- */
+  msAcquireLock( TLOCK_POOL );
+  if( gdalClassLUTCount == MS_GDAL_CLASS_LUT_CACHE_SIZE ) {
+    for( i = 0; i < gdalClassLUTCount; i++ ) {
+      if( gdalClassLUTCache[i]->refcount == 0
+          && (lru == -1 || gdalClassLUTCache[i]->last_used
+              < gdalClassLUTCache[lru]->last_used) )
+        lru = i;
+    }
+    if( lru != -1 ) {
+      msGDALFreeClassLUT( gdalClassLUTCache[lru] );
+      gdalClassLUTCache[lru] = gdalClassLUTCache[--gdalClassLUTCount];
+    }
+  }
+  if( gdalClassLUTCount < MS_GDAL_CLASS_LUT_CACHE_SIZE ) {
+    lut->cached = MS_TRUE;
+    lut->last_used = ++gdalClassLUTTick;
+    gdalClassLUTCache[gdalClassLUTCount++] = lut;
+  }
+  msReleaseLock( TLOCK_POOL );
+
+  return lut;
+}
+
+/************************************************************************/
+/*                     msGDALReleaseClassLUT()                          */
+/************************************************************************/
+
+static void msGDALReleaseClassLUT( gdalClassLUT *lut )
+
+{
+  int freeit;
+
+  msAcquireLock( TLOCK_POOL );
+  lut->refcount--;
+  freeit = (lut->refcount == 0 && !lut->cached);
+  msReleaseLock( TLOCK_POOL );
+
+  if( freeit )
+    msGDALFreeClassLUT( lut );
+}
+
+/************************************************************************/
+/*                      msGDALClassLUTCleanup()                         */
+/************************************************************************/
+
+void msGDALClassLUTCleanup( void )
+
+{
+  int i;
+
+  msAcquireLock( TLOCK_POOL );
+  for( i = 0; i < gdalClassLUTCount; i++ ) {
+    if( gdalClassLUTCache[i]->refcount > 0 ) {
+      gdalClassLUTCache[i]->cached = MS_FALSE;
+      continue;
+    }
+    msGDALFreeClassLUT( gdalClassLUTCache[i] );
+  }
+  gdalClassLUTCount = 0;
+  msReleaseLock( TLOCK_POOL );
+}
+
 /************************************************************************/
 /*              msDrawRasterLayerGDAL_16BitClassifcation()              */
 /*                                                                      */
@@ -2112,13 +2428,15 @@ msDrawRasterLayerGDAL_16BitClassification(
 {
   float *pafRawData;
   double dfScaleMin=0.0, dfScaleMax=0.0, dfScaleRatio;
+  double dfDataMin, dfDataMax;
   int   nPixelCount = dst_xsize * dst_ysize, i, nBucketCount=0;
   GDALDataType eDataType;
   float fDataMin=0.0, fDataMax=255.0, fNoDataValue;
   const char *pszScaleInfo;
   const char *pszBuckets;
-  int  *cmap, c, j, k, bGotNoData = FALSE, bGotFirstValue;
+  int  *cmap = NULL, j, k, bGotNoData = FALSE, bGotFirstValue;
   unsigned char *rb_cmap[4];
+  gdalClassLUT *lut = NULL;
   CPLErr eErr;
   rasterBufferObj *mask_rb = NULL;
   if(layer->mask) {
@@ -2163,20 +2481,29 @@ msDrawRasterLayerGDAL_16BitClassification(
   eDataType = GDALGetRasterDataType( hBand );
 
   /* -------------------------------------------------------------------- */
-  /*      Scan for absolute min/max of this block.                        */
+  /*      Take the min/max of the whole dataset if SCALE_STATS=DATASET,   */
+  /*      so that every request buckets the values the same way.          */
+  /*      Otherwise scan for absolute min/max of this block.              */
   /* -------------------------------------------------------------------- */
   bGotFirstValue = FALSE;
 
-  for( i = 1; i < nPixelCount; i++ ) {
-    if( bGotNoData && pafRawData[i] == fNoDataValue )
-      continue;
+  if( msGDALUseDatasetScaleStats( layer )
+      && msGDALGetBandScaleRange( layer, hDS, GDALGetBandNumber( hBand ),
+                                  &dfDataMin, &dfDataMax ) == MS_SUCCESS ) {
+    fDataMin = (float) dfDataMin;
+    fDataMax = (float) dfDataMax;
+  } else {
+    for( i = 1; i < nPixelCount; i++ ) {
+      if( bGotNoData && pafRawData[i] == fNoDataValue )
+        continue;
 
-    if( !bGotFirstValue ) {
-      fDataMin = fDataMax = pafRawData[i];
-      bGotFirstValue = TRUE;
-    } else {
-      fDataMin = MIN(fDataMin,pafRawData[i]);
-      fDataMax = MAX(fDataMax,pafRawData[i]);
+      if( !bGotFirstValue ) {
+        fDataMin = fDataMax = pafRawData[i];
+        bGotFirstValue = TRUE;
+      } else {
+        fDataMin = MIN(fDataMin,pafRawData[i]);
+        fDataMax = MAX(fDataMax,pafRawData[i]);
+      }
     }
   }
 
@@ -2267,55 +2594,21 @@ msDrawRasterLayerGDAL_16BitClassification(
              layer->name, nBucketCount, dfScaleMin, dfScaleMax );
 
   /* ==================================================================== */
-  /*      Compute classification lookup table.                            */
+  /*      Compute classification lookup table.  For RGBA output it is     */
+  /*      shared between requests with the same classes and scaling.      */
   /* ==================================================================== */
-
-  cmap = (int *) msSmallCalloc(sizeof(int),nBucketCount);
-  rb_cmap[0] = (unsigned char *) msSmallCalloc(1,nBucketCount);
-  rb_cmap[1] = (unsigned char *) msSmallCalloc(1,nBucketCount);
-  rb_cmap[2] = (unsigned char *) msSmallCalloc(1,nBucketCount);
-  rb_cmap[3] = (unsigned char *) msSmallCalloc(1,nBucketCount);
-
-  for(i=0; i < nBucketCount; i++) {
-    double dfOriginalValue;
-
-    cmap[i] = -1;
-
-    dfOriginalValue = (i+0.5) / dfScaleRatio + dfScaleMin;
-
-    c = msGetClass_FloatRGB(layer, (float) dfOriginalValue, -1, -1, -1);
-    if( c != -1 ) {
-      int s;
-
-      /* change colour based on colour range? */
-      for(s=0; s<layer->class[c]->numstyles; s++) {
-        if( MS_VALID_COLOR(layer->class[c]->styles[s]->mincolor)
-            && MS_VALID_COLOR(layer->class[c]->styles[s]->maxcolor) )
-          msValueToRange(layer->class[c]->styles[s],dfOriginalValue);
-      }
-#ifdef USE_GD
-      if(rb->type == MS_BUFFER_GD) {
-        RESOLVE_PEN_GD(rb->data.gd_img, layer->class[c]->styles[0]->color);
-        if( MS_TRANSPARENT_COLOR(layer->class[c]->styles[0]->color) )
-          cmap[i] = -1;
-        else if( MS_VALID_COLOR(layer->class[c]->styles[0]->color)) {
-          /* use class color */
-          cmap[i] = layer->class[c]->styles[0]->color.pen;
-        }
-      } else
-#endif
-        if( rb->type == MS_BUFFER_BYTE_RGBA ) {
-          if( MS_TRANSPARENT_COLOR(layer->class[c]->styles[0]->color) ) {
-            /* leave it transparent */
-          } else if( MS_VALID_COLOR(layer->class[c]->styles[0]->color)) {
-            /* use class color */
-            rb_cmap[0][i] = layer->class[c]->styles[0]->color.red;
-            rb_cmap[1][i] = layer->class[c]->styles[0]->color.green;
-            rb_cmap[2][i] = layer->class[c]->styles[0]->color.blue;
-            rb_cmap[3][i] = (255*layer->class[c]->styles[0]->opacity / 100);
-          }
-        }
-    }
+  if( rb->type == MS_BUFFER_BYTE_RGBA ) {
+    lut = msGDALAcquireClassLUT( layer, rb, dfScaleMin, dfScaleMax,
+                                 dfScaleRatio, nBucketCount );
+    /* premultiplied colors if the buffer has an alpha channel */
+    rb_cmap[0] = lut->cmap + (rb->data.rgba.a ? 4 : 0) * nBucketCount;
+    rb_cmap[1] = lut->cmap + (rb->data.rgba.a ? 5 : 1) * nBucketCount;
+    rb_cmap[2] = lut->cmap + (rb->data.rgba.a ? 6 : 2) * nBucketCount;
+    rb_cmap[3] = lut->cmap + 3 * nBucketCount;
+  } else {
+    cmap = (int *) msSmallCalloc(sizeof(int),nBucketCount);
+    msGDALBuildClassLUT( layer, rb, dfScaleMin, dfScaleRatio, nBucketCount,
+                         cmap, NULL );
   }
 
   /* ==================================================================== */
@@ -2359,11 +2652,11 @@ msDrawRasterLayerGDAL_16BitClassification(
         if( rb->type == MS_BUFFER_BYTE_RGBA ) {
           /* currently we never have partial alpha so keep simple */
           if( rb_cmap[3][iMapIndex] > 0 )
-            RB_SET_PIXEL( rb, j, i,
-                          rb_cmap[0][iMapIndex],
-                          rb_cmap[1][iMapIndex],
-                          rb_cmap[2][iMapIndex],
-                          rb_cmap[3][iMapIndex] );
+            RB_SET_PIXEL_PM( rb, j, i,
+                             rb_cmap[0][iMapIndex],
+                             rb_cmap[1][iMapIndex],
+                             rb_cmap[2][iMapIndex],
+                             rb_cmap[3][iMapIndex] );
         }
     }
   }
@@ -2373,10 +2666,8 @@ msDrawRasterLayerGDAL_16BitClassification(
   /* -------------------------------------------------------------------- */
   free( pafRawData );
   free( cmap );
-  free( rb_cmap[0] );
-  free( rb_cmap[1] );
-  free( rb_cmap[2] );
-  free( rb_cmap[3] );
+  if( lut != NULL )
+    msGDALReleaseClassLUT( lut );
   msFree( mask_rb );
 
   assert( k == dst_xsize * dst_ysize );
@@ -1088,7 +1088,7 @@ int msInitProjection(projectionObj *p)
 void msFreeProjection(projectionObj *p)
 {
 #ifdef USE_PROJ
-  if(p->proj) {
+  if(p->proj && !msProjectionPoolRelease(p)) { /* keep it for the next identical definition */
     pj_free(p->proj);
     p->proj = NULL;
   }
@@ -1258,6 +1258,10 @@ int msProcessProjection(projectionObj *p)
     /*WMS 1.3.0: AUTO2:auto_crs_id,factor,lon0,lat0*/
     return _msProcessAutoProjection(p);
   }
+
+  if(msProjectionPoolAcquire(p) == MS_TRUE) /* already initialized by an earlier load */
+    goto pj_done;
+
   msAcquireLock( TLOCK_PROJ );
 #if PJ_VERSION < 480
   if( !(p->proj = pj_init(p->numargs, p->args)) ) {
@@ -1280,6 +1284,7 @@ int msProcessProjection(projectionObj *p)
 
   msReleaseLock( TLOCK_PROJ );
 
+pj_done:
 #ifdef USE_PROJ_FASTPATHS
   if(strcasestr(p->args[0],"epsg:4326")) {
     p->wellknownprojection = wkp_lonlat;
@@ -2430,39 +2435,29 @@ int loadHashTable(hashTableObj *ptable)
 
 static void writeHashTable(FILE *stream, int indent, const char *title, hashTableObj *table)
 {
-  struct hashObj *tp;
-  int i;
+  const char *key = NULL;
 
   if(!table) return;
   if(msHashIsEmpty(table)) return;
 
   indent++;
   writeBlockBegin(stream, indent, title);
-  for (i=0; i<MS_HASHSIZE; i++) {
-    if (table->items[i] != NULL) {
-      for (tp=table->items[i]; tp!=NULL; tp=tp->next)
-        writeNameValuePair(stream, indent, tp->key, tp->data);
-    }
-  }
+  while((key = msNextKeyFromHashTable(table, key)) != NULL)
+    writeNameValuePair(stream, indent, key, msLookupHashTable(table, key));
   writeBlockEnd(stream, indent, title);
 }
 
 static void writeHashTableInline(FILE *stream, int indent, char *name, hashTableObj* table)
 {
-  struct hashObj *tp = NULL;
-  int i;
+  const char *key = NULL;
 
   if(!table) return;
   if(msHashIsEmpty(table)) return;
 
   ++indent;
-  for (i=0; i<MS_HASHSIZE; ++i) {
-    if (table->items[i] != NULL) {
-      for (tp=table->items[i]; tp!=NULL; tp=tp->next) {
-        writeIndent(stream, indent);
-        fprintf(stream, "%s \"%s\" \"%s\"\n", name, tp->key, tp->data);
-      }
-    }
+  while((key = msNextKeyFromHashTable(table, key)) != NULL) {
+    writeIndent(stream, indent);
+    fprintf(stream, "%s \"%s\" \"%s\"\n", name, key, msLookupHashTable(table, key));
   }
 }
 
@@ -3718,6 +3713,7 @@ int initLayer(layerObj *layer, mapObj *map)
   layer->units = MS_METERS;
   if(msInitProjection(&(layer->projection)) == -1) return(-1);
   layer->project = MS_TRUE;
+  layer->reprojectiongrid = NULL;
 
   initCluster(&layer->cluster);
 
@@ -5529,6 +5525,7 @@ int initMap(mapObj *map)
   map->cellsize = 0;
   map->shapepath = NULL;
   map->mappath = NULL;
+  map->mapfile = NULL;
 
   MS_INIT_COLOR(map->imagecolor, 255,255,255,255); /* white */
 
@@ -6191,6 +6188,7 @@ mapObj *msLoadMap(char *filename, char *new_mappath)
     map->mappath = msStrdup(msBuildPath(szPath, szCWDPath, path));
     if( path ) free( path );
   }
+  map->mapfile = msStrdup(msBuildPath(szPath, szCWDPath, filename));
 
   msyybasepath = map->mappath; /* for INCLUDEs */
 
@@ -63,6 +63,453 @@ void msGDALInitialize( void )
   }
 }
 
+/************************************************************************/
+/* ==================================================================== */
+/*      Dataset handle pool.                                            */
+/*                                                                      */
+/*      Raster layers (drawing, queries, WCS, UV) open their files      */
+/*      through msGDALOpenDataset() and give them back with             */
+/*      msGDALReleaseDataset(), so header parsing, overview             */
+/*      discovery and VRT XML parsing happen once per file rather       */
+/*      than once per request. As with the connection pool in          */
+/*      mappool.c a handle may be referenced several times by one       */
+/*      thread, but is never handed to another thread while in use.     */
+/*      Unreferenced handles are kept up to MS_GDAL_POOL_SIZE and       */
+/*      evicted least recently used first, and a handle is reopened     */
+/*      if the file's modification time or size changed.               */
+/*                                                                      */
+/*      CLOSE_CONNECTION=NORMAL or ALWAYS on the layer bypasses the     */
+/*      pool: the dataset is opened privately and closed on release.    */
+/*                                                                      */
+/*      The pool tables are protected by TLOCK_POOL, callers are        */
+/*      expected to hold TLOCK_GDAL as for any other GDAL call.         */
+/* ==================================================================== */
+/************************************************************************/
+
+#define MS_GDAL_POOL_SIZE 32
+
+typedef struct {
+  char *path;
+  GDALDatasetH hDS;
+
+  int ref_count;
+  int thread_id;
+  int debug;
+
+  int has_stat;
+  time_t mtime;
+  vsi_l_offset size;
+
+  unsigned long last_used; /* pool tick, for LRU eviction */
+} gdalDatasetPoolEntry;
+
+static gdalDatasetPoolEntry gdalDatasetPool[MS_GDAL_POOL_SIZE];
+static int gdalDatasetPoolCount = 0;
+static unsigned long gdalDatasetPoolTick = 0;
+
+/* remove an entry from the table, returning its handle for closing */
+static GDALDatasetH msGDALPoolRemove( int i )
+
+{
+  GDALDatasetH hDS = gdalDatasetPool[i].hDS;
+
+  free( gdalDatasetPool[i].path );
+  gdalDatasetPool[i] = gdalDatasetPool[--gdalDatasetPoolCount];
+
+  return hDS;
+}
+
+static int msGDALPoolUseClosing( layerObj *layer )
+
+{
+  const char *close_connection;
+
+  close_connection = msLayerGetProcessingKey( layer, "CLOSE_CONNECTION" );
+
+  return close_connection != NULL
+         && (strcasecmp(close_connection,"NORMAL") == 0
+             || strcasecmp(close_connection,"ALWAYS") == 0);
+}
+
+/************************************************************************/
+/*                         msGDALOpenDataset()                          */
+/*                                                                      */
+/*      Return a read only dataset handle for path, from the pool if    */
+/*      possible. Returns NULL (with the GDAL error left in place)      */
+/*      if the file cannot be opened.                                   */
+/************************************************************************/
+
+void *msGDALOpenDataset( layerObj *layer, const char *path )
+
+{
+  VSIStatBufL sStat;
+  int i, has_stat, thread_id = msGetThreadId();
+  GDALDatasetH hDS, hStale = NULL, hEvicted = NULL;
+  gdalDatasetPoolEntry *entry;
+
+  if( msGDALPoolUseClosing( layer ) )
+    return GDALOpen( path, GA_ReadOnly );
+
+  has_stat = (VSIStatL( path, &sStat ) == 0);
+
+  msAcquireLock( TLOCK_POOL );
+  for( i = 0; i < gdalDatasetPoolCount; i++ ) {
+    entry = gdalDatasetPool + i;
+
+    if( strcmp( entry->path, path ) != 0
+        || (entry->ref_count > 0 && entry->thread_id != thread_id) )
+      continue;
+
+    if( has_stat != entry->has_stat
+        || (has_stat && (sStat.st_mtime != entry->mtime
+                         || sStat.st_size != entry->size)) ) {
+      /* the file changed under us, reopen it */
+      if( entry->ref_count == 0 ) {
+        if( layer->debug )
+          msDebug( "msGDALOpenDataset(%s): %s changed, reopening.\n",
+                   layer->name, path );
+        hStale = msGDALPoolRemove( i );
+        break;
+      }
+      continue;
+    }
+
+    entry->ref_count++;
+    entry->thread_id = thread_id;
+    entry->last_used = ++gdalDatasetPoolTick;
+    hDS = entry->hDS;
+    msReleaseLock( TLOCK_POOL );
+
+    if( layer->debug )
+      msDebug( "msGDALOpenDataset(%s,%s) -> got %p\n",
+               layer->name, path, hDS );
+    return hDS;
+  }
+  msReleaseLock( TLOCK_POOL );
+
+  if( hStale != NULL )
+    GDALClose( hStale );
+
+  hDS = GDALOpen( path, GA_ReadOnly );
+  if( hDS == NULL )
+    return NULL;
+
+  /* -------------------------------------------------------------------- */
+  /*      Register the new handle, evicting the least recently used       */
+  /*      unreferenced one if the pool is full.  If all are in use the    */
+  /*      handle is simply not pooled and closed on release.              */
+  /* -------------------------------------------------------------------- */
+  msAcquireLock( TLOCK_POOL );
+  if( gdalDatasetPoolCount == MS_GDAL_POOL_SIZE ) {
+    int lru = -1;
+    for( i = 0; i < gdalDatasetPoolCount; i++ ) {
+      if( gdalDatasetPool[i].ref_count == 0
+          && (lru == -1 || gdalDatasetPool[i].last_used < gdalDatasetPool[lru].last_used) )
+        lru = i;
+    }
+    if( lru != -1 )
+      hEvicted = msGDALPoolRemove( lru );
+  }
+
+  if( gdalDatasetPoolCount < MS_GDAL_POOL_SIZE ) {
+    entry = gdalDatasetPool + gdalDatasetPoolCount++;
+    entry->path = msStrdup( path );
+    entry->hDS = hDS;
+    entry->ref_count = 1;
+    entry->thread_id = thread_id;
+    entry->debug = layer->debug;
+    entry->has_stat = has_stat;
+    entry->mtime = has_stat ? sStat.st_mtime : 0;
+    entry->size = has_stat ? sStat.st_size : 0;
+    entry->last_used = ++gdalDatasetPoolTick;
+  }
+  msReleaseLock( TLOCK_POOL );
+
+  if( hEvicted != NULL )
+    GDALClose( hEvicted );
+
+  if( layer->debug )
+    msDebug( "msGDALOpenDataset(%s,%s) -> opened %p\n",
+             layer->name, path, hDS );
+
+  return hDS;
+}
+
+/************************************************************************/
+/*                        msGDALReleaseDataset()                        */
+/*                                                                      */
+/*      Give back a handle obtained from msGDALOpenDataset().           */
+/*      Handles that are not in the pool are closed.                    */
+/************************************************************************/
+
+void msGDALReleaseDataset( layerObj *layer, void *hDS )
+
+{
+  int i;
+
+  if( hDS == NULL )
+    return;
+
+  msAcquireLock( TLOCK_POOL );
+  for( i = 0; i < gdalDatasetPoolCount; i++ ) {
+    gdalDatasetPoolEntry *entry = gdalDatasetPool + i;
+
+    if( entry->hDS == hDS ) {
+      entry->ref_count--;
+      if( entry->ref_count == 0 )
+        entry->thread_id = 0;
+      msReleaseLock( TLOCK_POOL );
+      return;
+    }
+  }
+  msReleaseLock( TLOCK_POOL );
+
+  GDALClose( (GDALDatasetH) hDS );
+}
+
+/************************************************************************/
+/*                         msGDALPoolCleanup()                          */
+/*                                                                      */
+/*      Close every pooled handle, in use or not.                       */
+/************************************************************************/
+
+static void msGDALPoolCleanup( void )
+
+{
+  msAcquireLock( TLOCK_POOL );
+  while( gdalDatasetPoolCount > 0 ) {
+    gdalDatasetPoolEntry *entry = gdalDatasetPool + gdalDatasetPoolCount - 1;
+
+    if( entry->ref_count > 0 && entry->debug )
+      msDebug( "msGDALPoolCleanup(): closing %s even though ref_count=%d.\n",
+               entry->path, entry->ref_count );
+    GDALClose( msGDALPoolRemove( gdalDatasetPoolCount - 1 ) );
+  }
+  msReleaseLock( TLOCK_POOL );
+}
+
+/************************************************************************/
+/* ==================================================================== */
+/*      Band scaling statistics cache.                                  */
+/*                                                                      */
+/*      Min/max of a band over the whole dataset, used for automatic    */
+/*      scaling with PROCESSING "SCALE_STATS=DATASET".  Values are      */
+/*      taken from the GDAL statistics metadata (.aux.xml or format     */
+/*      native) when present and the file nodata applies, otherwise     */
+/*      from a decimated read of the best matching overview.  Entries   */
+/*      are keyed by path, band and nodata value and dropped when the   */
+/*      file changes.  The table is protected by TLOCK_POOL, callers    */
+/*      hold TLOCK_GDAL.                                                */
+/* ==================================================================== */
+/************************************************************************/
+
+#define MS_GDAL_STATS_CACHE_SIZE 64
+#define MS_GDAL_STATS_SAMPLE_PIXELS (1024*1024)
+
+typedef struct {
+  char *path;
+  int band;
+  int has_nodata;
+  double nodata;
+
+  int has_stat;
+  time_t mtime;
+  vsi_l_offset size;
+
+  double min, max;
+  unsigned long last_used;
+} gdalBandStatsEntry;
+
+static gdalBandStatsEntry gdalBandStatsCache[MS_GDAL_STATS_CACHE_SIZE];
+static int gdalBandStatsCount = 0;
+static unsigned long gdalBandStatsTick = 0;
+
+/************************************************************************/
+/*                      msGDALComputeScaleRange()                       */
+/************************************************************************/
+
+static int msGDALComputeScaleRange( layerObj *layer, GDALRasterBandH hBand,
+                                    int has_nodata, double nodata,
+                                    double *pdfMin, double *pdfMax )
+
+{
+  const char *pszNODATAOpt = CSLFetchNameValue( layer->processing, "NODATA" );
+  GDALRasterBandH hSample;
+  int nXSize, nYSize, nBufXSize, nBufYSize, i, bGotValue = FALSE;
+  float *pafData, fNoDataValue = (float) nodata;
+  double dfRatio;
+
+  /* -------------------------------------------------------------------- */
+  /*      GDAL statistics exclude the file nodata value only, so they     */
+  /*      are usable if PROCESSING NODATA does not override it.           */
+  /* -------------------------------------------------------------------- */
+  if( pszNODATAOpt == NULL || EQUAL(pszNODATAOpt,"AUTO") ) {
+    if( GDALGetRasterStatistics( hBand, TRUE, FALSE, pdfMin, pdfMax,
+                                 NULL, NULL ) == CE_None ) {
+      if( layer->debug )
+        msDebug( "msGDALGetBandScaleRange(%s): using GDAL statistics.\n",
+                 layer->name );
+      return MS_SUCCESS;
+    }
+    CPLErrorReset();
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Otherwise scan the smallest overview holding enough pixels,     */
+  /*      decimating further on read if there is no such overview.        */
+  /* -------------------------------------------------------------------- */
+  hSample = GDALGetRasterSampleOverview( hBand, MS_GDAL_STATS_SAMPLE_PIXELS );
+  if( hSample == NULL )
+    hSample = hBand;
+
+  nXSize = GDALGetRasterBandXSize( hSample );
+  nYSize = GDALGetRasterBandYSize( hSample );
+  dfRatio = sqrt( (double) nXSize * nYSize / MS_GDAL_STATS_SAMPLE_PIXELS );
+  if( dfRatio < 1.0 )
+    dfRatio = 1.0;
+  nBufXSize = MAX(1, (int) (nXSize / dfRatio));
+  nBufYSize = MAX(1, (int) (nYSize / dfRatio));
+
+  if( layer->debug )
+    msDebug( "msGDALGetBandScaleRange(%s): scanning %dx%d of a %dx%d %s.\n",
+             layer->name, nBufXSize, nBufYSize, nXSize, nYSize,
+             hSample == hBand ? "band" : "overview" );
+
+  pafData = (float *) malloc( sizeof(float) * nBufXSize * nBufYSize );
+  if( pafData == NULL ) {
+    msSetError( MS_MEMERR, "Out of memory allocating %dx%d sample buffer.",
+                "msGDALGetBandScaleRange()", nBufXSize, nBufYSize );
+    return MS_FAILURE;
+  }
+
+  if( GDALRasterIO( hSample, GF_Read, 0, 0, nXSize, nYSize,
+                    pafData, nBufXSize, nBufYSize, GDT_Float32,
+                    0, 0 ) != CE_None ) {
+    free( pafData );
+    msSetError( MS_IOERR, "GDALRasterIO() failed: %s",
+                "msGDALGetBandScaleRange()", CPLGetLastErrorMsg() );
+    return MS_FAILURE;
+  }
+
+  for( i = 0; i < nBufXSize * nBufYSize; i++ ) {
+    if( has_nodata && pafData[i] == fNoDataValue )
+      continue;
+
+    if( !bGotValue ) {
+      *pdfMin = *pdfMax = pafData[i];
+      bGotValue = TRUE;
+    } else {
+      *pdfMin = MIN(*pdfMin,pafData[i]);
+      *pdfMax = MAX(*pdfMax,pafData[i]);
+    }
+  }
+  free( pafData );
+
+  return bGotValue ? MS_SUCCESS : MS_FAILURE;
+}
+
+/************************************************************************/
+/*                      msGDALGetBandScaleRange()                       */
+/*                                                                      */
+/*      Return the cached (or newly computed) min/max of band nBand     */
+/*      of hDS, excluding the layer's nodata value.  Returns            */
+/*      MS_FAILURE if no range is available, in which case the caller   */
+/*      should fall back to scanning the data it has read.              */
+/************************************************************************/
+
+int msGDALGetBandScaleRange( layerObj *layer, void *hDSIn, int nBand,
+                             double *pdfMin, double *pdfMax )
+
+{
+  GDALDatasetH hDS = (GDALDatasetH) hDSIn;
+  GDALRasterBandH hBand = GDALGetRasterBand( hDS, nBand );
+  const char *path = GDALGetDescription( hDS );
+  VSIStatBufL sStat;
+  int i, has_stat, has_nodata = FALSE, lru = -1;
+  double nodata;
+  gdalBandStatsEntry *entry;
+
+  if( hBand == NULL )
+    return MS_FAILURE;
+
+  nodata = msGetGDALNoDataValue( layer, hBand, &has_nodata );
+  if( !has_nodata )
+    nodata = 0.0;
+
+  /* in-memory or unnamed datasets are never cached */
+  if( path == NULL || *path == '\0' )
+    return msGDALComputeScaleRange( layer, hBand, has_nodata, nodata,
+                                    pdfMin, pdfMax );
+
+  has_stat = (VSIStatL( path, &sStat ) == 0);
+
+  msAcquireLock( TLOCK_POOL );
+  for( i = 0; i < gdalBandStatsCount; i++ ) {
+    entry = gdalBandStatsCache + i;
+
+    if( entry->band != nBand || entry->has_nodata != has_nodata
+        || entry->nodata != nodata || strcmp( entry->path, path ) != 0 )
+      continue;
+
+    if( has_stat == entry->has_stat
+        && (!has_stat || (sStat.st_mtime == entry->mtime
+                          && sStat.st_size == entry->size)) ) {
+      *pdfMin = entry->min;
+      *pdfMax = entry->max;
+      entry->last_used = ++gdalBandStatsTick;
+      msReleaseLock( TLOCK_POOL );
+      return MS_SUCCESS;
+    }
+
+    /* the file changed, forget what we knew about it */
+    free( entry->path );
+    gdalBandStatsCache[i--] = gdalBandStatsCache[--gdalBandStatsCount];
+  }
+  msReleaseLock( TLOCK_POOL );
+
+  if( msGDALComputeScaleRange( layer, hBand, has_nodata, nodata,
+                               pdfMin, pdfMax ) != MS_SUCCESS )
+    return MS_FAILURE;
+
+  msAcquireLock( TLOCK_POOL );
+  if( gdalBandStatsCount == MS_GDAL_STATS_CACHE_SIZE ) {
+    for( i = 0; i < gdalBandStatsCount; i++ ) {
+      if( lru == -1 || gdalBandStatsCache[i].last_used < gdalBandStatsCache[lru].last_used )
+        lru = i;
+    }
+    free( gdalBandStatsCache[lru].path );
+    gdalBandStatsCache[lru] = gdalBandStatsCache[--gdalBandStatsCount];
+  }
+
+  entry = gdalBandStatsCache + gdalBandStatsCount++;
+  entry->path = msStrdup( path );
+  entry->band = nBand;
+  entry->has_nodata = has_nodata;
+  entry->nodata = nodata;
+  entry->has_stat = has_stat;
+  entry->mtime = has_stat ? sStat.st_mtime : 0;
+  entry->size = has_stat ? sStat.st_size : 0;
+  entry->min = *pdfMin;
+  entry->max = *pdfMax;
+  entry->last_used = ++gdalBandStatsTick;
+  msReleaseLock( TLOCK_POOL );
+
+  return MS_SUCCESS;
+}
+
+/************************************************************************/
+/*                      msGDALStatsCacheCleanup()                       */
+/************************************************************************/
+
+static void msGDALStatsCacheCleanup( void )
+
+{
+  msAcquireLock( TLOCK_POOL );
+  while( gdalBandStatsCount > 0 )
+    free( gdalBandStatsCache[--gdalBandStatsCount].path );
+  msReleaseLock( TLOCK_POOL );
+}
+
 /************************************************************************/
 /*                           msGDALCleanup()                            */
 /************************************************************************/
@@ -74,6 +521,10 @@ void msGDALCleanup( void )
     int iRepeat = 5;
     msAcquireLock( TLOCK_GDAL );
 
+    msGDALPoolCleanup();
+    msGDALStatsCacheCleanup();
+    msGDALClassLUTCleanup();
+
 #if GDAL_RELEASE_DATE > 20101207
     {
       /*
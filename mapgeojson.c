@@ -0,0 +1,554 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Native GeoJSON output of query results.
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2013 Regents of the University of Minnesota.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/*
+** The GEOJSON output driver writes query results as a GeoJSON
+** FeatureCollection directly to the msIO stream, without going through an
+** OGR datasource and temporary files:
+**
+**   OUTPUTFORMAT
+**     NAME "geojson"
+**     DRIVER "GEOJSON"
+**     FORMATOPTION "PRECISION=6"       # decimals of coordinates
+**     FORMATOPTION "FEATURE_BBOX=YES"  # write a bbox member per feature
+**   END
+**
+** It serves mode=query (QFORMAT=geojson), WMS GetFeatureInfo and WFS
+** GetFeature (through wfs_getfeature_formatlist). The properties written
+** follow the gml_include_items / gml_exclude_items, gml_[item]_alias and
+** gml_[item]_type metadata when OWS support is compiled in; "Integer" and
+** "Real" items are written as JSON numbers. The "featureid" metadata gives
+** the feature id.
+*/
+
+#include <ctype.h>
+
+#include "mapserver.h"
+#include "mapows.h"
+
+#define GEOJSON_BUFFER_SIZE 16384
+
+struct geojsonWriterObj {
+  mapObj *map;
+  FILE *stream;
+  int precision;
+  int bFeatureBBox;
+  int features;
+
+  /* per layer state, set up on the first feature of a layer */
+  layerObj *lp;
+  int featureIdIndex;
+#if defined(USE_WMS_SVR) || defined (USE_WFS_SVR)
+  gmlItemListObj *itemList;
+#endif
+
+  int length;
+  char buffer[GEOJSON_BUFFER_SIZE];
+};
+
+/*
+** Output buffering, everything is written through the writer buffer and
+** handed to msIO in large chunks.
+*/
+static void geojsonFlush(geojsonWriterObj *writer)
+{
+  if(writer->length > 0)
+    msIO_fwrite(writer->buffer, 1, writer->length, writer->stream);
+  writer->length = 0;
+}
+
+static void geojsonWrite(geojsonWriterObj *writer, const char *data, int length)
+{
+  if(writer->length + length > GEOJSON_BUFFER_SIZE) {
+    geojsonFlush(writer);
+    if(length > GEOJSON_BUFFER_SIZE) {
+      msIO_fwrite(data, 1, length, writer->stream);
+      return;
+    }
+  }
+  memcpy(writer->buffer + writer->length, data, length);
+  writer->length += length;
+}
+
+#define geojsonWriteLiteral(writer, literal) geojsonWrite(writer, literal, sizeof(literal)-1)
+
+static void geojsonWriteChar(geojsonWriterObj *writer, char c)
+{
+  if(writer->length == GEOJSON_BUFFER_SIZE)
+    geojsonFlush(writer);
+  writer->buffer[writer->length++] = c;
+}
+
+/* false for NaN and +/-Inf, which JSON can't spell */
+#define geojsonIsFinite(x) (!msIsNan((x) - (x)))
+
+/* write a number with trailing zeros of the decimals removed */
+static void geojsonWriteNumber(geojsonWriterObj *writer, double value)
+{
+  char number[MS_FORMAT_FIXED_MAX_LENGTH];
+  int length;
+
+  if(!geojsonIsFinite(value)) {
+    geojsonWriteLiteral(writer, "null");
+    return;
+  }
+
+  length = msFormatFixed(number, value, writer->precision);
+  if(writer->precision > 0 && strchr(number, '.') != NULL) {
+    while(number[length-1] == '0') length--;
+    if(number[length-1] == '.') length--;
+  }
+
+  if(writer->length + length > GEOJSON_BUFFER_SIZE)
+    geojsonFlush(writer);
+  memcpy(writer->buffer + writer->length, number, length);
+  writer->length += length;
+}
+
+/* write a JSON string, escaping as RFC 4627 requires */
+static void geojsonWriteString(geojsonWriterObj *writer, const char *string)
+{
+  const unsigned char *c;
+  char escaped[8];
+
+  geojsonWriteChar(writer, '"');
+  for(c = (const unsigned char *) string; c && *c; c++) {
+    switch(*c) {
+      case '"':
+        geojsonWriteLiteral(writer, "\\\"");
+        break;
+      case '\\':
+        geojsonWriteLiteral(writer, "\\\\");
+        break;
+      case '\n':
+        geojsonWriteLiteral(writer, "\\n");
+        break;
+      case '\r':
+        geojsonWriteLiteral(writer, "\\r");
+        break;
+      case '\t':
+        geojsonWriteLiteral(writer, "\\t");
+        break;
+      default:
+        if(*c < 0x20) {
+          snprintf(escaped, sizeof(escaped), "\\u%04x", *c);
+          geojsonWrite(writer, escaped, 6);
+        } else
+          geojsonWriteChar(writer, (char) *c);
+    }
+  }
+  geojsonWriteChar(writer, '"');
+}
+
+/* is value a number as JSON spells it? */
+static int geojsonIsNumber(const char *value)
+{
+  const char *c = value;
+
+  if(*c == '-') c++;
+  if(*c == '0')
+    c++;
+  else if(isdigit((unsigned char) *c))
+    while(isdigit((unsigned char) *c)) c++;
+  else
+    return MS_FALSE;
+
+  if(*c == '.') {
+    c++;
+    if(!isdigit((unsigned char) *c)) return MS_FALSE;
+    while(isdigit((unsigned char) *c)) c++;
+  }
+
+  if(*c == 'e' || *c == 'E') {
+    c++;
+    if(*c == '+' || *c == '-') c++;
+    if(!isdigit((unsigned char) *c)) return MS_FALSE;
+    while(isdigit((unsigned char) *c)) c++;
+  }
+
+  return *c == '\0';
+}
+
+/* can every vertex of shape be written as a GeoJSON position? */
+static int geojsonShapeIsFinite(shapeObj *shape)
+{
+  int i, j;
+
+  for(i=0; i<shape->numlines; i++) {
+    for(j=0; j<shape->line[i].numpoints; j++) {
+      if(!geojsonIsFinite(shape->line[i].point[j].x) || !geojsonIsFinite(shape->line[i].point[j].y))
+        return MS_FALSE;
+    }
+  }
+
+  return MS_TRUE;
+}
+
+static void geojsonWritePosition(geojsonWriterObj *writer, pointObj *point)
+{
+  geojsonWriteChar(writer, '[');
+  geojsonWriteNumber(writer, point->x);
+  geojsonWriteChar(writer, ',');
+  geojsonWriteNumber(writer, point->y);
+  geojsonWriteChar(writer, ']');
+}
+
+static void geojsonWriteLine(geojsonWriterObj *writer, lineObj *line)
+{
+  int i;
+
+  geojsonWriteChar(writer, '[');
+  for(i=0; i<line->numpoints; i++) {
+    if(i > 0) geojsonWriteChar(writer, ',');
+    geojsonWritePosition(writer, &(line->point[i]));
+  }
+  geojsonWriteChar(writer, ']');
+}
+
+/* rings of one polygon: the outer ring followed by its holes */
+static void geojsonWritePolygon(geojsonWriterObj *writer, shapeObj *shape, int outer, int *outerlist)
+{
+  int *innerlist, i;
+
+  geojsonWriteChar(writer, '[');
+  geojsonWriteLine(writer, &(shape->line[outer]));
+
+  innerlist = msGetInnerList(shape, outer, outerlist);
+  for(i=0; innerlist && i<shape->numlines; i++) {
+    if(innerlist[i] == MS_TRUE) {
+      geojsonWriteChar(writer, ',');
+      geojsonWriteLine(writer, &(shape->line[i]));
+    }
+  }
+  free(innerlist);
+
+  geojsonWriteChar(writer, ']');
+}
+
+static void geojsonWriteGeometry(geojsonWriterObj *writer, shapeObj *shape)
+{
+  int i, j, *outerlist, numouters, first;
+
+  if(shape->numlines == 0 || shape->type == MS_SHAPE_NULL) {
+    geojsonWriteLiteral(writer, "null");
+    return;
+  }
+
+  switch(shape->type) {
+    case MS_SHAPE_POINT:
+      if(shape->numlines == 1 && shape->line[0].numpoints == 1) {
+        geojsonWriteLiteral(writer, "{\"type\":\"Point\",\"coordinates\":");
+        geojsonWritePosition(writer, &(shape->line[0].point[0]));
+      } else {
+        geojsonWriteLiteral(writer, "{\"type\":\"MultiPoint\",\"coordinates\":[");
+        first = MS_TRUE;
+        for(i=0; i<shape->numlines; i++) {
+          for(j=0; j<shape->line[i].numpoints; j++) {
+            if(!first) geojsonWriteChar(writer, ',');
+            geojsonWritePosition(writer, &(shape->line[i].point[j]));
+            first = MS_FALSE;
+          }
+        }
+        geojsonWriteChar(writer, ']');
+      }
+      break;
+    case MS_SHAPE_LINE:
+      if(shape->numlines == 1) {
+        geojsonWriteLiteral(writer, "{\"type\":\"LineString\",\"coordinates\":");
+        geojsonWriteLine(writer, &(shape->line[0]));
+      } else {
+        geojsonWriteLiteral(writer, "{\"type\":\"MultiLineString\",\"coordinates\":[");
+        for(i=0; i<shape->numlines; i++) {
+          if(i > 0) geojsonWriteChar(writer, ',');
+          geojsonWriteLine(writer, &(shape->line[i]));
+        }
+        geojsonWriteChar(writer, ']');
+      }
+      break;
+    case MS_SHAPE_POLYGON:
+      outerlist = msGetOuterList(shape);
+      numouters = 0;
+      for(i=0; i<shape->numlines; i++)
+        if(outerlist[i] == MS_TRUE) numouters++;
+
+      if(numouters == 1) {
+        geojsonWriteLiteral(writer, "{\"type\":\"Polygon\",\"coordinates\":");
+        for(i=0; i<shape->numlines; i++) {
+          if(outerlist[i] == MS_TRUE)
+            geojsonWritePolygon(writer, shape, i, outerlist);
+        }
+      } else {
+        geojsonWriteLiteral(writer, "{\"type\":\"MultiPolygon\",\"coordinates\":[");
+        first = MS_TRUE;
+        for(i=0; i<shape->numlines; i++) {
+          if(outerlist[i] == MS_TRUE) {
+            if(!first) geojsonWriteChar(writer, ',');
+            geojsonWritePolygon(writer, shape, i, outerlist);
+            first = MS_FALSE;
+          }
+        }
+        geojsonWriteChar(writer, ']');
+      }
+      free(outerlist);
+      break;
+    default:
+      geojsonWriteLiteral(writer, "null");
+      return;
+  }
+
+  geojsonWriteChar(writer, '}');
+}
+
+static void geojsonWriteProperty(geojsonWriterObj *writer, int *first, const char *name, const char *value, const char *type)
+{
+  if(!*first) geojsonWriteChar(writer, ',');
+  *first = MS_FALSE;
+
+  geojsonWriteString(writer, name);
+  geojsonWriteChar(writer, ':');
+  if(value && type && (strcasecmp(type, "Integer") == 0 || strcasecmp(type, "Real") == 0) && geojsonIsNumber(value))
+    geojsonWrite(writer, value, strlen(value));
+  else
+    geojsonWriteString(writer, value ? value : "");
+}
+
+static void geojsonLayerFree(geojsonWriterObj *writer)
+{
+#if defined(USE_WMS_SVR) || defined (USE_WFS_SVR)
+  if(writer->itemList) msGMLFreeItems(writer->itemList);
+  writer->itemList = NULL;
+#endif
+  writer->lp = NULL;
+}
+
+static int geojsonLayerInit(geojsonWriterObj *writer, layerObj *lp)
+{
+  const char *value;
+  int i;
+
+  geojsonLayerFree(writer);
+  writer->lp = lp;
+  writer->featureIdIndex = -1;
+
+  if((value = msOWSLookupMetadata(&(lp->metadata), "OFG", "featureid")) != NULL) {
+    for(i=0; i<lp->numitems; i++) {
+      if(strcasecmp(lp->items[i], value) == 0) {
+        writer->featureIdIndex = i;
+        break;
+      }
+    }
+  }
+
+#if defined(USE_WMS_SVR) || defined (USE_WFS_SVR)
+  writer->itemList = msGMLGetItems(lp, "G");
+  if(writer->itemList == NULL) {
+    msSetError(MS_MISCERR, "Unable to populate item metadata structures", "msGeoJSONStreamWriteShape()");
+    return MS_FAILURE;
+  }
+#endif
+
+  return MS_SUCCESS;
+}
+
+/************************************************************************/
+/*                        msGeoJSONStreamBegin()                        */
+/*                                                                      */
+/*      Start a FeatureCollection on stream. Features are added with    */
+/*      msGeoJSONStreamWriteShape(), which can also be used as a        */
+/*      queryObj sink to write features as they are queried.           */
+/************************************************************************/
+
+geojsonWriterObj *msGeoJSONStreamBegin(mapObj *map, outputFormatObj *format, FILE *stream)
+{
+  geojsonWriterObj *writer;
+  const char *value;
+
+  writer = (geojsonWriterObj *) msSmallCalloc(1, sizeof(geojsonWriterObj));
+  writer->map = map;
+  writer->stream = stream;
+
+  writer->precision = atoi(msGetOutputFormatOption(format, "PRECISION", "6")); /* as GML */
+  if(writer->precision < 0) writer->precision = 0;
+  if(writer->precision > 15) writer->precision = 15;
+  value = msGetOutputFormatOption(format, "FEATURE_BBOX", "NO");
+  writer->bFeatureBBox = (strcasecmp(value, "YES") == 0 || strcasecmp(value, "ON") == 0 || strcasecmp(value, "TRUE") == 0);
+
+  geojsonWriteLiteral(writer, "{\"type\":\"FeatureCollection\",\"features\":[\n");
+
+  return writer;
+}
+
+/************************************************************************/
+/*                      msGeoJSONStreamWriteShape()                     */
+/*                                                                      */
+/*      Write one feature, shape is expected in the map projection.     */
+/************************************************************************/
+
+int msGeoJSONStreamWriteShape(layerObj *lp, shapeObj *shape, void *sinkdata)
+{
+  geojsonWriterObj *writer = (geojsonWriterObj *) sinkdata;
+  int i, first = MS_TRUE;
+
+  if(writer->lp != lp && geojsonLayerInit(writer, lp) != MS_SUCCESS)
+    return MS_FAILURE;
+
+  /* e.g. vertices that failed to reproject, the feature can't be written */
+  if(!geojsonShapeIsFinite(shape)) {
+    msDebug("msGeoJSONStreamWriteShape(): skipping a feature of layer %s with non finite coordinates.\n",
+            lp->name ? lp->name : "");
+    return MS_SUCCESS;
+  }
+
+  if(writer->features > 0)
+    geojsonWriteLiteral(writer, ",\n");
+
+  geojsonWriteLiteral(writer, "{\"type\":\"Feature\"");
+
+  if(writer->featureIdIndex != -1 && shape->values && writer->featureIdIndex < shape->numvalues) {
+    geojsonWriteLiteral(writer, ",\"id\":");
+    geojsonWriteString(writer, shape->values[writer->featureIdIndex]);
+  }
+
+  if(writer->bFeatureBBox && shape->numlines > 0) {
+    geojsonWriteLiteral(writer, ",\"bbox\":[");
+    geojsonWriteNumber(writer, shape->bounds.minx);
+    geojsonWriteChar(writer, ',');
+    geojsonWriteNumber(writer, shape->bounds.miny);
+    geojsonWriteChar(writer, ',');
+    geojsonWriteNumber(writer, shape->bounds.maxx);
+    geojsonWriteChar(writer, ',');
+    geojsonWriteNumber(writer, shape->bounds.maxy);
+    geojsonWriteChar(writer, ']');
+  }
+
+  geojsonWriteLiteral(writer, ",\"geometry\":");
+  geojsonWriteGeometry(writer, shape);
+
+  geojsonWriteLiteral(writer, ",\"properties\":{");
+  for(i=0; i<lp->numitems && i<shape->numvalues; i++) {
+#if defined(USE_WMS_SVR) || defined (USE_WFS_SVR)
+    gmlItemObj *item = &(writer->itemList->items[i]);
+
+    if(!item->visible)
+      continue;
+    geojsonWriteProperty(writer, &first, item->alias ? item->alias : item->name, shape->values[i], item->type);
+#else
+    geojsonWriteProperty(writer, &first, lp->items[i], shape->values[i], NULL);
+#endif
+  }
+  geojsonWriteLiteral(writer, "}}");
+
+  writer->features++;
+
+  /* hand complete features to the client now and then */
+  if(writer->features % 1000 == 0) {
+    geojsonFlush(writer);
+    msIO_flush(writer->stream);
+  }
+
+  return MS_SUCCESS;
+}
+
+/************************************************************************/
+/*                         msGeoJSONStreamEnd()                         */
+/*                                                                      */
+/*      Close the FeatureCollection and release the writer, returns     */
+/*      the number of features written.                                 */
+/************************************************************************/
+
+int msGeoJSONStreamEnd(geojsonWriterObj *writer)
+{
+  int features;
+
+  if(!writer)
+    return 0;
+
+  geojsonWriteLiteral(writer, "\n]}\n");
+  geojsonFlush(writer);
+
+  features = writer->features;
+  geojsonLayerFree(writer);
+  free(writer);
+
+  return features;
+}
+
+/************************************************************************/
+/*                       msGeoJSONWriteFromQuery()                      */
+/*                                                                      */
+/*      Write the query results of all layers, the GEOJSON driver       */
+/*      counterpart of msOGRWriteFromQuery().                           */
+/************************************************************************/
+
+int msGeoJSONWriteFromQuery(mapObj *map, outputFormatObj *format, int sendheaders)
+{
+  geojsonWriterObj *writer;
+  shapeObj shape;
+  layerObj *lp;
+  int i, j, status;
+
+  if(sendheaders) {
+    msIO_setHeader("Content-Type", "%s", format->mimetype ? format->mimetype : "application/json");
+    msIO_sendHeaders();
+  }
+
+  writer = msGeoJSONStreamBegin(map, format, stdout);
+  msInitShape(&shape);
+
+  for(i=0; i<map->numlayers; i++) {
+    lp = GET_LAYER(map, map->layerorder[i]);
+
+    if(!lp->resultcache || lp->resultcache->numresults == 0)
+      continue;
+
+    for(j=0; j<lp->resultcache->numresults; j++) {
+      status = msLayerGetShape(lp, &shape, &(lp->resultcache->results[j]));
+      if(status != MS_SUCCESS) {
+        msGeoJSONStreamEnd(writer);
+        return status;
+      }
+
+#ifdef USE_PROJ
+      if(msProjectionsDiffer(&(lp->projection), &(map->projection)))
+        msProjectShape(&lp->projection, &map->projection, &shape);
+#endif
+
+      status = msGeoJSONStreamWriteShape(lp, &shape, writer);
+      msFreeShape(&shape);
+      if(status != MS_SUCCESS) {
+        msGeoJSONStreamEnd(writer);
+        return status;
+      }
+    }
+  }
+
+  msGeoJSONStreamEnd(writer);
+
+  return MS_SUCCESS;
+}
@@ -33,6 +33,14 @@
 
 #include <geos_c.h>
 
+/* prepared geometries appeared in GEOS 3.1, most prepared predicates in 3.3 */
+#if GEOS_VERSION_MAJOR > 3 || (GEOS_VERSION_MAJOR == 3 && GEOS_VERSION_MINOR >= 1)
+#define MS_GEOS_PREPARED
+#endif
+#if GEOS_VERSION_MAJOR > 3 || (GEOS_VERSION_MAJOR == 3 && GEOS_VERSION_MINOR >= 3)
+#define MS_GEOS_PREPARED_ALL
+#endif
+
 /*
 ** Error handling...
 */
@@ -589,8 +597,16 @@ void msGEOSFreeGeometry(shapeObj *shape)
   if(!shape || !shape->geometry)
     return;
 
+#ifdef MS_GEOS_PREPARED
+  /* the prepared geometry references the geometry, free it first */
+  if(shape->prepared_geometry)
+    GEOSPreparedGeom_destroy((const GEOSPreparedGeometry *) shape->prepared_geometry);
+#endif
+  shape->prepared_geometry = NULL;
+
   g = (GEOSGeom) shape->geometry;
   GEOSGeom_destroy(g);
+  shape->geometry = NULL;
 #else
   msSetError(MS_GEOSERR, "GEOS support is not available.", "msGEOSFreeGEOSGeom()");
   return;
@@ -924,6 +940,44 @@ shapeObj *msGEOSSymDifference(shapeObj *shape1, shapeObj *shape2)
 #endif
 }
 
+/*
+** Prepare the geometry of a shape that is tested against many others, such
+** as a query shape or a fromText() literal of an expression. The predicates
+** below use the prepared geometry (which indexes its segments) whenever one
+** of their arguments has one. It is released with the geometry. Returns
+** MS_FAILURE if GEOS is too old or the geometry can't be built, the
+** predicates then work as before.
+*/
+int msGEOSPrepare(shapeObj *shape)
+{
+#ifdef USE_GEOS
+#ifdef MS_GEOS_PREPARED
+  if(!shape)
+    return MS_FAILURE;
+
+  if(shape->prepared_geometry)
+    return MS_SUCCESS;
+
+  if(!shape->geometry) /* if no geometry for the shape then build one */
+    shape->geometry = (GEOSGeom) msGEOSShape2Geometry(shape);
+  if(!shape->geometry)
+    return MS_FAILURE;
+
+  shape->prepared_geometry = (void *) GEOSPrepare((GEOSGeom) shape->geometry);
+  return (shape->prepared_geometry) ? MS_SUCCESS : MS_FAILURE;
+#else
+  return MS_FAILURE;
+#endif
+#else
+  msSetError(MS_GEOSERR, "GEOS support is not available.", "msGEOSPrepare()");
+  return MS_FAILURE;
+#endif
+}
+
+#ifdef MS_GEOS_PREPARED
+#define MS_GEOS_PREPARED_GEOM(shape) ((const GEOSPreparedGeometry *) (shape)->prepared_geometry)
+#endif
+
 /*
 ** Binary predicates exposed to MapServer/MapScript
 */
@@ -950,7 +1004,16 @@ int msGEOSContains(shapeObj *shape1, shapeObj *shape2)
   g2 = shape2->geometry;
   if(!g2) return -1;
 
-  result = GEOSContains(g1, g2);
+#ifdef MS_GEOS_PREPARED
+  if(shape1->prepared_geometry)
+    result = GEOSPreparedContains(MS_GEOS_PREPARED_GEOM(shape1), g2);
+#ifdef MS_GEOS_PREPARED_ALL
+  else if(shape2->prepared_geometry)
+    result = GEOSPreparedWithin(MS_GEOS_PREPARED_GEOM(shape2), g1);
+#endif
+  else
+#endif
+    result = GEOSContains(g1, g2);
   return ((result==2) ? -1 : result);
 #else
   msSetError(MS_GEOSERR, "GEOS support is not available.", "msGEOSContains()");
@@ -980,7 +1043,14 @@ int msGEOSOverlaps(shapeObj *shape1, shapeObj *shape2)
   g2 = shape2->geometry;
   if(!g2) return -1;
 
-  result = GEOSOverlaps(g1, g2);
+#ifdef MS_GEOS_PREPARED_ALL
+  if(shape1->prepared_geometry)
+    result = GEOSPreparedOverlaps(MS_GEOS_PREPARED_GEOM(shape1), g2);
+  else if(shape2->prepared_geometry)
+    result = GEOSPreparedOverlaps(MS_GEOS_PREPARED_GEOM(shape2), g1);
+  else
+#endif
+    result = GEOSOverlaps(g1, g2);
   return ((result==2) ? -1 : result);
 #else
   msSetError(MS_GEOSERR, "GEOS support is not available.", "msGEOSOverlaps()");
@@ -1010,7 +1080,16 @@ int msGEOSWithin(shapeObj *shape1, shapeObj *shape2)
   g2 = shape2->geometry;
   if(!g2) return -1;
 
-  result = GEOSWithin(g1, g2);
+#ifdef MS_GEOS_PREPARED
+  if(shape2->prepared_geometry) /* shape1 within shape2 is shape2 contains shape1 */
+    result = GEOSPreparedContains(MS_GEOS_PREPARED_GEOM(shape2), g1);
+#ifdef MS_GEOS_PREPARED_ALL
+  else if(shape1->prepared_geometry)
+    result = GEOSPreparedWithin(MS_GEOS_PREPARED_GEOM(shape1), g2);
+#endif
+  else
+#endif
+    result = GEOSWithin(g1, g2);
   return ((result==2) ? -1 : result);
 #else
   msSetError(MS_GEOSERR, "GEOS support is not available.", "msGEOSWithin()");
@@ -1040,7 +1119,12 @@ int msGEOSCrosses(shapeObj *shape1, shapeObj *shape2)
   g2 = shape2->geometry;
   if(!g2) return -1;
 
-  result = GEOSCrosses(g1, g2);
+#ifdef MS_GEOS_PREPARED_ALL
+  if(shape1->prepared_geometry)
+    result = GEOSPreparedCrosses(MS_GEOS_PREPARED_GEOM(shape1), g2);
+  else
+#endif
+    result = GEOSCrosses(g1, g2);
   return ((result==2) ? -1 : result);
 #else
   msSetError(MS_GEOSERR, "GEOS support is not available.", "msGEOSCrosses()");
@@ -1070,7 +1154,14 @@ int msGEOSIntersects(shapeObj *shape1, shapeObj *shape2)
   g2 = (GEOSGeom) shape2->geometry;
   if(!g2) return -1;
 
-  result = GEOSIntersects(g1, g2);
+#ifdef MS_GEOS_PREPARED
+  if(shape1->prepared_geometry)
+    result = GEOSPreparedIntersects(MS_GEOS_PREPARED_GEOM(shape1), g2);
+  else if(shape2->prepared_geometry)
+    result = GEOSPreparedIntersects(MS_GEOS_PREPARED_GEOM(shape2), g1);
+  else
+#endif
+    result = GEOSIntersects(g1, g2);
   return ((result==2) ? -1 : result);
 #else
   if(!shape1 || !shape2)
@@ -1121,7 +1212,14 @@ int msGEOSTouches(shapeObj *shape1, shapeObj *shape2)
   g2 = (GEOSGeom) shape2->geometry;
   if(!g2) return -1;
 
-  result = GEOSTouches(g1, g2);
+#ifdef MS_GEOS_PREPARED_ALL
+  if(shape1->prepared_geometry)
+    result = GEOSPreparedTouches(MS_GEOS_PREPARED_GEOM(shape1), g2);
+  else if(shape2->prepared_geometry)
+    result = GEOSPreparedTouches(MS_GEOS_PREPARED_GEOM(shape2), g1);
+  else
+#endif
+    result = GEOSTouches(g1, g2);
   return ((result==2) ? -1 : result);
 #else
   msSetError(MS_GEOSERR, "GEOS support is not available.", "msGEOSTouches()");
@@ -1181,7 +1279,14 @@ int msGEOSDisjoint(shapeObj *shape1, shapeObj *shape2)
   g2 = (GEOSGeom) shape2->geometry;
   if(!g2) return -1;
 
-  result = GEOSDisjoint(g1, g2);
+#ifdef MS_GEOS_PREPARED_ALL
+  if(shape1->prepared_geometry)
+    result = GEOSPreparedDisjoint(MS_GEOS_PREPARED_GEOM(shape1), g2);
+  else if(shape2->prepared_geometry)
+    result = GEOSPreparedDisjoint(MS_GEOS_PREPARED_GEOM(shape2), g1);
+  else
+#endif
+    result = GEOSDisjoint(g1, g2);
   return ((result==2) ? -1 : result);
 #else
   msSetError(MS_GEOSERR, "GEOS support is not available.", "msGEOSDisjoint()");
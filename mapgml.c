@@ -95,6 +95,49 @@ static int gmlWriteBounds_GML3(FILE *stream, rectObj *rect, const char *srsname,
   return MS_SUCCESS;
 }
 
+/*
+** Coordinate output. Printing every number through msIO_fprintf() costs a
+** _ms_vsprintf() and an IO context lookup each, which dominates GetFeature
+** time. Coordinates are formatted with msFormatFixed() instead, and
+** coordinate lists go through a local buffer written out in large chunks.
+*/
+
+#define GML_COORD_BUFFER_SIZE 8192
+#define GML_COORD_MAX_LENGTH MS_FORMAT_FIXED_MAX_LENGTH
+
+/* format a single position as "x<separator>y", pos must hold 2*GML_COORD_MAX_LENGTH+2 bytes */
+static char *gmlFormatPos(char *pos, pointObj *point, char separator, int precision)
+{
+  int len;
+
+  len = msFormatFixed(pos, point->x, precision);
+  pos[len++] = separator;
+  msFormatFixed(pos+len, point->y, precision);
+
+  return pos;
+}
+
+/* write the points of a line as "x<separator>y " each */
+static void gmlWritePosList(FILE *stream, lineObj *line, char separator, int precision)
+{
+  char buffer[GML_COORD_BUFFER_SIZE];
+  int i, len = 0;
+
+  for(i=0; i<line->numpoints; i++) {
+    if(len > GML_COORD_BUFFER_SIZE - 2*GML_COORD_MAX_LENGTH - 3) {
+      msIO_fwrite(buffer, 1, len, stream);
+      len = 0;
+    }
+    len += msFormatFixed(buffer+len, line->point[i].x, precision);
+    buffer[len++] = separator;
+    len += msFormatFixed(buffer+len, line->point[i].y, precision);
+    buffer[len++] = ' ';
+  }
+
+  if(len > 0)
+    msIO_fwrite(buffer, 1, len, stream);
+}
+
 static void gmlStartGeometryContainer(FILE *stream, char *name, char *namespace, const char *tab)
 {
   const char *tag_name=OWS_GML_DEFAULT_GEOMETRY_NAME;
@@ -125,6 +168,7 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
   int i, j, k;
   int *innerlist, *outerlist, numouters;
   char *srsname_encoded = NULL;
+  char pos[2*GML_COORD_MAX_LENGTH+2];
 
   int geometry_aggregate_index, geometry_simple_index;
   char *geometry_aggregate_name = NULL, *geometry_simple_name = NULL;
@@ -160,7 +204,7 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
               msIO_fprintf(stream, "%s<gml:Point srsName=\"%s\">\n", tab, srsname_encoded);
             else
               msIO_fprintf(stream, "%s<gml:Point>\n", tab);
-            msIO_fprintf(stream, "%s  <gml:coordinates>%f,%f</gml:coordinates>\n", tab, shape->line[i].point[j].x, shape->line[i].point[j].y);
+            msIO_fprintf(stream, "%s  <gml:coordinates>%s</gml:coordinates>\n", tab, gmlFormatPos(pos, &(shape->line[i].point[j]), ',', geometryList->precision));
             msIO_fprintf(stream, "%s</gml:Point>\n", tab);
 
             gmlEndGeometryContainer(stream, geometry_simple_name, namespace, tab);
@@ -179,7 +223,7 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
           for(j=0; j<shape->line[i].numpoints; j++) {
             msIO_fprintf(stream, "%s  <gml:pointMember>\n", tab);
             msIO_fprintf(stream, "%s    <gml:Point>\n", tab);
-            msIO_fprintf(stream, "%s      <gml:coordinates>%f,%f</gml:coordinates>\n", tab, shape->line[i].point[j].x, shape->line[i].point[j].y);
+            msIO_fprintf(stream, "%s      <gml:coordinates>%s</gml:coordinates>\n", tab, gmlFormatPos(pos, &(shape->line[i].point[j]), ',', geometryList->precision));
             msIO_fprintf(stream, "%s    </gml:Point>\n", tab);
             msIO_fprintf(stream, "%s  </gml:pointMember>\n", tab);
           }
@@ -212,8 +256,7 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
             msIO_fprintf(stream, "%s<gml:LineString>\n", tab);
 
           msIO_fprintf(stream, "%s  <gml:coordinates>", tab);
-          for(j=0; j<shape->line[i].numpoints; j++)
-            msIO_fprintf(stream, "%f,%f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+          gmlWritePosList(stream, &(shape->line[i]), ',', geometryList->precision);
           msIO_fprintf(stream, "</gml:coordinates>\n");
 
           msIO_fprintf(stream, "%s</gml:LineString>\n", tab);
@@ -234,8 +277,7 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
           msIO_fprintf(stream, "%s    <gml:LineString>\n", tab); /* no srsname at this point */
 
           msIO_fprintf(stream, "%s      <gml:coordinates>", tab);
-          for(i=0; i<shape->line[j].numpoints; i++)
-            msIO_fprintf(stream, "%f,%f ", shape->line[j].point[i].x, shape->line[j].point[i].y);
+          gmlWritePosList(stream, &(shape->line[j]), ',', geometryList->precision);
           msIO_fprintf(stream, "</gml:coordinates>\n");
           msIO_fprintf(stream, "%s    </gml:LineString>\n", tab);
           msIO_fprintf(stream, "%s  </gml:lineStringMember>\n", tab);
@@ -283,8 +325,7 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
           msIO_fprintf(stream, "%s    <gml:LinearRing>\n", tab);
 
           msIO_fprintf(stream, "%s      <gml:coordinates>", tab);
-          for(j=0; j<shape->line[i].numpoints; j++)
-            msIO_fprintf(stream, "%f,%f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+          gmlWritePosList(stream, &(shape->line[i]), ',', geometryList->precision);
           msIO_fprintf(stream, "</gml:coordinates>\n");
 
           msIO_fprintf(stream, "%s    </gml:LinearRing>\n", tab);
@@ -296,8 +337,7 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
               msIO_fprintf(stream, "%s    <gml:LinearRing>\n", tab);
 
               msIO_fprintf(stream, "%s      <gml:coordinates>", tab);
-              for(j=0; j<shape->line[k].numpoints; j++)
-                msIO_fprintf(stream, "%f,%f ", shape->line[k].point[j].x, shape->line[k].point[j].y);
+              gmlWritePosList(stream, &(shape->line[k]), ',', geometryList->precision);
               msIO_fprintf(stream, "</gml:coordinates>\n");
 
               msIO_fprintf(stream, "%s    </gml:LinearRing>\n", tab);
@@ -331,8 +371,7 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
             msIO_fprintf(stream, "%s      <gml:LinearRing>\n", tab);
 
             msIO_fprintf(stream, "%s        <gml:coordinates>", tab);
-            for(j=0; j<shape->line[i].numpoints; j++)
-              msIO_fprintf(stream, "%f,%f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+            gmlWritePosList(stream, &(shape->line[i]), ',', geometryList->precision);
             msIO_fprintf(stream, "</gml:coordinates>\n");
 
             msIO_fprintf(stream, "%s      </gml:LinearRing>\n", tab);
@@ -344,8 +383,7 @@ static int gmlWriteGeometry_GML2(FILE *stream, gmlGeometryListObj *geometryList,
                 msIO_fprintf(stream, "%s      <gml:LinearRing>\n", tab);
 
                 msIO_fprintf(stream, "%s        <gml:coordinates>", tab);
-                for(j=0; j<shape->line[k].numpoints; j++)
-                  msIO_fprintf(stream, "%f,%f ", shape->line[k].point[j].x, shape->line[k].point[j].y);
+                gmlWritePosList(stream, &(shape->line[k]), ',', geometryList->precision);
                 msIO_fprintf(stream, "</gml:coordinates>\n");
 
                 msIO_fprintf(stream, "%s      </gml:LinearRing>\n", tab);
@@ -385,6 +423,7 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
   int i, j, k;
   int *innerlist, *outerlist, numouters;
   char *srsname_encoded = NULL;
+  char pos[2*GML_COORD_MAX_LENGTH+2];
 
   int geometry_aggregate_index, geometry_simple_index;
   char *geometry_aggregate_name = NULL, *geometry_simple_name = NULL;
@@ -420,7 +459,7 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
               msIO_fprintf(stream, "%s  <gml:Point srsName=\"%s\">\n", tab, srsname_encoded);
             else
               msIO_fprintf(stream, "%s  <gml:Point>\n", tab);
-            msIO_fprintf(stream, "%s    <gml:pos>%f %f</gml:pos>\n", tab, shape->line[i].point[j].x, shape->line[i].point[j].y);
+            msIO_fprintf(stream, "%s    <gml:pos>%s</gml:pos>\n", tab, gmlFormatPos(pos, &(shape->line[i].point[j]), ' ', geometryList->precision));
             msIO_fprintf(stream, "%s  </gml:Point>\n", tab);
 
             gmlEndGeometryContainer(stream, geometry_simple_name, namespace, tab);
@@ -439,7 +478,7 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
         for(i=0; i<shape->numlines; i++) {
           for(j=0; j<shape->line[i].numpoints; j++) {
             msIO_fprintf(stream, "%s      <gml:Point>\n", tab);
-            msIO_fprintf(stream, "%s        <gml:pos>%f %f</gml:pos>\n", tab, shape->line[i].point[j].x, shape->line[i].point[j].y);
+            msIO_fprintf(stream, "%s        <gml:pos>%s</gml:pos>\n", tab, gmlFormatPos(pos, &(shape->line[i].point[j]), ' ', geometryList->precision));
             msIO_fprintf(stream, "%s      </gml:Point>\n", tab);
           }
         }
@@ -472,8 +511,7 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
             msIO_fprintf(stream, "%s  <gml:LineString>\n", tab);
 
           msIO_fprintf(stream, "%s    <gml:posList srsDimension=\"2\">", tab);
-          for(j=0; j<shape->line[i].numpoints; j++)
-            msIO_fprintf(stream, "%f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+          gmlWritePosList(stream, &(shape->line[i]), ' ', geometryList->precision);
           msIO_fprintf(stream, "</gml:posList>\n");
 
           msIO_fprintf(stream, "%s  </gml:LineString>\n", tab);
@@ -494,8 +532,7 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
           msIO_fprintf(stream, "%s      <gml:LineString>\n", tab); /* no srsname at this point */
 
           msIO_fprintf(stream, "%s        <gml:posList srsDimension=\"2\">", tab);
-          for(j=0; j<shape->line[i].numpoints; j++)
-            msIO_fprintf(stream, "%f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+          gmlWritePosList(stream, &(shape->line[i]), ' ', geometryList->precision);
           msIO_fprintf(stream, "</gml:posList>\n");
           msIO_fprintf(stream, "%s      </gml:LineString>\n", tab);
         }
@@ -543,8 +580,7 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
           msIO_fprintf(stream, "%s      <gml:LinearRing>\n", tab);
 
           msIO_fprintf(stream, "%s        <gml:posList srsDimension=\"2\">", tab);
-          for(j=0; j<shape->line[i].numpoints; j++)
-            msIO_fprintf(stream, "%f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+          gmlWritePosList(stream, &(shape->line[i]), ' ', geometryList->precision);
           msIO_fprintf(stream, "</gml:posList>\n");
 
           msIO_fprintf(stream, "%s      </gml:LinearRing>\n", tab);
@@ -556,8 +592,7 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
               msIO_fprintf(stream, "%s      <gml:LinearRing>\n", tab);
 
               msIO_fprintf(stream, "%s        <gml:posList srsDimension=\"2\">", tab);
-              for(j=0; j<shape->line[k].numpoints; j++)
-                msIO_fprintf(stream, "%f %f ", shape->line[k].point[j].x, shape->line[k].point[j].y);
+              gmlWritePosList(stream, &(shape->line[k]), ' ', geometryList->precision);
               msIO_fprintf(stream, "</gml:posList>\n");
 
               msIO_fprintf(stream, "%s      </gml:LinearRing>\n", tab);
@@ -593,8 +628,7 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
             msIO_fprintf(stream, "%s          <gml:LinearRing>\n", tab);
 
             msIO_fprintf(stream, "%s            <gml:posList srsDimension=\"2\">", tab);
-            for(j=0; j<shape->line[i].numpoints; j++)
-              msIO_fprintf(stream, "%f %f ", shape->line[i].point[j].x, shape->line[i].point[j].y);
+            gmlWritePosList(stream, &(shape->line[i]), ' ', geometryList->precision);
             msIO_fprintf(stream, "</gml:posList>\n");
 
             msIO_fprintf(stream, "%s          </gml:LinearRing>\n", tab);
@@ -606,8 +640,7 @@ static int gmlWriteGeometry_GML3(FILE *stream, gmlGeometryListObj *geometryList,
                 msIO_fprintf(stream, "%s          <gml:LinearRing>\n", tab);
 
                 msIO_fprintf(stream, "%s            <gml:posList srsDimension=\"2\">", tab);
-                for(j=0; j<shape->line[k].numpoints; j++)
-                  msIO_fprintf(stream, "%f %f ", shape->line[k].point[j].x, shape->line[k].point[j].y);
+                gmlWritePosList(stream, &(shape->line[k]), ' ', geometryList->precision);
                 msIO_fprintf(stream, "</gml:posList>\n");
 
                 msIO_fprintf(stream, "%s          </gml:LinearRing>\n", tab);
@@ -728,6 +761,13 @@ gmlGeometryListObj *msGMLGetGeometries(layerObj *layer, const char *metadata_nam
   MS_CHECK_ALLOC(geometryList, sizeof(gmlGeometryListObj), NULL) ;
   geometryList->geometries = NULL;
   geometryList->numgeometries = 0;
+  geometryList->precision = OWS_GML_DEFAULT_PRECISION;
+
+  if((value = msOWSLookupMetadata(&(layer->metadata), metadata_namespaces, "geometry_precision")) != NULL) {
+    geometryList->precision = atoi(value);
+    if(geometryList->precision < 0) geometryList->precision = 0;
+    if(geometryList->precision > OWS_GML_MAX_PRECISION) geometryList->precision = OWS_GML_MAX_PRECISION;
+  }
 
   if((value = msOWSLookupMetadata(&(layer->metadata), metadata_namespaces, "geometries")) != NULL) {
     names = msStringSplit(value, ',', &numnames);
@@ -1341,30 +1381,40 @@ void msAxisSwapShape(shapeObj *shape)
 **
 ** Similar to msGMLWriteQuery() but tuned for use with WFS 1.0.0
 */
-int msGMLWriteWFSQuery(mapObj *map, FILE *stream, char *default_namespace_prefix, int outputformat)
-{
 #ifdef USE_WFS_SVR
-  int status;
-  int i,j,k;
-  layerObj *lp=NULL;
-  shapeObj shape;
-  rectObj  resultBounds = {-1.0,-1.0,-1.0,-1.0};
-  int features = 0;
-
-  gmlGroupListObj *groupList=NULL;
-  gmlItemListObj *itemList=NULL;
-  gmlConstantListObj *constantList=NULL;
-  gmlGeometryListObj *geometryList=NULL;
-  gmlItemObj *item=NULL;
-  gmlConstantObj *constant=NULL;
 
-  char *namespace_prefix=NULL;
+/*
+** Per layer state of the WFS feature writer, shared by msGMLWriteWFSQuery()
+** and the streaming writer below.
+*/
+typedef struct {
+  layerObj *lp;
+  char *layerName;
+  char *namespace_prefix;
+  int featureIdIndex; /* -1 if no feature id */
+  gmlItemListObj *itemList;
+  gmlConstantListObj *constantList;
+  gmlGroupListObj *groupList;
+  gmlGeometryListObj *geometryList;
+} gmlWFSLayerWriter;
+
+struct gmlWFSStreamObj {
+  mapObj *map;
+  FILE *stream;
+  char *default_namespace_prefix;
+  int outputformat;
+  int bSwapAxis;
+  int features;
+  gmlWFSLayerWriter writer; /* writer.lp is NULL until the first feature */
+};
+
+/* flush the output every that many streamed features */
+#define MS_GML_STREAM_FLUSH_INTERVAL 1000
+
+static int gmlIsAxisSwapped(mapObj *map)
+{
   const char *axis = NULL;
-  int bSwapAxis = 0;
-  double tmp;
-  const char *srsMap =  NULL;
-
-  msInitShape(&shape);
+  int i;
 
   /*add a check to see if the map projection is set to be north-east*/
   for( i = 0; i < map->projection.numargs; i++ ) {
@@ -1374,9 +1424,161 @@ int msGMLWriteWFSQuery(mapObj *map, FILE *stream, char *default_namespace_prefix
     }
   }
 
-  if (axis && strcasecmp(axis,"ne") == 0 )
-    bSwapAxis = 1;
+  return (axis && strcasecmp(axis,"ne") == 0 );
+}
+
+static int gmlWFSLayerWriterInit(gmlWFSLayerWriter *writer, FILE *stream, layerObj *lp, char *default_namespace_prefix)
+{
+  const char *value;
+  int j;
+
+  memset(writer, 0, sizeof(gmlWFSLayerWriter));
+  writer->lp = lp;
+  writer->featureIdIndex = -1;
+
+  /* setup namespace, a layer can override the default */
+  writer->namespace_prefix = (char*) msOWSLookupMetadata(&(lp->metadata), "OFG", "namespace_prefix");
+  if(!writer->namespace_prefix) writer->namespace_prefix = default_namespace_prefix;
+
+  value = msOWSLookupMetadata(&(lp->metadata), "OFG", "featureid");
+  if(value) { /* find the featureid amongst the items for this layer */
+    for(j=0; j<lp->numitems; j++) {
+      if(strcasecmp(lp->items[j], value) == 0) { /* found it */
+        writer->featureIdIndex = j;
+        break;
+      }
+    }
+
+    /* Produce a warning if a featureid was set but the corresponding item is not found. */
+    if (writer->featureIdIndex == -1)
+      msIO_fprintf(stream, "<!-- WARNING: FeatureId item '%s' not found in typename '%s'. -->\n", value, lp->name);
+  }
+
+  /* populate item and group metadata structures */
+  writer->itemList = msGMLGetItems(lp, "G");
+  writer->constantList = msGMLGetConstants(lp, "G");
+  writer->groupList = msGMLGetGroups(lp, "G");
+  writer->geometryList = msGMLGetGeometries(lp, "GFO");
+  if (writer->itemList == NULL || writer->constantList == NULL || writer->groupList == NULL || writer->geometryList == NULL) {
+    msSetError(MS_MISCERR, "Unable to populate item and group metadata structures", "msGMLWriteWFSQuery()");
+    return MS_FAILURE;
+  }
+
+  if (writer->namespace_prefix) {
+    writer->layerName = (char *) msSmallMalloc(strlen(writer->namespace_prefix)+strlen(lp->name)+2);
+    sprintf(writer->layerName, "%s:%s", writer->namespace_prefix, lp->name);
+  } else {
+    writer->layerName = msStrdup(lp->name);
+  }
+
+  return MS_SUCCESS;
+}
+
+static void gmlWFSLayerWriterFree(gmlWFSLayerWriter *writer)
+{
+  msFree(writer->layerName);
+
+  if(writer->groupList) msGMLFreeGroups(writer->groupList);
+  if(writer->constantList) msGMLFreeConstants(writer->constantList);
+  if(writer->itemList) msGMLFreeItems(writer->itemList);
+  if(writer->geometryList) msGMLFreeGeometries(writer->geometryList);
+
+  memset(writer, 0, sizeof(gmlWFSLayerWriter));
+}
+
+/*
+** Write one gml:featureMember, the shape is expected in the map projection.
+*/
+static void gmlWFSWriteFeature(FILE *stream, mapObj *map, gmlWFSLayerWriter *writer, shapeObj *shape, int outputformat, int bSwapAxis)
+{
+  layerObj *lp = writer->lp;
+  gmlGeometryListObj *geometryList = writer->geometryList;
+  char *layerName = writer->layerName;
+  char *namespace_prefix = writer->namespace_prefix;
+  gmlItemObj *item=NULL;
+  gmlConstantObj *constant=NULL;
+  int k;
+#ifdef USE_PROJ
+  const char *srsMap =  NULL;
+#endif
+
+  /*
+  ** start this feature
+  */
+  msIO_fprintf(stream, "    <gml:featureMember>\n");
+  if(msIsXMLTagValid(layerName) == MS_FALSE)
+    msIO_fprintf(stream, "<!-- WARNING: The value '%s' is not valid in a XML tag context. -->\n", layerName);
+  if(writer->featureIdIndex != -1) {
+    if(outputformat == OWS_GML2)
+      msIO_fprintf(stream, "      <%s fid=\"%s.%s\">\n", layerName, lp->name, shape->values[writer->featureIdIndex]);
+    else  /* OWS_GML3 */
+      msIO_fprintf(stream, "      <%s gml:id=\"%s.%s\">\n", layerName, lp->name, shape->values[writer->featureIdIndex]);
+  } else
+    msIO_fprintf(stream, "      <%s>\n", layerName);
+
+  if (bSwapAxis)
+    msAxisSwapShape(shape);
+
+  /* write the feature geometry and bounding box */
+  if(!(geometryList && geometryList->numgeometries == 1 && strcasecmp(geometryList->geometries[0].name, "none") == 0)) {
+#ifdef USE_PROJ
+    srsMap = msOWSGetEPSGProj(&(map->projection), NULL, "FGO", MS_TRUE);
+    if (!srsMap)
+      msOWSGetEPSGProj(&(map->projection), &(map->web.metadata), "FGO", MS_TRUE);
+    if(srsMap) { /* use the map projection first*/
+      gmlWriteBounds(stream, outputformat, &(shape->bounds), srsMap, "        ");
+      gmlWriteGeometry(stream, geometryList, outputformat, shape, srsMap, namespace_prefix, "        ");
+    } else { /* then use the layer projection and/or metadata */
+      gmlWriteBounds(stream, outputformat, &(shape->bounds), msOWSGetEPSGProj(&(lp->projection), &(lp->metadata), "FGO", MS_TRUE), "        ");
+      gmlWriteGeometry(stream, geometryList, outputformat, shape, msOWSGetEPSGProj(&(lp->projection), &(lp->metadata), "FGO", MS_TRUE), namespace_prefix, "        ");
+    }
+#else
+    gmlWriteBounds(stream, outputformat, &(shape->bounds), NULL, "        "); /* no projection information */
+    gmlWriteGeometry(stream, geometryList, outputformat, shape, NULL, namespace_prefix, "        ");
+#endif
+  }
+
+  /* write any item/values */
+  for(k=0; k<writer->itemList->numitems; k++) {
+    item = &(writer->itemList->items[k]);
+    if(msItemInGroups(item->name, writer->groupList) == MS_FALSE)
+      msGMLWriteItem(stream, item, shape->values[k], namespace_prefix, "        ");
+  }
+
+  /* write any constants */
+  for(k=0; k<writer->constantList->numconstants; k++) {
+    constant = &(writer->constantList->constants[k]);
+    if(msItemInGroups(constant->name, writer->groupList) == MS_FALSE)
+      msGMLWriteConstant(stream, constant, namespace_prefix, "        ");
+  }
+
+  /* write any groups */
+  for(k=0; k<writer->groupList->numgroups; k++)
+    msGMLWriteGroup(stream, &(writer->groupList->groups[k]), shape, writer->itemList, writer->constantList, namespace_prefix, "        ");
+
+  /* end this feature */
+  msIO_fprintf(stream, "      </%s>\n", layerName);
+  msIO_fprintf(stream, "    </gml:featureMember>\n");
+}
+
+#endif /* USE_WFS_SVR */
+
+int msGMLWriteWFSQuery(mapObj *map, FILE *stream, char *default_namespace_prefix, int outputformat)
+{
+#ifdef USE_WFS_SVR
+  int status;
+  int i,j;
+  layerObj *lp=NULL;
+  shapeObj shape;
+  rectObj  resultBounds = {-1.0,-1.0,-1.0,-1.0};
+  gmlWFSLayerWriter writer;
+  int bSwapAxis = 0;
+  double tmp;
+  const char *srsMap =  NULL;
+
+  msInitShape(&shape);
 
+  bSwapAxis = gmlIsAxisSwapped(map);
 
   /* Need to start with BBOX of the whole resultset */
   if (msGetQueryResultBounds(map, &resultBounds) > 0) {
@@ -1402,52 +1604,19 @@ int msGMLWriteWFSQuery(mapObj *map, FILE *stream, char *default_namespace_prefix
     lp = GET_LAYER(map, map->layerorder[i]);
 
     if(lp->resultcache && lp->resultcache->numresults > 0)  { /* found results */
-      char *layerName;
-      const char *value;
-      int featureIdIndex=-1; /* no feature id */
-
-
-      /* setup namespace, a layer can override the default */
-      namespace_prefix = (char*) msOWSLookupMetadata(&(lp->metadata), "OFG", "namespace_prefix");
-      if(!namespace_prefix) namespace_prefix = default_namespace_prefix;
-
-      value = msOWSLookupMetadata(&(lp->metadata), "OFG", "featureid");
-      if(value) { /* find the featureid amongst the items for this layer */
-        for(j=0; j<lp->numitems; j++) {
-          if(strcasecmp(lp->items[j], value) == 0) { /* found it */
-            featureIdIndex = j;
-            break;
-          }
-        }
 
-        /* Produce a warning if a featureid was set but the corresponding item is not found. */
-        if (featureIdIndex == -1)
-          msIO_fprintf(stream, "<!-- WARNING: FeatureId item '%s' not found in typename '%s'. -->\n", value, lp->name);
-      }
-
-      /* populate item and group metadata structures */
-      itemList = msGMLGetItems(lp, "G");
-      constantList = msGMLGetConstants(lp, "G");
-      groupList = msGMLGetGroups(lp, "G");
-      geometryList = msGMLGetGeometries(lp, "GFO");
-      if (itemList == NULL || constantList == NULL || groupList == NULL || geometryList == NULL) {
-        msSetError(MS_MISCERR, "Unable to populate item and group metadata structures", "msGMLWriteWFSQuery()");
+      if(gmlWFSLayerWriterInit(&writer, stream, lp, default_namespace_prefix) != MS_SUCCESS) {
+        gmlWFSLayerWriterFree(&writer);
         return MS_FAILURE;
       }
 
-
-      if (namespace_prefix) {
-        layerName = (char *) msSmallMalloc(strlen(namespace_prefix)+strlen(lp->name)+2);
-        sprintf(layerName, "%s:%s", namespace_prefix, lp->name);
-      } else {
-        layerName = msStrdup(lp->name);
-      }
-
       for(j=0; j<lp->resultcache->numresults; j++) {
 
         status = msLayerGetShape(lp, &shape, &(lp->resultcache->results[j]));
-        if(status != MS_SUCCESS)
+        if(status != MS_SUCCESS) {
+          gmlWFSLayerWriterFree(&writer);
           return(status);
+        }
 
 #ifdef USE_PROJ
         /* project the shape into the map projection (if necessary), note that this projects the bounds as well */
@@ -1455,76 +1624,13 @@ int msGMLWriteWFSQuery(mapObj *map, FILE *stream, char *default_namespace_prefix
           msProjectShape(&lp->projection, &map->projection, &shape);
 #endif
 
-        /*
-        ** start this feature
-        */
-        msIO_fprintf(stream, "    <gml:featureMember>\n");
-        if(msIsXMLTagValid(layerName) == MS_FALSE)
-          msIO_fprintf(stream, "<!-- WARNING: The value '%s' is not valid in a XML tag context. -->\n", layerName);
-        if(featureIdIndex != -1) {
-          if(outputformat == OWS_GML2)
-            msIO_fprintf(stream, "      <%s fid=\"%s.%s\">\n", layerName, lp->name, shape.values[featureIdIndex]);
-          else  /* OWS_GML3 */
-            msIO_fprintf(stream, "      <%s gml:id=\"%s.%s\">\n", layerName, lp->name, shape.values[featureIdIndex]);
-        } else
-          msIO_fprintf(stream, "      <%s>\n", layerName);
-
-        if (bSwapAxis)
-          msAxisSwapShape(&shape);
-
-        /* write the feature geometry and bounding box */
-        if(!(geometryList && geometryList->numgeometries == 1 && strcasecmp(geometryList->geometries[0].name, "none") == 0)) {
-#ifdef USE_PROJ
-          srsMap = msOWSGetEPSGProj(&(map->projection), NULL, "FGO", MS_TRUE);
-          if (!srsMap)
-            msOWSGetEPSGProj(&(map->projection), &(map->web.metadata), "FGO", MS_TRUE);
-          if(srsMap) { /* use the map projection first*/
-            gmlWriteBounds(stream, outputformat, &(shape.bounds), srsMap, "        ");
-            gmlWriteGeometry(stream, geometryList, outputformat, &(shape), srsMap, namespace_prefix, "        ");
-          } else { /* then use the layer projection and/or metadata */
-            gmlWriteBounds(stream, outputformat, &(shape.bounds), msOWSGetEPSGProj(&(lp->projection), &(lp->metadata), "FGO", MS_TRUE), "        ");
-            gmlWriteGeometry(stream, geometryList, outputformat, &(shape), msOWSGetEPSGProj(&(lp->projection), &(lp->metadata), "FGO", MS_TRUE), namespace_prefix, "        ");
-          }
-#else
-          gmlWriteBounds(stream, outputformat, &(shape.bounds), NULL, "        "); /* no projection information */
-          gmlWriteGeometry(stream, geometryList, outputformat, &(shape), NULL, namespace_prefix, "        ");
-#endif
-        }
-
-        /* write any item/values */
-        for(k=0; k<itemList->numitems; k++) {
-          item = &(itemList->items[k]);
-          if(msItemInGroups(item->name, groupList) == MS_FALSE)
-            msGMLWriteItem(stream, item, shape.values[k], namespace_prefix, "        ");
-        }
-
-        /* write any constants */
-        for(k=0; k<constantList->numconstants; k++) {
-          constant = &(constantList->constants[k]);
-          if(msItemInGroups(constant->name, groupList) == MS_FALSE)
-            msGMLWriteConstant(stream, constant, namespace_prefix, "        ");
-        }
-
-        /* write any groups */
-        for(k=0; k<groupList->numgroups; k++)
-          msGMLWriteGroup(stream, &(groupList->groups[k]), &shape, itemList, constantList, namespace_prefix, "        ");
-
-        /* end this feature */
-        msIO_fprintf(stream, "      </%s>\n", layerName);
-        msIO_fprintf(stream, "    </gml:featureMember>\n");
+        gmlWFSWriteFeature(stream, map, &writer, &shape, outputformat, bSwapAxis);
 
         msFreeShape(&shape); /* init too */
-
-        features++;
       }
 
       /* done with this layer, do a little clean-up */
-      msFree(layerName);
-
-      msGMLFreeGroups(groupList);
-      msGMLFreeConstants(constantList);
-      msGMLFreeItems(itemList);
-      msGMLFreeGeometries(geometryList);
+      gmlWFSLayerWriterFree(&writer);
 
       /* msLayerClose(lp); */
     }
@@ -1539,6 +1645,89 @@ int msGMLWriteWFSQuery(mapObj *map, FILE *stream, char *default_namespace_prefix
 #endif /* USE_WFS_SVR */
 }
 
+#ifdef USE_WFS_SVR
+
+/************************************************************************/
+/*                        msGMLWFSStreamBegin()                         */
+/*                                                                      */
+/*      Streaming counterpart of msGMLWriteWFSQuery(). Set              */
+/*      msGMLWFSStreamWriteShape() as map->query.sink and the features  */
+/*      are written as the query reads them, without a result cache    */
+/*      and a second pass through msLayerGetShape(). The bounds of the  */
+/*      whole collection are not known up front so they are written as */
+/*      unknown.                                                        */
+/************************************************************************/
+
+gmlWFSStreamObj *msGMLWFSStreamBegin(mapObj *map, FILE *stream, char *default_namespace_prefix, int outputformat)
+{
+  gmlWFSStreamObj *wfsstream;
+
+  wfsstream = (gmlWFSStreamObj *) msSmallCalloc(1, sizeof(gmlWFSStreamObj));
+  wfsstream->map = map;
+  wfsstream->stream = stream;
+  wfsstream->default_namespace_prefix = default_namespace_prefix;
+  wfsstream->outputformat = outputformat;
+  wfsstream->bSwapAxis = gmlIsAxisSwapped(map);
+
+  msIO_fprintf(stream, "   <gml:boundedBy>\n");
+  if(outputformat == OWS_GML3)
+    msIO_fprintf(stream, "      <gml:Null>unknown</gml:Null>\n");
+  else
+    msIO_fprintf(stream, "      <gml:null>unknown</gml:null>\n");
+  msIO_fprintf(stream, "   </gml:boundedBy>\n");
+
+  return wfsstream;
+}
+
+/************************************************************************/
+/*                      msGMLWFSStreamWriteShape()                      */
+/*                                                                      */
+/*      queryObj sink, shape is in the map projection.                  */
+/************************************************************************/
+
+int msGMLWFSStreamWriteShape(layerObj *lp, shapeObj *shape, void *sinkdata)
+{
+  gmlWFSStreamObj *wfsstream = (gmlWFSStreamObj *) sinkdata;
+
+  if(wfsstream->writer.lp != lp) {
+    gmlWFSLayerWriterFree(&(wfsstream->writer));
+    if(gmlWFSLayerWriterInit(&(wfsstream->writer), wfsstream->stream, lp, wfsstream->default_namespace_prefix) != MS_SUCCESS) {
+      gmlWFSLayerWriterFree(&(wfsstream->writer));
+      return MS_FAILURE;
+    }
+  }
+
+  gmlWFSWriteFeature(wfsstream->stream, wfsstream->map, &(wfsstream->writer), shape,
+                     wfsstream->outputformat, wfsstream->bSwapAxis);
+
+  if(++wfsstream->features % MS_GML_STREAM_FLUSH_INTERVAL == 0)
+    msIO_flush(wfsstream->stream);
+
+  return MS_SUCCESS;
+}
+
+/************************************************************************/
+/*                         msGMLWFSStreamEnd()                          */
+/*                                                                      */
+/*      Release the stream, returns the number of features written.     */
+/************************************************************************/
+
+int msGMLWFSStreamEnd(gmlWFSStreamObj *wfsstream)
+{
+  int features;
+
+  if(!wfsstream)
+    return 0;
+
+  features = wfsstream->features;
+  gmlWFSLayerWriterFree(&(wfsstream->writer));
+  free(wfsstream);
+
+  return features;
+}
+
+#endif /* USE_WFS_SVR */
+
 
 #ifdef USE_LIBXML2
 
@@ -33,28 +33,94 @@
 #include "maphash.h"
 
 
+#define MS_HASH_INITIAL_SLOTS 16
+
+/* keep the load factor (counting removed items) at or below 3/4 */
+#define MS_HASH_FULL(table, n) ((n) * 4 > (table)->numslots * 3)
 
 static unsigned hash(const char *key)
 {
   unsigned hashval;
 
   for(hashval=0; *key!='\0'; key++)
-    hashval = tolower(*key) + 31 * hashval;
+    hashval = tolower((unsigned char) *key) + 31 * hashval;
+
+  /* spread the low bits, the slot index is taken from them */
+  hashval ^= hashval >> 16;
+  hashval *= 0x45d9f3b;
+  hashval ^= hashval >> 16;
+
+  return(hashval);
+}
+
+/*
+** Returns the position in table->items of the entry for key, including
+** removed entries, or -1. If slot is not NULL it receives the slot where
+** the search ended (the item's slot, or the empty slot to insert into).
+*/
+static int findEntry(hashTableObj *table, const char *key, unsigned hashval, int *slot)
+{
+  unsigned mask = table->numslots - 1;
+  unsigned i = hashval & mask;
+
+  while(table->slots[i] != -1) {
+    struct hashObj *tp = &(table->items[table->slots[i]]);
+    if(tp->hashval == hashval && strcasecmp(key, tp->key) == 0)
+      break;
+    i = (i + 1) & mask;
+  }
 
-  return(hashval % MS_HASHSIZE);
+  if(slot) *slot = i;
+  return table->slots[i];
+}
+
+/*
+** (Re)build the slots array with numslots entries, dropping removed
+** items on the way.
+*/
+static int rebuildHashTable(hashTableObj *table, int numslots)
+{
+  int i, n = 0;
+  int *slots;
+
+  slots = (int *) malloc(sizeof(int)*numslots);
+  MS_CHECK_ALLOC(slots, sizeof(int)*numslots, MS_FAILURE);
+  for(i=0; i<numslots; i++)
+    slots[i] = -1;
+
+  free(table->slots);
+  table->slots = slots;
+  table->numslots = numslots;
+
+  for(i=0; i<table->numentries; i++) {
+    struct hashObj *tp = &(table->items[i]);
+    unsigned j;
+
+    if(tp->data == NULL) {
+      free(tp->key);
+      continue;
+    }
+
+    if(n != i)
+      table->items[n] = *tp;
+
+    for(j = tp->hashval & (numslots - 1); slots[j] != -1; j = (j + 1) & (numslots - 1)) {}
+    slots[j] = n++;
+  }
+  table->numentries = n;
+
+  return MS_SUCCESS;
 }
 
 hashTableObj *msCreateHashTable()
 {
-  int i;
   hashTableObj *table;
 
   table = (hashTableObj *) msSmallMalloc(sizeof(hashTableObj));
-  table->items = (struct hashObj **) msSmallMalloc(sizeof(struct hashObj *)*MS_HASHSIZE);
-
-  for (i=0; i<MS_HASHSIZE; i++)
-    table->items[i] = NULL;
-  table->numitems = 0;
+  if(initHashTable(table) != MS_SUCCESS) {
+    free(table);
+    return NULL;
+  }
 
   return table;
 }
@@ -63,12 +129,16 @@ int initHashTable( hashTableObj *table )
 {
   int i;
 
-  table->items = (struct hashObj **) malloc(sizeof(struct hashObj *)*MS_HASHSIZE);
-  MS_CHECK_ALLOC(table->items, sizeof(struct hashObj *)*MS_HASHSIZE, MS_FAILURE);
-
-  for (i=0; i<MS_HASHSIZE; i++)
-    table->items[i] = NULL;
   table->numitems = 0;
+  table->numentries = 0;
+  table->maxentries = 0;
+  table->items = NULL;
+  table->numslots = MS_HASH_INITIAL_SLOTS;
+  table->slots = (int *) malloc(sizeof(int)*MS_HASH_INITIAL_SLOTS);
+  MS_CHECK_ALLOC(table->slots, sizeof(int)*MS_HASH_INITIAL_SLOTS, MS_FAILURE);
+
+  for (i=0; i<MS_HASH_INITIAL_SLOTS; i++)
+    table->slots[i] = -1;
   return MS_SUCCESS;
 }
 
@@ -93,22 +163,19 @@ int msHashIsEmpty( hashTableObj *table )
 void msFreeHashItems( hashTableObj *table )
 {
   int i;
-  struct hashObj *tp=NULL;
-  struct hashObj *prev_tp=NULL;
 
   if (table) {
-    if(table->items) {
-      for (i=0; i<MS_HASHSIZE; i++) {
-        if (table->items[i] != NULL) {
-          for (tp=table->items[i]; tp!=NULL; prev_tp=tp,tp=tp->next,free(prev_tp)) {
-            msFree(tp->key);
-            msFree(tp->data);
-          }
-        }
-        if (tp) free(tp);
+    if(table->slots) {
+      for (i=0; i<table->numentries; i++) {
+        msFree(table->items[i].key);
+        msFree(table->items[i].data);
       }
       free(table->items);
+      free(table->slots);
       table->items = NULL;
+      table->slots = NULL;
+      table->numentries = table->maxentries = table->numslots = 0;
+      table->numitems = 0;
     } else {
       msSetError(MS_HASHERR, "No items allocated.", "msFreeHashItems()");
     }
@@ -121,29 +188,51 @@ struct hashObj *msInsertHashTable(hashTableObj *table,
                                   const char *key, const char *value) {
   struct hashObj *tp;
   unsigned hashval;
+  int index, slot;
 
-  if (!table || !key || !value) {
+  if (!table || !key || !value || !table->slots) {
     msSetError(MS_HASHERR, "Invalid hash table or key",
                "msInsertHashTable");
     return NULL;
   }
 
-  for (tp=table->items[hash(key)]; tp!=NULL; tp=tp->next)
-    if(strcasecmp(key, tp->key) == 0)
-      break;
+  hashval = hash(key);
+  index = findEntry(table, key, hashval, &slot);
+
+  if (index == -1) { /* not found */
+    if (MS_HASH_FULL(table, table->numentries + 1)) {
+      /* compact in place if enough removed items can be dropped */
+      int numslots = table->numslots;
+      if (MS_HASH_FULL(table, table->numitems * 2 + 1))
+        numslots *= 2;
+      if (rebuildHashTable(table, numslots) != MS_SUCCESS)
+        return NULL;
+      findEntry(table, key, hashval, &slot);
+    }
 
-  if (tp == NULL) { /* not found */
-    tp = (struct hashObj *) malloc(sizeof(*tp));
-    MS_CHECK_ALLOC(tp, sizeof(*tp), NULL);
+    if (table->numentries == table->maxentries) {
+      int maxentries = table->maxentries ? table->maxentries * 2 : MS_HASH_INITIAL_SLOTS / 2;
+      struct hashObj *items = (struct hashObj *) realloc(table->items, sizeof(struct hashObj)*maxentries);
+      MS_CHECK_ALLOC(items, sizeof(struct hashObj)*maxentries, NULL);
+      table->items = items;
+      table->maxentries = maxentries;
+    }
+
+    index = table->numentries++;
+    tp = &(table->items[index]);
     tp->key = msStrdup(key);
-    hashval = hash(key);
-    tp->next = table->items[hashval];
-    table->items[hashval] = tp;
-    table->numitems++;
+    tp->hashval = hashval;
+    tp->data = NULL;
+    table->slots[slot] = index;
   } else {
-    free(tp->data);
+    tp = &(table->items[index]);
   }
 
+  if (tp->data == NULL)
+    table->numitems++;
+  else
+    free(tp->data);
+
   if ((tp->data = msStrdup(value)) == NULL)
     return NULL;
 
@@ -152,81 +241,65 @@ struct hashObj *msInsertHashTable(hashTableObj *table,
 
 char *msLookupHashTable(hashTableObj *table, const char *key)
 {
-  struct hashObj *tp;
+  int index;
 
-  if (!table || !key) {
+  if (!table || !key || !table->slots) {
     return(NULL);
   }
 
-  for (tp=table->items[hash(key)]; tp!=NULL; tp=tp->next)
-    if (strcasecmp(key, tp->key) == 0)
-      return(tp->data);
+  index = findEntry(table, key, hash(key), NULL);
+  if (index == -1)
+    return NULL;
 
-  return NULL;
+  return(table->items[index].data);
 }
 
 int msRemoveHashTable(hashTableObj *table, const char *key)
 {
-  struct hashObj *tp;
-  struct hashObj *prev_tp=NULL;
-  int status = MS_FAILURE;
+  int index;
 
-  if (!table || !key) {
+  if (!table || !key || !table->slots) {
     msSetError(MS_HASHERR, "No hash table", "msRemoveHashTable");
     return MS_FAILURE;
   }
 
-  tp=table->items[hash(key)];
-  if (!tp) {
+  index = findEntry(table, key, hash(key), NULL);
+  if (index == -1 || table->items[index].data == NULL) {
     msSetError(MS_HASHERR, "No such hash entry", "msRemoveHashTable");
     return MS_FAILURE;
   }
 
-  prev_tp = NULL;
-  while (tp != NULL) {
-    if (strcasecmp(key, tp->key) == 0) {
-      status = MS_SUCCESS;
-      if (prev_tp) {
-        prev_tp->next = tp->next;
-        free(tp);
-        break;
-      } else {
-        table->items[hash(key)] = tp->next;
-        free(tp);
-        break;
-      }
-    }
-    prev_tp = tp;
-    tp = tp->next;
-  }
+  /* the key is kept so that iteration can continue from it */
+  free(table->items[index].data);
+  table->items[index].data = NULL;
+  table->numitems--;
 
-  if (status == MS_SUCCESS)
-    table->numitems--;
+  return MS_SUCCESS;
+}
+
+static const char *nextKeyFromIndex( hashTableObj *table, int index )
+{
+  for ( ; index < table->numentries; index++ ) {
+    if ( table->items[index].data != NULL )
+      return table->items[index].key;
+  }
 
-  return status;
+  return NULL;
 }
 
 const char *msFirstKeyFromHashTable( hashTableObj *table )
 {
-  int hash_index;
-
   if (!table) {
     msSetError(MS_HASHERR, "No hash table", "msFirstKeyFromHashTable");
     return NULL;
   }
 
-  for (hash_index = 0; hash_index < MS_HASHSIZE; hash_index++ ) {
-    if (table->items[hash_index] != NULL )
-      return table->items[hash_index]->key;
-  }
-
-  return NULL;
+  return nextKeyFromIndex( table, 0 );
 }
 
 const char *msNextKeyFromHashTable( hashTableObj *table, const char *lastKey )
 {
-  int hash_index;
-  struct hashObj *link;
+  int index;
 
   if (!table) {
     msSetError(MS_HASHERR, "No hash table", "msNextKeyFromHashTable");
@@ -236,19 +309,12 @@ const char *msNextKeyFromHashTable( hashTableObj *table, const char *lastKey )
   if ( lastKey == NULL )
     return msFirstKeyFromHashTable( table );
 
-  hash_index = hash(lastKey);
-  for ( link = table->items[hash_index];
-        link != NULL && strcasecmp(lastKey,link->key) != 0;
-        link = link->next ) {}
-
-  if ( link != NULL && link->next != NULL )
-    return link->next->key;
+  if ( !table->slots )
+    return NULL;
 
-  while ( ++hash_index < MS_HASHSIZE ) {
-    if ( table->items[hash_index] != NULL )
-      return table->items[hash_index]->key;
-  }
+  index = findEntry(table, lastKey, hash(lastKey), NULL);
+  if ( index == -1 )
+    return NULL;
 
-  return NULL;
+  return nextKeyFromIndex( table, index + 1 );
 }
-
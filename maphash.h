@@ -40,23 +40,32 @@ extern "C" {
 #define  MS_DLL_EXPORT
 #endif
 
-#define MS_HASHSIZE 41
-
   /* =========================================================================
    * Structs
    * ========================================================================= */
 
+  /*
+   * hashTableObj is an open addressing table with linear probing. Items are
+   * kept in insertion order in a dense array and the slots array maps
+   * hashes to item positions. Removed items stay in place (with a NULL
+   * data member) until the table is next grown or compacted.
+   */
+
 #ifndef SWIG
   struct hashObj {
-    struct hashObj *next;  /* pointer to next item */
-    char           *key;   /* string key that is hashed */
-    char           *data;  /* string stored in this item */
+    char           *key;     /* string key that is hashed */
+    char           *data;    /* string stored in this item, NULL if removed */
+    unsigned        hashval; /* case folded hash of key */
   };
 #endif /*SWIG*/
 
   typedef struct {
 #ifndef SWIG
-    struct hashObj **items;  /* the hash table */
+    struct hashObj *items;   /* items in insertion order */
+    int             numentries; /* used positions in items, incl. removed ones */
+    int             maxentries; /* allocated positions in items */
+    int            *slots;   /* item positions, -1 for empty slots */
+    int             numslots; /* always a power of two */
 #endif
 #ifdef SWIG
     %immutable;
@@ -100,7 +109,7 @@ extern "C" {
    *     key   - key string for new item
    *     value - data string for new item
    * RETURNS:
-   *     pointer to the new item or NULL
+   *     pointer to the new item or NULL, only valid until the next insert
    * EXCEPTIONS:
    *     raise MS_HASHERR on failure
    */
@@ -59,6 +59,7 @@ typedef struct msIOContextGroup_t {
 static msIOContextGroup default_contexts;
 static msIOContextGroup *io_context_list = NULL;
 static void msIO_Initialize( void );
+static int msIO_stdioWrite( void *cbData, void *data, int byteCount );
 
 #ifdef msIO_printf
 #  undef msIO_printf
@@ -214,6 +215,22 @@ void msIO_sendHeaders ()
 }
 
 
+/************************************************************************/
+/*                             msIO_flush()                             */
+/*                                                                      */
+/*      Push out what has been written so far, for handlers backed      */
+/*      by stdio. Other handlers do their own buffering.                */
+/************************************************************************/
+
+void msIO_flush( FILE *fp )
+
+{
+  msIOContext *context = msIO_getHandler( fp );
+
+  if( context != NULL && context->readWriteFunc == msIO_stdioWrite )
+    fflush( (FILE *) context->cbData );
+}
+
 /************************************************************************/
 /*                        msIO_installHandlers()                        */
 /************************************************************************/
@@ -73,6 +73,7 @@ extern "C" {
   msIOContext MS_DLL_EXPORT *msIO_getHandler( FILE * );
   void msIO_setHeader (const char *header, const char* value, ...);
   void msIO_sendHeaders(void);
+  void MS_DLL_EXPORT msIO_flush( FILE *fp );
 
   /*
   ** These can be used instead of the stdio style functions if you have
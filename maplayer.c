@@ -528,6 +528,9 @@ int msTokenizeExpression(expressionObj *expression, char **list, int *listsize)
           msSetError(MS_PARSEERR, "Parsing fromText function failed, WKT processing failed.", "msTokenizeExpression()");
           goto parse_error;
         }
+#ifdef USE_GEOS
+        msGEOSPrepare(node->tokenval.shpval); /* the literal is compared against every feature */
+#endif
 
         /* todo: perhaps process optional args (e.g. projection) */
 
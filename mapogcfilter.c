@@ -492,8 +492,37 @@ int FLTIsSimpleFilterNoSpatial(FilterEncodingNode *psNode)
 
 
 
+/* SQL dialects spatial operators can be translated to */
+#define FLT_SQL_DIALECT_NONE     0
+#define FLT_SQL_DIALECT_POSTGIS  1
+#define FLT_SQL_DIALECT_ORACLE   2
+#define FLT_SQL_DIALECT_MSSQL    3
+
+/************************************************************************/
+/*                           FLTGetSQLDialect                           */
+/*                                                                      */
+/*      Spatial SQL dialect of the layer's database, if any.            */
+/************************************************************************/
+static int FLTGetSQLDialect(layerObj *lp)
+{
+  if (lp->connectiontype == MS_POSTGIS)
+    return FLT_SQL_DIALECT_POSTGIS;
+  else if (lp->connectiontype == MS_ORACLESPATIAL)
+    return FLT_SQL_DIALECT_ORACLE;
+  else if (lp->connectiontype == MS_PLUGIN && lp->plugin_library &&
+           strcasestr(lp->plugin_library, "mssql") != NULL)
+    return FLT_SQL_DIALECT_MSSQL;
+
+  return FLT_SQL_DIALECT_NONE;
+}
+
 /************************************************************************/
 /*                      FLTApplySimpleSQLFilter()                       */
+/*                                                                      */
+/*      Apply the filter as the layer FILTER and query by the BBOX of   */
+/*      the filter. Also used for filters with other spatial            */
+/*      operators on layers whose database evaluates them (see          */
+/*      FLTGetSpatialSQLExpression()).                                  */
 /************************************************************************/
 
 int FLTApplySimpleSQLFilter(FilterEncodingNode *psNode, mapObj *map,
@@ -512,6 +541,7 @@ int FLTApplySimpleSQLFilter(FilterEncodingNode *psNode, mapObj *map,
   char *pszTmp = NULL, *pszTmp2 = NULL;
   size_t bufferSize = 0;
   char *tmpfilename = NULL;
+  int status;
 
   lp = (GET_LAYER(map, iLayerIndex));
 
@@ -605,6 +635,21 @@ int FLTApplySimpleSQLFilter(FilterEncodingNode *psNode, mapObj *map,
 
   }
 
+  /* predicates the database could not take (spatial operators, literals */
+  /* too long for the SQL builders) are evaluated by mapserver, dropping */
+  /* them would return too many features. Only a lone BBOX needs no */
+  /* expression. */
+  if (szExpression == NULL && !FLTIsBBoxFilter(psNode)) {
+    szExpression = FLTGetCommonExpression(psNode, lp);
+    if (szExpression == NULL) {
+      msSetError(MS_MISCERR, "Unable to translate the filter for layer %s.",
+                 "FLTApplySimpleSQLFilter()", lp->name ? lp->name : "");
+      return MS_FAILURE;
+    }
+    status = FLTApplyFilterToLayerCommonExpression(map, iLayerIndex, szExpression);
+    msFree(szExpression);
+    return status;
+  }
 
   if (szExpression) {
 
@@ -760,6 +805,16 @@ int FLTLayerApplyCondSQLFilterToLayer(FilterEncodingNode *psNode, mapObj *map,
     return FLTApplySimpleSQLFilter(psNode, map, iLayerIndex);
   }
 
+  /* ==================================================================== */
+  /*      Spatial databases can evaluate the other spatial operators      */
+  /*      too, using their spatial index instead of mapserver reading     */
+  /*      every feature in the BBOX.                                      */
+  /* ==================================================================== */
+  if (FLTValidForBBoxFilter(psNode) &&
+      FLTGetSQLDialect(GET_LAYER(map, iLayerIndex)) != FLT_SQL_DIALECT_NONE) {
+    return FLTApplySimpleSQLFilter(psNode, map, iLayerIndex);
+  }
+
   return FLTLayerApplyPlainFilterToLayer(psNode, map, iLayerIndex);
 }
 
@@ -2087,6 +2142,260 @@ char *FLTGetMapserverExpression(FilterEncodingNode *psFilterNode, layerObj *lp)
   return pszExpression;
 }
 
+/************************************************************************/
+/*                         FLTGetSQLGeometryColumn                      */
+/*                                                                      */
+/*      The geometry column is the first word of the DATA statement     */
+/*      for the PostGIS, Oracle and MSSQL providers (eg "the_geom       */
+/*      from roads"). Returns NULL if DATA does not look like that.     */
+/************************************************************************/
+static char *FLTGetSQLGeometryColumn(layerObj *lp)
+{
+  const char *pszStart, *pszEnd, *pszFrom;
+  char *pszColumn, *pszType;
+
+  if (!lp->data)
+    return NULL;
+
+  pszStart = lp->data;
+  while (isspace((unsigned char)*pszStart))
+    pszStart++;
+
+  pszEnd = pszStart;
+  while (*pszEnd && !isspace((unsigned char)*pszEnd))
+    pszEnd++;
+
+  pszFrom = pszEnd;
+  while (isspace((unsigned char)*pszFrom))
+    pszFrom++;
+
+  if (pszEnd == pszStart || pszFrom == pszEnd ||
+      strncasecmp(pszFrom, "from", 4) != 0 || !isspace((unsigned char)pszFrom[4]))
+    return NULL;
+
+  pszColumn = msSmallMalloc(pszEnd - pszStart + 1);
+  strlcpy(pszColumn, pszStart, pszEnd - pszStart + 1);
+
+  /* MSSQL allows "geom(geography) from ...", only geometry is handled */
+  if ((pszType = strchr(pszColumn, '(')) != NULL) {
+    if (strncasecmp(pszType, "(geometry)", 10) != 0) {
+      msFree(pszColumn);
+      return NULL;
+    }
+    *pszType = '\0';
+  }
+
+  return pszColumn;
+}
+
+/************************************************************************/
+/*                            FLTGetSQLSRID                             */
+/*                                                                      */
+/*      SRID of the layer geometries, from the "using srid=" part of    */
+/*      DATA or from an EPSG code in the layer projection. Returns -1   */
+/*      if it is unknown.                                               */
+/************************************************************************/
+static int FLTGetSQLSRID(layerObj *lp)
+{
+  const char *pszSRID;
+  int i;
+
+  pszSRID = lp->data;
+  while (pszSRID && (pszSRID = strcasestr(pszSRID, "srid")) != NULL) {
+    if (pszSRID > lp->data && isspace((unsigned char)pszSRID[-1])) {
+      pszSRID += 4;
+      while (isspace((unsigned char)*pszSRID) || *pszSRID == '=')
+        pszSRID++;
+      if (isdigit((unsigned char)*pszSRID))
+        return atoi(pszSRID);
+    } else
+      pszSRID += 4;
+  }
+
+  for (i=0; i<lp->projection.numargs; i++) {
+    if (strncasecmp(lp->projection.args[i], "init=epsg:", 10) == 0)
+      return atoi(lp->projection.args[i] + 10);
+  }
+
+  return -1;
+}
+
+/************************************************************************/
+/*                        FLTGetSpatialSQLExpression                    */
+/*                                                                      */
+/*      Translate a spatial operator (other than BBOX, which is         */
+/*      applied through the query rectangle) to the spatial SQL of      */
+/*      PostGIS, Oracle Spatial or MSSQL so the database can use its    */
+/*      spatial index. Returns NULL if the operator can not be          */
+/*      translated for the layer.                                       */
+/************************************************************************/
+char *FLTGetSpatialSQLExpression(FilterEncodingNode *psFilterNode, layerObj *lp)
+{
+  char *pszExpression = NULL;
+  char *pszColumn = NULL;
+  char *pszWKT = NULL;
+  char szGeometry[64];
+  char szTmp[256];
+  shapeObj *psQueryShape, sShape;
+  projectionObj sProjTmp;
+  double dfDistance = -1;
+  int nUnit = -1, nLayerUnit;
+  int nDialect, nOperator, nSRID;
+  const char *pszMask = NULL;
+
+  if (!psFilterNode || !lp || psFilterNode->eType != FILTER_NODE_TYPE_SPATIAL)
+    return NULL;
+
+  nDialect = FLTGetSQLDialect(lp);
+  nOperator = FLTGetGeosOperator(psFilterNode->pszValue);
+  if (nDialect == FLT_SQL_DIALECT_NONE || nOperator == -1)
+    return NULL;
+
+  /* SDO_RELATE masks, operators without one are left to mapserver */
+  if (nDialect == FLT_SQL_DIALECT_ORACLE) {
+    switch (nOperator) {
+      case MS_GEOS_EQUALS:
+        pszMask = "EQUAL";
+        break;
+      case MS_GEOS_INTERSECTS:
+        pszMask = "ANYINTERACT";
+        break;
+      case MS_GEOS_TOUCHES:
+        pszMask = "TOUCH";
+        break;
+      case MS_GEOS_WITHIN:
+        pszMask = "INSIDE+COVEREDBY";
+        break;
+      case MS_GEOS_CONTAINS:
+        pszMask = "CONTAINS+COVERS";
+        break;
+      case MS_GEOS_OVERLAPS:
+        pszMask = "OVERLAPBDYINTERSECT+OVERLAPBDYDISJOINT";
+        break;
+      case MS_GEOS_DWITHIN:
+        break;
+      default:
+        return NULL;
+    }
+  }
+
+  psQueryShape = FLTGetShape(psFilterNode, &dfDistance, &nUnit);
+  if (!psQueryShape || psQueryShape->numlines == 0)
+    return NULL;
+
+  nSRID = FLTGetSQLSRID(lp);
+  if (nSRID <= 0 && nDialect != FLT_SQL_DIALECT_ORACLE)
+    return NULL;
+
+  pszColumn = FLTGetSQLGeometryColumn(lp);
+  if (!pszColumn)
+    return NULL;
+
+  /* the filter geometry is in its own srs or the map projection, the */
+  /* database compares it with the layer geometries as they are */
+  msInitShape(&sShape);
+  msCopyShape(psQueryShape, &sShape);
+  if (lp->projection.numargs > 0) {
+    if (psFilterNode->pszSRS && FLTParseEpsgString(psFilterNode->pszSRS, &sProjTmp)) {
+      msProjectShape(&sProjTmp, &lp->projection, &sShape);
+      msFreeProjection(&sProjTmp);
+    } else if (lp->map->projection.numargs > 0)
+      msProjectShape(&lp->map->projection, &lp->projection, &sShape);
+  }
+
+  /* distances are expressed in the layer units */
+  if (nOperator == MS_GEOS_DWITHIN || nOperator == MS_GEOS_BEYOND) {
+    nLayerUnit = lp->projection.numargs > 0 ?
+                 GetMapserverUnitUsingProj(&lp->projection) : lp->map->units;
+    if (dfDistance < 0 || nLayerUnit < 0) {
+      msFreeShape(&sShape);
+      msFree(pszColumn);
+      return NULL;
+    }
+    if (nUnit < 0)
+      nUnit = lp->map->units;
+    if (nUnit != nLayerUnit)
+      dfDistance *= msInchesPerUnit(nUnit,0)/msInchesPerUnit(nLayerUnit,0);
+  }
+
+  pszWKT = msShapeToWKT(&sShape);
+  msFreeShape(&sShape);
+  if (!pszWKT) {
+    msFree(pszColumn);
+    return NULL;
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      geometry literal                                                */
+  /* -------------------------------------------------------------------- */
+  if (nDialect == FLT_SQL_DIALECT_POSTGIS)
+    pszExpression = msStringConcatenate(pszExpression, "ST_GeomFromText('");
+  else if (nDialect == FLT_SQL_DIALECT_ORACLE)
+    pszExpression = msStringConcatenate(pszExpression, "SDO_GEOMETRY('");
+  else
+    pszExpression = msStringConcatenate(pszExpression, "geometry::STGeomFromText('");
+  pszExpression = msStringConcatenate(pszExpression, pszWKT);
+  if (nSRID > 0)
+    snprintf(szGeometry, sizeof(szGeometry), "', %d)", nSRID);
+  else
+    snprintf(szGeometry, sizeof(szGeometry), "', NULL)");
+  pszExpression = msStringConcatenate(pszExpression, szGeometry);
+  msFree(pszWKT);
+  pszWKT = pszExpression;
+  pszExpression = NULL;
+
+  /* -------------------------------------------------------------------- */
+  /*      predicate                                                       */
+  /* -------------------------------------------------------------------- */
+  if (nDialect == FLT_SQL_DIALECT_POSTGIS) {
+    if (nOperator == MS_GEOS_DWITHIN || nOperator == MS_GEOS_BEYOND) {
+      snprintf(szTmp, sizeof(szTmp), "%sST_DWithin(%s, ",
+               nOperator == MS_GEOS_BEYOND ? "NOT " : "", pszColumn);
+      pszExpression = msStringConcatenate(pszExpression, szTmp);
+      pszExpression = msStringConcatenate(pszExpression, pszWKT);
+      snprintf(szTmp, sizeof(szTmp), ", %.15g)", dfDistance);
+    } else {
+      snprintf(szTmp, sizeof(szTmp), "ST_%s(%s, ",
+               nOperator == MS_GEOS_INTERSECTS ? "Intersects" : psFilterNode->pszValue, pszColumn);
+      pszExpression = msStringConcatenate(pszExpression, szTmp);
+      pszExpression = msStringConcatenate(pszExpression, pszWKT);
+      snprintf(szTmp, sizeof(szTmp), ")");
+    }
+  } else if (nDialect == FLT_SQL_DIALECT_ORACLE) {
+    if (nOperator == MS_GEOS_DWITHIN) {
+      snprintf(szTmp, sizeof(szTmp), "SDO_WITHIN_DISTANCE(%s, ", pszColumn);
+      pszExpression = msStringConcatenate(pszExpression, szTmp);
+      pszExpression = msStringConcatenate(pszExpression, pszWKT);
+      snprintf(szTmp, sizeof(szTmp), ", 'distance=%.15g') = 'TRUE'", dfDistance);
+    } else {
+      snprintf(szTmp, sizeof(szTmp), "SDO_RELATE(%s, ", pszColumn);
+      pszExpression = msStringConcatenate(pszExpression, szTmp);
+      pszExpression = msStringConcatenate(pszExpression, pszWKT);
+      snprintf(szTmp, sizeof(szTmp), ", 'mask=%s') = 'TRUE'", pszMask);
+    }
+  } else {
+    if (nOperator == MS_GEOS_DWITHIN || nOperator == MS_GEOS_BEYOND) {
+      snprintf(szTmp, sizeof(szTmp), "%s.STDistance(", pszColumn);
+      pszExpression = msStringConcatenate(pszExpression, szTmp);
+      pszExpression = msStringConcatenate(pszExpression, pszWKT);
+      snprintf(szTmp, sizeof(szTmp), ") %s %.15g",
+               nOperator == MS_GEOS_BEYOND ? ">" : "<=", dfDistance);
+    } else {
+      snprintf(szTmp, sizeof(szTmp), "%s.ST%s(", pszColumn,
+               nOperator == MS_GEOS_INTERSECTS ? "Intersects" : psFilterNode->pszValue);
+      pszExpression = msStringConcatenate(pszExpression, szTmp);
+      pszExpression = msStringConcatenate(pszExpression, pszWKT);
+      snprintf(szTmp, sizeof(szTmp), ") = 1");
+    }
+  }
+  pszExpression = msStringConcatenate(pszExpression, szTmp);
+
+  msFree(pszWKT);
+  msFree(pszColumn);
+
+  return pszExpression;
+}
+
 
 /************************************************************************/
 /*                           FLTGetSQLExpression                        */
@@ -2134,7 +2443,9 @@ char *FLTGetSQLExpression(FilterEncodingNode *psFilterNode, layerObj *lp)
   }
 
   else if (psFilterNode->eType == FILTER_NODE_TYPE_SPATIAL) {
-    /* TODO */
+    /* BBOX is applied as the query rectangle */
+    if (!FLTIsBBoxFilter(psFilterNode))
+      pszExpression = FLTGetSpatialSQLExpression(psFilterNode, lp);
   } else if (psFilterNode->eType == FILTER_NODE_TYPE_FEATUREID) {
 #if defined(USE_WMS_SVR) || defined (USE_WFS_SVR) || defined (USE_WCS_SVR) || defined(USE_SOS_SVR)
     if (psFilterNode->pszValue) {
@@ -2152,13 +2463,6 @@ char *FLTGetSQLExpression(FilterEncodingNode *psFilterNode, layerObj *lp)
               bString = 1;
 
             pszEscapedStr = msLayerEscapeSQLParam(lp, tokens[i]);
-            if (bString)
-              snprintf(szTmp, sizeof(szTmp), "(%s = '%s')" , pszAttribute, pszEscapedStr);
-            else
-              snprintf(szTmp, sizeof(szTmp), "(%s = %s)" , pszAttribute, pszEscapedStr);
-
-            msFree(pszEscapedStr);
-            pszEscapedStr=NULL;
 
             if (pszExpression != NULL)
               pszExpression = msStringConcatenate(pszExpression, " OR ");
@@ -2166,7 +2470,14 @@ char *FLTGetSQLExpression(FilterEncodingNode *psFilterNode, layerObj *lp)
               /*opening and closing brackets*/
               pszExpression = msStringConcatenate(pszExpression, "(");
 
+            /* long ids must not be truncated */
+            snprintf(szTmp, sizeof(szTmp), bString ? "(%s = '" : "(%s = ", pszAttribute);
             pszExpression = msStringConcatenate(pszExpression, szTmp);
+            pszExpression = msStringConcatenate(pszExpression, pszEscapedStr);
+            pszExpression = msStringConcatenate(pszExpression, bString ? "')" : ")");
+
+            msFree(pszEscapedStr);
+            pszEscapedStr=NULL;
           }
 
           msFreeCharArray(tokens, nTokens);
@@ -2561,8 +2872,9 @@ char *FLTGetBinaryComparisonSQLExpresssion(FilterEncodingNode *psFilterNode,
                  "PropertyIsEqualTo") == 0 &&
       psFilterNode->psRightNode->pOther &&
       (*(int *)psFilterNode->psRightNode->pOther) == 1) {
-    snprintf(szTmp, sizeof(szTmp), "lower(%s) ",  pszEscapedStr);
-    strlcat(szBuffer, szTmp, bufferSize);
+    strlcat(szBuffer, "lower(", bufferSize);
+    strlcat(szBuffer, pszEscapedStr, bufferSize);
+    strlcat(szBuffer, ") ", bufferSize);
   } else
     strlcat(szBuffer, pszEscapedStr, bufferSize);
 
@@ -2602,9 +2914,10 @@ char *FLTGetBinaryComparisonSQLExpresssion(FilterEncodingNode *psFilterNode,
       (*(int *)psFilterNode->psRightNode->pOther) == 1) {
     char* pszEscapedStr;
     pszEscapedStr = msLayerEscapeSQLParam(lp, psFilterNode->psRightNode->pszValue);
-    snprintf(szTmp, sizeof(szTmp), "lower('%s') ", pszEscapedStr);
+    strlcat(szBuffer, "lower('", bufferSize);
+    strlcat(szBuffer, pszEscapedStr, bufferSize);
+    strlcat(szBuffer, "') ", bufferSize);
     msFree(pszEscapedStr);
-    strlcat(szBuffer, szTmp, bufferSize);
   } else {
     if (bString)
       strlcat(szBuffer, "'", bufferSize);
@@ -2624,8 +2937,12 @@ char *FLTGetBinaryComparisonSQLExpresssion(FilterEncodingNode *psFilterNode,
       strlcat(szBuffer, "'", bufferSize);
 
   }
-  /*closing bracket*/
-  strlcat(szBuffer, ") ", bufferSize);
+  /*closing bracket. A truncated expression would not mean the same thing:
+    after any truncated append the buffer is full and this one fails too*/
+  if (strlcat(szBuffer, ") ", bufferSize) >= bufferSize) {
+    msSetError(MS_MISCERR, "Filter expression too long.", "FLTGetBinaryComparisonSQLExpresssion()");
+    return NULL;
+  }
 
   return msStrdup(szBuffer);
 }
@@ -2723,9 +3040,14 @@ char *FLTGetIsBetweenComparisonSQLExpresssion(FilterEncodingNode *psFilterNode,
   if (bString)
     strlcat(szBuffer,"'", bufferSize);
 
-  /*closing paranthesis*/
-  strlcat(szBuffer, ")", bufferSize);
+  msFreeCharArray(aszBounds, nBounds);
 
+  /*closing paranthesis. A truncated expression would not mean the same thing:
+    after any truncated append the buffer is full and this one fails too*/
+  if (strlcat(szBuffer, ")", bufferSize) >= bufferSize) {
+    msSetError(MS_MISCERR, "Filter expression too long.", "FLTGetIsBetweenComparisonSQLExpresssion()");
+    return NULL;
+  }
 
   return msStrdup(szBuffer);
 }
@@ -3055,7 +3377,12 @@ char *FLTGetIsLikeComparisonSQLExpression(FilterEncodingNode *psFilterNode,
 
     strlcat(szBuffer,  szTmp, bufferSize);
   }
-  strlcat(szBuffer,  ") ", bufferSize);
+  /* a truncated expression would not mean the same thing: after any */
+  /* truncated append the buffer is full and this one fails too */
+  if (strlcat(szBuffer,  ") ", bufferSize) >= bufferSize) {
+    msSetError(MS_MISCERR, "Filter expression too long.", "FLTGetIsLikeComparisonSQLExpression()");
+    return NULL;
+  }
 
   return msStrdup(szBuffer);
 }
@@ -45,6 +45,15 @@
 
 #ifdef USE_OGR
 
+/* size of the chunks result files are copied with */
+#define MS_OGR_COPY_BUFFER_SIZE 16384
+
+/* msIO writes take an int size, in memory files are sent in chunks of this */
+#define MS_OGR_SEND_CHUNK_SIZE (1024*1024)
+
+/* CPLWriteFileInZip() takes an int size, larger files go in several calls */
+#define MS_OGR_ZIP_WRITE_CHUNK_SIZE (1024*1024*1024)
+
 /************************************************************************/
 /*                       msInitOGROutputFormat()                        */
 /************************************************************************/
@@ -192,6 +201,126 @@ static void msOGRCleanupDS( const char *datasource_name )
   VSIRmdir( path );
 }
 
+/************************************************************************/
+/*                         msOGRTakeMemFile()                           */
+/*                                                                      */
+/*      Take over the buffer of a /vsimem/ file, the file is removed    */
+/*      so its memory goes away as soon as the caller is done with      */
+/*      the data instead of at the end of the request. Returns NULL     */
+/*      for files that are not in memory.                               */
+/************************************************************************/
+static GByte *msOGRTakeMemFile( const char *filename, vsi_l_offset *length )
+
+{
+  if( !EQUALN(filename, "/vsimem/", 8) )
+    return NULL;
+
+  return VSIGetMemFileBuffer( filename, length, TRUE );
+}
+
+/************************************************************************/
+/*                           msOGRSendFile()                            */
+/*                                                                      */
+/*      Write a result file to stdout. In memory files are handed to    */
+/*      msIO without a copy and released.                               */
+/************************************************************************/
+static int msOGRSendFile( const char *filename )
+
+{
+  GByte *data;
+  vsi_l_offset length, offset;
+  FILE *fp;
+  int bytes_read;
+  char buffer[MS_OGR_COPY_BUFFER_SIZE];
+
+  data = msOGRTakeMemFile( filename, &length );
+  if( data != NULL ) {
+    for( offset = 0; offset < length; ) {
+      size_t chunk = (size_t) MS_MIN( length - offset, MS_OGR_SEND_CHUNK_SIZE );
+
+      msIO_fwrite( data + offset, 1, chunk, stdout );
+      offset += chunk;
+    }
+    CPLFree( data );
+    return MS_SUCCESS;
+  }
+
+  fp = VSIFOpenL( filename, "r" );
+  if( fp == NULL ) {
+    msSetError( MS_MISCERR,
+                "Failed to open result file '%s'.",
+                "msOGRWriteFromQuery()",
+                filename );
+    return MS_FAILURE;
+  }
+
+  while( (bytes_read = VSIFReadL( buffer, 1, sizeof(buffer), fp )) > 0 )
+    msIO_fwrite( buffer, 1, bytes_read, stdout );
+  VSIFCloseL( fp );
+
+  return MS_SUCCESS;
+}
+
+#if defined(CPL_ZIP_API_OFFERED)
+/************************************************************************/
+/*                         msOGRAddFileToZip()                          */
+/*                                                                      */
+/*      Compress a result file into the zip. Each in memory file is     */
+/*      released once compressed, so at most one uncompressed file      */
+/*      and the zip are held at a time.                                 */
+/************************************************************************/
+static int msOGRAddFileToZip( void *hZip, const char *filename )
+
+{
+  GByte *data;
+  vsi_l_offset length, offset;
+  FILE *fp;
+  int bytes_read;
+  CPLErr eErr = CE_None;
+  char buffer[MS_OGR_COPY_BUFFER_SIZE];
+
+  CPLCreateFileInZip( hZip, CPLGetFilename(filename), NULL );
+
+  data = msOGRTakeMemFile( filename, &length );
+  if( data != NULL ) {
+    for( offset = 0; offset < length && eErr == CE_None; ) {
+      int chunk = (int) MS_MIN( length - offset, MS_OGR_ZIP_WRITE_CHUNK_SIZE );
+
+      eErr = CPLWriteFileInZip( hZip, data + offset, chunk );
+      offset += chunk;
+    }
+    CPLFree( data );
+  } else {
+    fp = VSIFOpenL( filename, "r" );
+    if( fp == NULL ) {
+      CPLCloseFileInZip( hZip );
+      msSetError( MS_MISCERR,
+                  "Failed to open result file '%s'.",
+                  "msOGRWriteFromQuery()",
+                  filename );
+      return MS_FAILURE;
+    }
+
+    while( eErr == CE_None
+           && (bytes_read = VSIFReadL( buffer, 1, sizeof(buffer), fp )) > 0 )
+      eErr = CPLWriteFileInZip( hZip, buffer, bytes_read );
+    VSIFCloseL( fp );
+  }
+
+  CPLCloseFileInZip( hZip );
+
+  if( eErr != CE_None ) {
+    msSetError( MS_MISCERR,
+                "Failed to write '%s' to the zip file: %s",
+                "msOGRWriteFromQuery()",
+                filename, CPLGetLastErrorMsg() );
+    return MS_FAILURE;
+  }
+
+  return MS_SUCCESS;
+}
+#endif /* defined(CPL_ZIP_API_OFFERED) */
+
 /************************************************************************/
 /*                          msOGRWriteShape()                           */
 /************************************************************************/
@@ -903,10 +1032,6 @@ int msOGRWriteFromQuery( mapObj *map, outputFormatObj *format, int sendheaders )
   /*      Handle case of simple file written to stdout.                   */
   /* -------------------------------------------------------------------- */
   else if( EQUAL(form,"simple") ) {
-    char buffer[1024];
-    int  bytes_read;
-    FILE *fp;
-
     if( sendheaders ) {
       msIO_setHeader("Content-Disposition","attachment; filename=%s",
                      CPLGetFilename( file_list[0] ) );
@@ -916,19 +1041,10 @@ int msOGRWriteFromQuery( mapObj *map, outputFormatObj *format, int sendheaders )
     } else
       msIO_fprintf( stdout, "%c", 10 );
 
-    fp = VSIFOpenL( file_list[0], "r" );
-    if( fp == NULL ) {
-      msSetError( MS_MISCERR,
-                  "Failed to open result file '%s'.",
-                  "msOGRWriteFromQuery()",
-                  file_list[0] );
+    if( msOGRSendFile( file_list[0] ) != MS_SUCCESS ) {
       msOGRCleanupDS( datasource_name );
       return MS_FAILURE;
     }
-
-    while( (bytes_read = VSIFReadL( buffer, 1, sizeof(buffer), fp )) > 0 )
-      msIO_fwrite( buffer, 1, bytes_read, stdout );
-    VSIFCloseL( fp );
   }
 
   /* -------------------------------------------------------------------- */
@@ -941,10 +1057,6 @@ int msOGRWriteFromQuery( mapObj *map, outputFormatObj *format, int sendheaders )
     msIO_fprintf(stdout,"--%s\r\n",boundary );
 
     for( i = 0; file_list != NULL && file_list[i] != NULL; i++ ) {
-      FILE *fp;
-      int bytes_read;
-      char buffer[1024];
-
       if( sendheaders )
         msIO_fprintf( stdout,
                       "Content-Disposition: attachment; filename=%s\r\n"
@@ -952,21 +1064,11 @@ int msOGRWriteFromQuery( mapObj *map, outputFormatObj *format, int sendheaders )
                       "Content-Transfer-Encoding: binary\r\n\r\n",
                       CPLGetFilename( file_list[i] ));
 
-
-      fp = VSIFOpenL( file_list[i], "r" );
-      if( fp == NULL ) {
-        msSetError( MS_MISCERR,
-                    "Failed to open result file '%s'.",
-                    "msOGRWriteFromQuery()",
-                    file_list[0] );
+      if( msOGRSendFile( file_list[i] ) != MS_SUCCESS ) {
         msOGRCleanupDS( datasource_name );
         return MS_FAILURE;
       }
 
-      while( (bytes_read = VSIFReadL( buffer, 1, sizeof(buffer), fp )) > 0 )
-        msIO_fwrite( buffer, 1, bytes_read, stdout );
-      VSIFCloseL( fp );
-
       if (file_list[i+1] == NULL)
         msIO_fprintf( stdout, "\r\n--%s--\r\n", boundary );
       else
@@ -984,35 +1086,21 @@ int msOGRWriteFromQuery( mapObj *map, outputFormatObj *format, int sendheaders )
     msOGRCleanupDS( datasource_name );
     return MS_FAILURE;
 #else
-    FILE *fp;
     char *zip_filename = msTmpFile(map, NULL, "/vsimem/ogrzip/", "zip" );
     void *hZip;
-    int bytes_read;
-    char buffer[1024];
 
+    /* the zip writer seeks back to patch entry headers, so the zip can */
+    /* not go to /vsistdout/ directly and is assembled in memory. */
     hZip = CPLCreateZip( zip_filename, NULL );
 
     for( i = 0; file_list != NULL && file_list[i] != NULL; i++ ) {
-
-      CPLCreateFileInZip( hZip, CPLGetFilename(file_list[i]), NULL );
-
-      fp = VSIFOpenL( file_list[i], "r" );
-      if( fp == NULL ) {
+      if( msOGRAddFileToZip( hZip, file_list[i] ) != MS_SUCCESS ) {
         CPLCloseZip( hZip );
-        msSetError( MS_MISCERR,
-                    "Failed to open result file '%s'.",
-                    "msOGRWriteFromQuery()",
-                    file_list[0] );
+        VSIUnlink( zip_filename );
+        msFree( zip_filename );
         msOGRCleanupDS( datasource_name );
         return MS_FAILURE;
       }
-
-      while( (bytes_read = VSIFReadL( buffer, 1, sizeof(buffer), fp )) > 0 ) {
-        CPLWriteFileInZip( hZip, buffer, bytes_read );
-      }
-      VSIFCloseL( fp );
-
-      CPLCloseFileInZip( hZip );
     }
     CPLCloseZip( hZip );
 
@@ -1022,20 +1110,13 @@ int msOGRWriteFromQuery( mapObj *map, outputFormatObj *format, int sendheaders )
       msIO_sendHeaders();
     }
 
-    fp = VSIFOpenL( zip_filename, "r" );
-    if( fp == NULL ) {
-      msSetError( MS_MISCERR,
-                  "Failed to open zip file '%s'.",
-                  "msOGRWriteFromQuery()",
-                  file_list[0] );
+    if( msOGRSendFile( zip_filename ) != MS_SUCCESS ) {
+      VSIUnlink( zip_filename );
+      msFree( zip_filename );
       msOGRCleanupDS( datasource_name );
       return MS_FAILURE;
     }
 
-    while( (bytes_read = VSIFReadL( buffer, 1, sizeof(buffer), fp )) > 0 )
-      msIO_fwrite( buffer, 1, bytes_read, stdout );
-    VSIFCloseL( fp );
-
     msFree( zip_filename );
 #endif /* defined(CPL_ZIP_API_OFFERED) */
   }
@@ -346,6 +346,15 @@ outputFormatObj *msCreateDefaultOutputFormat( mapObj *map,
     format->renderer = MS_RENDER_WITH_IMAGEMAP;
   }
 
+  if( strcasecmp(driver,"GEOJSON") == 0 ) {
+    if(!name) name="geojson";
+    format = msAllocOutputFormat( map, name, driver );
+    format->mimetype = msStrdup("application/json; subtype=geojson");
+    format->extension = msStrdup("json");
+    format->imagemode = MS_IMAGEMODE_FEATURE;
+    format->renderer = MS_RENDER_WITH_GEOJSON;
+  }
+
   if( strcasecmp(driver,"template") == 0 ) {
     if(!name) name="template";
     format = msAllocOutputFormat( map, name, driver );
@@ -197,6 +197,9 @@ static int msOWSPreParseRequest(cgiRequestObj *request,
   return MS_SUCCESS;
 }
 
+static int msOWSDispatchRequest(mapObj *map, cgiRequestObj *request, int ows_mode,
+                                int use_capabilities_cache);
+
 /*
 ** msOWSDispatch() is the entry point for any OWS request (WMS, WFS, ...)
 ** - If this is a valid request then it is processed and MS_SUCCESS is returned
@@ -206,11 +209,33 @@ static int msOWSPreParseRequest(cgiRequestObj *request,
 ** - If force_ows_mode is false and this does not appear to be a valid OWS
 **   request then MS_DONE is returned and MapServer is expected to process
 **   this as a regular MapServer (traditional CGI) request.
+**
+** The GetCapabilities cache is not used: the map may have been modified in
+** memory by the caller (e.g. MapScript), see msOWSDispatchCached().
 */
 int msOWSDispatch(mapObj *map, cgiRequestObj *request, int ows_mode)
+{
+  return msOWSDispatchRequest(map, request, ows_mode, MS_FALSE);
+}
+
+/*
+** msOWSDispatchCached() is msOWSDispatch() for maps that are exactly what
+** their mapfile and the request parameters describe (the mapserv CGI), for
+** which GetCapabilities responses may be served from or saved to the cache.
+*/
+int msOWSDispatchCached(mapObj *map, cgiRequestObj *request, int ows_mode)
+{
+  return msOWSDispatchRequest(map, request, ows_mode, MS_TRUE);
+}
+
+static int msOWSDispatchRequest(mapObj *map, cgiRequestObj *request, int ows_mode,
+                                int use_capabilities_cache)
 {
   int status = MS_DONE, force_ows_mode = 0;
   owsRequestObj ows_request;
+  const char *cache_namespaces = NULL;
+  char *cache_key = NULL;
+  void *cache_capture = NULL;
 
   if (!request) {
     return status;
@@ -228,6 +253,30 @@ int msOWSDispatch(mapObj *map, cgiRequestObj *request, int ows_mode)
       status = MS_DONE;
   }
 
+  /* GetCapabilities responses may be served from, or saved to, the cache */
+  if (use_capabilities_cache && ows_request.service && ows_request.request &&
+      (EQUAL(ows_request.request, "GetCapabilities") ||
+       EQUAL(ows_request.request, "capabilities"))) {
+    if (EQUAL(ows_request.service, "WMS"))
+      cache_namespaces = "MO";
+    else if (EQUAL(ows_request.service, "WFS"))
+      cache_namespaces = "FO";
+    else if (EQUAL(ows_request.service, "WCS"))
+      cache_namespaces = "CO";
+
+    if (cache_namespaces)
+      cache_key = msOWSCapabilitiesCacheKey(map, request, cache_namespaces);
+
+    if (cache_key) {
+      if (msOWSCapabilitiesCacheServe(map, cache_key, cache_namespaces) == MS_SUCCESS) {
+        msFree(cache_key);
+        msOWSClearRequestObj(&ows_request);
+        return MS_SUCCESS;
+      }
+      cache_capture = msOWSCapabilitiesCacheBeginCapture();
+    }
+  }
+
   if (ows_request.service == NULL) {
     /* exit if service is not set */
     if(force_ows_mode) {
@@ -277,6 +326,14 @@ int msOWSDispatch(mapObj *map, cgiRequestObj *request, int ows_mode)
     status = MS_FAILURE;
   }
 
+  if (cache_capture)
+    msOWSCapabilitiesCacheEndCapture(map, cache_capture, cache_key, cache_namespaces,
+                                     status == MS_SUCCESS);
+  msFree(cache_key);
+
+  /* extents computed for this request are saved once, not once per layer */
+  msOWSLayerExtentCacheFlush();
+
   msOWSClearRequestObj(&ows_request);
   return status;
 }
@@ -1967,6 +2024,8 @@ void msOWSPrintContactInfo( FILE *stream, const char *tabspace,
 ** Try to establish layer extent, first looking for "ows_extent" metadata, and
 ** if not found then call msLayerGetExtent() which will lookup the
 ** layer->extent member, and if not found will open layer to read extent.
+** The latter goes through the extent cache if "extent_cache" is enabled
+** (see mapowscache.c).
 **
 */
 int msOWSGetLayerExtent(mapObj *map, layerObj *lp, const char *namespaces, rectObj *ext)
@@ -1991,7 +2050,7 @@ int msOWSGetLayerExtent(mapObj *map, layerObj *lp, const char *namespaces, rectO
     msFreeCharArray(tokens, n);
     return MS_SUCCESS;
   } else {
-    return msLayerGetExtent(lp, ext);
+    return msOWSGetCachedLayerExtent(map, lp, namespaces, ext);
   }
 
   return MS_FAILURE;
@@ -114,6 +114,7 @@ typedef struct {
 } owsRequestObj;
 
 MS_DLL_EXPORT int msOWSDispatch(mapObj *map, cgiRequestObj *request, int ows_mode);
+MS_DLL_EXPORT int msOWSDispatchCached(mapObj *map, cgiRequestObj *request, int ows_mode);
 
 MS_DLL_EXPORT const char * msOWSLookupMetadata(hashTableObj *metadata,
     const char *namespaces, const char *name);
@@ -289,6 +290,19 @@ outputFormatObj *msOwsIsOutputFormatValid(mapObj *map, const char *format, hashT
     const char *namespaces, const char *name);
 #endif /* #if any wxs service enabled */
 
+/*====================================================================
+ *   mapowscache.c
+ *====================================================================*/
+
+MS_DLL_EXPORT char *msOWSCapabilitiesCacheKey(mapObj *map, cgiRequestObj *request, const char *namespaces);
+MS_DLL_EXPORT int msOWSCapabilitiesCacheServe(mapObj *map, const char *key, const char *namespaces);
+MS_DLL_EXPORT void *msOWSCapabilitiesCacheBeginCapture(void);
+MS_DLL_EXPORT void msOWSCapabilitiesCacheEndCapture(mapObj *map, void *capture, const char *key,
+    const char *namespaces, int store);
+MS_DLL_EXPORT void msOWSCapabilitiesCacheCleanup(void);
+MS_DLL_EXPORT int msOWSGetCachedLayerExtent(mapObj *map, layerObj *lp, const char *namespaces, rectObj *ext);
+MS_DLL_EXPORT void msOWSLayerExtentCacheFlush(void);
+
 /*====================================================================
  *   mapgml.c
  *====================================================================*/
@@ -298,6 +312,8 @@ outputFormatObj *msOwsIsOutputFormatValid(mapObj *map, const char *format, hashT
 #define OWS_WFS_FEATURE_COLLECTION_NAME "msFeatureCollection"
 #define OWS_GML_DEFAULT_GEOMETRY_NAME "msGeometry"
 #define OWS_GML_OCCUR_UNBOUNDED -1
+#define OWS_GML_DEFAULT_PRECISION 6 /* decimals of geometry coordinates */
+#define OWS_GML_MAX_PRECISION 15
 
 /* TODO, there must be a better way to generalize these lists of objects... */
 
@@ -341,6 +357,7 @@ typedef struct {
 typedef struct {
   gmlGeometryObj *geometries;
   int numgeometries;
+  int precision; /* decimals of coordinates (default OWS_GML_DEFAULT_PRECISION) */
 } gmlGeometryListObj;
 
 typedef struct {
@@ -387,6 +404,11 @@ MS_DLL_EXPORT int msGMLWriteQuery(mapObj *map, char *filename, const char *names
 
 #ifdef USE_WFS_SVR
 MS_DLL_EXPORT int msGMLWriteWFSQuery(mapObj *map, FILE *stream, char *wfs_namespace, int outputformat);
+
+typedef struct gmlWFSStreamObj gmlWFSStreamObj;
+MS_DLL_EXPORT gmlWFSStreamObj *msGMLWFSStreamBegin(mapObj *map, FILE *stream, char *wfs_namespace, int outputformat);
+MS_DLL_EXPORT int msGMLWFSStreamWriteShape(layerObj *lp, shapeObj *shape, void *sinkdata);
+MS_DLL_EXPORT int msGMLWFSStreamEnd(gmlWFSStreamObj *wfsstream);
 #endif
 
 
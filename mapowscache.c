@@ -0,0 +1,852 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  Caches used by the OWS services: serialized GetCapabilities
+ *           responses and layer extents / feature counts.
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2013 Regents of the University of Minnesota.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/*
+** GetCapabilities documents are expensive to build (every layer is visited,
+** extents and projections are computed) but only depend on the mapfile and
+** on the request. When the "capabilities_cache" metadata is enabled for a
+** service (e.g. "wms_capabilities_cache" "true" or "ows_capabilities_cache"
+** "true") the complete response written to stdout is captured and kept in a
+** per-process cache, keyed by:
+**
+**   - the full path and modification time of the mapfile,
+**   - what the default online resource is built from (host, port, script),
+**   - all the request parameters (which covers service, version, language,
+**     updatesequence, sections, ...) and the POST body if any.
+**
+** Modifying the mapfile changes the key, so stale documents are never
+** served. Note that files pulled in with INCLUDE are not checked.
+**
+** Only the mapserv CGI uses the cache (msOWSDispatchCached()): there the
+** map is what the mapfile and the request parameters describe. A map that
+** MapScript modified in memory goes through msOWSDispatch(), which never
+** looks at the cache.
+**
+** If "capabilities_cache_dir" is set the documents are also persisted in
+** that directory so they survive process restarts and can be shared between
+** processes. Keys are hashed to one of MS_CAPABILITIES_CACHE_MAX_FILES file
+** names, a new document replaces the one in its slot: requests with extra
+** (e.g. cache busting) parameters can't grow the directory without limit.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "mapserver.h"
+#include "mapows.h"
+#include "mapthread.h"
+
+#if defined(_WIN32) && !defined(__CYGWIN__)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#define MS_CAPABILITIES_CACHE_MAX_BYTES (32*1024*1024)
+#define MS_CAPABILITIES_CACHE_MAX_FILES 256
+
+typedef struct capabilitiesCacheEntry {
+  char *key;
+  unsigned char *data;
+  int size;
+  struct capabilitiesCacheEntry *next; /* most recently used first */
+} capabilitiesCacheEntry;
+
+static capabilitiesCacheEntry *capabilitiesCache = NULL;
+
+typedef struct layerExtentCacheEntry {
+  char *mapfile;
+  char *name;
+  char identity[20];
+  long mapfile_mtime;
+  long timestamp;
+  rectObj extent;   /* minx > maxx if unknown */
+  struct layerExtentCacheEntry *next;
+} layerExtentCacheEntry;
+
+static layerExtentCacheEntry *layerExtentCache = NULL;
+
+/* state of the sidecar file of each mapfile present in layerExtentCache */
+typedef struct extentSidecarState {
+  char *mapfile;
+  long mtime;       /* of the sidecar when last read or written, -1 if missing */
+  long size;
+  int dirty;        /* records changed since, written by msOWSLayerExtentCacheFlush() */
+  struct extentSidecarState *next;
+} extentSidecarState;
+
+static extentSidecarState *extentSidecars = NULL;
+
+static void flushSidecars(void);
+
+/* stdout tee used while a document is being captured */
+typedef struct {
+  msIOContext stdout_context;
+  msIOBuffer buffer;
+} capabilitiesCaptureObj;
+
+/************************************************************************/
+/*                      msOWSCapabilitiesCacheKey()                     */
+/*                                                                      */
+/*      Returns the cache key for this request, or NULL if the          */
+/*      response should not be cached. The caller must free the key.   */
+/************************************************************************/
+
+/* what msBuildOnlineResource() derives the default online resource from */
+static const char *online_resource_env[] = {"SERVER_NAME", "SERVER_PORT", "SCRIPT_NAME", "HTTPS", NULL};
+
+static int compareParams(const void *a, const void *b)
+{
+  return strcmp(*(const char **) a, *(const char **) b);
+}
+
+char *msOWSCapabilitiesCacheKey(mapObj *map, cgiRequestObj *request, const char *namespaces)
+{
+  const char *value;
+  char **params;
+  char *key;
+  char szTime[64];
+  struct stat sbuf;
+  msIOContext *ctx;
+  int i;
+
+  value = msOWSLookupMetadata(&(map->web.metadata), namespaces, "capabilities_cache");
+  if(value == NULL || !(strcasecmp(value, "true") == 0 || strcasecmp(value, "on") == 0))
+    return NULL;
+
+  /* maps built from strings can't be validated */
+  if(map->mapfile == NULL || stat(map->mapfile, &sbuf) != 0)
+    return NULL;
+
+  /* headers don't go through the stream under apache, we can't replay them */
+  ctx = msIO_getHandler(stdout);
+  if(ctx == NULL || strcmp(ctx->label, "apache") == 0)
+    return NULL;
+
+  key = msStringConcatenate(NULL, map->mapfile);
+  snprintf(szTime, sizeof(szTime), "\n%ld\n", (long) sbuf.st_mtime);
+  key = msStringConcatenate(key, szTime);
+
+  for(i=0; online_resource_env[i]; i++) {
+    key = msStringConcatenate(key, getenv(online_resource_env[i]));
+    key = msStringConcatenate(key, "\n");
+  }
+
+  /* parameters sorted by upper cased name so that order doesn't matter */
+  params = (char **) msSmallMalloc(sizeof(char *) * (request->NumParams + 1));
+  for(i=0; i<request->NumParams; i++) {
+    char *param = msStrdup(request->ParamNames[i]);
+    msStringToUpper(param);
+    param = msStringConcatenate(param, "=");
+    params[i] = msStringConcatenate(param, request->ParamValues[i]);
+  }
+  qsort(params, request->NumParams, sizeof(char *), compareParams);
+  for(i=0; i<request->NumParams; i++) {
+    key = msStringConcatenate(key, "\n");
+    key = msStringConcatenate(key, params[i]);
+  }
+  msFreeCharArray(params, request->NumParams);
+
+  if(request->postrequest) {
+    key = msStringConcatenate(key, "\n");
+    key = msStringConcatenate(key, request->postrequest);
+  }
+
+  return key;
+}
+
+/************************************************************************/
+/*                       Persistent (disk) storage                      */
+/************************************************************************/
+
+static char *getCacheFilename(mapObj *map, const char *key, const char *namespaces)
+{
+  const char *dir;
+  char szDir[MS_MAXPATHLEN], szPath[MS_MAXPATHLEN], szName[64];
+  unsigned h = 2166136261U;
+  const char *p;
+
+  dir = msOWSLookupMetadata(&(map->web.metadata), namespaces, "capabilities_cache_dir");
+  if(dir == NULL)
+    return NULL;
+
+  /* the slot of the key, the full key is checked on read */
+  for(p = key; *p; p++)
+    h = (h ^ (unsigned char) *p) * 16777619U;
+  snprintf(szName, sizeof(szName), "capabilities_%03u.cache",
+           (h ^ (h >> 16)) % MS_CAPABILITIES_CACHE_MAX_FILES);
+
+  if(msBuildPath(szDir, map->mappath, dir) == NULL
+      || msBuildPath(szPath, szDir, szName) == NULL)
+    return NULL;
+  return msStrdup(szPath);
+}
+
+static int readCacheFile(const char *filename, const char *key,
+                         unsigned char **data, int *size)
+{
+  FILE *fp;
+  long filesize;
+  int keylen = strlen(key) + 1;
+  unsigned char *buffer;
+
+  if((fp = fopen(filename, "rb")) == NULL)
+    return MS_FAILURE;
+
+  if(fseek(fp, 0, SEEK_END) != 0 || (filesize = ftell(fp)) < keylen) {
+    fclose(fp);
+    return MS_FAILURE;
+  }
+  fseek(fp, 0, SEEK_SET);
+
+  buffer = (unsigned char *) msSmallMalloc(filesize);
+  if(fread(buffer, 1, filesize, fp) != (size_t) filesize
+      || memcmp(buffer, key, keylen) != 0) {
+    free(buffer);
+    fclose(fp);
+    return MS_FAILURE;
+  }
+  fclose(fp);
+
+  *size = filesize - keylen;
+  *data = (unsigned char *) msSmallMalloc(*size + 1);
+  memcpy(*data, buffer + keylen, *size);
+  free(buffer);
+
+  return MS_SUCCESS;
+}
+
+static void writeCacheFile(const char *filename, const char *key,
+                           const unsigned char *data, int size)
+{
+  FILE *fp;
+  char *tmpname;
+  char szPid[32];
+  int ok;
+
+  /* write to a temporary name first so readers never see partial files */
+  snprintf(szPid, sizeof(szPid), ".%ld.tmp", (long) getpid());
+  tmpname = msStringConcatenate(msStrdup(filename), szPid);
+
+  if((fp = fopen(tmpname, "wb")) == NULL) {
+    msDebug("msOWSCapabilitiesCache: unable to write %s\n", tmpname);
+    free(tmpname);
+    return;
+  }
+
+  ok = fwrite(key, 1, strlen(key) + 1, fp) == strlen(key) + 1
+       && fwrite(data, 1, size, fp) == (size_t) size;
+  ok = (fclose(fp) == 0) && ok;
+
+  if(!ok || rename(tmpname, filename) != 0)
+    unlink(tmpname);
+
+  free(tmpname);
+}
+
+/************************************************************************/
+/*                        In memory cache handling                      */
+/*                                                                      */
+/*      Callers must hold TLOCK_OWSCACHE.                               */
+/************************************************************************/
+
+static void freeCacheEntry(capabilitiesCacheEntry *entry)
+{
+  free(entry->key);
+  free(entry->data);
+  free(entry);
+}
+
+static capabilitiesCacheEntry *findCacheEntry(const char *key)
+{
+  capabilitiesCacheEntry *entry, *prev = NULL;
+
+  for(entry = capabilitiesCache; entry; prev = entry, entry = entry->next) {
+    if(strcmp(entry->key, key) == 0) {
+      if(prev) { /* move to the front */
+        prev->next = entry->next;
+        entry->next = capabilitiesCache;
+        capabilitiesCache = entry;
+      }
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+static void addCacheEntry(const char *key, unsigned char *data, int size)
+{
+  capabilitiesCacheEntry *entry, **link;
+  const char *keyend;
+  int pathlen, timelen, total = 0;
+
+  if(size > MS_CAPABILITIES_CACHE_MAX_BYTES) {
+    free(data);
+    return;
+  }
+
+  /* drop documents for older versions of the same mapfile */
+  keyend = strchr(key, '\n');
+  pathlen = keyend - key + 1;
+  timelen = strcspn(keyend + 1, "\n") + 1;
+  link = &capabilitiesCache;
+  while((entry = *link) != NULL) {
+    if(strncmp(entry->key, key, pathlen) == 0
+        && strncmp(entry->key + pathlen, key + pathlen, timelen) != 0) {
+      *link = entry->next;
+      freeCacheEntry(entry);
+    } else
+      link = &(entry->next);
+  }
+
+  entry = (capabilitiesCacheEntry *) msSmallMalloc(sizeof(capabilitiesCacheEntry));
+  entry->key = msStrdup(key);
+  entry->data = data;
+  entry->size = size;
+  entry->next = capabilitiesCache;
+  capabilitiesCache = entry;
+
+  /* evict least recently used documents above the size limit */
+  link = &capabilitiesCache;
+  while((entry = *link) != NULL) {
+    total += entry->size;
+    if(total > MS_CAPABILITIES_CACHE_MAX_BYTES) {
+      *link = entry->next;
+      freeCacheEntry(entry);
+    } else
+      link = &(entry->next);
+  }
+}
+
+/************************************************************************/
+/*                     msOWSCapabilitiesCacheServe()                    */
+/*                                                                      */
+/*      Writes the cached document for key to stdout. Returns           */
+/*      MS_SUCCESS if it was served and MS_DONE on cache miss.          */
+/************************************************************************/
+
+int msOWSCapabilitiesCacheServe(mapObj *map, const char *key, const char *namespaces)
+{
+  capabilitiesCacheEntry *entry;
+  unsigned char *data = NULL;
+  int size = 0;
+  char *filename;
+
+  msAcquireLock(TLOCK_OWSCACHE);
+  entry = findCacheEntry(key);
+  if(entry) {
+    data = (unsigned char *) msSmallMalloc(entry->size + 1);
+    memcpy(data, entry->data, entry->size);
+    size = entry->size;
+  }
+  msReleaseLock(TLOCK_OWSCACHE);
+
+  if(data == NULL) {
+    filename = getCacheFilename(map, key, namespaces);
+    if(filename && readCacheFile(filename, key, &data, &size) == MS_SUCCESS) {
+      unsigned char *copy = (unsigned char *) msSmallMalloc(size + 1);
+      memcpy(copy, data, size);
+      msAcquireLock(TLOCK_OWSCACHE);
+      if(findCacheEntry(key) == NULL)
+        addCacheEntry(key, copy, size);
+      else
+        free(copy);
+      msReleaseLock(TLOCK_OWSCACHE);
+    }
+    msFree(filename);
+  }
+
+  if(data == NULL)
+    return MS_DONE;
+
+  if(map->debug >= MS_DEBUGLEVEL_V)
+    msDebug("msOWSCapabilitiesCacheServe(): serving %d cached bytes\n", size);
+
+  msIO_fwrite(data, 1, size, stdout);
+  free(data);
+
+  return MS_SUCCESS;
+}
+
+/************************************************************************/
+/*                  msOWSCapabilitiesCacheBeginCapture()                */
+/*                                                                      */
+/*      Installs a stdout handler forwarding everything to the          */
+/*      current handler while keeping a copy.                           */
+/************************************************************************/
+
+static int captureWrite(void *cbData, void *data, int byteCount)
+{
+  capabilitiesCaptureObj *capture = (capabilitiesCaptureObj *) cbData;
+
+  msIO_bufferWrite(&(capture->buffer), data, byteCount);
+  return msIO_contextWrite(&(capture->stdout_context), data, byteCount);
+}
+
+void *msOWSCapabilitiesCacheBeginCapture()
+{
+  capabilitiesCaptureObj *capture;
+  msIOContext context;
+  msIOContext *stdout_context = msIO_getHandler(stdout);
+
+  if(stdout_context == NULL)
+    return NULL;
+
+  capture = (capabilitiesCaptureObj *) msSmallCalloc(1, sizeof(capabilitiesCaptureObj));
+  capture->stdout_context = *stdout_context;
+
+  context.label = "capabilities_cache";
+  context.write_channel = MS_TRUE;
+  context.readWriteFunc = captureWrite;
+  context.cbData = capture;
+
+  msIO_installHandlers(msIO_getHandler(stdin), &context, msIO_getHandler(stderr));
+
+  return capture;
+}
+
+/************************************************************************/
+/*                   msOWSCapabilitiesCacheEndCapture()                 */
+/*                                                                      */
+/*      Restores the original stdout handler and, if store is           */
+/*      MS_TRUE, saves the captured document under key.                 */
+/************************************************************************/
+
+void msOWSCapabilitiesCacheEndCapture(mapObj *map, void *handle, const char *key,
+                                      const char *namespaces, int store)
+{
+  capabilitiesCaptureObj *capture = (capabilitiesCaptureObj *) handle;
+  char *filename;
+
+  if(capture == NULL)
+    return;
+
+  msIO_installHandlers(msIO_getHandler(stdin), &(capture->stdout_context), msIO_getHandler(stderr));
+
+  if(store && key && capture->buffer.data_offset > 0) {
+    filename = getCacheFilename(map, key, namespaces);
+    if(filename)
+      writeCacheFile(filename, key, capture->buffer.data, capture->buffer.data_offset);
+    msFree(filename);
+
+    msAcquireLock(TLOCK_OWSCACHE);
+    if(findCacheEntry(key) == NULL) {
+      addCacheEntry(key, capture->buffer.data, capture->buffer.data_offset);
+      capture->buffer.data = NULL;
+    }
+    msReleaseLock(TLOCK_OWSCACHE);
+  }
+
+  msFree(capture->buffer.data);
+  free(capture);
+}
+
+/************************************************************************/
+/*                     msOWSCapabilitiesCacheCleanup()                  */
+/************************************************************************/
+
+void msOWSCapabilitiesCacheCleanup()
+{
+  msAcquireLock(TLOCK_OWSCACHE);
+  flushSidecars();
+  while(extentSidecars) {
+    extentSidecarState *state = extentSidecars;
+    extentSidecars = state->next;
+    free(state->mapfile);
+    free(state);
+  }
+  while(capabilitiesCache) {
+    capabilitiesCacheEntry *entry = capabilitiesCache;
+    capabilitiesCache = entry->next;
+    freeCacheEntry(entry);
+  }
+  while(layerExtentCache) {
+    layerExtentCacheEntry *entry = layerExtentCache;
+    layerExtentCache = entry->next;
+    free(entry->mapfile);
+    free(entry->name);
+    free(entry);
+  }
+  msReleaseLock(TLOCK_OWSCACHE);
+}
+
+/* ==================================================================== */
+/*      Layer extent cache.                                             */
+/*                                                                      */
+/*      When a layer has no "extent" metadata and no EXTENT, building   */
+/*      capabilities asks the data source for it, which is a full scan  */
+/*      for many providers. With "extent_cache" enabled in the map      */
+/*      metadata the extent is computed once, kept per process and      */
+/*      saved to a sidecar file (<mapfile>.extents) so that other       */
+/*      processes and restarts reuse it. Records are invalidated when   */
+/*      the mapfile changes or, if "extent_cache_ttl" is set, after     */
+/*      that many seconds.                                              */
+/*                                                                      */
+/*      The sidecar is only read again when it changed on disk, and     */
+/*      written once at the end of the request that added records       */
+/*      (msOWSLayerExtentCacheFlush()), not once per layer.             */
+/*                                                                      */
+/*      Sidecar lines are tab separated:                                */
+/*        name  identity-hash  mapfile-mtime  time  extent              */
+/*      the identity hash covers the connection and data so that the    */
+/*      sidecar never contains credentials.                             */
+/* ==================================================================== */
+
+static void getLayerIdentity(layerObj *lp, char *identity, int size)
+{
+  const char *parts[4];
+  unsigned h1 = 2166136261U, h2 = 0;
+  char szType[32];
+  const char *p;
+  int i;
+
+  snprintf(szType, sizeof(szType), "%d", lp->connectiontype);
+  parts[0] = szType;
+  parts[1] = lp->connection;
+  parts[2] = lp->data;
+  parts[3] = lp->map ? lp->map->shapepath : NULL;
+
+  for(i=0; i<4; i++) {
+    for(p = parts[i] ? parts[i] : ""; *p; p++) {
+      h1 = (h1 ^ (unsigned char) *p) * 16777619U;
+      h2 = (unsigned char) *p + 31 * h2;
+    }
+    h1 = (h1 ^ '\t') * 16777619U;
+    h2 = '\t' + 31 * h2;
+  }
+
+  snprintf(identity, size, "%08x%08x", h1, h2);
+}
+
+static int getExtentCacheSettings(mapObj *map, const char *namespaces, long *mapfile_mtime, long *ttl)
+{
+  const char *value;
+  struct stat sbuf;
+
+  value = msOWSLookupMetadata(&(map->web.metadata), namespaces, "extent_cache");
+  if(value == NULL || !(strcasecmp(value, "true") == 0 || strcasecmp(value, "on") == 0))
+    return MS_FALSE;
+
+  if(map->mapfile == NULL || stat(map->mapfile, &sbuf) != 0)
+    return MS_FALSE;
+  *mapfile_mtime = (long) sbuf.st_mtime;
+
+  value = msOWSLookupMetadata(&(map->web.metadata), namespaces, "extent_cache_ttl");
+  *ttl = value ? atol(value) : 0;
+
+  return MS_TRUE;
+}
+
+static int isEntryValid(layerExtentCacheEntry *entry, long mapfile_mtime, long ttl)
+{
+  if(entry->mapfile_mtime != mapfile_mtime)
+    return MS_FALSE;
+  if(ttl > 0 && (long) time(NULL) - entry->timestamp > ttl)
+    return MS_FALSE;
+  return MS_TRUE;
+}
+
+/*
+** Parse one sidecar line into entry. Returns MS_FAILURE on malformed lines.
+*/
+static int parseSidecarLine(char *line, layerExtentCacheEntry *entry)
+{
+  char **tokens;
+  int n, status = MS_FAILURE;
+
+  line[strcspn(line, "\r\n")] = '\0';
+  tokens = msStringSplit(line, '\t', &n);
+  if(tokens && n == 5 && strlen(tokens[1]) < sizeof(entry->identity)) {
+    entry->name = msStrdup(tokens[0]);
+    strlcpy(entry->identity, tokens[1], sizeof(entry->identity));
+    entry->mapfile_mtime = atol(tokens[2]);
+    entry->timestamp = atol(tokens[3]);
+    if(sscanf(tokens[4], "%lf %lf %lf %lf", &entry->extent.minx, &entry->extent.miny,
+              &entry->extent.maxx, &entry->extent.maxy) != 4) {
+      entry->extent.minx = entry->extent.miny = 0;
+      entry->extent.maxx = entry->extent.maxy = -1;
+    }
+    status = MS_SUCCESS;
+  }
+  msFreeCharArray(tokens, n);
+
+  return status;
+}
+
+static char *getSidecarFilename(const char *mapfile)
+{
+  return msStringConcatenate(msStrdup(mapfile), ".extents");
+}
+
+static void statSidecar(const char *filename, long *mtime, long *size)
+{
+  struct stat sbuf;
+
+  if(stat(filename, &sbuf) != 0) {
+    *mtime = *size = -1;
+  } else {
+    *mtime = (long) sbuf.st_mtime;
+    *size = (long) sbuf.st_size;
+  }
+}
+
+/*
+** Find (or create) the sidecar state of a mapfile. Caller holds
+** TLOCK_OWSCACHE.
+*/
+static extentSidecarState *getSidecarState(const char *mapfile)
+{
+  extentSidecarState *state;
+
+  for(state = extentSidecars; state; state = state->next) {
+    if(strcmp(state->mapfile, mapfile) == 0)
+      return state;
+  }
+
+  state = (extentSidecarState *) msSmallCalloc(1, sizeof(extentSidecarState));
+  state->mapfile = msStrdup(mapfile);
+  state->mtime = state->size = -2; /* never read */
+  state->next = extentSidecars;
+  extentSidecars = state;
+
+  return state;
+}
+
+/*
+** Load the records of a mapfile from its sidecar file into the in memory
+** cache, for layers not already present, unless the file is unchanged since
+** it was last read or written. Caller holds TLOCK_OWSCACHE.
+*/
+static void loadSidecar(const char *mapfile)
+{
+  extentSidecarState *state = getSidecarState(mapfile);
+  char *filename = getSidecarFilename(mapfile);
+  char line[2048];
+  long mtime, size;
+  FILE *fp;
+
+  statSidecar(filename, &mtime, &size);
+  if(mtime == state->mtime && size == state->size) {
+    free(filename);
+    return;
+  }
+  state->mtime = mtime;
+  state->size = size;
+
+  if((fp = fopen(filename, "r")) != NULL) {
+    while(fgets(line, sizeof(line), fp) != NULL) {
+      layerExtentCacheEntry *entry, *existing;
+
+      if(line[0] == '#')
+        continue;
+
+      entry = (layerExtentCacheEntry *) msSmallCalloc(1, sizeof(layerExtentCacheEntry));
+      if(parseSidecarLine(line, entry) != MS_SUCCESS) {
+        free(entry);
+        continue;
+      }
+
+      for(existing = layerExtentCache; existing; existing = existing->next) {
+        if(strcmp(existing->mapfile, mapfile) == 0 && strcmp(existing->name, entry->name) == 0
+            && strcmp(existing->identity, entry->identity) == 0)
+          break;
+      }
+      if(existing) {
+        free(entry->name);
+        free(entry);
+        continue;
+      }
+
+      entry->mapfile = msStrdup(mapfile);
+      entry->next = layerExtentCache;
+      layerExtentCache = entry;
+    }
+    fclose(fp);
+  }
+
+  free(filename);
+}
+
+/*
+** Rewrite the sidecar with all in memory records of a mapfile. Caller holds
+** TLOCK_OWSCACHE.
+*/
+static void saveSidecar(extentSidecarState *state)
+{
+  char *filename = getSidecarFilename(state->mapfile);
+  char *tmpname;
+  char szPid[32];
+  layerExtentCacheEntry *entry;
+  FILE *fp;
+  int ok = MS_TRUE;
+
+  state->dirty = MS_FALSE;
+
+  snprintf(szPid, sizeof(szPid), ".%ld.tmp", (long) getpid());
+  tmpname = msStringConcatenate(msStrdup(filename), szPid);
+
+  if((fp = fopen(tmpname, "w")) == NULL) {
+    msDebug("msOWSLayerExtentCacheFlush(): unable to write extent cache %s\n", tmpname);
+    free(tmpname);
+    free(filename);
+    return;
+  }
+
+  fprintf(fp, "# MapServer layer extent cache, generated file\n");
+  for(entry = layerExtentCache; entry; entry = entry->next) {
+    if(strcmp(entry->mapfile, state->mapfile) != 0)
+      continue;
+    if(fprintf(fp, "%s\t%s\t%ld\t%ld\t%.15g %.15g %.15g %.15g\n", entry->name, entry->identity,
+               entry->mapfile_mtime, entry->timestamp, entry->extent.minx, entry->extent.miny,
+               entry->extent.maxx, entry->extent.maxy) < 0)
+      ok = MS_FALSE;
+  }
+  ok = (fclose(fp) == 0) && ok;
+
+  if(!ok || rename(tmpname, filename) != 0)
+    unlink(tmpname);
+  else
+    statSidecar(filename, &state->mtime, &state->size);
+
+  free(tmpname);
+  free(filename);
+}
+
+/* Caller holds TLOCK_OWSCACHE. */
+static void flushSidecars()
+{
+  extentSidecarState *state;
+
+  for(state = extentSidecars; state; state = state->next) {
+    if(state->dirty)
+      saveSidecar(state);
+  }
+}
+
+/************************************************************************/
+/*                     msOWSLayerExtentCacheFlush()                     */
+/*                                                                      */
+/*      Write the sidecar files of the maps whose extent records        */
+/*      changed. Called at the end of each OWS request and by           */
+/*      msCleanup().                                                    */
+/************************************************************************/
+
+void msOWSLayerExtentCacheFlush()
+{
+  msAcquireLock(TLOCK_OWSCACHE);
+  flushSidecars();
+  msReleaseLock(TLOCK_OWSCACHE);
+}
+
+/*
+** Find (or create) the cache record for a layer. Caller holds TLOCK_OWSCACHE.
+*/
+static layerExtentCacheEntry *getLayerCacheEntry(mapObj *map, layerObj *lp, int create)
+{
+  layerExtentCacheEntry *entry;
+  char identity[20];
+  int pass;
+
+  getLayerIdentity(lp, identity, sizeof(identity));
+
+  for(pass = 0; pass < 2; pass++) {
+    for(entry = layerExtentCache; entry; entry = entry->next) {
+      if(strcmp(entry->mapfile, map->mapfile) == 0 && strcmp(entry->name, lp->name) == 0
+          && strcmp(entry->identity, identity) == 0)
+        return entry;
+    }
+    if(pass == 0)
+      loadSidecar(map->mapfile);
+  }
+
+  if(!create)
+    return NULL;
+
+  entry = (layerExtentCacheEntry *) msSmallCalloc(1, sizeof(layerExtentCacheEntry));
+  entry->mapfile = msStrdup(map->mapfile);
+  entry->name = msStrdup(lp->name);
+  strlcpy(entry->identity, identity, sizeof(entry->identity));
+  entry->next = layerExtentCache;
+  layerExtentCache = entry;
+
+  return entry;
+}
+
+static void resetLayerCacheEntry(layerExtentCacheEntry *entry, long mapfile_mtime)
+{
+  entry->mapfile_mtime = mapfile_mtime;
+  entry->timestamp = (long) time(NULL);
+  entry->extent.minx = entry->extent.miny = 0;
+  entry->extent.maxx = entry->extent.maxy = -1;
+}
+
+/************************************************************************/
+/*                      msOWSGetCachedLayerExtent()                     */
+/*                                                                      */
+/*      msLayerGetExtent() going through the extent cache when it is    */
+/*      enabled for this map.                                           */
+/************************************************************************/
+
+int msOWSGetCachedLayerExtent(mapObj *map, layerObj *lp, const char *namespaces, rectObj *ext)
+{
+  layerExtentCacheEntry *entry;
+  long mapfile_mtime, ttl;
+  rectObj extent;
+
+  if(MS_VALID_EXTENT(lp->extent) || lp->name == NULL
+      || !getExtentCacheSettings(map, namespaces, &mapfile_mtime, &ttl))
+    return msLayerGetExtent(lp, ext);
+
+  msAcquireLock(TLOCK_OWSCACHE);
+  entry = getLayerCacheEntry(map, lp, MS_FALSE);
+  if(entry && isEntryValid(entry, mapfile_mtime, ttl)
+      && entry->extent.minx <= entry->extent.maxx && entry->extent.miny <= entry->extent.maxy) {
+    *ext = entry->extent;
+    msReleaseLock(TLOCK_OWSCACHE);
+    return MS_SUCCESS;
+  }
+  msReleaseLock(TLOCK_OWSCACHE);
+
+  if(msLayerGetExtent(lp, &extent) != MS_SUCCESS)
+    return MS_FAILURE;
+
+  msAcquireLock(TLOCK_OWSCACHE);
+  entry = getLayerCacheEntry(map, lp, MS_TRUE);
+  if(!isEntryValid(entry, mapfile_mtime, ttl))
+    resetLayerCacheEntry(entry, mapfile_mtime);
+  entry->extent = extent;
+  getSidecarState(map->mapfile)->dirty = MS_TRUE;
+  msReleaseLock(TLOCK_OWSCACHE);
+
+  *ext = extent;
+  return MS_SUCCESS;
+}
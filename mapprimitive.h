@@ -74,6 +74,7 @@ typedef struct {
   lineObj *line;
   char **values;
   void *geometry;
+  void *prepared_geometry;
   void *renderer_cache;
 #endif
 
@@ -94,6 +95,16 @@ typedef struct {
 
 typedef lineObj multipointObj;
 
+#ifndef SWIG
+/* polygon edges bucketed by y for repeated point in polygon tests (mapsearch.c) */
+typedef struct {
+  int numbuckets;
+  double miny, maxy, bucketheight;
+  int *bucketoffsets; /* numbuckets+1 offsets into edges */
+  double *edges; /* x1,y1,x2,y2 per edge, edges spanning several buckets are repeated */
+} edgeIndexObj;
+#endif
+
 #ifndef SWIG
 /* attribute primatives */
 typedef struct {
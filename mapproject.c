@@ -184,6 +184,388 @@ int msProjectPoint(projectionObj *in, projectionObj *out, pointObj *point)
 #endif
 }
 
+/************************************************************************/
+/*                          msProjectPoints()                           */
+/*                                                                      */
+/*      Project an array of points in place, with a single              */
+/*      pj_transform() call (and a single lock with older PROJ) when    */
+/*      both projections are defined. Points that fail to project       */
+/*      are set to HUGE_VAL and no error is set, callers decide what    */
+/*      a failed point means (horizon, dropped point, error).           */
+/************************************************************************/
+#ifdef USE_PROJ
+static void msProjectPoints(projectionObj *in, projectionObj *out,
+                            pointObj *points, int count)
+
+{
+  int i, error;
+  pointObj *saved;
+
+  if( count <= 0 )
+    return;
+
+  if( count == 1
+      || !(in && in->proj && out && out->proj)
+      || (in->numargs == 1 && out->numargs == 1
+          && strcmp(in->args[0],out->args[0]) == 0) ) {
+    for( i = 0; i < count; i++ ) {
+      if( msProjectPoint( in, out, points+i ) == MS_FAILURE )
+        points[i].x = points[i].y = HUGE_VAL;
+    }
+    return;
+  }
+
+  /* keep the input in case PROJ rejects the batch as a whole */
+  saved = (pointObj *) msSmallMalloc(sizeof(pointObj)*count);
+  memcpy( saved, points, sizeof(pointObj)*count );
+
+  if( in->gt.need_geotransform ) {
+    for( i = 0; i < count; i++ ) {
+      double x = points[i].x, y = points[i].y;
+      points[i].x = in->gt.geotransform[0] + in->gt.geotransform[1]*x + in->gt.geotransform[2]*y;
+      points[i].y = in->gt.geotransform[3] + in->gt.geotransform[4]*x + in->gt.geotransform[5]*y;
+    }
+  }
+
+  if( pj_is_latlong(in->proj) ) {
+    for( i = 0; i < count; i++ ) {
+      points[i].x *= DEG_TO_RAD;
+      points[i].y *= DEG_TO_RAD;
+    }
+  }
+
+  /* pointObj is all doubles, so the x and y members can be strided over */
+#if PJ_VERSION < 480
+  msAcquireLock( TLOCK_PROJ );
+#endif
+  error = pj_transform( in->proj, out->proj, count,
+                        sizeof(pointObj)/sizeof(double),
+                        &(points[0].x), &(points[0].y), NULL );
+#if PJ_VERSION < 480
+  msReleaseLock( TLOCK_PROJ );
+#endif
+
+  if( error ) { /* fall back to one point at a time */
+    for( i = 0; i < count; i++ ) {
+      points[i] = saved[i];
+      if( msProjectPoint( in, out, points+i ) == MS_FAILURE )
+        points[i].x = points[i].y = HUGE_VAL;
+    }
+    free( saved );
+    return;
+  }
+  free( saved );
+
+  for( i = 0; i < count; i++ ) {
+    if( points[i].x == HUGE_VAL || points[i].y == HUGE_VAL ) {
+      points[i].x = points[i].y = HUGE_VAL;
+      continue;
+    }
+    if( pj_is_latlong(out->proj) ) {
+      points[i].x *= RAD_TO_DEG;
+      points[i].y *= RAD_TO_DEG;
+    }
+    if( out->gt.need_geotransform ) {
+      double x = points[i].x, y = points[i].y;
+      points[i].x = out->gt.invgeotransform[0] + out->gt.invgeotransform[1]*x + out->gt.invgeotransform[2]*y;
+      points[i].y = out->gt.invgeotransform[3] + out->gt.invgeotransform[4]*x + out->gt.invgeotransform[5]*y;
+    }
+  }
+}
+#endif /* def USE_PROJ */
+
+/************************************************************************/
+/* ==================================================================== */
+/*      Approximate reprojection grid.                                  */
+/*                                                                      */
+/*      A coarse grid of exactly projected nodes is laid over an        */
+/*      extent of the input projection, and vertices falling inside     */
+/*      it are bilinearly interpolated from the corners of their        */
+/*      cell. Cells whose edge and center midpoints differ from the     */
+/*      interpolation by more than the allowed error are split in       */
+/*      four, up to MS_PROJ_GRID_MAXDEPTH times, in the same spirit     */
+/*      as msApproxTransformer() does for rasters. Cells that still     */
+/*      fail, or that have a corner which does not project, are        */
+/*      flagged and their vertices are projected exactly.               */
+/* ==================================================================== */
+/************************************************************************/
+#define MS_PROJ_GRID_SIZE 16
+#define MS_PROJ_GRID_MAXDEPTH 4
+
+#ifdef USE_PROJ
+static int msProjectionGridAddCells(projectionGridObj *grid, int count)
+{
+  int first = grid->numcells;
+
+  if( grid->numcells + count > grid->maxcells ) {
+    grid->maxcells = MS_MAX(grid->maxcells*2, grid->numcells + count);
+    grid->cells = (projectionGridCell *) msSmallRealloc(grid->cells,
+                  sizeof(projectionGridCell)*grid->maxcells);
+  }
+  grid->numcells += count;
+
+  return first;
+}
+
+static void msProjectionGridRefine(projectionGridObj *grid,
+                                   projectionObj *in, projectionObj *out,
+                                   int index, rectObj bounds, int depth)
+{
+  /* probes are the bottom, left, center, right and top midpoints */
+  static const double probe_u[5] = { 0.5, 0.0, 0.5, 1.0, 0.5 };
+  static const double probe_v[5] = { 0.0, 0.5, 0.5, 0.5, 1.0 };
+  pointObj probe[5], corner[4];
+  rectObj sub;
+  double error = 0.0, midx, midy;
+  int i, children;
+
+  memcpy( corner, grid->cells[index].corner, sizeof(corner) );
+  for( i = 0; i < 4; i++ ) {
+    if( corner[i].x == HUGE_VAL ) { /* don't chase the horizon */
+      grid->cells[index].exact = MS_TRUE;
+      return;
+    }
+  }
+
+  midx = (bounds.minx + bounds.maxx) / 2.0;
+  midy = (bounds.miny + bounds.maxy) / 2.0;
+  for( i = 0; i < 5; i++ ) {
+    probe[i].x = bounds.minx + probe_u[i] * (bounds.maxx - bounds.minx);
+    probe[i].y = bounds.miny + probe_v[i] * (bounds.maxy - bounds.miny);
+#ifdef USE_POINT_Z_M
+    probe[i].z = probe[i].m = 0.0;
+#endif
+  }
+  msProjectPoints( in, out, probe, 5 );
+
+  for( i = 0; i < 5 && error != HUGE_VAL; i++ ) {
+    double u = probe_u[i], v = probe_v[i], x, y;
+
+    if( probe[i].x == HUGE_VAL ) {
+      error = HUGE_VAL;
+      break;
+    }
+    x = (1-u)*(1-v)*corner[0].x + u*(1-v)*corner[1].x
+        + (1-u)*v*corner[2].x + u*v*corner[3].x;
+    y = (1-u)*(1-v)*corner[0].y + u*(1-v)*corner[1].y
+        + (1-u)*v*corner[2].y + u*v*corner[3].y;
+    error = MS_MAX(error, fabs(x - probe[i].x) + fabs(y - probe[i].y));
+  }
+
+  if( error <= grid->maxerror )
+    return;
+
+  if( depth >= MS_PROJ_GRID_MAXDEPTH ) {
+    grid->cells[index].exact = MS_TRUE;
+    return;
+  }
+
+  /* split in four: lower left, lower right, upper left, upper right */
+  children = msProjectionGridAddCells( grid, 4 );
+  grid->cells[index].children = children;
+  for( i = 0; i < 4; i++ ) {
+    grid->cells[children+i].children = -1;
+    grid->cells[children+i].exact = MS_FALSE;
+  }
+
+#define SET_CORNERS(c, ll, lr, ul, ur) \
+  grid->cells[children+c].corner[0] = ll; \
+  grid->cells[children+c].corner[1] = lr; \
+  grid->cells[children+c].corner[2] = ul; \
+  grid->cells[children+c].corner[3] = ur;
+  SET_CORNERS( 0, corner[0], probe[0], probe[1], probe[2] );
+  SET_CORNERS( 1, probe[0], corner[1], probe[2], probe[3] );
+  SET_CORNERS( 2, probe[1], probe[2], corner[2], probe[4] );
+  SET_CORNERS( 3, probe[2], probe[3], probe[4], corner[3] );
+#undef SET_CORNERS
+
+  for( i = 0; i < 4; i++ ) {
+    sub.minx = (i & 1) ? midx : bounds.minx;
+    sub.maxx = (i & 1) ? bounds.maxx : midx;
+    sub.miny = (i & 2) ? midy : bounds.miny;
+    sub.maxy = (i & 2) ? bounds.maxy : midy;
+    msProjectionGridRefine( grid, in, out, children+i, sub, depth+1 );
+  }
+}
+
+/*
+** Interpolate a point from the grid, returns MS_FALSE (and leaves the
+** point alone) if it has to be projected exactly.
+*/
+static int msProjectionGridInterpolate(projectionGridObj *grid, pointObj *point)
+{
+  projectionGridCell *cell;
+  double fx, fy, u, v;
+  int ix, iy;
+
+  fx = (point->x - grid->extent.minx) / grid->cellwidth;
+  fy = (point->y - grid->extent.miny) / grid->cellheight;
+  if( !(fx >= 0 && fx <= grid->nx && fy >= 0 && fy <= grid->ny) )
+    return MS_FALSE; /* outside, or NaN */
+
+  ix = MS_MIN((int) fx, grid->nx-1);
+  iy = MS_MIN((int) fy, grid->ny-1);
+  u = fx - ix;
+  v = fy - iy;
+
+  cell = grid->cells + iy*grid->nx + ix;
+  while( cell->children >= 0 ) {
+    int quadrant = 0;
+
+    u *= 2;
+    v *= 2;
+    if( u >= 1.0 ) {
+      quadrant |= 1;
+      u -= 1.0;
+    }
+    if( v >= 1.0 ) {
+      quadrant |= 2;
+      v -= 1.0;
+    }
+    cell = grid->cells + cell->children + quadrant;
+  }
+
+  if( cell->exact )
+    return MS_FALSE;
+
+  point->x = (1-u)*(1-v)*cell->corner[0].x + u*(1-v)*cell->corner[1].x
+             + (1-u)*v*cell->corner[2].x + u*v*cell->corner[3].x;
+  point->y = (1-u)*(1-v)*cell->corner[0].y + u*(1-v)*cell->corner[1].y
+             + (1-u)*v*cell->corner[2].y + u*v*cell->corner[3].y;
+
+  return MS_TRUE;
+}
+
+/*
+** Same contract as msProjectPoints(), but interpolates whatever the grid
+** (if any) covers and projects the remaining points in one batch.
+*/
+static void msProjectPointsGrid(projectionGridObj *grid,
+                                projectionObj *in, projectionObj *out,
+                                pointObj *points, int count)
+{
+  int i, numexact = 0, *exact = NULL;
+  pointObj *exactpoints;
+
+  if( grid == NULL ) {
+    msProjectPoints( in, out, points, count );
+    return;
+  }
+
+  for( i = 0; i < count; i++ ) {
+    if( !msProjectionGridInterpolate( grid, points+i ) ) {
+      if( exact == NULL )
+        exact = (int *) msSmallMalloc(sizeof(int)*count);
+      exact[numexact++] = i;
+    }
+  }
+
+  if( numexact == 0 )
+    return;
+
+  exactpoints = (pointObj *) msSmallMalloc(sizeof(pointObj)*numexact);
+  for( i = 0; i < numexact; i++ )
+    exactpoints[i] = points[exact[i]];
+  msProjectPoints( in, out, exactpoints, numexact );
+  for( i = 0; i < numexact; i++ )
+    points[exact[i]] = exactpoints[i];
+
+  free( exactpoints );
+  free( exact );
+}
+#endif /* def USE_PROJ */
+
+/************************************************************************/
+/*                       msCreateProjectionGrid()                       */
+/*                                                                      */
+/*      Build an approximate reprojection grid over extent (in the      */
+/*      input projection) with a maximum error of maxerror output       */
+/*      units. Returns NULL if no grid is needed or possible, in        */
+/*      which case shapes are simply projected exactly.                 */
+/************************************************************************/
+projectionGridObj *msCreateProjectionGrid(projectionObj *in, projectionObj *out,
+    rectObj *extent, double maxerror)
+{
+#ifdef USE_PROJ
+  projectionGridObj *grid;
+  pointObj *nodes;
+  rectObj bounds;
+  int i, j, n;
+
+  if( in == NULL || out == NULL || in->proj == NULL || out->proj == NULL
+      || maxerror <= 0.0 || !(extent->maxx > extent->minx)
+      || !(extent->maxy > extent->miny) )
+    return NULL;
+
+#ifdef USE_PROJ_FASTPATHS
+  if(in->wellknownprojection == wkp_lonlat && out->wellknownprojection == wkp_gmerc)
+    return NULL; /* already cheaper than interpolating */
+#endif
+
+  grid = (projectionGridObj *) msSmallMalloc(sizeof(projectionGridObj));
+  grid->extent = *extent;
+  grid->nx = grid->ny = MS_PROJ_GRID_SIZE;
+  grid->cellwidth = (extent->maxx - extent->minx) / grid->nx;
+  grid->cellheight = (extent->maxy - extent->miny) / grid->ny;
+  grid->maxerror = maxerror;
+  grid->numcells = grid->maxcells = 0;
+  grid->cells = NULL;
+
+  /* project the coarse nodes all at once */
+  n = grid->nx + 1;
+  nodes = (pointObj *) msSmallMalloc(sizeof(pointObj)*n*(grid->ny+1));
+  for( j = 0; j <= grid->ny; j++ ) {
+    for( i = 0; i <= grid->nx; i++ ) {
+      nodes[j*n+i].x = extent->minx + i*grid->cellwidth;
+      nodes[j*n+i].y = extent->miny + j*grid->cellheight;
+#ifdef USE_POINT_Z_M
+      nodes[j*n+i].z = nodes[j*n+i].m = 0.0;
+#endif
+    }
+  }
+  msProjectPoints( in, out, nodes, n*(grid->ny+1) );
+
+  msProjectionGridAddCells( grid, grid->nx*grid->ny );
+  for( j = 0; j < grid->ny; j++ ) {
+    for( i = 0; i < grid->nx; i++ ) {
+      projectionGridCell *cell = grid->cells + j*grid->nx + i;
+      cell->corner[0] = nodes[j*n+i];
+      cell->corner[1] = nodes[j*n+i+1];
+      cell->corner[2] = nodes[(j+1)*n+i];
+      cell->corner[3] = nodes[(j+1)*n+i+1];
+      cell->children = -1;
+      cell->exact = MS_FALSE;
+    }
+  }
+  free( nodes );
+
+  for( j = 0; j < grid->ny; j++ ) {
+    for( i = 0; i < grid->nx; i++ ) {
+      bounds.minx = extent->minx + i*grid->cellwidth;
+      bounds.maxx = bounds.minx + grid->cellwidth;
+      bounds.miny = extent->miny + j*grid->cellheight;
+      bounds.maxy = bounds.miny + grid->cellheight;
+      msProjectionGridRefine( grid, in, out, j*grid->nx + i, bounds, 0 );
+    }
+  }
+
+  return grid;
+#else
+  return NULL;
+#endif
+}
+
+/************************************************************************/
+/*                        msFreeProjectionGrid()                        */
+/************************************************************************/
+void msFreeProjectionGrid(projectionGridObj *grid)
+{
+  if( grid == NULL )
+    return;
+  free( grid->cells );
+  free( grid );
+}
+
 /************************************************************************/
 /*                         msProjectGrowRect()                          */
 /************************************************************************/
@@ -288,7 +670,7 @@ static int msProjectSegment( projectionObj *in, projectionObj *out,
 #ifdef USE_PROJ
 static int
 msProjectShapeLine(projectionObj *in, projectionObj *out,
-                   shapeObj *shape, int line_index)
+                   projectionGridObj *grid, shapeObj *shape, int line_index)
 
 {
   int i;
@@ -299,6 +681,7 @@ msProjectShapeLine(projectionObj *in, projectionObj *out,
   int numpoints_in = line->numpoints;
   int line_alloc = numpoints_in;
   int wrap_test;
+  pointObj *projected;
 
 #ifdef USE_PROJ_FASTPATHS
 #define MAXEXTENT 20037508.34
@@ -334,14 +717,24 @@ msProjectShapeLine(projectionObj *in, projectionObj *out,
 
   memset( &lastPoint, 0, sizeof(lastPoint) );
 
+  /* -------------------------------------------------------------------- */
+  /*      Project all the points at once, the loop below only deals       */
+  /*      with failed points and wrapping.                                */
+  /* -------------------------------------------------------------------- */
+  projected = (pointObj *) msSmallMalloc(sizeof(pointObj)*MS_MAX(numpoints_in,1));
+  if( numpoints_in > 0 )
+    memcpy( projected, line->point, sizeof(pointObj)*numpoints_in );
+  msProjectPointsGrid( grid, in, out, projected, numpoints_in );
+
   /* -------------------------------------------------------------------- */
   /*      Loop over all input points in linestring.                       */
   /* -------------------------------------------------------------------- */
   for( i=0; i < numpoints_in; i++ ) {
     int ms_err;
-    wrkPoint = thisPoint = line->point[i];
+    thisPoint = line->point[i];
+    wrkPoint = projected[i];
 
-    ms_err = msProjectPoint(in, out, &wrkPoint );
+    ms_err = (wrkPoint.x == HUGE_VAL) ? MS_FAILURE : MS_SUCCESS;
 
     /* -------------------------------------------------------------------- */
     /*      Apply wrap logic.                                               */
@@ -464,6 +857,8 @@ msProjectShapeLine(projectionObj *in, projectionObj *out,
     lastPoint = thisPoint;
   }
 
+  free( projected );
+
   /* -------------------------------------------------------------------- */
   /*      Make sure that polygons are closed, even if the trip over       */
   /*      the horizon left them unclosed.                                 */
@@ -481,10 +876,28 @@ msProjectShapeLine(projectionObj *in, projectionObj *out,
 }
 #endif
 
+#ifdef USE_PROJ
+static int msProjectLineGrid(projectionObj *in, projectionObj *out,
+                             projectionGridObj *grid, lineObj *line);
+#endif
+
 /************************************************************************/
 /*                           msProjectShape()                           */
 /************************************************************************/
 int msProjectShape(projectionObj *in, projectionObj *out, shapeObj *shape)
+{
+  return msProjectShapeGrid(in, out, NULL, shape);
+}
+
+/************************************************************************/
+/*                         msProjectShapeGrid()                         */
+/*                                                                      */
+/*      Same as msProjectShape(), but vertices covered by grid (from    */
+/*      msCreateProjectionGrid(), may be NULL) are interpolated.        */
+/*      Only meant for rendering, results are approximate.              */
+/************************************************************************/
+int msProjectShapeGrid(projectionObj *in, projectionObj *out,
+                       projectionGridObj *grid, shapeObj *shape)
 {
 #ifdef USE_PROJ
   int i;
@@ -516,9 +929,9 @@ int msProjectShape(projectionObj *in, projectionObj *out, shapeObj *shape)
 
   for( i = shape->numlines-1; i >= 0; i-- ) {
     if( shape->type == MS_SHAPE_LINE || shape->type == MS_SHAPE_POLYGON ) {
-      if( msProjectShapeLine( in, out, shape, i ) == MS_FAILURE )
+      if( msProjectShapeLine( in, out, grid, shape, i ) == MS_FAILURE )
         msShapeDeleteLine( shape, i );
-    } else if( msProjectLine(in, out, shape->line+i ) == MS_FAILURE ) {
+    } else if( msProjectLineGrid(in, out, grid, shape->line+i ) == MS_FAILURE ) {
       msShapeDeleteLine( shape, i );
     }
   }
@@ -531,7 +944,7 @@ int msProjectShape(projectionObj *in, projectionObj *out, shapeObj *shape)
     return(MS_SUCCESS);
   }
 #else
-  msSetError(MS_PROJERR, "Projection support is not available.", "msProjectShape()");
+  msSetError(MS_PROJERR, "Projection support is not available.", "msProjectShapeGrid()");
   return(MS_FAILURE);
 #endif
 }
@@ -547,6 +960,17 @@ int msProjectShape(projectionObj *in, projectionObj *out, shapeObj *shape)
 int msProjectLine(projectionObj *in, projectionObj *out, lineObj *line)
 {
 #ifdef USE_PROJ
+  return msProjectLineGrid(in, out, NULL, line);
+#else
+  msSetError(MS_PROJERR, "Projection support is not available.", "msProjectLine()");
+  return(MS_FAILURE);
+#endif
+}
+
+#ifdef USE_PROJ
+static int msProjectLineGrid(projectionObj *in, projectionObj *out,
+                             projectionGridObj *grid, lineObj *line)
+{
   int i, be_careful = 1;
 
   if( be_careful )
@@ -555,19 +979,25 @@ int msProjectLine(projectionObj *in, projectionObj *out, lineObj *line)
 
   if( be_careful ) {
     pointObj  startPoint, thisPoint; /* locations in projected space */
+    pointObj *unprojected;
 
     startPoint = line->point[0];
 
+    /* the wrap test needs the unprojected points */
+    unprojected = (pointObj *) msSmallMalloc(sizeof(pointObj)*MS_MAX(line->numpoints,1));
+    if( line->numpoints > 0 )
+      memcpy( unprojected, line->point, sizeof(pointObj)*line->numpoints );
+    msProjectPointsGrid( grid, in, out, line->point, line->numpoints );
+
     for(i=0; i<line->numpoints; i++) {
       double  dist;
 
-      thisPoint = line->point[i];
+      thisPoint = unprojected[i];
 
       /*
       ** Read comments before msTestNeedWrap() to better understand
       ** this dateline wrapping logic.
       */
-      msProjectPoint(in, out, &(line->point[i]));
       if( i > 0 ) {
         dist = line->point[i].x - line->point[0].x;
         if( fabs(dist) > 180.0 ) {
@@ -583,19 +1013,20 @@ int msProjectLine(projectionObj *in, projectionObj *out, lineObj *line)
 
       }
     }
+    free( unprojected );
   } else {
+    msProjectPointsGrid( grid, in, out, line->point, line->numpoints );
     for(i=0; i<line->numpoints; i++) {
-      if( msProjectPoint(in, out, &(line->point[i])) == MS_FAILURE )
+      if( line->point[i].x == HUGE_VAL ) {
+        msSetError(MS_PROJERR, "Failed to project point %d.", "msProjectLine()", i);
         return MS_FAILURE;
+      }
     }
   }
 
   return(MS_SUCCESS);
-#else
-  msSetError(MS_PROJERR, "Projection support is not available.", "msProjectLine()");
-  return(MS_FAILURE);
-#endif
 }
+#endif /* def USE_PROJ */
 
 /************************************************************************/
 /*                           msProjectRectGrid()                        */
@@ -839,7 +1270,7 @@ msProjectRectAsPolygon(projectionObj *in, projectionObj *out,
   /* -------------------------------------------------------------------- */
   /*      Attempt to reproject.                                           */
   /* -------------------------------------------------------------------- */
-  msProjectShapeLine( in, out, &polygonObj, 0 );
+  msProjectShapeLine( in, out, NULL, &polygonObj, 0 );
 
   /* If no points reprojected, try a grid sampling */
   if( polygonObj.numlines == 0 || polygonObj.line[0].numpoints == 0 ) {
@@ -1126,6 +1557,138 @@ void msSetPROJ_LIB( const char *proj_lib, const char *pszRelToPath )
 #endif
 }
 
+/************************************************************************/
+/*                          Projection pool                             */
+/*                                                                      */
+/*      pj_init() parses the definition and looks up +init= files       */
+/*      every time a mapfile is loaded, although the same handful of    */
+/*      projections is used over and over in a long running process.    */
+/*      msFreeProjection() hands initialized PROJ objects (with their   */
+/*      context) to this pool, keyed by the normalized definition and   */
+/*      the current PROJ_LIB, and msProcessProjection() takes them back */
+/*      out. An object is only ever owned by one projectionObj, so      */
+/*      nothing is shared between threads.                              */
+/************************************************************************/
+#ifdef USE_PROJ
+#define MS_PROJ_POOL_SIZE 64
+
+typedef struct {
+  char *key;
+  projPJ proj;
+#if PJ_VERSION >= 480
+  projCtx proj_ctx;
+#endif
+} projPoolEntry;
+
+static projPoolEntry proj_pool[MS_PROJ_POOL_SIZE];
+static int proj_pool_count = 0;
+
+static char *msProjectionPoolKey(projectionObj *p)
+{
+  int i;
+  char *key;
+
+  if( p->numargs == 0 || strncasecmp(p->args[0], "AUTO", 4) == 0 )
+    return NULL; /* AUTO projections are built from a derived definition */
+
+  key = msStrdup( ms_proj_lib ? ms_proj_lib : "" );
+  for( i = 0; i < p->numargs; i++ ) {
+    const char *arg = p->args[i];
+    while( *arg == '+' || *arg == ' ' ) arg++;
+    key = msStringConcatenate( key, " " );
+    key = msStringConcatenate( key, (char *) arg );
+  }
+
+  return key;
+}
+
+static void msProjectionPoolFreeEntry(projPoolEntry *entry)
+{
+  msFree( entry->key );
+  pj_free( entry->proj );
+#if PJ_VERSION >= 480
+  if( entry->proj_ctx )
+    pj_ctx_free( entry->proj_ctx );
+#endif
+}
+
+/* Returns MS_TRUE and sets p->proj if the pool had a matching object. */
+int msProjectionPoolAcquire(projectionObj *p)
+{
+  int i, found = MS_FALSE;
+  char *key = msProjectionPoolKey( p );
+
+  if( !key )
+    return MS_FALSE;
+
+  msAcquireLock( TLOCK_PROJ );
+  for( i = proj_pool_count-1; i >= 0; i-- ) { /* most recently released first */
+    if( strcmp(proj_pool[i].key, key) == 0 ) {
+      p->proj = proj_pool[i].proj;
+#if PJ_VERSION >= 480
+      p->proj_ctx = proj_pool[i].proj_ctx;
+#endif
+      msFree( proj_pool[i].key );
+      memmove( proj_pool+i, proj_pool+i+1, sizeof(projPoolEntry)*(proj_pool_count-i-1) );
+      proj_pool_count--;
+      found = MS_TRUE;
+      break;
+    }
+  }
+  msReleaseLock( TLOCK_PROJ );
+
+  msFree( key );
+  return found;
+}
+
+/* Returns MS_TRUE if the pool took over p->proj (and its context). */
+int msProjectionPoolRelease(projectionObj *p)
+{
+  char *key;
+
+  if( !p->proj )
+    return MS_FALSE;
+#if PJ_VERSION >= 480
+  if( !p->proj_ctx )
+    return MS_FALSE; /* not created by msProcessProjection() */
+#endif
+
+  if( (key = msProjectionPoolKey( p )) == NULL )
+    return MS_FALSE;
+
+  msAcquireLock( TLOCK_PROJ );
+  if( proj_pool_count == MS_PROJ_POOL_SIZE ) { /* drop the least recently released */
+    msProjectionPoolFreeEntry( proj_pool );
+    memmove( proj_pool, proj_pool+1, sizeof(projPoolEntry)*(MS_PROJ_POOL_SIZE-1) );
+    proj_pool_count--;
+  }
+  proj_pool[proj_pool_count].key = key;
+  proj_pool[proj_pool_count].proj = p->proj;
+#if PJ_VERSION >= 480
+  proj_pool[proj_pool_count].proj_ctx = p->proj_ctx;
+  p->proj_ctx = NULL;
+#endif
+  proj_pool_count++;
+  msReleaseLock( TLOCK_PROJ );
+
+  p->proj = NULL;
+  return MS_TRUE;
+}
+#endif /* def USE_PROJ */
+
+void msProjectionPoolCleanup(void)
+{
+#ifdef USE_PROJ
+  int i;
+
+  msAcquireLock( TLOCK_PROJ );
+  for( i = 0; i < proj_pool_count; i++ )
+    msProjectionPoolFreeEntry( proj_pool+i );
+  proj_pool_count = 0;
+  msReleaseLock( TLOCK_PROJ );
+#endif
+}
+
 /************************************************************************/
 /*                       msGetProjectionString()                        */
 /*                                                                      */
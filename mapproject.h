@@ -75,9 +75,28 @@ extern "C" {
 
 #ifndef SWIG
 
+  /* approximate reprojection grid, see msCreateProjectionGrid() */
+  typedef struct {
+    pointObj corner[4]; /* projected lower left, lower right, upper left, upper right corners */
+    int children; /* index of the first of four sub-cells, -1 for a leaf */
+    int exact; /* leaf that failed the error test, its points are projected exactly */
+  } projectionGridCell;
+
+  typedef struct {
+    rectObj extent; /* grid extent, in the input projection */
+    int nx, ny; /* number of top level cells */
+    double cellwidth, cellheight;
+    double maxerror; /* in output projection units */
+    int numcells, maxcells;
+    projectionGridCell *cells; /* nx*ny top level cells, followed by sub-cells */
+  } projectionGridObj;
+
   MS_DLL_EXPORT int msIsAxisInverted(int epsg_code);
   MS_DLL_EXPORT int msProjectPoint(projectionObj *in, projectionObj *out, pointObj *point);
   MS_DLL_EXPORT int msProjectShape(projectionObj *in, projectionObj *out, shapeObj *shape);
+  MS_DLL_EXPORT int msProjectShapeGrid(projectionObj *in, projectionObj *out, projectionGridObj *grid, shapeObj *shape);
+  MS_DLL_EXPORT projectionGridObj *msCreateProjectionGrid(projectionObj *in, projectionObj *out, rectObj *extent, double maxerror);
+  MS_DLL_EXPORT void msFreeProjectionGrid(projectionGridObj *grid);
   MS_DLL_EXPORT int msProjectLine(projectionObj *in, projectionObj *out, lineObj *line);
   MS_DLL_EXPORT int msProjectRect(projectionObj *in, projectionObj *out, rectObj *rect);
   MS_DLL_EXPORT int msProjectionsDiffer(projectionObj *, projectionObj *);
@@ -97,6 +116,9 @@ extern "C" {
       double *x, double *y );
 
   MS_DLL_EXPORT void msSetPROJ_LIB( const char *, const char * );
+  MS_DLL_EXPORT int msProjectionPoolAcquire(projectionObj *p);
+  MS_DLL_EXPORT int msProjectionPoolRelease(projectionObj *p);
+  MS_DLL_EXPORT void msProjectionPoolCleanup(void);
 
   /* Provides compatiblity with PROJ.4 4.4.2 */
 #ifndef PJ_VERSION
@@ -58,6 +58,9 @@ int msInitQuery(queryObj *query)
   query->item = query->str = NULL;
   query->filter = NULL;
 
+  query->sink = NULL;
+  query->sinkdata = NULL;
+
   return MS_SUCCESS;
 }
 
@@ -146,15 +149,15 @@ static int addResult(resultCacheObj *cache, shapeObj *shape)
   int i;
 
   if(cache->numresults == cache->cachesize) { /* just add it to the end */
-    if(cache->cachesize == 0)
-      cache->results = (resultObj *) malloc(sizeof(resultObj)*MS_RESULTCACHEINCREMENT);
-    else
-      cache->results = (resultObj *) realloc(cache->results, sizeof(resultObj)*(cache->cachesize+MS_RESULTCACHEINCREMENT));
-    if(!cache->results) {
+    /* grow geometrically, large result sets would otherwise realloc every few shapes */
+    int cachesize = (cache->cachesize == 0) ? MS_RESULTCACHEINCREMENT : cache->cachesize*2;
+    resultObj *results = (resultObj *) realloc(cache->results, sizeof(resultObj)*cachesize);
+    if(!results) {
       msSetError(MS_MEMERR, "Realloc() error.", "addResult()");
       return(MS_FAILURE);
     }
-    cache->cachesize += MS_RESULTCACHEINCREMENT;
+    cache->results = results;
+    cache->cachesize = cachesize;
   }
 
   i = cache->numresults;
@@ -173,20 +176,130 @@ static int addResult(resultCacheObj *cache, shapeObj *shape)
   return(MS_SUCCESS);
 }
 
+/*
+** Bounded top-K by distance for msQueryByPoint(): the first numresults
+** entries of the cache are kept as a max-heap on distance (distances[] and
+** bounds[] are parallel to cache->results), so the root is the farthest of
+** the kept shapes and is the one replaced by a closer candidate.
+*/
+static void swapResults(resultCacheObj *cache, double *distances, rectObj *bounds, int i, int j)
+{
+  resultObj r = cache->results[i];
+  double d = distances[i];
+  rectObj b = bounds[i];
+
+  cache->results[i] = cache->results[j];
+  distances[i] = distances[j];
+  bounds[i] = bounds[j];
+  cache->results[j] = r;
+  distances[j] = d;
+  bounds[j] = b;
+}
+
+static void siftDownResult(resultCacheObj *cache, double *distances, rectObj *bounds, int i, int n)
+{
+  int child;
+
+  while((child = 2*i+1) < n) {
+    if(child+1 < n && distances[child+1] > distances[child]) child++;
+    if(distances[i] >= distances[child]) break;
+    swapResults(cache, distances, bounds, i, child);
+    i = child;
+  }
+}
+
+static int addResultByDistance(resultCacheObj *cache, double *distances, rectObj *bounds, int maxresults, shapeObj *shape, double d)
+{
+  int i;
+
+  if(cache->numresults < maxresults) {
+    if(addResult(cache, shape) != MS_SUCCESS) return(MS_FAILURE);
+    i = cache->numresults-1;
+    distances[i] = d;
+    bounds[i] = shape->bounds;
+    while(i > 0 && distances[(i-1)/2] < distances[i]) { /* sift up */
+      swapResults(cache, distances, bounds, i, (i-1)/2);
+      i = (i-1)/2;
+    }
+  } else if(d < distances[0]) { /* closer than the farthest kept shape, replace it */
+    cache->results[0].classindex = shape->classindex;
+    cache->results[0].tileindex = shape->tileindex;
+    cache->results[0].shapeindex = shape->index;
+    cache->results[0].resultindex = shape->resultindex;
+    distances[0] = d;
+    bounds[0] = shape->bounds;
+    siftDownResult(cache, distances, bounds, 0, cache->numresults);
+  }
+
+  return(MS_SUCCESS);
+}
+
+/*
+** Turn the heap into a list ordered by increasing distance and recompute
+** the cache bounds, which still include replaced shapes.
+*/
+static void sortResultsByDistance(resultCacheObj *cache, double *distances, rectObj *bounds)
+{
+  int i;
+
+  for(i=cache->numresults-1; i>0; i--) {
+    swapResults(cache, distances, bounds, 0, i);
+    siftDownResult(cache, distances, bounds, 0, i);
+  }
+
+  for(i=0; i<cache->numresults; i++) {
+    if(i == 0)
+      cache->bounds = bounds[0];
+    else
+      msMergeRect(&(cache->bounds), &(bounds[i]));
+  }
+}
+
 /*
 ** Serialize a query result set to disk.
+**
+** After the magic string line the file holds a small binary header, a table
+** with one entry per layer with results (layer index, count, bounds and the
+** file offset of its results) and then the resultObj arrays of each layer in
+** native layout, so loading a layer is a single read straight into its
+** result cache. The header records the byte order and structure sizes, a
+** file written on a different architecture is refused rather than misread.
 */
+#define MS_QUERY_RESULTS_TAG "MSQR"
+#define MS_QUERY_RESULTS_VERSION 2
+#define MS_QUERY_RESULTS_BYTEORDER 0x01020304
+
+typedef struct {
+  char tag[4];
+  int version;
+  int byteorder;
+  int resultsize; /* sizeof(resultObj) */
+  int entrysize; /* sizeof(queryResultsEntry) */
+  int numlayers;
+} queryResultsHeader;
+
+typedef struct {
+  int layerindex;
+  int numresults;
+  rectObj bounds;
+  long offset; /* of the results from the start of the file */
+} queryResultsEntry;
+
 static int saveQueryResults(mapObj *map, char *filename)
 {
   FILE *stream;
-  int i, j, n=0;
+  int i, n=0;
+  long offset;
+  queryResultsHeader header;
+  queryResultsEntry entry;
+  resultCacheObj *cache;
 
   if(!filename) {
     msSetError(MS_MISCERR, "No filename provided to save query results to.", "saveQueryResults()");
     return MS_FAILURE;
   }
 
-  stream = fopen(filename, "w");
+  stream = fopen(filename, "wb");
   if(!stream) {
     msSetError(MS_IOERR, "(%s)", "saveQueryResults()", filename);
     return MS_FAILURE;
@@ -197,26 +310,147 @@ static int saveQueryResults(mapObj *map, char *filename)
   /* count the number of layers with results */
   for(i=0; i<map->numlayers; i++)
     if(GET_LAYER(map, i)->resultcache) n++;
-  fwrite(&n, sizeof(int), 1, stream);
 
-  /* now write the result set for each layer */
+  memset(&header, 0, sizeof(header));
+  memcpy(header.tag, MS_QUERY_RESULTS_TAG, 4);
+  header.version = MS_QUERY_RESULTS_VERSION;
+  header.byteorder = MS_QUERY_RESULTS_BYTEORDER;
+  header.resultsize = sizeof(resultObj);
+  header.entrysize = sizeof(queryResultsEntry);
+  header.numlayers = n;
+  fwrite(&header, sizeof(header), 1, stream);
+
+  /* the offset table, results follow it in the same layer order */
+  offset = ftell(stream) + n*sizeof(queryResultsEntry);
   for(i=0; i<map->numlayers; i++) {
-    if(GET_LAYER(map, i)->resultcache) {
-      fwrite(&i, sizeof(int), 1, stream); /* layer index */
-      fwrite(&(GET_LAYER(map, i)->resultcache->numresults), sizeof(int), 1, stream); /* number of results */
-      fwrite(&(GET_LAYER(map, i)->resultcache->bounds), sizeof(rectObj), 1, stream); /* bounding box */
-      for(j=0; j<GET_LAYER(map, i)->resultcache->numresults; j++)
-        fwrite(&(GET_LAYER(map, i)->resultcache->results[j]), sizeof(resultObj), 1, stream); /* each result */
+    if((cache = GET_LAYER(map, i)->resultcache) != NULL) {
+      memset(&entry, 0, sizeof(entry));
+      entry.layerindex = i;
+      entry.numresults = cache->numresults;
+      entry.bounds = cache->bounds;
+      entry.offset = offset;
+      fwrite(&entry, sizeof(entry), 1, stream);
+      offset += cache->numresults*sizeof(resultObj);
     }
   }
 
-  fclose(stream);
+  for(i=0; i<map->numlayers; i++) {
+    if((cache = GET_LAYER(map, i)->resultcache) != NULL && cache->numresults > 0) {
+      if(fwrite(cache->results, sizeof(resultObj), cache->numresults, stream) != (size_t) cache->numresults) {
+        msSetError(MS_IOERR, "Failed writing results to %s.", "saveQueryResults()", filename);
+        fclose(stream);
+        return MS_FAILURE;
+      }
+    }
+  }
+
+  if(fclose(stream) != 0) {
+    msSetError(MS_IOERR, "Failed writing results to %s.", "saveQueryResults()", filename);
+    return MS_FAILURE;
+  }
+  return MS_SUCCESS;
+}
+
+static void resetLoadedResults(layerObj *layer)
+{
+  int k;
+  resultObj *results = layer->resultcache->results;
+
+  for(k=0; k<layer->resultcache->numresults; k++) {
+    if(!layer->tileindex) results[k].tileindex = -1; /* reset the tile index for non-tiled layers */
+    results[k].resultindex = -1; /* all results loaded this way have a -1 result (set) index */
+  }
+}
+
+static int loadQueryResultsTable(mapObj *map, FILE *stream)
+{
+  int i;
+  queryResultsHeader header;
+  queryResultsEntry *entries;
+  layerObj *lp;
+
+  if(1 != fread(&header, sizeof(header), 1, stream) || memcmp(header.tag, MS_QUERY_RESULTS_TAG, 4) != 0) {
+    msSetError(MS_MISCERR,"failed to read header from query file stream", "loadQueryResults()");
+    return MS_FAILURE;
+  }
+
+  if(header.version != MS_QUERY_RESULTS_VERSION || header.byteorder != MS_QUERY_RESULTS_BYTEORDER ||
+      header.resultsize != sizeof(resultObj) || header.entrysize != sizeof(queryResultsEntry) || header.numlayers < 0) {
+    msSetError(MS_MISCERR, "Query file version %d was written by an incompatible build or platform.", "loadQueryResults()", header.version);
+    return MS_FAILURE;
+  }
+
+  entries = (queryResultsEntry *) msSmallMalloc(MS_MAX(header.numlayers, 1)*sizeof(queryResultsEntry));
+  if(header.numlayers > 0 && fread(entries, sizeof(queryResultsEntry), header.numlayers, stream) != (size_t) header.numlayers) {
+    msSetError(MS_MISCERR,"failed to read layer table from query file stream", "loadQueryResults()");
+    free(entries);
+    return MS_FAILURE;
+  }
+
+  for(i=0; i<header.numlayers; i++) {
+    if(entries[i].layerindex < 0 || entries[i].layerindex >= map->numlayers || entries[i].numresults < 0) {
+      msSetError(MS_MISCERR, "Invalid layer index loaded from query file.", "loadQueryResults()");
+      free(entries);
+      return MS_FAILURE;
+    }
+    lp = GET_LAYER(map, entries[i].layerindex);
+
+    if(lp->resultcache) { /* a layer listed twice, or left from an earlier query */
+      if(lp->resultcache->results) free(lp->resultcache->results);
+      free(lp->resultcache);
+    }
+    lp->resultcache = (resultCacheObj *)malloc(sizeof(resultCacheObj)); /* allocate and initialize the result cache */
+    if(!lp->resultcache) {
+      msSetError(MS_MEMERR, "Failed to allocate result cache.", "loadQueryResults()");
+      free(entries);
+      return MS_FAILURE;
+    }
+    initResultCache(lp->resultcache);
+    lp->resultcache->bounds = entries[i].bounds;
+
+    if(entries[i].numresults == 0) continue;
+
+    lp->resultcache->results = (resultObj *) malloc(sizeof(resultObj)*entries[i].numresults);
+    if(!lp->resultcache->results) {
+      msSetError(MS_MEMERR, "%s: %d: Out of memory allocating %u bytes.\n", "loadQueryResults()",
+                 __FILE__, __LINE__, sizeof(resultObj)*entries[i].numresults);
+      free(lp->resultcache);
+      lp->resultcache = NULL;
+      free(entries);
+      return MS_FAILURE;
+    }
+
+    /* one read for the whole layer */
+    if(fseek(stream, entries[i].offset, SEEK_SET) != 0 ||
+        fread(lp->resultcache->results, sizeof(resultObj), entries[i].numresults, stream) != (size_t) entries[i].numresults) {
+      msSetError(MS_MISCERR,"failed to read results of layer %d from query file stream", "loadQueryResults()", entries[i].layerindex);
+      free(lp->resultcache->results);
+      free(lp->resultcache);
+      lp->resultcache = NULL;
+      free(entries);
+      return MS_FAILURE;
+    }
+    lp->resultcache->numresults = lp->resultcache->cachesize = entries[i].numresults;
+
+    resetLoadedResults(lp);
+  }
+
+  free(entries);
   return MS_SUCCESS;
 }
 
 static int loadQueryResults(mapObj *map, FILE *stream)
 {
   int i, j, k, n=0;
+  char tag[4];
+  long start = ftell(stream);
+
+  /* current files start with a tag, older ones directly with the layer count */
+  if(fread(tag, 1, 4, stream) == 4 && memcmp(tag, MS_QUERY_RESULTS_TAG, 4) == 0) {
+    fseek(stream, start, SEEK_SET);
+    return loadQueryResultsTable(map, stream);
+  }
+  fseek(stream, start, SEEK_SET);
 
   if(1 != fread(&n, sizeof(int), 1, stream)) {
     msSetError(MS_MISCERR,"failed to read query count from query file stream", "loadQueryResults()");
@@ -353,13 +587,13 @@ static int loadQueryParams(mapObj *map, FILE *stream)
       case 6:
         if(strncmp(buffer, "NULL", 4) != 0) {
           map->query.item = msStrdup(buffer);
-          msStringChop(map->query.item);
+          map->query.item[strcspn(map->query.item, "\r\n")] = '\0'; /* the file is read in binary mode */
         }
         break;
       case 7:
         if(strncmp(buffer, "NULL", 4) != 0) {
           map->query.str = msStrdup(buffer);
-          msStringChop(map->query.str);
+          map->query.str[strcspn(map->query.str, "\r\n")] = '\0'; /* the file is read in binary mode */
         }
         break;
       case 8:
@@ -447,7 +681,7 @@ int msLoadQuery(mapObj *map, char *filename)
   /*
   ** Open the file and inspect the first line.
   */
-  stream = fopen(filename, "r");
+  stream = fopen(filename, "rb"); /* query results are binary */
   if(!stream) {
     msSetError(MS_IOERR, "(%s)", "msLoadQuery()", filename);
     return MS_FAILURE;
@@ -1003,6 +1237,7 @@ int msQueryByRect(mapObj *map)
   int nclasses = 0;
   int *classgroup = NULL;
   double minfeaturesize = -1;
+  int numresults, numstreamed = 0;
 
   if(map->query.type != MS_QUERY_BY_RECT) {
     msSetError(MS_QUERYERR, "The query is not properly defined.", "msQueryByRect()");
@@ -1104,9 +1339,12 @@ int msQueryByRect(mapObj *map)
       return(MS_FAILURE);
     }
 
-    lp->resultcache = (resultCacheObj *)malloc(sizeof(resultCacheObj)); /* allocate and initialize the result cache */
-    MS_CHECK_ALLOC(lp->resultcache, sizeof(resultCacheObj), MS_FAILURE);
-    initResultCache( lp->resultcache);
+    if(!map->query.sink) {
+      lp->resultcache = (resultCacheObj *)malloc(sizeof(resultCacheObj)); /* allocate and initialize the result cache */
+      MS_CHECK_ALLOC(lp->resultcache, sizeof(resultCacheObj), MS_FAILURE);
+      initResultCache( lp->resultcache);
+    }
+    numresults = 0;
 
     nclasses = 0;
     classgroup = NULL;
@@ -1171,13 +1409,28 @@ int msQueryByRect(mapObj *map)
           msFreeShape(&shape);
           continue;
         }
-        addResult(lp->resultcache, &shape);
+        if(map->query.sink) {
+          /* stream the shape out rather than caching it, nothing to re-read later */
+          if(map->query.sink(lp, &shape, map->query.sinkdata) != MS_SUCCESS) {
+            msFreeShape(&shape);
+            status = MS_FAILURE;
+            break;
+          }
+        } else
+          addResult(lp->resultcache, &shape);
+        numresults++;
         --map->query.maxfeatures;
       }
       msFreeShape(&shape);
 
       /* check shape count */
-      if(lp->maxfeatures > 0 && lp->maxfeatures == lp->resultcache->numresults) {
+      if(lp->maxfeatures > 0 && lp->maxfeatures == numresults) {
+        status = MS_DONE;
+        break;
+      }
+
+      /* FEATURE_COUNT and the like, no need to look at the remaining candidates */
+      if(map->query.mode == MS_QUERY_MULTIPLE && map->query.maxresults > 0 && numresults == map->query.maxresults) {
         status = MS_DONE;
         break;
       }
@@ -1187,14 +1440,20 @@ int msQueryByRect(mapObj *map)
     if (classgroup)
       msFree(classgroup);
 
-    if(status != MS_DONE) return(MS_FAILURE);
+    if(status != MS_DONE) {
+      if(map->query.sink) msLayerClose(lp);
+      return(MS_FAILURE);
+    }
 
-    if(lp->resultcache->numresults == 0) msLayerClose(lp); /* no need to keep the layer open */
+    numstreamed += (map->query.sink) ? numresults : 0;
+    if(numresults == 0 || map->query.sink) msLayerClose(lp); /* no need to keep the layer open */
   } /* next layer */
 
   msFreeShape(&searchshape);
 
   /* was anything found? */
+  if(numstreamed > 0)
+    return(MS_SUCCESS);
   for(l=start; l>=stop; l--) {
     if(GET_LAYER(map, l)->resultcache && GET_LAYER(map, l)->resultcache->numresults > 0)
       return(MS_SUCCESS);
@@ -1214,17 +1473,51 @@ static int is_duplicate(resultCacheObj *resultcache, int shapeindex, int tileind
   return(MS_FALSE);
 }
 
+/*
+** Intersection test of a query shape against a candidate shape using the
+** query polygon's edge index for points, or the query shape's prepared GEOS
+** geometry (see msGEOSPrepare()). For GEOS the bounds of both shapes are
+** compared first so most misses never get converted. Returns
+** MS_TRUE/MS_FALSE, or -1 if neither is available and the caller has to
+** fall back to the native intersection tests.
+*/
+static int msQueryShapeIntersects(shapeObj *qshape, edgeIndexObj *qindex, shapeObj *shape)
+{
+#ifdef USE_GEOS
+  int intersects;
+#endif
+
+  if(qindex && shape->type == MS_SHAPE_POINT)
+    return msEdgeIndexIntersectMultipoint(qindex, shape);
+
+#ifdef USE_GEOS
+
+  if(!qshape->prepared_geometry)
+    return -1;
+
+  if(msRectOverlap(&(qshape->bounds), &(shape->bounds)) != MS_TRUE)
+    return MS_FALSE;
+
+  intersects = msGEOSIntersects(qshape, shape);
+  return ((intersects == -1) ? -1 : (intersects ? MS_TRUE : MS_FALSE));
+#else
+  return -1;
+#endif
+}
+
 int msQueryByFeatures(mapObj *map)
 {
   int i, l;
   int start, stop=0;
   layerObj *lp, *slp;
   char status;
+  int intersects;
 
   double distance, tolerance, layer_tolerance;
 
   rectObj searchrect;
   shapeObj shape, selectshape;
+  edgeIndexObj *selectindex;
   int nclasses = 0;
   int *classgroup = NULL;
   double minfeaturesize = -1;
@@ -1343,6 +1636,10 @@ int msQueryByFeatures(mapObj *map)
         slp->project = MS_FALSE;
 #endif
 
+#ifdef USE_GEOS
+      msGEOSPrepare(&selectshape); /* tested against every candidate below */
+#endif
+
       /* identify target shapes */
       searchrect = selectshape.bounds;
 
@@ -1383,6 +1680,8 @@ int msQueryByFeatures(mapObj *map)
       if (lp->minfeaturesize > 0)
         minfeaturesize = Pix2LayerGeoref(map, lp, lp->minfeaturesize);
 
+      selectindex = msCreateEdgeIndex(&selectshape); /* NULL for lines */
+
       while((status = msLayerNextShape(lp, &shape)) == MS_SUCCESS) { /* step through the shapes */
 
         /* check for dups when there are multiple selection shapes */
@@ -1411,13 +1710,16 @@ int msQueryByFeatures(mapObj *map)
         }
 
 #ifdef USE_PROJ
-        if(lp->project && msProjectionsDiffer(&(lp->projection), &(map->projection)))
+        if(lp->project && msProjectionsDiffer(&(lp->projection), &(map->projection))) {
           msProjectShape(&(lp->projection), &(map->projection), &shape);
-        else
+          msComputeBounds(&shape);
+        } else
           lp->project = MS_FALSE;
 #endif
 
-        switch(selectshape.type) { /* may eventually support types other than polygon on line */
+        if(tolerance == 0 && (intersects = msQueryShapeIntersects(&selectshape, selectindex, &shape)) != -1)
+          status = intersects;
+        else switch(selectshape.type) { /* may eventually support types other than polygon on line */
           case MS_SHAPE_POLYGON:
             switch(shape.type) { /* make sure shape actually intersects the selectshape */
               case MS_SHAPE_POINT:
@@ -1503,6 +1805,8 @@ int msQueryByFeatures(mapObj *map)
         }
       } /* next shape */
 
+      msFreeEdgeIndex(selectindex);
+
       if (classgroup)
         msFree(classgroup);
 
@@ -1535,8 +1839,8 @@ int msQueryByFeatures(mapObj *map)
  * With mode=MS_QUERY_MULTIPLE:
  *   Set maxresults = 0 to have an unlimited number of results.
  *   Set maxresults > 0 to limit the number of results per layer (the shapes
- *     returned are the first ones found in each layer and are not necessarily
- *     the closest ones).
+ *     returned are the closest ones of each layer, ordered by distance; only
+ *     maxresults of them are held at any time).
  */
 int msQueryByPoint(mapObj *map)
 {
@@ -1556,6 +1860,10 @@ int msQueryByPoint(mapObj *map)
   int *classgroup = NULL;
   double minfeaturesize = -1;
 
+  int topk = 0; /* keep the maxresults closest shapes of each layer */
+  double *distances = NULL;
+  rectObj *bounds = NULL;
+
   if(map->query.type != MS_QUERY_BY_POINT) {
     msSetError(MS_QUERYERR, "The query is not properly defined.", "msQueryByPoint()");
     return(MS_FAILURE);
@@ -1673,6 +1981,13 @@ int msQueryByPoint(mapObj *map)
     if (lp->minfeaturesize > 0)
       minfeaturesize = Pix2LayerGeoref(map, lp, lp->minfeaturesize);
 
+    if(map->query.mode == MS_QUERY_MULTIPLE && map->query.maxresults > 0) {
+      topk = map->query.maxresults;
+      if(lp->maxfeatures > 0 && lp->maxfeatures < topk) topk = lp->maxfeatures;
+      distances = (double *) msSmallMalloc(topk*sizeof(double));
+      bounds = (rectObj *) msSmallMalloc(topk*sizeof(rectObj));
+    }
+
     while((status = msLayerNextShape(lp, &shape)) == MS_SUCCESS) { /* step through the shapes */
 
       /* Check if the shape size is ok to be drawn */
@@ -1717,6 +2032,10 @@ int msQueryByPoint(mapObj *map)
           lp->resultcache->numresults = 0;
           addResult(lp->resultcache, &shape);
           t = d; /* next one must be closer */
+        } else if(topk > 0) {
+          addResultByDistance(lp->resultcache, distances, bounds, topk, &shape, d);
+          if(lp->resultcache->numresults == topk)
+            t = distances[0]; /* next ones must be closer than the farthest kept */
         } else {
           addResult(lp->resultcache, &shape);
         }
@@ -1724,18 +2043,20 @@ int msQueryByPoint(mapObj *map)
 
       msFreeShape(&shape);
 
-      if(map->query.mode == MS_QUERY_MULTIPLE && map->query.maxresults > 0 && lp->resultcache->numresults == map->query.maxresults) {
-        status = MS_DONE;   /* got enough results for this layer */
-        break;
-      }
-
-      /* check shape count */
-      if(lp->maxfeatures > 0 && lp->maxfeatures == lp->resultcache->numresults) {
+      /* check shape count, the closest shapes can only be known at the end */
+      if(topk == 0 && lp->maxfeatures > 0 && lp->maxfeatures == lp->resultcache->numresults) {
         status = MS_DONE;
         break;
       }
     } /* next shape */
 
+    if(topk > 0) {
+      if(status == MS_DONE)
+        sortResultsByDistance(lp->resultcache, distances, bounds);
+      msFree(distances);
+      msFree(bounds);
+    }
+
     if (classgroup)
       msFree(classgroup);
 
@@ -1761,8 +2082,10 @@ int msQueryByShape(mapObj *map)
 {
   int start, stop=0, l;
   shapeObj shape, *qshape=NULL;
+  edgeIndexObj *qindex;
   layerObj *lp;
   char status;
+  int intersects;
   double distance, tolerance, layer_tolerance;
   rectObj searchrect;
 
@@ -1794,6 +2117,13 @@ int msQueryByShape(mapObj *map)
 
   msComputeBounds(qshape); /* make sure an accurate extent exists */
 
+#ifdef USE_GEOS
+  /* the shape may have been edited since a previous query, rebuild its geometry */
+  msGEOSFreeGeometry(qshape);
+  if(qshape->type != MS_SHAPE_POINT)
+    msGEOSPrepare(qshape);
+#endif
+
   for(l=start; l>=stop; l--) { /* each layer */
     lp = (GET_LAYER(map, l));
     if (map->query.maxfeatures == 0)
@@ -1896,6 +2226,8 @@ int msQueryByShape(mapObj *map)
     if (lp->minfeaturesize > 0)
       minfeaturesize = Pix2LayerGeoref(map, lp, lp->minfeaturesize);
 
+    qindex = msCreateEdgeIndex(qshape); /* NULL unless qshape is a polygon */
+
     while((status = msLayerNextShape(lp, &shape)) == MS_SUCCESS) { /* step through the shapes */
 
       /* Check if the shape size is ok to be drawn */
@@ -1920,13 +2252,16 @@ int msQueryByShape(mapObj *map)
       }
 
 #ifdef USE_PROJ
-      if(lp->project && msProjectionsDiffer(&(lp->projection), &(map->projection)))
+      if(lp->project && msProjectionsDiffer(&(lp->projection), &(map->projection))) {
         msProjectShape(&(lp->projection), &(map->projection), &shape);
-      else
+        msComputeBounds(&shape);
+      } else
         lp->project = MS_FALSE;
 #endif
 
-      switch(qshape->type) { /* may eventually support types other than polygon or line */
+      if(tolerance == 0 && (intersects = msQueryShapeIntersects(qshape, qindex, &shape)) != -1)
+        status = intersects;
+      else switch(qshape->type) { /* may eventually support types other than polygon or line */
         case MS_SHAPE_POLYGON:
           switch(shape.type) { /* make sure shape actually intersects the shape */
             case MS_SHAPE_POINT:
@@ -2017,6 +2352,8 @@ int msQueryByShape(mapObj *map)
       }
     } /* next shape */
 
+    msFreeEdgeIndex(qindex);
+
     if(status != MS_DONE) return(MS_FAILURE);
 
     if(lp->resultcache->numresults == 0) msLayerClose(lp); /* no need to keep the layer open */
@@ -311,6 +311,360 @@ int msAddColorGD(mapObj *map, gdImagePtr img, int cmt, int r, int g, int b)
 
 #endif
 
+#ifdef USE_GDAL
+
+#define GEO_TRANS(tr,x,y)  ((tr)[0]+(tr)[1]*(x)+(tr)[2]*(y))
+
+/*
+** Mosaic coverage culling, enabled with PROCESSING "MOSAIC_ORDER".
+**
+** Tiles of a tile index are normally drawn in index order, each one over
+** the previous ones, so every tile overlapping the map is read even when
+** later tiles hide it completely. With MOSAIC_ORDER set, the tiles are
+** drawn from the top of the mosaic down instead: each tile is drawn into
+** a scratch buffer and composited under the tiles already drawn. A tile
+** whose footprint only covers pixels that are already opaque is skipped
+** without being opened, and drawing stops once the whole image is
+** opaque. The mosaic is composited over the map image at the end.
+**
+** MOSAIC_ORDER=LAST puts the last tile of the index on top, which is the
+** result of the default drawing, FIRST puts the first tile on top and
+** NEWEST the most recently modified tile file.
+*/
+
+enum MS_MOSAIC_ORDER {MS_MOSAIC_FIRST, MS_MOSAIC_LAST, MS_MOSAIC_NEWEST};
+
+typedef struct {
+  char *location; /* tileitem value */
+  rectObj bounds; /* footprint, in the layer projection */
+  int index; /* position in the tile index */
+  time_t mtime;
+} rasterMosaicTile;
+
+typedef struct {
+  rasterMosaicTile *tiles;
+  int numtiles, maxtiles, nexttile;
+  rasterBufferObj mosaic; /* tiles drawn so far, premultiplied */
+  rasterBufferObj tile; /* the current tile is drawn in there */
+  int numopaque; /* opaque pixels in mosaic */
+  int numskipped;
+} rasterMosaicObj;
+
+/*
+** Path of a tile file, relative to the tile index if SHAPEPATH is not set.
+*/
+static void msRasterTilePath(mapObj *map, layerObj *layer, const char *filename, char *szPath)
+{
+  if(layer->tileindex && !map->shapepath) {
+    char tiAbsFilePath[MS_MAXPATHLEN];
+    char *tiAbsDirPath;
+
+    msTryBuildPath(tiAbsFilePath, map->mappath, layer->tileindex); /* absolute path to tileindex file */
+    tiAbsDirPath = msGetPath(tiAbsFilePath); /* tileindex file's directory */
+    msBuildPath(szPath, tiAbsDirPath, filename);
+    free(tiAbsDirPath);
+  } else {
+    msTryBuildPath3(szPath, map->mappath, map->shapepath, filename);
+  }
+}
+
+/*
+** Tile file name from the tileitem value and the layer DATA.
+*/
+static void msRasterTileName(layerObj *layer, const char *tilevalue, char *tilename, size_t size)
+{
+  if(layer->data == NULL || strlen(layer->data) == 0 ) /* assume whole filename is in attribute field */
+    strlcpy(tilename, tilevalue, size);
+  else
+    snprintf(tilename, size, "%s/%s", tilevalue, layer->data);
+}
+
+static int cmpMosaicFirst(const void *a, const void *b)
+{
+  return ((rasterMosaicTile *)a)->index - ((rasterMosaicTile *)b)->index;
+}
+
+static int cmpMosaicLast(const void *a, const void *b)
+{
+  return ((rasterMosaicTile *)b)->index - ((rasterMosaicTile *)a)->index;
+}
+
+static int cmpMosaicNewest(const void *a, const void *b)
+{
+  const rasterMosaicTile *ta = (const rasterMosaicTile *)a, *tb = (const rasterMosaicTile *)b;
+
+  if(ta->mtime != tb->mtime)
+    return (ta->mtime > tb->mtime) ? -1 : 1;
+  return tb->index - ta->index;
+}
+
+static void msRasterMosaicAddTile(rasterMosaicObj *mosaic, const char *location, rectObj *bounds)
+{
+  rasterMosaicTile *tile;
+
+  if(strlen(location) == 0) return;
+
+  if(mosaic->numtiles == mosaic->maxtiles) {
+    mosaic->maxtiles = MS_MAX(64, mosaic->maxtiles*2);
+    mosaic->tiles = (rasterMosaicTile *) msSmallRealloc(mosaic->tiles, sizeof(rasterMosaicTile)*mosaic->maxtiles);
+  }
+  tile = mosaic->tiles + mosaic->numtiles;
+  tile->location = msStrdup(location);
+  tile->bounds = *bounds;
+  tile->index = mosaic->numtiles++;
+  tile->mtime = 0;
+}
+
+static void msRasterMosaicInitBuffer(rasterBufferObj *rb, int width, int height)
+{
+  rb->type = MS_BUFFER_BYTE_RGBA;
+  rb->width = width;
+  rb->height = height;
+  rb->data.rgba.pixel_step = 4;
+  rb->data.rgba.row_step = width * 4;
+  rb->data.rgba.pixels = (unsigned char *) msSmallCalloc(width*height*4, sizeof(unsigned char));
+  rb->data.rgba.r = &(rb->data.rgba.pixels[2]);
+  rb->data.rgba.g = &(rb->data.rgba.pixels[1]);
+  rb->data.rgba.b = &(rb->data.rgba.pixels[0]);
+  rb->data.rgba.a = &(rb->data.rgba.pixels[3]);
+}
+
+static void msRasterMosaicFree(rasterMosaicObj *mosaic)
+{
+  int i;
+
+  if(!mosaic) return;
+  for(i=0; i<mosaic->numtiles; i++)
+    msFree(mosaic->tiles[i].location);
+  msFree(mosaic->tiles);
+  msFree(mosaic->mosaic.data.rgba.pixels);
+  msFree(mosaic->tile.data.rgba.pixels);
+  free(mosaic);
+}
+
+/*
+** Set up the mosaic if MOSAIC_ORDER is set and can be honoured, reading
+** the tiles overlapping the map from the catalog records or from the
+** tile index layer, which has gone through msLayerWhichShapes().
+** *mosaic is left NULL if the tiles are to be drawn the usual way.
+*/
+static int msRasterMosaicCreate(mapObj *map, layerObj *layer, rasterBufferObj *rb,
+                                tileCatalogObj *catalog, int *records, int numrecords,
+                                layerObj *tlp, int tileitemindex, rasterMosaicObj **mosaic)
+{
+  const char *value;
+  enum MS_MOSAIC_ORDER order;
+  rasterMosaicObj *m;
+  int i;
+
+  *mosaic = NULL;
+
+  value = msLayerGetProcessingKey(layer, "MOSAIC_ORDER");
+  if(value == NULL)
+    return MS_SUCCESS;
+  if(strcasecmp(value, "FIRST") == 0)
+    order = MS_MOSAIC_FIRST;
+  else if(strcasecmp(value, "LAST") == 0)
+    order = MS_MOSAIC_LAST;
+  else if(strcasecmp(value, "NEWEST") == 0)
+    order = MS_MOSAIC_NEWEST;
+  else {
+    msSetError(MS_MISCERR, "Unsupported MOSAIC_ORDER value '%s', expected FIRST, LAST or NEWEST.",
+               "msDrawRasterLayerLow()", value);
+    return MS_FAILURE;
+  }
+
+  /* the coverage is tracked on an RGBA buffer in map pixel space */
+  if(rb == NULL || rb->type != MS_BUFFER_BYTE_RGBA || !layer->transform
+      || map->gt.need_geotransform || map->cellsize <= 0) {
+    if(layer->debug)
+      msDebug("msDrawRasterLayerLow(%s): MOSAIC_ORDER not supported for this output, drawing tiles in index order.\n", layer->name);
+    return MS_SUCCESS;
+  }
+
+  m = (rasterMosaicObj *) msSmallCalloc(1, sizeof(rasterMosaicObj));
+
+  if(catalog) {
+    for(i=0; i<numrecords; i++) {
+      rectObj bounds;
+      if(msTileCatalogGetBounds(catalog, records[i], &bounds) == MS_SUCCESS)
+        msRasterMosaicAddTile(m, msTileCatalogGetPath(catalog, records[i]), &bounds);
+    }
+  } else {
+    shapeObj shape;
+    int status;
+
+    msInitShape(&shape);
+    while((status = msLayerNextShape(tlp, &shape)) == MS_SUCCESS) {
+      msRasterMosaicAddTile(m, shape.values[tileitemindex], &(shape.bounds));
+      msFreeShape(&shape);
+    }
+    if(status == MS_FAILURE) {
+      msRasterMosaicFree(m);
+      return MS_FAILURE;
+    }
+  }
+
+  if(order == MS_MOSAIC_NEWEST) {
+    for(i=0; i<m->numtiles; i++) {
+      char tilename[MS_MAXPATHLEN], szPath[MS_MAXPATHLEN];
+      VSIStatBufL sStat;
+
+      msRasterTileName(layer, m->tiles[i].location, tilename, sizeof(tilename));
+      msRasterTilePath(map, layer, tilename, szPath);
+      if(VSIStatL(szPath, &sStat) == 0)
+        m->tiles[i].mtime = sStat.st_mtime;
+    }
+  }
+
+  qsort(m->tiles, m->numtiles, sizeof(rasterMosaicTile),
+        (order == MS_MOSAIC_FIRST) ? cmpMosaicFirst : (order == MS_MOSAIC_LAST) ? cmpMosaicLast : cmpMosaicNewest);
+
+  msRasterMosaicInitBuffer(&(m->mosaic), rb->width, rb->height);
+  msRasterMosaicInitBuffer(&(m->tile), rb->width, rb->height);
+
+  *mosaic = m;
+  return MS_SUCCESS;
+}
+
+/*
+** Pixel window of the map image (x1 and y1 excluded) that a rectangle in
+** the layer projection may touch, with one pixel of margin. Returns
+** MS_FALSE if the window is empty.
+*/
+static int msRasterMosaicWindow(mapObj *map, layerObj *layer, rasterMosaicObj *mosaic,
+                                rectObj rect, int *x0, int *y0, int *x1, int *y1)
+{
+  double minx, maxy, fx0, fy0, fx1, fy1;
+  int width = mosaic->mosaic.width, height = mosaic->mosaic.height;
+
+#ifdef USE_PROJ
+  if(msProjectionsDiffer(&(map->projection), &(layer->projection))
+      && msProjectRect(&(layer->projection), &(map->projection), &rect) != MS_SUCCESS) {
+    *x0 = *y0 = 0; /* be safe, assume anything may be touched */
+    *x1 = width;
+    *y1 = height;
+    return MS_TRUE;
+  }
+#endif
+
+  minx = map->extent.minx - map->cellsize*0.5;
+  maxy = map->extent.maxy + map->cellsize*0.5;
+
+  fx0 = MS_MAX(0, floor((rect.minx - minx) / map->cellsize) - 1);
+  fy0 = MS_MAX(0, floor((maxy - rect.maxy) / map->cellsize) - 1);
+  fx1 = MS_MIN(width, ceil((rect.maxx - minx) / map->cellsize) + 1);
+  fy1 = MS_MIN(height, ceil((maxy - rect.miny) / map->cellsize) + 1);
+  if(fx0 >= fx1 || fy0 >= fy1)
+    return MS_FALSE;
+
+  *x0 = (int) fx0;
+  *y0 = (int) fy0;
+  *x1 = (int) fx1;
+  *y1 = (int) fy1;
+  return MS_TRUE;
+}
+
+/*
+** Next tile to draw, or NULL once all the tiles are drawn or the image
+** is opaque. Tiles hidden by the ones already drawn are skipped.
+*/
+static rasterMosaicTile *msRasterMosaicNextTile(mapObj *map, layerObj *layer, rasterMosaicObj *mosaic)
+{
+  unsigned char *alpha = mosaic->mosaic.data.rgba.a;
+  int row_step = mosaic->mosaic.data.rgba.row_step;
+
+  while(mosaic->nexttile < mosaic->numtiles) {
+    rasterMosaicTile *tile = mosaic->tiles + mosaic->nexttile++;
+    int x, y, x0, y0, x1, y1, covered = MS_TRUE;
+
+    if(mosaic->numopaque == mosaic->mosaic.width * mosaic->mosaic.height) {
+      mosaic->numskipped += mosaic->numtiles - mosaic->nexttile + 1;
+      mosaic->nexttile = mosaic->numtiles;
+      break;
+    }
+
+    if(!msRasterMosaicWindow(map, layer, mosaic, tile->bounds, &x0, &y0, &x1, &y1)) {
+      mosaic->numskipped++;
+      continue;
+    }
+
+    for(y=y0; y<y1 && covered; y++) {
+      for(x=x0; x<x1; x++) {
+        if(alpha[y*row_step + x*4] != 255) {
+          covered = MS_FALSE;
+          break;
+        }
+      }
+    }
+    if(!covered)
+      return tile;
+
+    mosaic->numskipped++;
+  }
+
+  return NULL;
+}
+
+/*
+** Composite the tile buffer under the mosaic in the window the tile may
+** have drawn to, clearing the tile buffer for the next tile on the way.
+*/
+static void msRasterMosaicMergeTile(mapObj *map, layerObj *layer, rasterMosaicObj *mosaic, rectObj extent)
+{
+  int x, y, x0, y0, x1, y1;
+
+  if(!msRasterMosaicWindow(map, layer, mosaic, extent, &x0, &y0, &x1, &y1))
+    return;
+
+  for(y=y0; y<y1; y++) {
+    unsigned char *dst = mosaic->mosaic.data.rgba.pixels + y*mosaic->mosaic.data.rgba.row_step + x0*4;
+    unsigned char *src = mosaic->tile.data.rgba.pixels + y*mosaic->tile.data.rgba.row_step + x0*4;
+
+    for(x=x0; x<x1; x++, dst+=4, src+=4) {
+      /* b,g,r,a premultiplied pixels, see msRasterMosaicInitBuffer() */
+      if(src[3] == 0 || dst[3] == 255) {
+        /* nothing to add */
+      } else if(dst[3] == 0) {
+        memcpy(dst, src, 4);
+        if(dst[3] == 255) mosaic->numopaque++;
+      } else {
+        int weight = 255 - dst[3];
+
+        dst[0] += src[0] * weight / 255;
+        dst[1] += src[1] * weight / 255;
+        dst[2] += src[2] * weight / 255;
+        dst[3] += src[3] * weight / 255;
+        if(dst[3] == 255) mosaic->numopaque++;
+      }
+      memset(src, 0, 4);
+    }
+  }
+}
+
+/*
+** Composite the mosaic over the map image.
+*/
+static void msRasterMosaicFlush(rasterMosaicObj *mosaic, rasterBufferObj *rb)
+{
+  int x, y;
+
+  for(y=0; y<mosaic->mosaic.height; y++) {
+    unsigned char *src = mosaic->mosaic.data.rgba.pixels + y*mosaic->mosaic.data.rgba.row_step;
+
+    for(x=0; x<mosaic->mosaic.width; x++, src+=4) {
+      int rb_off = x * rb->data.rgba.pixel_step + y * rb->data.rgba.row_step;
+
+      if(src[3] == 0) continue;
+      msAlphaBlendPM(src[2], src[1], src[0], src[3],
+                     rb->data.rgba.r + rb_off, rb->data.rgba.g + rb_off, rb->data.rgba.b + rb_off,
+                     (rb->data.rgba.a == NULL) ? NULL : rb->data.rgba.a + rb_off);
+    }
+  }
+}
+
+#endif /* def USE_GDAL */
+
 /************************************************************************/
 /*                        msDrawRasterLayerLow()                        */
 /*                                                                      */
@@ -339,6 +693,11 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
   layerObj *tlp=NULL; /* pointer to the tile layer either real or temporary */
   int tileitemindex=-1, tilelayerindex=-1;
   shapeObj tshp;
+  tileCatalogObj *catalog=NULL; /* in-memory tile index, when possible */
+  int *tilerecords=NULL, numtiles=0, nexttile=0;
+  rasterMosaicObj *mosaic=NULL; /* MOSAIC_ORDER coverage culling */
+  rasterMosaicTile *mosaictile=NULL;
+  rasterBufferObj *tile_rb = rb; /* where tiles are drawn */
 
   char szPath[MS_MAXPATHLEN];
   char *decrypted_path;
@@ -346,11 +705,8 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
 
   rectObj searchrect;
   char *pszTmp = NULL;
-  char tiAbsFilePath[MS_MAXPATHLEN];
-  char *tiAbsDirPath = NULL;
   GDALDatasetH  hDS;
   double  adfGeoTransform[6];
-  const char *close_connection;
 
   msGDALInitialize();
 
@@ -399,7 +755,25 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
     }
   }
 
-  if(layer->tileindex) { /* we have an index file */
+  if(layer->tileindex) {
+    searchrect = map->extent;
+#ifdef USE_PROJ
+    /* if necessary, project the searchrect to source coords */
+    if((map->projection.numargs > 0) && (layer->projection.numargs > 0)) {
+      if( msProjectRect(&map->projection, &layer->projection, &searchrect)
+          != MS_SUCCESS ) {
+        msDebug( "msDrawRasterLayerLow(%s): unable to reproject map request rectangle into layer projection, canceling.\n", layer->name );
+        return MS_FAILURE;
+      }
+    }
+#endif
+
+    catalog = msTileCatalogAcquire(layer);
+    if(catalog)
+      numtiles = msTileCatalogSearch(catalog, searchrect, &tilerecords);
+  }
+
+  if(layer->tileindex && !catalog) { /* we have an index file */
 
     msInitShape(&tshp);
 
@@ -471,18 +845,6 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
       goto cleanup;
     }
 
-    searchrect = map->extent;
-#ifdef USE_PROJ
-    /* if necessary, project the searchrect to source coords */
-    if((map->projection.numargs > 0) && (layer->projection.numargs > 0)) {
-      if( msProjectRect(&map->projection, &layer->projection, &searchrect)
-          != MS_SUCCESS ) {
-        msDebug( "msDrawRasterLayerLow(%s): unable to reproject map request rectangle into layer projection, canceling.\n", layer->name );
-        final_status = MS_FAILURE;
-        goto cleanup;
-      }
-    }
-#endif
     status = msLayerWhichShapes(tlp, searchrect, MS_FALSE);
     if (status != MS_SUCCESS) {
       /* Can be either MS_DONE or MS_FAILURE */
@@ -493,24 +855,44 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
     }
   }
 
+  if(layer->tileindex) {
+    if(msRasterMosaicCreate(map, layer, rb, catalog, tilerecords, numtiles,
+                            tlp, tileitemindex, &mosaic) != MS_SUCCESS) {
+      final_status = MS_FAILURE;
+      goto cleanup;
+    }
+    if(mosaic)
+      tile_rb = &(mosaic->tile);
+  }
+
   done = MS_FALSE;
   while(done != MS_TRUE) {
     if(layer->tileindex) {
-      status = msLayerNextShape(tlp, &tshp);
-      if( status == MS_FAILURE) {
-        final_status = MS_FAILURE;
-        break;
-      }
+      const char *tilevalue;
+
+      if(mosaic) {
+        mosaictile = msRasterMosaicNextTile(map, layer, mosaic);
+        if(mosaictile == NULL) break; /* no more tiles, or nothing left to paint */
+        tilevalue = mosaictile->location;
+      } else if(catalog) {
+        if(nexttile == numtiles) break; /* no more tiles/images */
+        tilevalue = msTileCatalogGetPath(catalog, tilerecords[nexttile++]);
+      } else {
+        status = msLayerNextShape(tlp, &tshp);
+        if( status == MS_FAILURE) {
+          final_status = MS_FAILURE;
+          break;
+        }
 
-      if(status == MS_DONE) break; /* no more tiles/images */
+        if(status == MS_DONE) break; /* no more tiles/images */
+        tilevalue = tshp.values[tileitemindex];
+      }
 
-      if(layer->data == NULL || strlen(layer->data) == 0 ) { /* assume whole filename is in attribute field */
-        strlcpy( tilename, tshp.values[tileitemindex], sizeof(tilename));
-      } else
-        snprintf(tilename, sizeof(tilename), "%s/%s", tshp.values[tileitemindex], layer->data);
+      msRasterTileName(layer, tilevalue, tilename, sizeof(tilename));
       filename = tilename;
 
-      msFreeShape(&tshp); /* done with the shape */
+      if(!mosaic && !catalog)
+        msFreeShape(&tshp); /* done with the shape */
     } else {
       filename = layer->data;
       done = MS_TRUE; /* only one image so we're done after this */
@@ -524,14 +906,7 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
     /*
     ** If using a tileindex then build the path relative to that file if SHAPEPATH is not set.
     */
-    if(layer->tileindex && !map->shapepath) {
-      msTryBuildPath(tiAbsFilePath, map->mappath, layer->tileindex); /* absolute path to tileindex file */
-      tiAbsDirPath = msGetPath(tiAbsFilePath); /* tileindex file's directory */
-      msBuildPath(szPath, tiAbsDirPath, filename);
-      free(tiAbsDirPath);
-    } else {
-      msTryBuildPath3(szPath, map->mappath, map->shapepath, filename);
-    }
+    msRasterTilePath(map, layer, filename, szPath);
     if(layer->debug == MS_TRUE)
       msDebug("msDrawRasterLayerLow(%s): Path is: %s\n", layer->name, szPath);
 
@@ -543,11 +918,13 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
     ** oracle georaster do not use real paths.
     */
     decrypted_path = msDecryptStringTokens( map, szPath );
-    if( decrypted_path == NULL )
-      return MS_FAILURE;
+    if( decrypted_path == NULL ) {
+      final_status = MS_FAILURE;
+      break;
+    }
 
     msAcquireLock( TLOCK_GDAL );
-    hDS = GDALOpenShared( decrypted_path, GA_ReadOnly );
+    hDS = msGDALOpenDataset( layer, decrypted_path );
 
     /*
     ** If GDAL doesn't recognise it, and it wasn't successfully opened
@@ -579,7 +956,8 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
 
       if(ignore_missing == MS_MISSING_DATA_FAIL) {
         msSetError(MS_IOERR, "Corrupt, empty or missing file '%s' for layer '%s'. %s", "msDrawRasterLayerLow()", szPath, layer->name, cpl_error_msg );
-        return(MS_FAILURE);
+        final_status = MS_FAILURE;
+        break;
       } else if( ignore_missing == MS_MISSING_DATA_LOG ) {
         if( layer->debug || layer->map->debug ) {
           msDebug( "Corrupt, empty or missing file '%s' for layer '%s' ... ignoring this missing data.  %s\n", szPath, layer->name, cpl_error_msg );
@@ -590,7 +968,8 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
       } else {
         /* never get here */
         msSetError(MS_IOERR, "msIgnoreMissingData returned unexpected value.", "msDrawRasterLayerLow()");
-        return(MS_FAILURE);
+        final_status = MS_FAILURE;
+        break;
       }
     }
 
@@ -622,6 +1001,7 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
           msSetError(MS_OGRERR, "%s","msDrawRasterLayer()",
                      szLongMsg);
 
+          msGDALReleaseDataset( layer, hDS );
           msReleaseLock( TLOCK_GDAL );
           final_status = MS_FAILURE;
           break;
@@ -643,7 +1023,7 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
         || msProjectionsDiffer( &(map->projection),
                                 &(layer->projection) )
         || CSLFetchNameValue( layer->processing, "RESAMPLE" ) != NULL ) {
-      status = msResampleGDALToMap( map, layer, image, rb, hDS );
+      status = msResampleGDALToMap( map, layer, image, tile_rb, hDS );
     } else
 #endif
     {
@@ -656,45 +1036,66 @@ int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image,
             layer->name );
 
       }
-      status = msDrawRasterLayerGDAL(map, layer, image, rb, hDS );
+      status = msDrawRasterLayerGDAL(map, layer, image, tile_rb, hDS );
     }
 
-    if( status == -1 ) {
-      GDALClose( hDS );
-      msReleaseLock( TLOCK_GDAL );
-      final_status = MS_FAILURE;
-      break;
+    /*
+    ** The tile may have drawn over its footprint in the tile index and
+    ** over the extent of the dataset, merge all of that into the mosaic.
+    */
+    if( mosaic && status != -1 ) {
+      rectObj extent = mosaictile->bounds;
+      int nXSize = GDALGetRasterXSize( hDS ), nYSize = GDALGetRasterYSize( hDS );
+      double x[4], y[4];
+
+      x[0] = GEO_TRANS(adfGeoTransform, 0, 0);
+      y[0] = GEO_TRANS(adfGeoTransform+3, 0, 0);
+      x[1] = GEO_TRANS(adfGeoTransform, nXSize, 0);
+      y[1] = GEO_TRANS(adfGeoTransform+3, nXSize, 0);
+      x[2] = GEO_TRANS(adfGeoTransform, 0, nYSize);
+      y[2] = GEO_TRANS(adfGeoTransform+3, 0, nYSize);
+      x[3] = GEO_TRANS(adfGeoTransform, nXSize, nYSize);
+      y[3] = GEO_TRANS(adfGeoTransform+3, nXSize, nYSize);
+      for( i = 0; i < 4; i++ ) {
+        extent.minx = MS_MIN(extent.minx, x[i]);
+        extent.miny = MS_MIN(extent.miny, y[i]);
+        extent.maxx = MS_MAX(extent.maxx, x[i]);
+        extent.maxy = MS_MAX(extent.maxy, y[i]);
+      }
+      msRasterMosaicMergeTile( map, layer, mosaic, extent );
     }
 
     /*
-    ** Should we keep this file open for future use?
-    ** default to keeping open for single data files, and
-    ** to closing for tile indexes
+    ** The dataset goes back to the pool, which keeps it open for
+    ** future use unless CLOSE_CONNECTION asks otherwise.
     */
+    msGDALReleaseDataset( layer, hDS );
+    msReleaseLock( TLOCK_GDAL );
 
-    close_connection = msLayerGetProcessingKey( layer,
-                       "CLOSE_CONNECTION" );
-
-    if( close_connection == NULL && layer->tileindex == NULL )
-      close_connection = "DEFER";
-
-    if( close_connection != NULL
-        && strcasecmp(close_connection,"DEFER") == 0 ) {
-      GDALDereferenceDataset( hDS );
-    } else {
-      GDALClose( hDS );
+    if( status == -1 ) {
+      final_status = MS_FAILURE;
+      break;
     }
-    msReleaseLock( TLOCK_GDAL );
   } /* next tile */
 
 cleanup:
-  if(layer->tileindex) { /* tiling clean-up */
+  if(tlp) { /* tiling clean-up */
     msLayerClose(tlp);
     if(tilelayerindex == -1) {
       freeLayer(tlp);
       free(tlp);
     }
   }
+  msFree(tilerecords);
+  msTileCatalogRelease(catalog);
+
+  if(mosaic) {
+    msRasterMosaicFlush(mosaic, rb);
+    if(layer->debug)
+      msDebug("msDrawRasterLayerLow(%s): MOSAIC_ORDER skipped %d of %d tiles.\n",
+              layer->name, mosaic->numskipped, mosaic->numtiles);
+    msRasterMosaicFree(mosaic);
+  }
 
   return final_status;
 
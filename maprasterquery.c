@@ -39,6 +39,8 @@ int msRASTERLayerGetItems(layerObj *layer);
 
 #ifdef USE_GDAL
 
+#include "cpl_conv.h"
+
 /* ==================================================================== */
 /*      For now the rasterLayerInfo lives here since it is just used    */
 /*      to hold information related to queries.                         */
@@ -104,15 +106,15 @@ static int addResult(resultCacheObj *cache, int classindex, int shapeindex, int
   int i;
 
   if(cache->numresults == cache->cachesize) { /* just add it to the end */
-    if(cache->cachesize == 0)
-      cache->results = (resultObj *) malloc(sizeof(resultObj)*MS_RESULTCACHEINCREMENT);
-    else
-      cache->results = (resultObj *) realloc(cache->results, sizeof(resultObj)*(cache->cachesize+MS_RESULTCACHEINCREMENT));
-    if(!cache->results) {
+    /* grow geometrically, large result sets would otherwise realloc every few shapes */
+    int cachesize = (cache->cachesize == 0) ? MS_RESULTCACHEINCREMENT : cache->cachesize*2;
+    resultObj *results = (resultObj *) realloc(cache->results, sizeof(resultObj)*cachesize);
+    if(!results) {
       msSetError(MS_MEMERR, "Realloc() error.", "addResult()");
       return(MS_FAILURE);
     }
-    cache->cachesize += MS_RESULTCACHEINCREMENT;
+    cache->results = results;
+    cache->cachesize = cachesize;
   }
 
   i = cache->numresults;
@@ -398,6 +400,292 @@ static void msRasterQueryAddPixel( layerObj *layer, pointObj *location,
   }
 }
 
+/************************************************************************/
+/* ==================================================================== */
+/*      Raster query block cache.                                       */
+/*                                                                      */
+/*      Point queries (GetFeatureInfo) read a handful of pixels, and    */
+/*      repeated clicks over the same imagery read the same few         */
+/*      blocks again since the dataset (and GDAL's own block cache      */
+/*      with it) is closed after each request.  Small query windows     */
+/*      are therefore read as whole cache tiles, aligned on the file's  */
+/*      blocks, which are kept per process keyed by file, band list     */
+/*      and tile.  Entries are dropped when the file changes.  The      */
+/*      cache size in megabytes is set with CONFIG                      */
+/*      "MS_RASTER_QUERY_CACHE" (default 16, 0 disables it).            */
+/* ==================================================================== */
+/************************************************************************/
+
+#define MS_RQ_CACHE_DEFAULT_MB     16
+#define MS_RQ_CACHE_TILE_TARGET    128 /* preferred tile edge, in pixels */
+#define MS_RQ_CACHE_TILE_MAX       512
+#define MS_RQ_CACHE_MAX_WIN_TILES  4   /* larger windows bypass the cache */
+
+typedef struct {
+  char *path;
+  int has_stat;
+  time_t mtime;
+  vsi_l_offset size;
+  int band_count;
+  int *band_map;
+
+  int tile_x, tile_y;           /* tile index */
+  int tile_xsize, tile_ysize;   /* nominal tile size */
+  int xsize, ysize;             /* actual size, smaller on the right/bottom */
+  float *data;                  /* pixel interleaved, like the query buffer */
+  size_t bytes;
+  unsigned long last_used;
+} rasterQueryCacheEntry;
+
+static rasterQueryCacheEntry *rqCache = NULL;
+static int rqCacheCount = 0, rqCacheAlloc = 0;
+static size_t rqCacheBytes = 0;
+static unsigned long rqCacheTick = 0;
+
+/************************************************************************/
+/*                      msRasterQueryCacheDrop()                        */
+/*                                                                      */
+/*      Remove entry i.  Called with TLOCK_POOL held.                   */
+/************************************************************************/
+
+static void msRasterQueryCacheDrop( int i )
+
+{
+  rqCacheBytes -= rqCache[i].bytes;
+  free( rqCache[i].path );
+  free( rqCache[i].band_map );
+  free( rqCache[i].data );
+  rqCache[i] = rqCache[--rqCacheCount];
+}
+
+/************************************************************************/
+/*                     msRasterQueryCacheTileSize()                     */
+/*                                                                      */
+/*      Pick a tile edge made of whole blocks near the target size,     */
+/*      or a fraction of very large (strip) blocks.                     */
+/************************************************************************/
+
+static int msRasterQueryCacheTileSize( int nBlockSize )
+
+{
+  if( nBlockSize <= 0 || nBlockSize > MS_RQ_CACHE_TILE_MAX )
+    return MS_RQ_CACHE_TILE_TARGET;
+
+  return nBlockSize * MAX(1, MS_RQ_CACHE_TILE_TARGET / nBlockSize);
+}
+
+/************************************************************************/
+/*                      msRasterQueryCopyTile()                         */
+/*                                                                      */
+/*      Copy the part of a cached tile overlapping the query window.    */
+/************************************************************************/
+
+static void msRasterQueryCopyTile( rasterQueryCacheEntry *entry,
+                                   int nWinXOff, int nWinYOff,
+                                   int nWinXSize, int nWinYSize,
+                                   float *pafRaster )
+
+{
+  int nBands = entry->band_count;
+  int nTileXOff = entry->tile_x * entry->tile_xsize;
+  int nTileYOff = entry->tile_y * entry->tile_ysize;
+  int nX0 = MAX(nWinXOff, nTileXOff);
+  int nX1 = MIN(nWinXOff + nWinXSize, nTileXOff + entry->xsize);
+  int nY0 = MAX(nWinYOff, nTileYOff);
+  int nY1 = MIN(nWinYOff + nWinYSize, nTileYOff + entry->ysize);
+  int iLine;
+
+  for( iLine = nY0; iLine < nY1; iLine++ )
+    memcpy( pafRaster + ((iLine - nWinYOff) * nWinXSize + nX0 - nWinXOff) * nBands,
+            entry->data + ((iLine - nTileYOff) * entry->xsize + nX0 - nTileXOff) * nBands,
+            sizeof(float) * (nX1 - nX0) * nBands );
+}
+
+/************************************************************************/
+/*                      msRasterQueryReadWindow()                       */
+/*                                                                      */
+/*      Read a window of the requested bands as pixel interleaved       */
+/*      floats, through the block cache when the window is small.       */
+/************************************************************************/
+
+static CPLErr msRasterQueryReadWindow( mapObj *map, layerObj *layer,
+                                       GDALDatasetH hDS,
+                                       int nBandCount, int *panBandMap,
+                                       int nWinXOff, int nWinYOff,
+                                       int nWinXSize, int nWinYSize,
+                                       float *pafRaster )
+
+{
+  const char *path = GDALGetDescription( hDS );
+  const char *pszCacheSize = msGetConfigOption( map, "MS_RASTER_QUERY_CACHE" );
+  size_t nMaxBytes;
+  int nBlockXSize, nBlockYSize, nTileXSize, nTileYSize;
+  int nTileX0, nTileX1, nTileY0, nTileY1, iTileX, iTileY, i, has_stat;
+  VSIStatBufL sStat;
+
+  nMaxBytes = (size_t) (pszCacheSize ? MAX(0,atoi(pszCacheSize))
+                        : MS_RQ_CACHE_DEFAULT_MB) * 1024 * 1024;
+
+  /* -------------------------------------------------------------------- */
+  /*      Work out the cache tiles covering the window; large windows     */
+  /*      and unnamed datasets are read directly.                         */
+  /* -------------------------------------------------------------------- */
+  GDALGetBlockSize( GDALGetRasterBand( hDS, panBandMap[0] ),
+                    &nBlockXSize, &nBlockYSize );
+  nTileXSize = msRasterQueryCacheTileSize( nBlockXSize );
+  nTileYSize = msRasterQueryCacheTileSize( nBlockYSize );
+
+  nTileX0 = nWinXOff / nTileXSize;
+  nTileY0 = nWinYOff / nTileYSize;
+  nTileX1 = (nWinXOff + nWinXSize - 1) / nTileXSize;
+  nTileY1 = (nWinYOff + nWinYSize - 1) / nTileYSize;
+
+  if( nMaxBytes == 0 || path == NULL || *path == '\0'
+      || nWinXSize <= 0 || nWinYSize <= 0
+      || (nTileX1 - nTileX0 + 1) * (nTileY1 - nTileY0 + 1) > MS_RQ_CACHE_MAX_WIN_TILES )
+    return GDALDatasetRasterIO( hDS, GF_Read,
+                                nWinXOff, nWinYOff, nWinXSize, nWinYSize,
+                                pafRaster, nWinXSize, nWinYSize, GDT_Float32,
+                                nBandCount, panBandMap,
+                                4 * nBandCount,
+                                4 * nBandCount * nWinXSize,
+                                4 );
+
+  has_stat = (VSIStatL( path, &sStat ) == 0);
+
+  for( iTileY = nTileY0; iTileY <= nTileY1; iTileY++ ) {
+    for( iTileX = nTileX0; iTileX <= nTileX1; iTileX++ ) {
+      rasterQueryCacheEntry entry, *found = NULL;
+      CPLErr eErr;
+
+      /* -------------------------------------------------------------------- */
+      /*      Look for the tile, dropping entries of a changed file.          */
+      /* -------------------------------------------------------------------- */
+      msAcquireLock( TLOCK_POOL );
+      for( i = 0; i < rqCacheCount; i++ ) {
+        rasterQueryCacheEntry *e = rqCache + i;
+
+        if( strcmp( e->path, path ) != 0 )
+          continue;
+
+        if( has_stat != e->has_stat
+            || (has_stat && (sStat.st_mtime != e->mtime
+                             || sStat.st_size != e->size)) ) {
+          msRasterQueryCacheDrop( i-- );
+          continue;
+        }
+
+        if( e->tile_x == iTileX && e->tile_y == iTileY
+            && e->tile_xsize == nTileXSize && e->tile_ysize == nTileYSize
+            && e->band_count == nBandCount
+            && memcmp( e->band_map, panBandMap, sizeof(int) * nBandCount ) == 0 ) {
+          found = e;
+          break;
+        }
+      }
+
+      if( found != NULL ) {
+        found->last_used = ++rqCacheTick;
+        msRasterQueryCopyTile( found, nWinXOff, nWinYOff,
+                               nWinXSize, nWinYSize, pafRaster );
+        msReleaseLock( TLOCK_POOL );
+        continue;
+      }
+      msReleaseLock( TLOCK_POOL );
+
+      /* -------------------------------------------------------------------- */
+      /*      Read the whole tile, and keep it if it fits.                    */
+      /* -------------------------------------------------------------------- */
+      memset( &entry, 0, sizeof(entry) );
+      entry.band_count = nBandCount;
+      entry.tile_x = iTileX;
+      entry.tile_y = iTileY;
+      entry.tile_xsize = nTileXSize;
+      entry.tile_ysize = nTileYSize;
+      entry.xsize = MIN(nTileXSize, GDALGetRasterXSize(hDS) - iTileX * nTileXSize);
+      entry.ysize = MIN(nTileYSize, GDALGetRasterYSize(hDS) - iTileY * nTileYSize);
+      entry.bytes = sizeof(float) * entry.xsize * entry.ysize * nBandCount;
+      entry.data = (float *) malloc( entry.bytes );
+      MS_CHECK_ALLOC( entry.data, entry.bytes, CE_Failure );
+
+      eErr = GDALDatasetRasterIO( hDS, GF_Read,
+                                  iTileX * nTileXSize, iTileY * nTileYSize,
+                                  entry.xsize, entry.ysize,
+                                  entry.data, entry.xsize, entry.ysize,
+                                  GDT_Float32, nBandCount, panBandMap,
+                                  4 * nBandCount,
+                                  4 * nBandCount * entry.xsize,
+                                  4 );
+      if( eErr != CE_None ) {
+        free( entry.data );
+        return eErr;
+      }
+
+      msRasterQueryCopyTile( &entry, nWinXOff, nWinYOff,
+                             nWinXSize, nWinYSize, pafRaster );
+
+      if( layer->debug >= MS_DEBUGLEVEL_VVV )
+        msDebug( "msRasterQueryReadWindow(%s): read %dx%d tile %d,%d of %s.\n",
+                 layer->name, entry.xsize, entry.ysize, iTileX, iTileY, path );
+
+      if( entry.bytes > nMaxBytes ) {
+        free( entry.data );
+        continue;
+      }
+
+      entry.path = msStrdup( path );
+      entry.has_stat = has_stat;
+      entry.mtime = has_stat ? sStat.st_mtime : 0;
+      entry.size = has_stat ? sStat.st_size : 0;
+      entry.band_map = (int *) msSmallMalloc( sizeof(int) * nBandCount );
+      memcpy( entry.band_map, panBandMap, sizeof(int) * nBandCount );
+
+      msAcquireLock( TLOCK_POOL );
+      while( rqCacheCount > 0 && rqCacheBytes + entry.bytes > nMaxBytes ) {
+        int lru = 0;
+        for( i = 1; i < rqCacheCount; i++ ) {
+          if( rqCache[i].last_used < rqCache[lru].last_used )
+            lru = i;
+        }
+        msRasterQueryCacheDrop( lru );
+      }
+      if( rqCacheCount == rqCacheAlloc ) {
+        rqCacheAlloc = rqCacheAlloc ? rqCacheAlloc * 2 : 16;
+        rqCache = (rasterQueryCacheEntry *)
+                  msSmallRealloc( rqCache, sizeof(rasterQueryCacheEntry) * rqCacheAlloc );
+      }
+      entry.last_used = ++rqCacheTick;
+      rqCache[rqCacheCount++] = entry;
+      rqCacheBytes += entry.bytes;
+      msReleaseLock( TLOCK_POOL );
+    }
+  }
+
+  return CE_None;
+}
+#endif /* def USE_GDAL */
+
+/************************************************************************/
+/*                     msRasterQueryCacheCleanup()                      */
+/************************************************************************/
+
+void msRasterQueryCacheCleanup( void )
+
+{
+#ifdef USE_GDAL
+  msAcquireLock( TLOCK_POOL );
+  while( rqCacheCount > 0 )
+    msRasterQueryCacheDrop( rqCacheCount - 1 );
+  free( rqCache );
+  rqCache = NULL;
+  rqCacheAlloc = 0;
+  rqCacheBytes = 0;
+  msReleaseLock( TLOCK_POOL );
+#endif
+}
+
+#ifdef USE_GDAL
+
 /************************************************************************/
 /*                       msRasterQueryByRectLow()                       */
 /************************************************************************/
@@ -518,13 +806,9 @@ msRasterQueryByRectLow(mapObj *map, layerObj *layer, GDALDatasetH hDS,
               calloc(sizeof(float),nWinXSize*nWinYSize*nBandCount);
   MS_CHECK_ALLOC(pafRaster, sizeof(float)*nWinXSize*nWinYSize*nBandCount, -1);
 
-  eErr = GDALDatasetRasterIO( hDS, GF_Read,
-                              nWinXOff, nWinYOff, nWinXSize, nWinYSize,
-                              pafRaster, nWinXSize, nWinYSize, GDT_Float32,
-                              nBandCount, panBandMap,
-                              4 * nBandCount,
-                              4 * nBandCount * nWinXSize,
-                              4 );
+  eErr = msRasterQueryReadWindow( map, layer, hDS, nBandCount, panBandMap,
+                                  nWinXOff, nWinYOff, nWinXSize, nWinYSize,
+                                  pafRaster );
 
   if( eErr != CE_None ) {
     msSetError( MS_IOERR, "GDALDatasetRasterIO() failed: %s",
@@ -665,6 +949,8 @@ int msRasterQueryByRect(mapObj *map, layerObj *layer, rectObj queryRect)
   layerObj *tlp=NULL; /* pointer to the tile layer either real or temporary */
   int tileitemindex=-1, tilelayerindex=-1;
   shapeObj tshp;
+  tileCatalogObj *catalog=NULL; /* in-memory tile index, when possible */
+  int *tilerecords=NULL, numtiles=0, nexttile=0;
   char tilename[MS_PATH_LENGTH];
   int  done;
 
@@ -722,7 +1008,19 @@ int msRasterQueryByRect(mapObj *map, layerObj *layer, rectObj queryRect)
   /* ==================================================================== */
   /*      Handle setting up tileindex layer.                              */
   /* ==================================================================== */
-  if(layer->tileindex) { /* we have an index file */
+  if(layer->tileindex) {
+    searchrect = queryRect;
+#ifdef USE_PROJ
+    /* if necessary, project the searchrect to source coords */
+    if((map->projection.numargs > 0) && (layer->projection.numargs > 0)) msProjectRect(&map->projection, &layer->projection, &searchrect);
+#endif
+
+    catalog = msTileCatalogAcquire(layer);
+    if(catalog)
+      numtiles = msTileCatalogSearch(catalog, searchrect, &tilerecords);
+  }
+
+  if(layer->tileindex && !catalog) { /* we have an index file */
     int i;
 
     msInitShape(&tshp);
@@ -794,11 +1092,6 @@ int msRasterQueryByRect(mapObj *map, layerObj *layer, rectObj queryRect)
       goto cleanup;
     }
 
-    searchrect = queryRect;
-#ifdef USE_PROJ
-    /* if necessary, project the searchrect to source coords */
-    if((map->projection.numargs > 0) && (layer->projection.numargs > 0)) msProjectRect(&map->projection, &layer->projection, &searchrect);
-#endif
     status = msLayerWhichShapes(tlp, searchrect, MS_TRUE);
     if (status != MS_SUCCESS) {
       goto cleanup;
@@ -818,19 +1111,28 @@ int msRasterQueryByRect(mapObj *map, layerObj *layer, rectObj queryRect)
     /*      Get filename.                                                   */
     /* -------------------------------------------------------------------- */
     if(layer->tileindex) {
-      status = msLayerNextShape(tlp, &tshp);
-      if( status == MS_FAILURE)
-        break;
+      const char *tilevalue;
 
-      if(status == MS_DONE) break; /* no more tiles/images */
+      if(catalog) {
+        if(nexttile == numtiles) break; /* no more tiles/images */
+        tilevalue = msTileCatalogGetPath(catalog, tilerecords[nexttile++]);
+      } else {
+        status = msLayerNextShape(tlp, &tshp);
+        if( status == MS_FAILURE)
+          break;
+
+        if(status == MS_DONE) break; /* no more tiles/images */
+        tilevalue = tshp.values[tileitemindex];
+      }
 
       if(layer->data == NULL || strlen(layer->data) == 0 ) { /* assume whole filename is in attribute field */
-        strlcpy( tilename, tshp.values[tileitemindex], sizeof(tilename));
+        strlcpy( tilename, tilevalue, sizeof(tilename));
       } else
-        snprintf(tilename, sizeof(tilename), "%s/%s", tshp.values[tileitemindex], layer->data);
+        snprintf(tilename, sizeof(tilename), "%s/%s", tilevalue, layer->data);
       filename = tilename;
 
-      msFreeShape(&tshp); /* done with the shape */
+      if(!catalog)
+        msFreeShape(&tshp); /* done with the shape */
     } else {
       filename = layer->data;
       done = MS_TRUE; /* only one image so we're done after this */
@@ -856,11 +1158,13 @@ int msRasterQueryByRect(mapObj *map, layerObj *layer, rectObj queryRect)
     }
 
     decrypted_path = msDecryptStringTokens( map, szPath );
-    if( !decrypted_path )
-      return MS_FAILURE;
+    if( !decrypted_path ) {
+      status = MS_FAILURE;
+      goto cleanup;
+    }
 
     msAcquireLock( TLOCK_GDAL );
-    hDS = GDALOpen(decrypted_path, GA_ReadOnly );
+    hDS = msGDALOpenDataset( layer, decrypted_path );
 
     if( hDS == NULL ) {
       int ignore_missing = msMapIgnoreMissingData( map );
@@ -923,6 +1227,7 @@ int msRasterQueryByRect(mapObj *map, layerObj *layer, rectObj queryRect)
           msSetError(MS_OGRERR, "%s","msDrawRasterLayer()",
                      szLongMsg);
 
+          msGDALReleaseDataset( layer, hDS );
           msReleaseLock( TLOCK_GDAL );
           return(MS_FAILURE);
         }
@@ -935,7 +1240,7 @@ int msRasterQueryByRect(mapObj *map, layerObj *layer, rectObj queryRect)
     if( status == MS_SUCCESS )
       status = msRasterQueryByRectLow( map, layer, hDS, queryRect );
 
-    GDALClose( hDS );
+    msGDALReleaseDataset( layer, hDS );
     msReleaseLock( TLOCK_GDAL );
 
   } /* next tile */
@@ -944,13 +1249,15 @@ int msRasterQueryByRect(mapObj *map, layerObj *layer, rectObj queryRect)
   /*      Cleanup tileindex if it is open.                                */
   /* -------------------------------------------------------------------- */
 cleanup:
-  if(layer->tileindex) { /* tiling clean-up */
+  if(tlp) { /* tiling clean-up */
     msLayerClose(tlp);
     if(tilelayerindex == -1) {
       freeLayer(tlp);
       free(tlp);
     }
   }
+  msFree(tilerecords);
+  msTileCatalogRelease(catalog);
 
   /* -------------------------------------------------------------------- */
   /*      On failure, or empty result set, cleanup the rlinfo since we    */
@@ -1477,7 +1784,7 @@ int msRASTERLayerGetExtent(layerObj *layer, rectObj *extent)
 
   msAcquireLock( TLOCK_GDAL );
   if( decrypted_path ) {
-    hDS = GDALOpen(decrypted_path, GA_ReadOnly );
+    hDS = msGDALOpenDataset( layer, decrypted_path );
     msFree( decrypted_path );
   } else
     hDS = NULL;
@@ -1487,7 +1794,7 @@ int msRASTERLayerGetExtent(layerObj *layer, rectObj *extent)
     nYSize = GDALGetRasterYSize( hDS );
     eErr = GDALGetGeoTransform( hDS, adfGeoTransform );
 
-    GDALClose( hDS );
+    msGDALReleaseDataset( layer, hDS );
   }
 
   msReleaseLock( TLOCK_GDAL );
@@ -31,8 +31,6 @@
 #include "mapresample.h"
 #include "mapthread.h"
 
-
-
 #ifndef MAX
 #  define MIN(a,b)      ((a<b) ? a : b)
 #  define MAX(a,b)      ((a>b) ? a : b)
@@ -79,6 +77,323 @@ int InvGeoTransform( double *gt_in, double *gt_out )
 
 #if defined(USE_PROJ) && defined(USE_GDAL)
 
+/* ==================================================================== */
+/*      Row kernels for interleaved 8 bit RGBA buffers.                 */
+/*                                                                      */
+/*      The generic resamplers below go through msSourceSample() and    */
+/*      test the renderer and buffer types for every source sample.     */
+/*      Reprojected imagery is nearly always resampled between two      */
+/*      RGBA buffers of the same renderer, with 4 byte pixels and the   */
+/*      same channel order, so these kernels handle that case a whole   */
+/*      row of output pixels at a time, with the channel offsets and    */
+/*      byte to double conversions looked up once. They produce the     */
+/*      same pixels as the generic code: the sums are computed with     */
+/*      the same operations in the same order.                          */
+/*                                                                      */
+/*      PROCESSING "RESAMPLE_ROW_KERNELS=OFF" falls back to the         */
+/*      generic code, which is handy to compare the two.                */
+/* ==================================================================== */
+
+typedef struct {
+  const unsigned char *src;
+  int src_row_step, nSrcXSize, nSrcYSize;
+  unsigned char *dst;
+  int dst_row_step, dst_has_alpha;
+  rasterBufferObj *dst_rb, *mask_rb;
+  int ro, go, bo, ao; /* offsets of the channels in a pixel */
+  const double *tab[4]; /* value of each byte of a pixel in the sums */
+  double value[256], alpha01[256];
+} msRGBARowContext;
+
+/*
+** Sum of weighted source pixels, by pixel byte. The alpha byte adds
+** weight * alpha/255 to the weight sum, like msSourceSample(), and
+** pixels with an alpha of 0 or 1 are left out.
+*/
+#define MS_RGBA_SUM_ADD(ctx,sum,p,w) \
+  if( (p)[(ctx)->ao] > 1 ) { \
+    double _w = (w); \
+    (sum)[0] += (ctx)->tab[0][(p)[0]] * _w; \
+    (sum)[1] += (ctx)->tab[1][(p)[1]] * _w; \
+    (sum)[2] += (ctx)->tab[2][(p)[2]] * _w; \
+    (sum)[3] += (ctx)->tab[3][(p)[3]] * _w; \
+  }
+
+#define MS_RGBA_PIXEL(ctx,x,y) ((ctx)->src + (x) * 4 + (y) * (ctx)->src_row_step)
+
+/************************************************************************/
+/*                       msInitRGBARowContext()                         */
+/*                                                                      */
+/*      Returns MS_FALSE if the buffers are not a case the row          */
+/*      kernels handle.                                                 */
+/************************************************************************/
+
+static int msInitRGBARowContext( msRGBARowContext *ctx,
+                                 imageObj *psSrcImage, rasterBufferObj *src_rb,
+                                 rasterBufferObj *dst_rb, rasterBufferObj *mask_rb )
+{
+  rgbaArrayObj *src, *dst;
+  int i;
+
+  if( !MS_RENDERER_PLUGIN(psSrcImage->format) || src_rb == NULL || dst_rb == NULL
+      || src_rb->type != MS_BUFFER_BYTE_RGBA || dst_rb->type != MS_BUFFER_BYTE_RGBA )
+    return MS_FALSE;
+
+  src = &(src_rb->data.rgba);
+  dst = &(dst_rb->data.rgba);
+  if( src->pixel_step != 4 || dst->pixel_step != 4
+      || src->pixels == NULL || dst->pixels == NULL || src->a == NULL
+      || src->r - src->pixels != dst->r - dst->pixels
+      || src->g - src->pixels != dst->g - dst->pixels
+      || src->b - src->pixels != dst->b - dst->pixels
+      || (dst->a != NULL && src->a - src->pixels != dst->a - dst->pixels) )
+    return MS_FALSE;
+
+  /* pixel offsets are computed in int */
+  if( (double) src->row_step * psSrcImage->height > INT_MAX )
+    return MS_FALSE;
+
+  ctx->src = src->pixels;
+  ctx->src_row_step = src->row_step;
+  ctx->nSrcXSize = psSrcImage->width;
+  ctx->nSrcYSize = psSrcImage->height;
+  ctx->dst = dst->pixels;
+  ctx->dst_row_step = dst->row_step;
+  ctx->dst_has_alpha = (dst->a != NULL);
+  ctx->dst_rb = dst_rb;
+  ctx->mask_rb = mask_rb;
+  ctx->ro = src->r - src->pixels;
+  ctx->go = src->g - src->pixels;
+  ctx->bo = src->b - src->pixels;
+  ctx->ao = src->a - src->pixels;
+
+  for( i = 0; i < 256; i++ ) {
+    ctx->value[i] = i;
+    ctx->alpha01[i] = i / 255.0;
+  }
+  for( i = 0; i < 4; i++ )
+    ctx->tab[i] = (i == ctx->ao) ? ctx->alpha01 : ctx->value;
+
+  return MS_TRUE;
+}
+
+/************************************************************************/
+/*                          msNearestRowRGBA()                          */
+/************************************************************************/
+
+static void msNearestRowRGBA( msRGBARowContext *ctx, int nDstY, int nDstXSize,
+                              double *x, double *y, int *panSuccess,
+                              int *pnFailedPoints, int *pnSetPoints )
+{
+  rasterBufferObj *mask_rb = ctx->mask_rb; /* for SKIP_MASK() */
+  unsigned char *dst_row = ctx->dst + nDstY * ctx->dst_row_step;
+  int nDstX;
+
+  for( nDstX = 0; nDstX < nDstXSize; nDstX++ ) {
+    const unsigned char *s;
+    unsigned char *d;
+    int nSrcX, nSrcY;
+
+    if(SKIP_MASK(nDstX,nDstY))
+      continue;
+
+    if( !panSuccess[nDstX] ) {
+      (*pnFailedPoints)++;
+      continue;
+    }
+
+    nSrcX = (int) x[nDstX];
+    nSrcY = (int) y[nDstX];
+    if( x[nDstX] < 0.0 || y[nDstX] < 0.0
+        || nSrcX < 0 || nSrcY < 0
+        || nSrcX >= ctx->nSrcXSize || nSrcY >= ctx->nSrcYSize )
+      continue;
+
+    s = MS_RGBA_PIXEL( ctx, nSrcX, nSrcY );
+    d = dst_row + nDstX * 4;
+    if( s[ctx->ao] == 255 ) {
+      (*pnSetPoints)++;
+      if( ctx->dst_has_alpha )
+        memcpy( d, s, 4 );
+      else {
+        d[ctx->ro] = s[ctx->ro];
+        d[ctx->go] = s[ctx->go];
+        d[ctx->bo] = s[ctx->bo];
+      }
+    } else if( s[ctx->ao] != 0 ) {
+      (*pnSetPoints)++;
+      msAlphaBlendPM( s[ctx->ro], s[ctx->go], s[ctx->bo], s[ctx->ao],
+                      d + ctx->ro, d + ctx->go, d + ctx->bo,
+                      ctx->dst_has_alpha ? d + ctx->ao : NULL );
+    }
+  }
+}
+
+/************************************************************************/
+/*                         msBilinearRowRGBA()                          */
+/************************************************************************/
+
+static void msBilinearRowRGBA( msRGBARowContext *ctx, int nDstY, int nDstXSize,
+                               double *x, double *y, int *panSuccess,
+                               int *pnFailedPoints, int *pnSetPoints )
+{
+  rasterBufferObj *mask_rb = ctx->mask_rb; /* for SKIP_MASK() */
+  unsigned char *dst_row = ctx->dst + nDstY * ctx->dst_row_step;
+  int nDstX;
+
+  for( nDstX = 0; nDstX < nDstXSize; nDstX++ ) {
+    int   nSrcX, nSrcY, nSrcX2, nSrcY2;
+    double dfSrcX, dfSrcY, dfRatioX2, dfRatioY2, dfWeightSum, adfSum[4];
+    unsigned char *d;
+
+    if(SKIP_MASK(nDstX,nDstY))
+      continue;
+
+    if( !panSuccess[nDstX] ) {
+      (*pnFailedPoints)++;
+      continue;
+    }
+
+    /* see msBilinearRasterResampler() */
+    dfSrcX = x[nDstX] - 0.5;
+    dfSrcY = y[nDstX] - 0.5;
+
+    nSrcX = (int) floor(dfSrcX);
+    nSrcY = (int) floor(dfSrcY);
+    nSrcX2 = nSrcX+1;
+    nSrcY2 = nSrcY+1;
+
+    dfRatioX2 = dfSrcX - nSrcX;
+    dfRatioY2 = dfSrcY - nSrcY;
+
+    if( nSrcX2 < 0 || nSrcX >= ctx->nSrcXSize
+        || nSrcY2 < 0 || nSrcY >= ctx->nSrcYSize )
+      continue;
+
+    nSrcX = MAX(nSrcX,0);
+    nSrcY = MAX(nSrcY,0);
+    nSrcX2 = MIN(nSrcX2,ctx->nSrcXSize-1);
+    nSrcY2 = MIN(nSrcY2,ctx->nSrcYSize-1);
+
+    adfSum[0] = adfSum[1] = adfSum[2] = adfSum[3] = 0.0;
+    MS_RGBA_SUM_ADD( ctx, adfSum, MS_RGBA_PIXEL( ctx, nSrcX, nSrcY ),
+                     (1.0 - dfRatioX2) * (1.0 - dfRatioY2) );
+    MS_RGBA_SUM_ADD( ctx, adfSum, MS_RGBA_PIXEL( ctx, nSrcX2, nSrcY ),
+                     (dfRatioX2) * (1.0 - dfRatioY2) );
+    MS_RGBA_SUM_ADD( ctx, adfSum, MS_RGBA_PIXEL( ctx, nSrcX, nSrcY2 ),
+                     (1.0 - dfRatioX2) * (dfRatioY2) );
+    MS_RGBA_SUM_ADD( ctx, adfSum, MS_RGBA_PIXEL( ctx, nSrcX2, nSrcY2 ),
+                     (dfRatioX2) * (dfRatioY2) );
+
+    dfWeightSum = adfSum[ctx->ao];
+    if( dfWeightSum == 0.0 )
+      continue;
+
+    (*pnSetPoints)++;
+
+    if( dfWeightSum > 0.001 ) {
+      double red = adfSum[ctx->ro] / dfWeightSum;
+      double green = adfSum[ctx->go] / dfWeightSum;
+      double blue = adfSum[ctx->bo] / dfWeightSum;
+
+      d = dst_row + nDstX * 4;
+      msAlphaBlendPM( (unsigned char) MAX(0,MIN(255,red)),
+                      (unsigned char) MAX(0,MIN(255,green)),
+                      (unsigned char) MAX(0,MIN(255,blue)),
+                      (unsigned char) MAX(0,MIN(255,255.5*dfWeightSum)),
+                      d + ctx->ro, d + ctx->go, d + ctx->bo,
+                      ctx->dst_has_alpha ? d + ctx->ao : NULL );
+    }
+  }
+}
+
+/************************************************************************/
+/*                          msAverageRowRGBA()                          */
+/*                                                                      */
+/*      x1/y1 and x2/y2 are the source positions of the top and         */
+/*      bottom corners of the row of output pixels.                     */
+/************************************************************************/
+
+static void msAverageRowRGBA( msRGBARowContext *ctx, int nDstY, int nDstXSize,
+                              double *x1, double *y1, int *panSuccess1,
+                              double *x2, double *y2, int *panSuccess2,
+                              int *pnFailedPoints, int *pnSetPoints )
+{
+  rasterBufferObj *mask_rb = ctx->mask_rb; /* for SKIP_MASK() */
+  rasterBufferObj *dst_rb = ctx->dst_rb; /* for RB_SET_PIXEL() */
+  int nDstX;
+
+  for( nDstX = 0; nDstX < nDstXSize; nDstX++ ) {
+    double dfXMin, dfYMin, dfXMax, dfYMax;
+    double dfWeightSum, dfMaxWeight = 0.0, dfAlpha01, adfSum[4];
+    int nXMin, nXMax, nYMin, nYMax, iX, iY;
+
+    if(SKIP_MASK(nDstX,nDstY))
+      continue;
+
+    if( !panSuccess1[nDstX] || !panSuccess1[nDstX+1]
+        || !panSuccess2[nDstX] || !panSuccess2[nDstX+1] ) {
+      (*pnFailedPoints)++;
+      continue;
+    }
+
+    /* see msAverageRasterResampler() and msAverageSample() */
+    dfXMin = MIN(MIN(x1[nDstX],x1[nDstX+1]),
+                 MIN(x2[nDstX],x2[nDstX+1]));
+    dfYMin = MIN(MIN(y1[nDstX],y1[nDstX+1]),
+                 MIN(y2[nDstX],y2[nDstX+1]));
+    dfXMax = MAX(MAX(x1[nDstX],x1[nDstX+1]),
+                 MAX(x2[nDstX],x2[nDstX+1]));
+    dfYMax = MAX(MAX(y1[nDstX],y1[nDstX+1]),
+                 MAX(y2[nDstX],y2[nDstX+1]));
+
+    dfXMin = MIN(MAX(dfXMin,0),ctx->nSrcXSize+1);
+    dfYMin = MIN(MAX(dfYMin,0),ctx->nSrcYSize+1);
+    dfXMax = MIN(MAX(-1,dfXMax),ctx->nSrcXSize);
+    dfYMax = MIN(MAX(-1,dfYMax),ctx->nSrcYSize);
+
+    nXMin = (int) dfXMin;
+    nYMin = (int) dfYMin;
+    nXMax = (int) ceil(dfXMax);
+    nYMax = (int) ceil(dfYMax);
+
+    adfSum[0] = adfSum[1] = adfSum[2] = adfSum[3] = 0.0;
+    for( iY = nYMin; iY < nYMax; iY++ ) {
+      double dfYCellMin = MAX(iY,dfYMin);
+      double dfYCellMax = MIN(iY+1,dfYMax);
+
+      for( iX = nXMin; iX < nXMax; iX++ ) {
+        double dfXCellMin = MAX(iX,dfXMin);
+        double dfXCellMax = MIN(iX+1,dfXMax);
+        double dfWeight = (dfXCellMax-dfXCellMin) * (dfYCellMax-dfYCellMin);
+
+        MS_RGBA_SUM_ADD( ctx, adfSum, MS_RGBA_PIXEL( ctx, iX, iY ), dfWeight );
+        dfMaxWeight += dfWeight;
+      }
+    }
+
+    dfWeightSum = adfSum[ctx->ao];
+    if( dfWeightSum == 0.0 )
+      continue;
+
+    dfAlpha01 = dfWeightSum / dfMaxWeight;
+
+    (*pnSetPoints)++;
+
+    if( dfAlpha01 > 0 ) {
+      unsigned char red, green, blue, alpha;
+
+      red   = (unsigned char) MAX(0,MIN(255,adfSum[ctx->ro] / dfWeightSum + 0.5));
+      green = (unsigned char) MAX(0,MIN(255,adfSum[ctx->go] / dfWeightSum + 0.5));
+      blue  = (unsigned char) MAX(0,MIN(255,adfSum[ctx->bo] / dfWeightSum + 0.5));
+      alpha = (unsigned char) MAX(0,MIN(255,255*dfAlpha01+0.5));
+
+      RB_SET_PIXEL(dst_rb,nDstX,nDstY,
+                   red, green, blue, alpha );
+    }
+  }
+}
+
 /************************************************************************/
 /*                      msNearestRasterResample()                       */
 /************************************************************************/
@@ -88,27 +403,35 @@ msNearestRasterResampler( imageObj *psSrcImage, rasterBufferObj *src_rb,
                           imageObj *psDstImage, rasterBufferObj *dst_rb,
                           int *panCMap,
                           SimpleTransformer pfnTransform, void *pCBData,
-                          int debug, rasterBufferObj *mask_rb )
+                          int nDstYStart, int nDstYEnd,
+                          int debug, rasterBufferObj *mask_rb, int bRowKernels )
 
 {
   double  *x, *y;
   int   nDstX, nDstY;
   int         *panSuccess;
   int   nDstXSize = psDstImage->width;
-  int   nDstYSize = psDstImage->height;
   int   nSrcXSize = psSrcImage->width;
   int   nSrcYSize = psSrcImage->height;
   int   nFailedPoints = 0, nSetPoints = 0;
+  msRGBARowContext *psRowContext = NULL;
 #ifndef USE_GD
   assert(!MS_RENDERER_PLUGIN(psSrcImage->format) || src_rb->type != MS_BUFFER_GD);
 #endif
 
+  if( bRowKernels ) {
+    psRowContext = (msRGBARowContext *) msSmallMalloc( sizeof(msRGBARowContext) );
+    if( !msInitRGBARowContext( psRowContext, psSrcImage, src_rb, dst_rb, mask_rb ) ) {
+      free( psRowContext );
+      psRowContext = NULL;
+    }
+  }
 
   x = (double *) msSmallMalloc( sizeof(double) * nDstXSize );
   y = (double *) msSmallMalloc( sizeof(double) * nDstXSize );
   panSuccess = (int *) msSmallMalloc( sizeof(int) * nDstXSize );
 
-  for( nDstY = 0; nDstY < nDstYSize; nDstY++ ) {
+  for( nDstY = nDstYStart; nDstY < nDstYEnd; nDstY++ ) {
     for( nDstX = 0; nDstX < nDstXSize; nDstX++ ) {
       x[nDstX] = nDstX + 0.5;
       y[nDstX] = nDstY + 0.5;
@@ -116,6 +439,12 @@ msNearestRasterResampler( imageObj *psSrcImage, rasterBufferObj *src_rb,
 
     pfnTransform( pCBData, nDstXSize, x, y, panSuccess );
 
+    if( psRowContext ) {
+      msNearestRowRGBA( psRowContext, nDstY, nDstXSize, x, y, panSuccess,
+                        &nFailedPoints, &nSetPoints );
+      continue;
+    }
+
     for( nDstX = 0; nDstX < nDstXSize; nDstX++ ) {
       int   nSrcX, nSrcY;
       if(SKIP_MASK(nDstX,nDstY))
@@ -233,7 +562,7 @@ msNearestRasterResampler( imageObj *psSrcImage, rasterBufferObj *src_rb,
   free( panSuccess );
   free( x );
   free( y );
-  msFree(mask_rb);
+  msFree(psRowContext);
 
   /* -------------------------------------------------------------------- */
   /*      Some debugging output.                                          */
@@ -335,29 +664,37 @@ msBilinearRasterResampler( imageObj *psSrcImage, rasterBufferObj *src_rb,
                            imageObj *psDstImage, rasterBufferObj *dst_rb,
                            int *panCMap,
                            SimpleTransformer pfnTransform, void *pCBData,
-                           int debug, rasterBufferObj *mask_rb )
+                           int nDstYStart, int nDstYEnd,
+                           int debug, rasterBufferObj *mask_rb, int bRowKernels )
 
 {
   double  *x, *y;
   int   nDstX, nDstY, i;
   int         *panSuccess;
   int   nDstXSize = psDstImage->width;
-  int   nDstYSize = psDstImage->height;
   int   nSrcXSize = psSrcImage->width;
   int   nSrcYSize = psSrcImage->height;
   int   nFailedPoints = 0, nSetPoints = 0;
   double     *padfPixelSum;
   int         bandCount = MAX(4,psSrcImage->format->bands);
+  msRGBARowContext *psRowContext = NULL;
 
   padfPixelSum = (double *) msSmallMalloc(sizeof(double) * bandCount);
 
+  if( bRowKernels ) {
+    psRowContext = (msRGBARowContext *) msSmallMalloc( sizeof(msRGBARowContext) );
+    if( !msInitRGBARowContext( psRowContext, psSrcImage, src_rb, dst_rb, mask_rb ) ) {
+      free( psRowContext );
+      psRowContext = NULL;
+    }
+  }
 
 
   x = (double *) msSmallMalloc( sizeof(double) * nDstXSize );
   y = (double *) msSmallMalloc( sizeof(double) * nDstXSize );
   panSuccess = (int *) msSmallMalloc( sizeof(int) * nDstXSize );
 
-  for( nDstY = 0; nDstY < nDstYSize; nDstY++ ) {
+  for( nDstY = nDstYStart; nDstY < nDstYEnd; nDstY++ ) {
     for( nDstX = 0; nDstX < nDstXSize; nDstX++ ) {
       x[nDstX] = nDstX + 0.5;
       y[nDstX] = nDstY + 0.5;
@@ -365,6 +702,12 @@ msBilinearRasterResampler( imageObj *psSrcImage, rasterBufferObj *src_rb,
 
     pfnTransform( pCBData, nDstXSize, x, y, panSuccess );
 
+    if( psRowContext ) {
+      msBilinearRowRGBA( psRowContext, nDstY, nDstXSize, x, y, panSuccess,
+                         &nFailedPoints, &nSetPoints );
+      continue;
+    }
+
     for( nDstX = 0; nDstX < nDstXSize; nDstX++ ) {
       int   nSrcX, nSrcY, nSrcX2, nSrcY2;
       double      dfRatioX2, dfRatioY2, dfWeightSum = 0.0;
@@ -495,7 +838,7 @@ msBilinearRasterResampler( imageObj *psSrcImage, rasterBufferObj *src_rb,
   free( panSuccess );
   free( x );
   free( y );
-  msFree(mask_rb);
+  msFree(psRowContext);
 
   /* -------------------------------------------------------------------- */
   /*      Some debugging output.                                          */
@@ -576,21 +919,30 @@ msAverageRasterResampler( imageObj *psSrcImage, rasterBufferObj *src_rb,
                           imageObj *psDstImage, rasterBufferObj *dst_rb,
                           int *panCMap,
                           SimpleTransformer pfnTransform, void *pCBData,
-                          int debug, rasterBufferObj *mask_rb )
+                          int nDstYStart, int nDstYEnd,
+                          int debug, rasterBufferObj *mask_rb, int bRowKernels )
 
 {
   double  *x1, *y1, *x2, *y2;
   int   nDstX, nDstY;
   int         *panSuccess1, *panSuccess2;
   int   nDstXSize = psDstImage->width;
-  int   nDstYSize = psDstImage->height;
   int   nFailedPoints = 0, nSetPoints = 0;
   double     *padfPixelSum;
+  msRGBARowContext *psRowContext = NULL;
 
   int         bandCount = MAX(4,psSrcImage->format->bands);
 
   padfPixelSum = (double *) msSmallMalloc(sizeof(double) * bandCount);
 
+  if( bRowKernels ) {
+    psRowContext = (msRGBARowContext *) msSmallMalloc( sizeof(msRGBARowContext) );
+    if( !msInitRGBARowContext( psRowContext, psSrcImage, src_rb, dst_rb, mask_rb ) ) {
+      free( psRowContext );
+      psRowContext = NULL;
+    }
+  }
+
 
 
   x1 = (double *) msSmallMalloc( sizeof(double) * (nDstXSize+1) );
@@ -600,7 +952,7 @@ msAverageRasterResampler( imageObj *psSrcImage, rasterBufferObj *src_rb,
   panSuccess1 = (int *) msSmallMalloc( sizeof(int) * (nDstXSize+1) );
   panSuccess2 = (int *) msSmallMalloc( sizeof(int) * (nDstXSize+1) );
 
-  for( nDstY = 0; nDstY < nDstYSize; nDstY++ ) {
+  for( nDstY = nDstYStart; nDstY < nDstYEnd; nDstY++ ) {
     for( nDstX = 0; nDstX <= nDstXSize; nDstX++ ) {
       x1[nDstX] = nDstX;
       y1[nDstX] = nDstY;
@@ -611,6 +963,13 @@ msAverageRasterResampler( imageObj *psSrcImage, rasterBufferObj *src_rb,
     pfnTransform( pCBData, nDstXSize+1, x1, y1, panSuccess1 );
     pfnTransform( pCBData, nDstXSize+1, x2, y2, panSuccess2 );
 
+    if( psRowContext ) {
+      msAverageRowRGBA( psRowContext, nDstY, nDstXSize,
+                        x1, y1, panSuccess1, x2, y2, panSuccess2,
+                        &nFailedPoints, &nSetPoints );
+      continue;
+    }
+
     for( nDstX = 0; nDstX < nDstXSize; nDstX++ ) {
       double  dfXMin, dfYMin, dfXMax, dfYMax;
       double  dfAlpha01;
@@ -716,7 +1075,7 @@ msAverageRasterResampler( imageObj *psSrcImage, rasterBufferObj *src_rb,
   free( panSuccess2 );
   free( x2 );
   free( y2 );
-  msFree(mask_rb);
+  msFree(psRowContext);
 
   /* -------------------------------------------------------------------- */
   /*      Some debugging output.                                          */
@@ -862,10 +1221,14 @@ int msProjTransformer( void *pCBData, int nPoints,
 
     z = (double *) msSmallCalloc(sizeof(double),nPoints);
 
+#if PJ_VERSION < 480
     msAcquireLock( TLOCK_PROJ );
+#endif
     tr_result = pj_transform( psPTInfo->psDstProj, psPTInfo->psSrcProj,
                               nPoints, 1, x, y,  z);
+#if PJ_VERSION < 480
     msReleaseLock( TLOCK_PROJ );
+#endif
 
     if( tr_result != 0 ) {
       free( z );
@@ -1224,6 +1587,128 @@ static int msTransformMapToSource( int nDstXSize, int nDstYSize,
 #endif /* def USE_PROJ */
 
 #ifdef USE_GDAL
+/************************************************************************/
+/* ==================================================================== */
+/*      Multithreaded resampling.                                       */
+/*                                                                      */
+/*      The destination image is split into chunks of rows which a      */
+/*      small pool of worker threads pull from a shared counter.  Each  */
+/*      worker has its own transformer (and with PROJ >= 4.8 its own    */
+/*      copy of the projections) and writes only the rows of its        */
+/*      chunks, so the shared destination buffer needs no locking.      */
+/* ==================================================================== */
+/************************************************************************/
+
+#define MS_RESAMPLE_CHUNK_ROWS 32
+#define MS_RESAMPLE_MAX_THREADS 64
+
+typedef struct {
+  const char *pszResampleMode;
+  imageObj *psSrcImage;
+  rasterBufferObj *src_rb;
+  imageObj *psDstImage;
+  rasterBufferObj *dst_rb;
+  int *panCMap;
+  int debug;
+  rasterBufferObj *mask_rb;
+  int bRowKernels;
+
+  void **papTCBData;   /* one proj transformer per worker slot */
+  void **papACBData;   /* one approx transformer per worker slot */
+  int nNextSlot;
+  int nNextRow;
+  int nRows;
+} msResampleJob;
+
+/************************************************************************/
+/*                         msResampleRows()                             */
+/************************************************************************/
+
+static int msResampleRows( msResampleJob *psJob, void *pACBData,
+                           int nDstYStart, int nDstYEnd )
+
+{
+  if( EQUAL(psJob->pszResampleMode,"AVERAGE") )
+    return
+      msAverageRasterResampler( psJob->psSrcImage, psJob->src_rb,
+                                psJob->psDstImage, psJob->dst_rb,
+                                psJob->panCMap, msApproxTransformer, pACBData,
+                                nDstYStart, nDstYEnd,
+                                psJob->debug, psJob->mask_rb, psJob->bRowKernels );
+  else if( EQUAL(psJob->pszResampleMode,"BILINEAR") )
+    return
+      msBilinearRasterResampler( psJob->psSrcImage, psJob->src_rb,
+                                 psJob->psDstImage, psJob->dst_rb,
+                                 psJob->panCMap, msApproxTransformer, pACBData,
+                                 nDstYStart, nDstYEnd,
+                                 psJob->debug, psJob->mask_rb, psJob->bRowKernels );
+  else
+    return
+      msNearestRasterResampler( psJob->psSrcImage, psJob->src_rb,
+                                psJob->psDstImage, psJob->dst_rb,
+                                psJob->panCMap, msApproxTransformer, pACBData,
+                                nDstYStart, nDstYEnd,
+                                psJob->debug, psJob->mask_rb, psJob->bRowKernels );
+}
+
+/************************************************************************/
+/*                        msResampleWorker()                            */
+/************************************************************************/
+
+static void msResampleWorker( void *pData )
+
+{
+  msResampleJob *psJob = (msResampleJob *) pData;
+  void *pACBData;
+  int nDstYStart;
+
+  msAcquireLock( TLOCK_RESAMPLE );
+  pACBData = psJob->papACBData[psJob->nNextSlot++];
+  msReleaseLock( TLOCK_RESAMPLE );
+
+  for( ;; ) {
+    msAcquireLock( TLOCK_RESAMPLE );
+    nDstYStart = psJob->nNextRow;
+    psJob->nNextRow += MS_RESAMPLE_CHUNK_ROWS;
+    msReleaseLock( TLOCK_RESAMPLE );
+
+    if( nDstYStart >= psJob->nRows )
+      break;
+
+    msResampleRows( psJob, pACBData, nDstYStart,
+                    MIN(nDstYStart + MS_RESAMPLE_CHUNK_ROWS, psJob->nRows) );
+  }
+}
+
+/************************************************************************/
+/*                      msResampleThreadCount()                         */
+/*                                                                      */
+/*      Number of threads to resample with, from the                    */
+/*      MS_RESAMPLE_THREADS config option (default 1).  Raw mode        */
+/*      output always uses one thread since its pixel mask is a         */
+/*      shared bit array.                                               */
+/************************************************************************/
+
+static int msResampleThreadCount( mapObj *map, imageObj *image )
+
+{
+#ifdef USE_THREAD
+  const char *pszThreads = msGetConfigOption( map, "MS_RESAMPLE_THREADS" );
+  int nThreads, nChunks;
+
+  if( pszThreads == NULL || !MS_RENDERER_PLUGIN(image->format) )
+    return 1;
+
+  nThreads = atoi( pszThreads );
+  nChunks = (image->height + MS_RESAMPLE_CHUNK_ROWS - 1) / MS_RESAMPLE_CHUNK_ROWS;
+  nThreads = MIN(nThreads, MIN(nChunks, MS_RESAMPLE_MAX_THREADS));
+
+  return MAX(nThreads, 1);
+#else
+  return 1;
+#endif
+}
+
 /************************************************************************/
 /*                        msResampleGDALToMap()                         */
 /************************************************************************/
@@ -1249,8 +1734,9 @@ int msResampleGDALToMap( mapObj *map, layerObj *layer, imageObj *image,
   rectObj sSrcExtent, sOrigSrcExtent;
   mapObj  sDummyMap;
   imageObj   *srcImage;
-  void  *pTCBData;
-  void  *pACBData;
+  void       **papTCBData, **papACBData;
+  projectionObj *pasProjections;
+  int         nThreads, iThread, nProjections = 0;
   int         anCMap[256];
   char       **papszAlteredProcessing = NULL;
   int         nLoadImgXSize, nLoadImgYSize;
@@ -1260,6 +1746,7 @@ int msResampleGDALToMap( mapObj *map, layerObj *layer, imageObj *image,
 
   const char *resampleMode = CSLFetchNameValue( layer->processing,
                              "RESAMPLE" );
+  int bRowKernels = CSLFetchBoolean( layer->processing, "RESAMPLE_ROW_KERNELS", TRUE );
 
   if( resampleMode == NULL )
     resampleMode = "NEAREST";
@@ -1554,46 +2041,86 @@ int msResampleGDALToMap( mapObj *map, layerObj *layer, imageObj *image,
 
   /* -------------------------------------------------------------------- */
   /*      Setup transformations between our source image, and the         */
-  /*      target map image.                                               */
-  /* -------------------------------------------------------------------- */
-  pTCBData = msInitProjTransformer( &(layer->projection),
-                                    adfSrcGeoTransform,
-                                    &(map->projection),
-                                    adfDstGeoTransform );
+  /*      target map image.  Every worker thread gets its own pair of     */
+  /*      transformers; with PROJ >= 4.8 the extra workers also get       */
+  /*      their own copies of the projections, so that no PROJ object     */
+  /*      (and context) is used by two threads at once.                   */
+  /* -------------------------------------------------------------------- */
+  nThreads = msResampleThreadCount( map, image );
+  papTCBData = (void **) msSmallCalloc( nThreads, sizeof(void *) );
+  papACBData = (void **) msSmallCalloc( nThreads, sizeof(void *) );
+  pasProjections = (projectionObj *) msSmallCalloc( 2*nThreads, sizeof(projectionObj) );
+
+  for( iThread = 0; iThread < nThreads; iThread++ ) {
+    projectionObj *psSrcProj = &(layer->projection);
+    projectionObj *psDstProj = &(map->projection);
+
+#if PJ_VERSION >= 480
+    if( iThread > 0 ) {
+      psSrcProj = pasProjections + 2*iThread;
+      psDstProj = pasProjections + 2*iThread + 1;
+      msInitProjection( psSrcProj );
+      msInitProjection( psDstProj );
+      nProjections += 2;
+      if( msCopyProjection( psSrcProj, &(layer->projection) ) != MS_SUCCESS
+          || msCopyProjection( psDstProj, &(map->projection) ) != MS_SUCCESS ) {
+        if( layer->debug )
+          msDebug( "msResampleGDALToMap(): failed to copy projections, "
+                   "using %d thread(s).\n", iThread );
+        nThreads = iThread;
+        break;
+      }
+    }
+#endif
 
-  if( pTCBData == NULL ) {
-    if( layer->debug )
-      msDebug( "msInitProjTransformer() returned NULL.\n" );
-    if( MS_RENDERER_PLUGIN( srcImage->format ) && !srcImage->format->vtable->supports_pixel_buffer)
-      msFreeRasterBuffer(psrc_rb);
-    msFreeImage( srcImage );
-    return MS_PROJERR;
-  }
+    papTCBData[iThread] = msInitProjTransformer( psSrcProj,
+                          adfSrcGeoTransform,
+                          psDstProj,
+                          adfDstGeoTransform );
 
-  /* -------------------------------------------------------------------- */
-  /*      It is cheaper to use linear approximations as long as our       */
-  /*      error is modest (less than 0.333 pixels).                       */
-  /* -------------------------------------------------------------------- */
-  pACBData = msInitApproxTransformer( msProjTransformer, pTCBData, 0.333 );
+    if( papTCBData[iThread] == NULL ) {
+      if( layer->debug )
+        msDebug( "msInitProjTransformer() returned NULL.\n" );
+      result = MS_PROJERR;
+      break;
+    }
+
+    /* -------------------------------------------------------------------- */
+    /*      It is cheaper to use linear approximations as long as our       */
+    /*      error is modest (less than 0.333 pixels).                       */
+    /* -------------------------------------------------------------------- */
+    papACBData[iThread] =
+      msInitApproxTransformer( msProjTransformer, papTCBData[iThread], 0.333 );
+  }
 
   /* -------------------------------------------------------------------- */
   /*      Perform the resampling.                                         */
   /* -------------------------------------------------------------------- */
-  if( EQUAL(resampleMode,"AVERAGE") )
-    result =
-      msAverageRasterResampler( srcImage, psrc_rb, image, rb,
-                                anCMap, msApproxTransformer, pACBData,
-                                layer->debug, mask_rb );
-  else if( EQUAL(resampleMode,"BILINEAR") )
-    result =
-      msBilinearRasterResampler( srcImage, psrc_rb, image, rb,
-                                 anCMap, msApproxTransformer, pACBData,
-                                 layer->debug, mask_rb );
-  else
-    result =
-      msNearestRasterResampler( srcImage, psrc_rb, image, rb,
-                                anCMap, msApproxTransformer, pACBData,
-                                layer->debug, mask_rb );
+  if( result == 0 ) {
+    msResampleJob sJob;
+
+    sJob.pszResampleMode = resampleMode;
+    sJob.psSrcImage = srcImage;
+    sJob.src_rb = psrc_rb;
+    sJob.psDstImage = image;
+    sJob.dst_rb = rb;
+    sJob.panCMap = anCMap;
+    sJob.debug = layer->debug;
+    sJob.mask_rb = mask_rb;
+    sJob.bRowKernels = bRowKernels;
+    sJob.papTCBData = papTCBData;
+    sJob.papACBData = papACBData;
+    sJob.nNextSlot = 0;
+    sJob.nNextRow = 0;
+    sJob.nRows = nDstYSize;
+
+    if( nThreads > 1 ) {
+      int nRan = msThreadRunWorkers( nThreads, msResampleWorker, &sJob );
+      if( layer->debug )
+        msDebug( "msResampleGDALToMap(): resampled with %d thread(s).\n", nRan );
+    } else
+      result = msResampleRows( &sJob, papACBData[0], 0, nDstYSize );
+  }
 
   /* -------------------------------------------------------------------- */
   /*      cleanup                                                         */
@@ -1601,9 +2128,19 @@ int msResampleGDALToMap( mapObj *map, layerObj *layer, imageObj *image,
   if( MS_RENDERER_PLUGIN( srcImage->format ) && !srcImage->format->vtable->supports_pixel_buffer)
     msFreeRasterBuffer(psrc_rb);
   msFreeImage( srcImage );
+  msFree( mask_rb );
 
-  msFreeProjTransformer( pTCBData );
-  msFreeApproxTransformer( pACBData );
+  for( iThread = 0; iThread < nThreads; iThread++ ) {
+    if( papTCBData[iThread] )
+      msFreeProjTransformer( papTCBData[iThread] );
+    if( papACBData[iThread] )
+      msFreeApproxTransformer( papACBData[iThread] );
+  }
+  for( iThread = 0; iThread < nProjections; iThread++ )
+    msFreeProjection( pasProjections + 2 + iThread );
+  free( papTCBData );
+  free( papACBData );
+  free( pasProjections );
 
   return result;
 #endif
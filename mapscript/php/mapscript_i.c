@@ -1756,7 +1756,7 @@ void cgirequestObj_setParameter(cgiRequestObj *self, char *name, char *value)
 
   for (i=0; i<self->NumParams; i++) {
     if (strcasecmp(self->ParamNames[i], name) == 0) {
-      free(self->ParamValues[i]);
+      msRequestFree(self->ParamValues[i]);
       self->ParamValues[i] = strdup(value);
       break;
     }
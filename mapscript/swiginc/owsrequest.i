@@ -93,7 +93,7 @@ static char *msGetEnvURL( const char *key, void *thread_context )
         
         for (i=0; i<self->NumParams; i++) {
             if (strcasecmp(self->ParamNames[i], name) == 0) {
-                free(self->ParamValues[i]);
+                msRequestFree(self->ParamValues[i]);
                 self->ParamValues[i] = strdup(value);
                 break;
             }
@@ -159,9 +159,13 @@ int msPolygonDirection(lineObj *c)
 int msPointInPolygon(pointObj *p, lineObj *c)
 {
   int i, j, status = MS_FALSE;
+  double px = p->x, py = p->y; /* keep the test point in registers */
+  const pointObj *pi, *pj;
 
   for (i = 0, j = c->numpoints-1; i < c->numpoints; j = i++) {
-    if ((((c->point[i].y<=p->y) && (p->y<c->point[j].y)) || ((c->point[j].y<=p->y) && (p->y<c->point[i].y))) && (p->x < (c->point[j].x - c->point[i].x) * (p->y - c->point[i].y) / (c->point[j].y - c->point[i].y) + c->point[i].x))
+    pi = &(c->point[i]);
+    pj = &(c->point[j]);
+    if (((pi->y<=py) != (pj->y<=py)) && (px < (pj->x - pi->x) * (py - pi->y) / (pj->y - pi->y) + pi->x))
       status = !status;
   }
   return status;
@@ -249,17 +253,178 @@ int msIntersectMultipointPolygon(shapeObj *multipoint, shapeObj *poly)
   return(MS_FALSE);
 }
 
+/*
+** Edge index: the edges of a polygon are sorted into horizontal bands so a
+** point in polygon test only looks at the edges crossing the band of the
+** point instead of every edge of every ring. Meant for shapes tested many
+** times (query shapes), building it costs about as much as a couple of
+** plain msIntersectPointPolygon() calls. The results are the same as
+** msIntersectPointPolygon(): the parity over all rings is counted.
+*/
+#define MS_EDGEINDEX_EDGES_PER_BUCKET 4
+#define MS_EDGEINDEX_MAX_BUCKETS 65536
+#define MS_EDGEINDEX_MAX_REPEAT 8 /* total bucketed edges allowed per edge */
+
+static int msEdgeIndexBucket(edgeIndexObj *index, double y)
+{
+  int b = (int) ((y - index->miny) / index->bucketheight);
+  return MS_MAX(0, MS_MIN(b, index->numbuckets-1));
+}
+
+static int msEdgeIndexCount(edgeIndexObj *index, shapeObj *polygon, int *counts)
+{
+  int i, j, k, total=0;
+  lineObj *line;
+
+  for(i=0; i<polygon->numlines; i++) {
+    line = &(polygon->line[i]);
+    for(j=0, k=line->numpoints-1; j<line->numpoints; k = j++) {
+      int b1, b2;
+      if(line->point[j].y == line->point[k].y) continue; /* horizontal edges never cross */
+      b1 = msEdgeIndexBucket(index, MS_MIN(line->point[j].y, line->point[k].y));
+      b2 = msEdgeIndexBucket(index, MS_MAX(line->point[j].y, line->point[k].y));
+      if(counts) {
+        for(; b1<=b2; b1++) counts[b1]++;
+      } else
+        total += b2-b1+1;
+    }
+  }
+
+  return total;
+}
+
+edgeIndexObj *msCreateEdgeIndex(shapeObj *polygon)
+{
+  int i, j, k, b, b2, numedges=0, total;
+  int *fill;
+  edgeIndexObj *index;
+  lineObj *line;
+
+  if(!polygon || polygon->type != MS_SHAPE_POLYGON || polygon->numlines == 0)
+    return NULL;
+
+  for(i=0; i<polygon->numlines; i++)
+    numedges += polygon->line[i].numpoints;
+  if(numedges < 3)
+    return NULL;
+
+  index = (edgeIndexObj *) msSmallMalloc(sizeof(edgeIndexObj));
+  index->miny = index->maxy = polygon->line[0].point[0].y;
+  for(i=0; i<polygon->numlines; i++) {
+    for(j=0; j<polygon->line[i].numpoints; j++) {
+      index->miny = MS_MIN(index->miny, polygon->line[i].point[j].y);
+      index->maxy = MS_MAX(index->maxy, polygon->line[i].point[j].y);
+    }
+  }
+
+  /* fewer, taller buckets if long edges would be repeated too often */
+  index->numbuckets = MS_MAX(1, MS_MIN(numedges / MS_EDGEINDEX_EDGES_PER_BUCKET, MS_EDGEINDEX_MAX_BUCKETS));
+  while(1) {
+    index->bucketheight = (index->maxy - index->miny) / index->numbuckets;
+    if(index->bucketheight <= 0) index->numbuckets = 1;
+    if(index->numbuckets == 1) {
+      index->bucketheight = MS_MAX(index->maxy - index->miny, 1);
+      total = msEdgeIndexCount(index, polygon, NULL);
+      break;
+    }
+    total = msEdgeIndexCount(index, polygon, NULL);
+    if(total <= MS_EDGEINDEX_MAX_REPEAT * numedges) break;
+    index->numbuckets /= 2;
+  }
+
+  index->bucketoffsets = (int *) msSmallCalloc(index->numbuckets+1, sizeof(int));
+  msEdgeIndexCount(index, polygon, index->bucketoffsets+1);
+  for(b=0; b<index->numbuckets; b++)
+    index->bucketoffsets[b+1] += index->bucketoffsets[b];
+
+  index->edges = (double *) msSmallMalloc(MS_MAX(total, 1) * 4 * sizeof(double));
+  fill = (int *) msSmallMalloc(index->numbuckets * sizeof(int));
+  memcpy(fill, index->bucketoffsets, index->numbuckets * sizeof(int));
+
+  /* same edge orientation as msPointInPolygon() so the results are identical */
+  for(i=0; i<polygon->numlines; i++) {
+    line = &(polygon->line[i]);
+    for(j=0, k=line->numpoints-1; j<line->numpoints; k = j++) {
+      if(line->point[j].y == line->point[k].y) continue;
+      b = msEdgeIndexBucket(index, MS_MIN(line->point[j].y, line->point[k].y));
+      b2 = msEdgeIndexBucket(index, MS_MAX(line->point[j].y, line->point[k].y));
+      for(; b<=b2; b++) {
+        double *edge = index->edges + 4*fill[b]++;
+        edge[0] = line->point[j].x;
+        edge[1] = line->point[j].y;
+        edge[2] = line->point[k].x;
+        edge[3] = line->point[k].y;
+      }
+    }
+  }
+
+  free(fill);
+  return index;
+}
+
+void msFreeEdgeIndex(edgeIndexObj *index)
+{
+  if(!index) return;
+  free(index->bucketoffsets);
+  free(index->edges);
+  free(index);
+}
+
+int msEdgeIndexIntersectPoint(edgeIndexObj *index, pointObj *p)
+{
+  int b, e, end, status = MS_FALSE;
+  double px = p->x, py = p->y;
+  const double *edge;
+
+  if(py < index->miny || py >= index->maxy) /* no edge can cross */
+    return MS_FALSE;
+
+  b = msEdgeIndexBucket(index, py);
+  end = index->bucketoffsets[b+1];
+  for(e=index->bucketoffsets[b]; e<end; e++) {
+    edge = index->edges + 4*e;
+    if(((edge[1]<=py) != (edge[3]<=py)) && (px < (edge[2] - edge[0]) * (py - edge[1]) / (edge[3] - edge[1]) + edge[0]))
+      status = !status;
+  }
+
+  return status;
+}
+
+int msEdgeIndexIntersectMultipoint(edgeIndexObj *index, shapeObj *multipoint)
+{
+  int i, j;
+
+  for(i=0; i<multipoint->numlines; i++) {
+    for(j=0; j<multipoint->line[i].numpoints; j++) {
+      if(msEdgeIndexIntersectPoint(index, &(multipoint->line[i].point[j])) == MS_TRUE)
+        return(MS_TRUE);
+    }
+  }
+
+  return(MS_FALSE);
+}
+
 int msIntersectPolylines(shapeObj *line1, shapeObj *line2)
 {
   int c1,v1,c2,v2;
+  pointObj *a, *b, *c, *d;
 
   for(c1=0; c1<line1->numlines; c1++)
-    for(v1=1; v1<line1->line[c1].numpoints; v1++)
+    for(v1=1; v1<line1->line[c1].numpoints; v1++) {
+      a = &(line1->line[c1].point[v1-1]);
+      b = &(line1->line[c1].point[v1]);
       for(c2=0; c2<line2->numlines; c2++)
-        for(v2=1; v2<line2->line[c2].numpoints; v2++)
-          if(msIntersectSegments(&(line1->line[c1].point[v1-1]), &(line1->line[c1].point[v1]),
-                                 &(line2->line[c2].point[v2-1]), &(line2->line[c2].point[v2])) ==  MS_TRUE)
+        for(v2=1; v2<line2->line[c2].numpoints; v2++) {
+          c = &(line2->line[c2].point[v2-1]);
+          d = &(line2->line[c2].point[v2]);
+          /* cheap rejection of segments whose extents don't overlap */
+          if(MS_MAX(a->x,b->x) < MS_MIN(c->x,d->x) || MS_MIN(a->x,b->x) > MS_MAX(c->x,d->x) ||
+              MS_MAX(a->y,b->y) < MS_MIN(c->y,d->y) || MS_MIN(a->y,b->y) > MS_MAX(c->y,d->y))
+            continue;
+          if(msIntersectSegments(a, b, c, d) ==  MS_TRUE)
             return(MS_TRUE);
+        }
+    }
 
   return(MS_FALSE);
 }
@@ -140,6 +140,8 @@ int main(int argc, char *argv[])
   struct mstimeval execstarttime, execendtime;
   struct mstimeval requeststarttime, requestendtime;
   mapservObj* mapserv = NULL;
+  msArenaObj* arena = NULL;
+  const char *arena_option;
 
   /* -------------------------------------------------------------------- */
   /*      Initialize mapserver.  This sets up threads, GD and GEOS as     */
@@ -203,6 +205,15 @@ int main(int argc, char *argv[])
     }
   }
 
+  /* -------------------------------------------------------------------- */
+  /*      Optionally allocate the small request scoped strings (CGI       */
+  /*      parameters) from an arena that is reset after each request.    */
+  /*      MS_REQUEST_ARENA may be ON or the arena block size in bytes.    */
+  /* -------------------------------------------------------------------- */
+  arena_option = getenv("MS_REQUEST_ARENA");
+  if( arena_option && strcasecmp(arena_option, "OFF") != 0 && strcmp(arena_option, "0") != 0 )
+    arena = msArenaCreate( atoi(arena_option) > 0 ? atoi(arena_option) : 0 );
+
   /* -------------------------------------------------------------------- */
   /*      Setup cleanup magic, mainly for FastCGI case.                   */
   /* -------------------------------------------------------------------- */
@@ -226,6 +237,7 @@ int main(int argc, char *argv[])
     /* -------------------------------------------------------------------- */
     /*      Process a request.                                              */
     /* -------------------------------------------------------------------- */
+    msSetRequestArena(arena);
     mapserv = msAllocMapServObj();
     mapserv->sendheaders = sendheaders; /* override the default if necessary (via command line -nh switch) */
 
@@ -273,6 +285,11 @@ end_request:
       msCGIWriteLog(mapserv,MS_FALSE);
       msFreeMapServObj(mapserv);
     }
+
+    /* everything allocated from the arena is released in one go */
+    msSetRequestArena(NULL);
+    if(arena)
+      msArenaReset(arena);
 #ifdef USE_FASTCGI
     /* FCGI_ --- return to top of loop */
     msResetErrorList();
@@ -287,6 +304,7 @@ end_request:
             (execendtime.tv_sec+execendtime.tv_usec/1.0e6)-
             (execstarttime.tv_sec+execstarttime.tv_usec/1.0e6) );
   }
+  msArenaDestroy(arena);
   msCleanup(0);
 
 #ifdef _WIN32
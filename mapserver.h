@@ -394,6 +394,7 @@ extern "C" {
 #define MS_RENDER_WITH_IMAGEMAP 5
 #define MS_RENDER_WITH_TEMPLATE 8 /* query results only */
 #define MS_RENDER_WITH_OGR 16
+#define MS_RENDER_WITH_GEOJSON 17
 
 #define MS_RENDER_WITH_PLUGIN 100
 #define MS_RENDER_WITH_CAIRO_RASTER   101
@@ -412,6 +413,7 @@ extern "C" {
 #define MS_RENDERER_TEMPLATE(format) ((format)->renderer == MS_RENDER_WITH_TEMPLATE)
 #define MS_RENDERER_KML(format) ((format)->renderer == MS_RENDER_WITH_KML)
 #define MS_RENDERER_OGR(format) ((format)->renderer == MS_RENDER_WITH_OGR)
+#define MS_RENDERER_GEOJSON(format) ((format)->renderer == MS_RENDER_WITH_GEOJSON)
 
 #define MS_RENDERER_PLUGIN(format) ((format)->renderer > MS_RENDER_WITH_PLUGIN)
 
@@ -788,6 +790,8 @@ extern "C" {
   /*      encapsulates the information necessary to perform a query       */
   /************************************************************************/
 #ifndef SWIG
+  struct layerObj;
+
   typedef struct {
     int type; /* MS_QUERY_TYPE */
     int mode; /* MS_QUERY_MODE */
@@ -814,6 +818,11 @@ extern "C" {
     expressionObj *filter; /* by filter */
 
     int slayer; /* selection layer, used for msQueryByFeatures() (note this is not a query mode per se) */
+
+    /* streaming, if set msQueryByRect() hands each matching shape (in map projection) to sink() */
+    /* instead of adding it to the layer result cache, see msGMLWFSStreamWriteShape() */
+    int (*sink)(struct layerObj *layer, shapeObj *shape, void *sinkdata);
+    void *sinkdata;
   } queryObj;
 #endif
 
@@ -1556,6 +1565,7 @@ extern "C" {
     int tileitemindex;
     projectionObj projection; /* projection information for the layer */
     int project; /* boolean variable, do we need to project this layer or not */
+    projectionGridObj *reprojectiongrid; /* approximate reprojection, only set while the layer is drawn */
 #endif /* not SWIG */
 
     int units; /* units of the projection */
@@ -1756,6 +1766,8 @@ extern "C" {
     unsigned char encryption_key[MS_ENCRYPTION_KEY_SIZE]; /* 128bits encryption key */
 
     queryObj query;
+
+    char *mapfile; /* full path of the mapfile for maps loaded with msLoadMap(), NULL otherwise */
 #endif
   } mapObj;
 
@@ -1938,6 +1950,10 @@ extern "C" {
   MS_DLL_EXPORT void msOGRCleanup(void);
   MS_DLL_EXPORT void msGDALCleanup(void);
   MS_DLL_EXPORT void msGDALInitialize(void);
+  MS_DLL_EXPORT void *msGDALOpenDataset(layerObj *layer, const char *path);
+  MS_DLL_EXPORT void msGDALReleaseDataset(layerObj *layer, void *hDS);
+  MS_DLL_EXPORT int msGDALGetBandScaleRange(layerObj *layer, void *hDS, int nBand, double *pdfMin, double *pdfMax);
+  MS_DLL_EXPORT void msGDALClassLUTCleanup(void);
 
   MS_DLL_EXPORT imageObj *msDrawScalebar(mapObj *map); /* in mapscale.c */
   MS_DLL_EXPORT int msCalculateScale(rectObj extent, int units, int width, int height, double resolution, double *scaledenom);
@@ -1974,6 +1990,10 @@ extern "C" {
   MS_DLL_EXPORT int msIntersectPolylinePolygon(shapeObj *line, shapeObj *poly);
   MS_DLL_EXPORT int msIntersectPolygons(shapeObj *p1, shapeObj *p2);
   MS_DLL_EXPORT int msIntersectPolylines(shapeObj *line1, shapeObj *line2);
+  MS_DLL_EXPORT edgeIndexObj *msCreateEdgeIndex(shapeObj *polygon);
+  MS_DLL_EXPORT void msFreeEdgeIndex(edgeIndexObj *index);
+  MS_DLL_EXPORT int msEdgeIndexIntersectPoint(edgeIndexObj *index, pointObj *p);
+  MS_DLL_EXPORT int msEdgeIndexIntersectMultipoint(edgeIndexObj *index, shapeObj *multipoint);
 
   MS_DLL_EXPORT int msInitQuery(queryObj *query); /* in mapquery.c */
   MS_DLL_EXPORT void msFreeQuery(queryObj *query);
@@ -1995,6 +2015,7 @@ extern "C" {
   MS_DLL_EXPORT int msRasterQueryByShape(mapObj *map, layerObj *layer, shapeObj *selectshape);
   MS_DLL_EXPORT int msRasterQueryByRect(mapObj *map, layerObj *layer, rectObj queryRect);
   MS_DLL_EXPORT int msRasterQueryByPoint(mapObj *map, layerObj *layer, int mode, pointObj p, double buffer, int maxresults );
+  MS_DLL_EXPORT void msRasterQueryCacheCleanup(void);
 
   /* in mapstring.c */
   MS_DLL_EXPORT void msStringTrim(char *str);
@@ -2038,6 +2059,8 @@ extern "C" {
   MS_DLL_EXPORT int msGetNumGlyphs(const char *in_ptr);
   MS_DLL_EXPORT int msGetUnicodeEntity(const char *inptr, int *unicode);
   MS_DLL_EXPORT int msStringIsInteger(const char *string);
+#define MS_FORMAT_FIXED_MAX_LENGTH 400 /* "%.15f" of -DBL_MAX */
+  MS_DLL_EXPORT int msFormatFixed(char *out, double value, int precision);
   MS_DLL_EXPORT int msUTF8ToUniChar(const char *str, int *chPtr); /* maptclutf.c */
   MS_DLL_EXPORT char* msStringEscape( const char * pszString );
   MS_DLL_EXPORT int msStringInArray( const char * pszString, char **array, int numelements);
@@ -2375,6 +2398,15 @@ extern "C" {
 
   /*in mapraster.c */
   MS_DLL_EXPORT int msDrawRasterLayerLow(mapObj *map, layerObj *layer, imageObj *image, rasterBufferObj *rb );
+
+  /* in-memory raster tile index catalog (maptilecatalog.c) */
+  typedef struct tileCatalogObj tileCatalogObj;
+  MS_DLL_EXPORT tileCatalogObj *msTileCatalogAcquire(layerObj *layer);
+  MS_DLL_EXPORT void msTileCatalogRelease(tileCatalogObj *catalog);
+  MS_DLL_EXPORT int msTileCatalogSearch(tileCatalogObj *catalog, rectObj rect, int **records);
+  MS_DLL_EXPORT const char *msTileCatalogGetPath(tileCatalogObj *catalog, int record);
+  MS_DLL_EXPORT int msTileCatalogGetBounds(tileCatalogObj *catalog, int record, rectObj *bounds);
+  MS_DLL_EXPORT void msTileCatalogCleanup(void);
 #ifdef USE_GD
   MS_DLL_EXPORT int msAddColorGD(mapObj *map, gdImagePtr img, int cmt, int r, int g, int b);
 #endif
@@ -2403,6 +2435,21 @@ extern "C" {
   MS_DLL_EXPORT void *msSmallMalloc( size_t nSize );
   MS_DLL_EXPORT void * msSmallRealloc( void * pData, size_t nNewSize );
   MS_DLL_EXPORT void *msSmallCalloc( size_t nCount, size_t nSize );
+
+  typedef struct msArenaObj msArenaObj;
+
+  MS_DLL_EXPORT msArenaObj *msArenaCreate(size_t blocksize);
+  MS_DLL_EXPORT void *msArenaAlloc(msArenaObj *arena, size_t nSize);
+  MS_DLL_EXPORT void *msArenaCalloc(msArenaObj *arena, size_t nCount, size_t nSize);
+  MS_DLL_EXPORT char *msArenaStrdup(msArenaObj *arena, const char *pszString);
+  MS_DLL_EXPORT int msArenaOwns(msArenaObj *arena, const void *p);
+  MS_DLL_EXPORT void msArenaReset(msArenaObj *arena);
+  MS_DLL_EXPORT void msArenaDestroy(msArenaObj *arena);
+  MS_DLL_EXPORT void msSetRequestArena(msArenaObj *arena);
+  MS_DLL_EXPORT msArenaObj *msGetRequestArena(void);
+  MS_DLL_EXPORT void *msRequestMalloc(size_t nSize);
+  MS_DLL_EXPORT char *msRequestStrdup(const char *pszString);
+  MS_DLL_EXPORT void msRequestFree(void *p);
   MS_DLL_EXPORT int msIntegerInArray(const int value, int *array, int numelements);
 
   MS_DLL_EXPORT int msExtentsOverlap(mapObj *map, layerObj *layer);
@@ -2530,6 +2577,16 @@ extern "C" {
   MS_DLL_EXPORT int msOGRWriteFromQuery( mapObj *map, outputFormatObj *format,
                                          int sendheaders );
 
+  /* ==================================================================== */
+  /*      prototypes for functions in mapgeojson.c                        */
+  /* ==================================================================== */
+  typedef struct geojsonWriterObj geojsonWriterObj;
+  MS_DLL_EXPORT int msGeoJSONWriteFromQuery( mapObj *map, outputFormatObj *format,
+                                             int sendheaders );
+  MS_DLL_EXPORT geojsonWriterObj *msGeoJSONStreamBegin( mapObj *map, outputFormatObj *format, FILE *stream );
+  MS_DLL_EXPORT int msGeoJSONStreamWriteShape( layerObj *lp, shapeObj *shape, void *sinkdata );
+  MS_DLL_EXPORT int msGeoJSONStreamEnd( geojsonWriterObj *writer );
+
   /* ==================================================================== */
   /*      Public prototype for mapogr.cpp functions.                      */
   /* ==================================================================== */
@@ -2592,6 +2649,7 @@ extern "C" {
   MS_DLL_EXPORT void msGEOSSetup(void);
   MS_DLL_EXPORT void msGEOSCleanup(void);
   MS_DLL_EXPORT void msGEOSFreeGeometry(shapeObj *shape);
+  MS_DLL_EXPORT int msGEOSPrepare(shapeObj *shape);
 
   MS_DLL_EXPORT shapeObj *msGEOSShapeFromWKT(const char *string);
   MS_DLL_EXPORT char *msGEOSShapeToWKT(shapeObj *shape);
@@ -1605,8 +1605,8 @@ int msCGIDispatchRequest(mapservObj *mapserv)
    ** process this as a regular MapServer request.
    */
   if((mapserv->Mode == -1 || mapserv->Mode == OWS || mapserv->Mode == WFS) &&
-      (status = msOWSDispatch(mapserv->map, mapserv->request,
-                              mapserv->Mode)) != MS_DONE  )  {
+      (status = msOWSDispatchCached(mapserv->map, mapserv->request,
+                                    mapserv->Mode)) != MS_DONE  )  {
     /*
      ** OWSDispatch returned either MS_SUCCESS or MS_FAILURE
      */
@@ -36,6 +36,7 @@
 
 
 #include <ctype.h>
+#include <float.h>
 #include <string.h>
 #include <errno.h>
 
@@ -1998,6 +1999,75 @@ int msStringIsInteger(const char *string)
   return MS_SUCCESS;
 }
 
+/************************************************************************/
+/*                            msFormatFixed()                           */
+/*                                                                      */
+/*      Same as sprintf(out, "%.*f", precision, value) but a lot        */
+/*      faster for the common case, used for writing out coordinates.   */
+/*      out must hold MS_FORMAT_FIXED_MAX_LENGTH bytes and precision    */
+/*      be between 0 and 15. Returns the length of the string.          */
+/************************************************************************/
+
+static const double msPowersOf10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+
+int msFormatFixed(char *out, double value, int precision)
+{
+  double scaled, n, ipart, fpart, scale;
+  unsigned long ip, fp;
+  char digits[16];
+  int len = 0, ndigits = 0, i;
+
+  /* the fast path handles what fits in an unsigned long, NaN fails here too */
+  if(precision > 9 || !(value > -4e9 && value < 4e9))
+    return sprintf(out, "%.*f", precision, value);
+
+  scale = msPowersOf10[precision];
+  scaled = fabs(value) * scale;
+  n = floor(scaled);
+  fpart = scaled - n;
+
+  /* the product is off by up to half an ulp, leave near ties to printf */
+  if(scaled >= 4.5e15 || fabs(fpart - 0.5) <= scaled * DBL_EPSILON)
+    return sprintf(out, "%.*f", precision, value);
+  if(fpart > 0.5) n += 1;
+
+  ipart = floor(n / scale);
+  fpart = n - ipart * scale;
+  if(fpart < 0) {
+    ipart -= 1;
+    fpart += scale;
+  } else if(fpart >= scale) {
+    ipart += 1;
+    fpart -= scale;
+  }
+  ip = (unsigned long) ipart;
+  fp = (unsigned long) fpart;
+
+  if(value < 0 || (value == 0 && 1.0/value < 0)) /* printf keeps the sign of -0 */
+    out[len++] = '-';
+
+  do {
+    digits[ndigits++] = (char) ('0' + ip % 10);
+    ip /= 10;
+  } while(ip > 0);
+  while(ndigits > 0)
+    out[len++] = digits[--ndigits];
+
+  if(precision > 0) {
+    out[len++] = '.';
+    for(i=precision-1; i>=0; i--) {
+      out[len+i] = (char) ('0' + fp % 10);
+      fp /= 10;
+    }
+    len += precision;
+  }
+  out[len] = '\0';
+
+  return len;
+}
+
 /************************************************************************/
 /*                             msStrdup()                               */
 /************************************************************************/
@@ -262,6 +262,13 @@ int msReturnTemplateQuery(mapservObj *mapserv, char *queryFormat, char **papszBu
       return status;
     }
 
+    if( MS_RENDERER_GEOJSON(outputFormat) ) {
+      if( mapserv != NULL )
+        checkWebScale(mapserv);
+
+      return msGeoJSONWriteFromQuery(map, outputFormat, mapserv->sendheaders);
+    }
+
     if( !MS_RENDERER_TEMPLATE(outputFormat) ) { /* got an image format, return the query results that way */
       outputFormatObj *tempOutputFormat = map->outputformat; /* save format */
 
@@ -3512,7 +3519,7 @@ static char *processLine(mapservObj *mapserv, char *instr, FILE *stream, int mod
   int i, j;
 #define PROCESSLINE_BUFLEN 5120
   char repstr[PROCESSLINE_BUFLEN], substr[PROCESSLINE_BUFLEN], *outstr; /* repstr = replace string, substr = sub string */
-  struct hashObj *tp=NULL;
+  const char *key, *value;
   char *encodedstr;
 
 #ifdef USE_PROJ
@@ -3685,41 +3692,37 @@ static char *processLine(mapservObj *mapserv, char *instr, FILE *stream, int mod
    */
 
   if(&(mapserv->map->web.metadata) && strstr(outstr, "web_")) {
-    for (j=0; j<MS_HASHSIZE; j++) {
-      if(mapserv->map->web.metadata.items[j] != NULL) {
-        for(tp=mapserv->map->web.metadata.items[j]; tp!=NULL; tp=tp->next) {
-          snprintf(substr, PROCESSLINE_BUFLEN, "[web_%s]", tp->key);
-          outstr = msReplaceSubstring(outstr, substr, tp->data);
-          snprintf(substr, PROCESSLINE_BUFLEN, "[web_%s_esc]", tp->key);
-
-          encodedstr = msEncodeUrl(tp->data);
-          outstr = msReplaceSubstring(outstr, substr, encodedstr);
-          free(encodedstr);
-        }
-      }
+    key = NULL;
+    while((key = msNextKeyFromHashTable(&(mapserv->map->web.metadata), key)) != NULL) {
+      value = msLookupHashTable(&(mapserv->map->web.metadata), key);
+      snprintf(substr, PROCESSLINE_BUFLEN, "[web_%s]", key);
+      outstr = msReplaceSubstring(outstr, substr, value);
+      snprintf(substr, PROCESSLINE_BUFLEN, "[web_%s_esc]", key);
+
+      encodedstr = msEncodeUrl(value);
+      outstr = msReplaceSubstring(outstr, substr, encodedstr);
+      free(encodedstr);
     }
   }
 
   /* allow layer metadata access in template */
   for(i=0; i<mapserv->map->numlayers; i++) {
     if(&(GET_LAYER(mapserv->map, i)->metadata) && GET_LAYER(mapserv->map, i)->name && strstr(outstr, GET_LAYER(mapserv->map, i)->name)) {
-      for(j=0; j<MS_HASHSIZE; j++) {
-        if(GET_LAYER(mapserv->map, i)->metadata.items[j] != NULL) {
-          for(tp=GET_LAYER(mapserv->map, i)->metadata.items[j]; tp!=NULL; tp=tp->next) {
-            snprintf(substr, PROCESSLINE_BUFLEN, "[%s_%s]", GET_LAYER(mapserv->map, i)->name, tp->key);
-            if(GET_LAYER(mapserv->map, i)->status == MS_ON)
-              outstr = msReplaceSubstring(outstr, substr, tp->data);
-            else
-              outstr = msReplaceSubstring(outstr, substr, "");
-            snprintf(substr, PROCESSLINE_BUFLEN, "[%s_%s_esc]", GET_LAYER(mapserv->map, i)->name, tp->key);
-            if(GET_LAYER(mapserv->map, i)->status == MS_ON) {
-              encodedstr = msEncodeUrl(tp->data);
-              outstr = msReplaceSubstring(outstr, substr, encodedstr);
-              free(encodedstr);
-            } else
-              outstr = msReplaceSubstring(outstr, substr, "");
-          }
-        }
+      key = NULL;
+      while((key = msNextKeyFromHashTable(&(GET_LAYER(mapserv->map, i)->metadata), key)) != NULL) {
+        value = msLookupHashTable(&(GET_LAYER(mapserv->map, i)->metadata), key);
+        snprintf(substr, PROCESSLINE_BUFLEN, "[%s_%s]", GET_LAYER(mapserv->map, i)->name, key);
+        if(GET_LAYER(mapserv->map, i)->status == MS_ON)
+          outstr = msReplaceSubstring(outstr, substr, value);
+        else
+          outstr = msReplaceSubstring(outstr, substr, "");
+        snprintf(substr, PROCESSLINE_BUFLEN, "[%s_%s_esc]", GET_LAYER(mapserv->map, i)->name, key);
+        if(GET_LAYER(mapserv->map, i)->status == MS_ON) {
+          encodedstr = msEncodeUrl(value);
+          outstr = msReplaceSubstring(outstr, substr, encodedstr);
+          free(encodedstr);
+        } else
+          outstr = msReplaceSubstring(outstr, substr, "");
       }
     }
   }
@@ -3870,18 +3873,16 @@ static char *processLine(mapservObj *mapserv, char *instr, FILE *stream, int mod
 
     /* allow layer metadata access in a query template, within the context of a query no layer name is necessary */
     if(&(mapserv->resultlayer->metadata) && strstr(outstr, "[metadata_")) {
-      for(i=0; i<MS_HASHSIZE; i++) {
-        if(mapserv->resultlayer->metadata.items[i] != NULL) {
-          for(tp=mapserv->resultlayer->metadata.items[i]; tp!=NULL; tp=tp->next) {
-            snprintf(substr, PROCESSLINE_BUFLEN, "[metadata_%s]", tp->key);
-            outstr = msReplaceSubstring(outstr, substr, tp->data);
-
-            snprintf(substr, PROCESSLINE_BUFLEN, "[metadata_%s_esc]", tp->key);
-            encodedstr = msEncodeUrl(tp->data);
-            outstr = msReplaceSubstring(outstr, substr, encodedstr);
-            free(encodedstr);
-          }
-        }
+      key = NULL;
+      while((key = msNextKeyFromHashTable(&(mapserv->resultlayer->metadata), key)) != NULL) {
+        value = msLookupHashTable(&(mapserv->resultlayer->metadata), key);
+        snprintf(substr, PROCESSLINE_BUFLEN, "[metadata_%s]", key);
+        outstr = msReplaceSubstring(outstr, substr, value);
+
+        snprintf(substr, PROCESSLINE_BUFLEN, "[metadata_%s_esc]", key);
+        encodedstr = msEncodeUrl(value);
+        outstr = msReplaceSubstring(outstr, substr, encodedstr);
+        free(encodedstr);
       }
     }
 
@@ -4346,11 +4347,11 @@ int msReturnOpenLayersPage(mapservObj *mapserv)
         (strcasecmp(mapserv->request->ParamNames[i], "CRS") == 0) ) {
       projection = mapserv->request->ParamValues[i];
     } else if(strcasecmp(mapserv->request->ParamNames[i], "LAYERS") == 0) {
-      free(mapserv->request->ParamNames[i]);
-      mapserv->request->ParamNames[i] = msStrdup("LAYERS");
+      msRequestFree(mapserv->request->ParamNames[i]);
+      mapserv->request->ParamNames[i] = msRequestStrdup("LAYERS");
     } else if(strcasecmp(mapserv->request->ParamNames[i], "VERSION") == 0) {
-      free(mapserv->request->ParamNames[i]);
-      mapserv->request->ParamNames[i] = msStrdup("VERSION");
+      msRequestFree(mapserv->request->ParamNames[i]);
+      mapserv->request->ParamNames[i] = msRequestStrdup("VERSION");
     }
   }
   if(mapserv->map->outputformat->mimetype && *mapserv->map->outputformat->mimetype) {
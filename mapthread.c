@@ -144,7 +144,8 @@ static int thread_debug = 0;
 
 static char *lock_names[] = {
   NULL, "PARSER", "GDAL", "ERROROBJ", "PROJ", "TTF", "POOL", "SDE",
-  "ORACLE", "OWS", "LAYER_VTABLE", "IOCONTEXT", "TMPFILE", "DEBUGOBJ", NULL
+  "ORACLE", "OWS", "LAYER_VTABLE", "IOCONTEXT", "TMPFILE", "DEBUGOBJ",
+  "OGR", "TIME", "FRIBIDI", "OWSCACHE", "TILECATALOG", "RESAMPLE", NULL
 };
 #endif
 
@@ -227,6 +228,59 @@ void msReleaseLock( int nLockId )
   pthread_mutex_unlock( mutex_locks + nLockId );
 }
 
+/************************************************************************/
+/*                        msThreadRunWorkers()                          */
+/*                                                                      */
+/*      Run pfnWorker(pData) on nThreads threads (the calling thread    */
+/*      being one of them) and wait for all of them to return.  The     */
+/*      worker is responsible for sharing out the work, typically by    */
+/*      pulling items from a counter protected by a lock.  Returns the  */
+/*      number of threads that actually ran the worker, which is 1 if   */
+/*      no extra thread could be started.                               */
+/************************************************************************/
+
+typedef struct {
+  void (*pfnWorker)(void *);
+  void *pData;
+} msThreadWorkerArgs;
+
+static void *msThreadWorkerStart( void *pArg )
+
+{
+  msThreadWorkerArgs *psArgs = (msThreadWorkerArgs *) pArg;
+  psArgs->pfnWorker( psArgs->pData );
+  return NULL;
+}
+
+int msThreadRunWorkers( int nThreads, void (*pfnWorker)(void *), void *pData )
+
+{
+  pthread_t *pahThreads;
+  msThreadWorkerArgs sArgs;
+  int i, nStarted = 0;
+
+  if( nThreads > 1 ) {
+    pahThreads = (pthread_t *) msSmallMalloc( sizeof(pthread_t) * (nThreads-1) );
+    sArgs.pfnWorker = pfnWorker;
+    sArgs.pData = pData;
+
+    for( i = 0; i < nThreads-1; i++ ) {
+      if( pthread_create( pahThreads + nStarted, NULL,
+                          msThreadWorkerStart, &sArgs ) == 0 )
+        nStarted++;
+    }
+
+    pfnWorker( pData );
+
+    for( i = 0; i < nStarted; i++ )
+      pthread_join( pahThreads[i], NULL );
+    free( pahThreads );
+  } else
+    pfnWorker( pData );
+
+  return nStarted + 1;
+}
+
 #endif /* defined(USE_THREAD) && !defined(_WIN32) */
 
 /************************************************************************/
@@ -315,4 +369,55 @@ void msReleaseLock( int nLockId )
   ReleaseMutex( mutex_locks[nLockId] );
 }
 
+/************************************************************************/
+/*                        msThreadRunWorkers()                          */
+/*                                                                      */
+/*      See the pthreads implementation above.                          */
+/************************************************************************/
+
+typedef struct {
+  void (*pfnWorker)(void *);
+  void *pData;
+} msThreadWorkerArgs;
+
+static DWORD WINAPI msThreadWorkerStart( LPVOID pArg )
+
+{
+  msThreadWorkerArgs *psArgs = (msThreadWorkerArgs *) pArg;
+  psArgs->pfnWorker( psArgs->pData );
+  return 0;
+}
+
+int msThreadRunWorkers( int nThreads, void (*pfnWorker)(void *), void *pData )
+
+{
+  HANDLE *pahThreads;
+  msThreadWorkerArgs sArgs;
+  int i, nStarted = 0;
+
+  if( nThreads > 1 ) {
+    pahThreads = (HANDLE *) msSmallMalloc( sizeof(HANDLE) * (nThreads-1) );
+    sArgs.pfnWorker = pfnWorker;
+    sArgs.pData = pData;
+
+    for( i = 0; i < nThreads-1; i++ ) {
+      pahThreads[nStarted] = CreateThread( NULL, 0, msThreadWorkerStart,
+                                           &sArgs, 0, NULL );
+      if( pahThreads[nStarted] != NULL )
+        nStarted++;
+    }
+
+    pfnWorker( pData );
+
+    if( nStarted > 0 )
+      WaitForMultipleObjects( nStarted, pahThreads, TRUE, INFINITE );
+    for( i = 0; i < nStarted; i++ )
+      CloseHandle( pahThreads[i] );
+    free( pahThreads );
+  } else
+    pfnWorker( pData );
+
+  return nStarted + 1;
+}
+
 #endif /* defined(USE_THREAD) && defined(_WIN32) */
@@ -39,11 +39,13 @@ extern "C" {
   int msGetThreadId(void);
   void msAcquireLock(int);
   void msReleaseLock(int);
+  int msThreadRunWorkers(int nThreads, void (*pfnWorker)(void *), void *pData);
 #else
 #define msThreadInit()
 #define msGetThreadId() (0)
 #define msAcquireLock(x)
 #define msReleaseLock(x)
+#define msThreadRunWorkers(n,pfn,data) ((pfn)(data), 1)
 #endif
 
   /*
@@ -67,6 +69,9 @@ extern "C" {
 #define TLOCK_OGR       14
 #define TLOCK_TIME      15
 #define TLOCK_FRIBIDI   16
+#define TLOCK_OWSCACHE  17
+#define TLOCK_TILECATALOG 18
+#define TLOCK_RESAMPLE  19
 
 #define TLOCK_STATIC_MAX 20
 #define TLOCK_MAX       100
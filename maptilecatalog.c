@@ -0,0 +1,523 @@
+/******************************************************************************
+ * $Id$
+ *
+ * Project:  MapServer
+ * Purpose:  In-memory catalog of raster tile index shapefiles.
+ * Author:   MapServer team.
+ *
+ ******************************************************************************
+ * Copyright (c) 2013 Regents of the University of Minnesota.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies of this Software or works derived from this Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ ****************************************************************************/
+
+/*
+** Raster layers with a TILEINDEX shapefile used to open the index as a
+** temporary layer on every draw or query, and then walk the matching
+** shapes through the .qix and the DBF. For large mosaics that is a
+** noticeable part of the request.
+**
+** Instead, the bounds and tile names of the index are read once per
+** process into a tile catalog. The bounds are kept in a packed R-tree:
+** the tiles are sorted into STR (sort-tile-recursive) order and grouped
+** by MS_TILE_CATALOG_FANOUT into parent nodes, level after level, up to
+** a single root. The tile names are stored back to back in one buffer.
+** A search returns the matching tile records in tile index order, so
+** tiles are still drawn in the same order as before and overlaps are
+** composited the same way.
+**
+** Catalogs are shared between threads. They are read only once built,
+** and a reference count keeps one alive while it is in use. A catalog is
+** rebuilt when the modification time or size of the .shp or .dbf
+** changes. Only tile indexes that are plain files without a FILTER are
+** cataloged, and PROCESSING "TILEINDEX_CATALOG=OFF" disables the catalog
+** for a layer.
+*/
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <ctype.h>
+
+#include "mapserver.h"
+#include "mapthread.h"
+
+#define MS_TILE_CATALOG_FANOUT 16
+#define MS_TILE_CATALOG_MAX 16
+
+struct tileCatalogObj {
+  char *key; /* tile index path and tile item */
+
+  time_t shp_mtime, dbf_mtime;
+  long shp_size, dbf_size;
+
+  int numrecords;
+  int *pathoffset; /* per record, into paths, -1 for null shapes */
+  char *paths;
+
+  int numtiles; /* non null records */
+  rectObj *bounds; /* per tile, in STR order */
+  int *record; /* per tile, record number in the tile index */
+  int *tile; /* per record, index into bounds, -1 for null shapes */
+
+  int numlevels;
+  int *levelstart; /* per level, index of its first node in nodes */
+  int *levelcount;
+  rectObj *nodes; /* level 0 groups the tiles, the last level is the root */
+
+  int refcount;
+  int stale; /* free once the last reference is released */
+  unsigned long last_used;
+};
+
+/*
+** These static structures are protected by the TLOCK_TILECATALOG mutex.
+*/
+static tileCatalogObj *tileCatalogs[MS_TILE_CATALOG_MAX];
+static int tileCatalogCount = 0;
+static unsigned long tileCatalogTick = 0;
+
+typedef struct {
+  double cx, cy;
+  rectObj bounds;
+  int record;
+} tileCatalogSortItem;
+
+static int cmpTileCenterX(const void *a, const void *b)
+{
+  double d = ((tileCatalogSortItem *)a)->cx - ((tileCatalogSortItem *)b)->cx;
+  return (d < 0) ? -1 : (d > 0) ? 1 : 0;
+}
+
+static int cmpTileCenterY(const void *a, const void *b)
+{
+  double d = ((tileCatalogSortItem *)a)->cy - ((tileCatalogSortItem *)b)->cy;
+  return (d < 0) ? -1 : (d > 0) ? 1 : 0;
+}
+
+static int cmpTileRecord(const void *a, const void *b)
+{
+  return *((int *)a) - *((int *)b);
+}
+
+static void msFreeTileCatalog(tileCatalogObj *catalog)
+{
+  if(!catalog) return;
+  msFree(catalog->key);
+  msFree(catalog->pathoffset);
+  msFree(catalog->paths);
+  msFree(catalog->bounds);
+  msFree(catalog->record);
+  msFree(catalog->tile);
+  msFree(catalog->levelstart);
+  msFree(catalog->levelcount);
+  msFree(catalog->nodes);
+  free(catalog);
+}
+
+/*
+** Stat base.ext or base.EXT, the way msSHPOpen() looks for the files.
+*/
+static int msTileCatalogStat(const char *base, const char *ext, time_t *mtime, long *size)
+{
+  char path[MS_MAXPATHLEN];
+  struct stat st;
+  int i;
+
+  snprintf(path, sizeof(path), "%s.%s", base, ext);
+  if(stat(path, &st) != 0) {
+    for(i=strlen(base)+1; path[i] != '\0'; i++)
+      path[i] = toupper(path[i]);
+    if(stat(path, &st) != 0)
+      return MS_FAILURE;
+  }
+
+  *mtime = st.st_mtime;
+  *size = (long) st.st_size;
+  return MS_SUCCESS;
+}
+
+/*
+** Build the packed R-tree over the tiles, which are sorted in STR order
+** on the way.
+*/
+static void msTileCatalogBuildTree(tileCatalogObj *catalog, tileCatalogSortItem *items)
+{
+  int i, j, n, numslices, slicesize, numnodes, level;
+
+  /* sort-tile-recursive: slices along x, then along y within a slice */
+  n = catalog->numtiles;
+  qsort(items, n, sizeof(tileCatalogSortItem), cmpTileCenterX);
+  numslices = (int) ceil(sqrt(ceil((double) n / MS_TILE_CATALOG_FANOUT)));
+  slicesize = numslices * MS_TILE_CATALOG_FANOUT;
+  for(i=0; i<n; i+=slicesize)
+    qsort(items+i, MS_MIN(slicesize, n-i), sizeof(tileCatalogSortItem), cmpTileCenterY);
+
+  for(i=0; i<n; i++) {
+    catalog->bounds[i] = items[i].bounds;
+    catalog->record[i] = items[i].record;
+    catalog->tile[items[i].record] = i;
+  }
+
+  /* count the nodes of all levels */
+  numnodes = 0;
+  catalog->numlevels = 0;
+  for(n=catalog->numtiles; ; ) {
+    n = (n + MS_TILE_CATALOG_FANOUT - 1) / MS_TILE_CATALOG_FANOUT;
+    numnodes += n;
+    catalog->numlevels++;
+    if(n <= 1) break;
+  }
+
+  catalog->levelstart = (int *) msSmallMalloc(sizeof(int)*catalog->numlevels);
+  catalog->levelcount = (int *) msSmallMalloc(sizeof(int)*catalog->numlevels);
+  catalog->nodes = (rectObj *) msSmallMalloc(sizeof(rectObj)*numnodes);
+
+  numnodes = 0;
+  n = catalog->numtiles;
+  for(level=0; level<catalog->numlevels; level++) {
+    rectObj *children = (level == 0) ? catalog->bounds : catalog->nodes + catalog->levelstart[level-1];
+    int count = (n + MS_TILE_CATALOG_FANOUT - 1) / MS_TILE_CATALOG_FANOUT;
+
+    catalog->levelstart[level] = numnodes;
+    catalog->levelcount[level] = count;
+    for(i=0; i<count; i++) {
+      rectObj *node = catalog->nodes + numnodes + i;
+      *node = children[i*MS_TILE_CATALOG_FANOUT];
+      for(j=i*MS_TILE_CATALOG_FANOUT+1; j<MS_MIN((i+1)*MS_TILE_CATALOG_FANOUT, n); j++) {
+        node->minx = MS_MIN(node->minx, children[j].minx);
+        node->miny = MS_MIN(node->miny, children[j].miny);
+        node->maxx = MS_MAX(node->maxx, children[j].maxx);
+        node->maxy = MS_MAX(node->maxy, children[j].maxy);
+      }
+    }
+    numnodes += count;
+    n = count;
+  }
+}
+
+/*
+** Read the tile index shapefile into a new catalog.
+*/
+static tileCatalogObj *msTileCatalogLoad(layerObj *layer, const char *key, char *path,
+    time_t shp_mtime, long shp_size, time_t dbf_mtime, long dbf_size)
+{
+  shapefileObj shpfile;
+  tileCatalogObj *catalog;
+  tileCatalogSortItem *items;
+  int i, itemindex, pathsize = 0, pathmax = 0;
+
+  if(msShapefileOpen(&shpfile, "rb", path, MS_FALSE) == -1)
+    return NULL;
+
+  itemindex = msDBFGetItemIndex(shpfile.hDBF, layer->tileitem);
+  if(itemindex == -1) {
+    msShapefileClose(&shpfile);
+    return NULL;
+  }
+
+  catalog = (tileCatalogObj *) msSmallCalloc(1, sizeof(tileCatalogObj));
+  catalog->key = msStrdup(key);
+  catalog->shp_mtime = shp_mtime;
+  catalog->shp_size = shp_size;
+  catalog->dbf_mtime = dbf_mtime;
+  catalog->dbf_size = dbf_size;
+  catalog->numrecords = shpfile.numshapes;
+  catalog->pathoffset = (int *) msSmallMalloc(sizeof(int)*MS_MAX(shpfile.numshapes,1));
+  catalog->tile = (int *) msSmallMalloc(sizeof(int)*MS_MAX(shpfile.numshapes,1));
+  items = (tileCatalogSortItem *) msSmallMalloc(sizeof(tileCatalogSortItem)*MS_MAX(shpfile.numshapes,1));
+
+  for(i=0; i<shpfile.numshapes; i++) {
+    rectObj bounds;
+    const char *value;
+    int length;
+
+    catalog->pathoffset[i] = -1;
+    catalog->tile[i] = -1;
+    if(msSHPReadBounds(shpfile.hSHP, i, &bounds) != MS_SUCCESS)
+      continue; /* null shape, never returned by msSHPLayerNextShape() either */
+
+    value = msDBFReadStringAttribute(shpfile.hDBF, i, itemindex);
+    if(value == NULL) {
+      msFree(items);
+      msFreeTileCatalog(catalog);
+      msShapefileClose(&shpfile);
+      return NULL;
+    }
+
+    length = strlen(value) + 1;
+    if(pathsize + length > pathmax) {
+      pathmax = MS_MAX(pathmax*2, pathsize + length + 1024);
+      catalog->paths = (char *) msSmallRealloc(catalog->paths, pathmax);
+    }
+    memcpy(catalog->paths + pathsize, value, length);
+    catalog->pathoffset[i] = pathsize;
+    pathsize += length;
+
+    items[catalog->numtiles].bounds = bounds;
+    items[catalog->numtiles].cx = (bounds.minx + bounds.maxx) / 2.0;
+    items[catalog->numtiles].cy = (bounds.miny + bounds.maxy) / 2.0;
+    items[catalog->numtiles].record = i;
+    catalog->numtiles++;
+  }
+  msShapefileClose(&shpfile);
+
+  catalog->bounds = (rectObj *) msSmallMalloc(sizeof(rectObj)*MS_MAX(catalog->numtiles,1));
+  catalog->record = (int *) msSmallMalloc(sizeof(int)*MS_MAX(catalog->numtiles,1));
+  if(catalog->numtiles > 0)
+    msTileCatalogBuildTree(catalog, items);
+  msFree(items);
+
+  if(layer->debug)
+    msDebug("msTileCatalogLoad(%s): %d tiles from %s\n", layer->name, catalog->numtiles, path);
+
+  return catalog;
+}
+
+/************************************************************************/
+/*                         msTileCatalogAcquire()                       */
+/*                                                                      */
+/*      Return the catalog for the tile index of a raster layer,        */
+/*      loading it if needed, or NULL if the layer's tile index         */
+/*      can't be cataloged (the caller then uses the tile index as a    */
+/*      layer as usual). Release it with msTileCatalogRelease().        */
+/************************************************************************/
+tileCatalogObj *msTileCatalogAcquire(layerObj *layer)
+{
+  char path[MS_MAXPATHLEN], base[MS_MAXPATHLEN], *key, *ext;
+  const char *setting;
+  time_t shp_mtime, dbf_mtime;
+  long shp_size, dbf_size;
+  tileCatalogObj *catalog = NULL, *stale = NULL;
+  int i;
+
+  if(!layer->tileindex || !layer->tileitem || !layer->map)
+    return NULL;
+  if(layer->filter.string || layer->filteritem)
+    return NULL; /* the filter applies to the tile index */
+  if(msGetLayerIndex(layer->map, layer->tileindex) != -1)
+    return NULL; /* tile index is a layer, it may be anything */
+
+  setting = msLayerGetProcessingKey(layer, "TILEINDEX_CATALOG");
+  if(setting && strcasecmp(setting, "OFF") == 0)
+    return NULL;
+
+  /* same path resolution as msSHPLayerOpen() */
+  for(i=0; i<2; i++) {
+    if(i == 0)
+      msBuildPath3(path, layer->map->mappath, layer->map->shapepath, layer->tileindex);
+    else
+      msBuildPath(path, layer->map->mappath, layer->tileindex);
+
+    strlcpy(base, path, sizeof(base));
+    ext = strrchr(base, '.');
+    if(ext && strlen(ext) == 4 && strcasecmp(ext, ".shp") == 0)
+      *ext = '\0';
+
+    if(msTileCatalogStat(base, "shp", &shp_mtime, &shp_size) == MS_SUCCESS
+        && msTileCatalogStat(base, "dbf", &dbf_mtime, &dbf_size) == MS_SUCCESS)
+      break;
+  }
+  if(i == 2)
+    return NULL; /* let the regular code report the error */
+
+  key = (char *) msSmallMalloc(strlen(path) + strlen(layer->tileitem) + 2);
+  sprintf(key, "%s|%s", path, layer->tileitem);
+
+  msAcquireLock(TLOCK_TILECATALOG);
+  for(i=0; i<tileCatalogCount; i++) {
+    if(strcasecmp(tileCatalogs[i]->key, key) != 0)
+      continue;
+    if(tileCatalogs[i]->shp_mtime == shp_mtime && tileCatalogs[i]->shp_size == shp_size
+        && tileCatalogs[i]->dbf_mtime == dbf_mtime && tileCatalogs[i]->dbf_size == dbf_size) {
+      catalog = tileCatalogs[i];
+      catalog->refcount++;
+      catalog->last_used = ++tileCatalogTick;
+    } else {
+      /* the tile index changed, drop the old catalog */
+      stale = tileCatalogs[i];
+      tileCatalogs[i] = tileCatalogs[--tileCatalogCount];
+      if(stale->refcount > 0) {
+        stale->stale = MS_TRUE;
+        stale = NULL;
+      }
+    }
+    break;
+  }
+  msReleaseLock(TLOCK_TILECATALOG);
+
+  msFreeTileCatalog(stale);
+  if(catalog) {
+    free(key);
+    return catalog;
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Load it, outside of the lock. Two threads may both load the     */
+  /*      same catalog, in which case the second one is not kept.         */
+  /* -------------------------------------------------------------------- */
+  catalog = msTileCatalogLoad(layer, key, path, shp_mtime, shp_size, dbf_mtime, dbf_size);
+  free(key);
+  if(!catalog)
+    return NULL; /* the regular code path will run into the same problem */
+  catalog->refcount = 1;
+
+  msAcquireLock(TLOCK_TILECATALOG);
+  for(i=0; i<tileCatalogCount; i++) {
+    if(strcasecmp(tileCatalogs[i]->key, catalog->key) == 0)
+      break;
+  }
+  if(i == tileCatalogCount) {
+    if(tileCatalogCount == MS_TILE_CATALOG_MAX) {
+      int lru = -1;
+      for(i=0; i<tileCatalogCount; i++) {
+        if(lru == -1 || tileCatalogs[i]->last_used < tileCatalogs[lru]->last_used)
+          lru = i;
+      }
+      stale = tileCatalogs[lru];
+      tileCatalogs[lru] = tileCatalogs[--tileCatalogCount];
+      if(stale->refcount > 0) {
+        stale->stale = MS_TRUE;
+        stale = NULL;
+      }
+    }
+    catalog->last_used = ++tileCatalogTick;
+    tileCatalogs[tileCatalogCount++] = catalog;
+  } else
+    catalog->stale = MS_TRUE; /* someone beat us to it */
+  msReleaseLock(TLOCK_TILECATALOG);
+
+  msFreeTileCatalog(stale);
+
+  return catalog;
+}
+
+/************************************************************************/
+/*                         msTileCatalogRelease()                       */
+/************************************************************************/
+void msTileCatalogRelease(tileCatalogObj *catalog)
+{
+  int freeit;
+
+  if(!catalog) return;
+
+  msAcquireLock(TLOCK_TILECATALOG);
+  catalog->refcount--;
+  freeit = (catalog->refcount == 0 && catalog->stale);
+  msReleaseLock(TLOCK_TILECATALOG);
+
+  if(freeit)
+    msFreeTileCatalog(catalog);
+}
+
+/************************************************************************/
+/*                         msTileCatalogSearch()                        */
+/*                                                                      */
+/*      Find the tiles overlapping rect. The matching record numbers    */
+/*      are returned in *records in increasing order (the caller        */
+/*      frees them), along with their count.                            */
+/************************************************************************/
+int msTileCatalogSearch(tileCatalogObj *catalog, rectObj rect, int **records)
+{
+  int *stack, *stacklevel, depth = 0, numrecords = 0, maxrecords = 64, i;
+
+  *records = NULL;
+  if(catalog->numtiles == 0)
+    return 0;
+
+  *records = (int *) msSmallMalloc(sizeof(int)*maxrecords);
+  stack = (int *) msSmallMalloc(sizeof(int)*(catalog->numlevels+1)*MS_TILE_CATALOG_FANOUT);
+  stacklevel = (int *) msSmallMalloc(sizeof(int)*(catalog->numlevels+1)*MS_TILE_CATALOG_FANOUT);
+
+  /* the root */
+  stack[depth] = 0;
+  stacklevel[depth++] = catalog->numlevels - 1;
+
+  while(depth > 0) {
+    int node = stack[--depth], level = stacklevel[depth];
+
+    if(level < 0) { /* a tile */
+      if(msRectOverlap(&(catalog->bounds[node]), &rect) != MS_TRUE)
+        continue;
+      if(numrecords == maxrecords) {
+        maxrecords *= 2;
+        *records = (int *) msSmallRealloc(*records, sizeof(int)*maxrecords);
+      }
+      (*records)[numrecords++] = catalog->record[node];
+      continue;
+    }
+
+    if(msRectOverlap(&(catalog->nodes[catalog->levelstart[level] + node]), &rect) != MS_TRUE)
+      continue;
+
+    /* push the children */
+    for(i=node*MS_TILE_CATALOG_FANOUT;
+        i<MS_MIN((node+1)*MS_TILE_CATALOG_FANOUT, (level == 0) ? catalog->numtiles : catalog->levelcount[level-1]);
+        i++) {
+      stack[depth] = i;
+      stacklevel[depth++] = level - 1;
+    }
+  }
+
+  free(stack);
+  free(stacklevel);
+
+  /* keep the tile index order, it is the drawing order */
+  qsort(*records, numrecords, sizeof(int), cmpTileRecord);
+
+  return numrecords;
+}
+
+/************************************************************************/
+/*                         msTileCatalogGetPath()                       */
+/************************************************************************/
+const char *msTileCatalogGetPath(tileCatalogObj *catalog, int record)
+{
+  if(record < 0 || record >= catalog->numrecords || catalog->pathoffset[record] < 0)
+    return "";
+  return catalog->paths + catalog->pathoffset[record];
+}
+
+/************************************************************************/
+/*                         msTileCatalogGetBounds()                     */
+/************************************************************************/
+int msTileCatalogGetBounds(tileCatalogObj *catalog, int record, rectObj *bounds)
+{
+  if(record < 0 || record >= catalog->numrecords || catalog->tile[record] < 0)
+    return MS_FAILURE;
+  *bounds = catalog->bounds[catalog->tile[record]];
+  return MS_SUCCESS;
+}
+
+/************************************************************************/
+/*                         msTileCatalogCleanup()                       */
+/************************************************************************/
+void msTileCatalogCleanup(void)
+{
+  int i;
+
+  msAcquireLock(TLOCK_TILECATALOG);
+  for(i=0; i<tileCatalogCount; i++) {
+    if(tileCatalogs[i]->refcount > 0)
+      tileCatalogs[i]->stale = MS_TRUE;
+    else
+      msFreeTileCatalog(tileCatalogs[i]);
+  }
+  tileCatalogCount = 0;
+  msReleaseLock(TLOCK_TILECATALOG);
+}
@@ -1870,6 +1870,9 @@ void msCleanup(int signal)
 {
   msForceTmpFileBase( NULL );
   msConnPoolFinalCleanup();
+  msOWSCapabilitiesCacheCleanup();
+  msTileCatalogCleanup();
+  msRasterQueryCacheCleanup();
   /* Lexer string parsing variable */
   if (msyystring_buffer != NULL) {
     msFree(msyystring_buffer);
@@ -1887,6 +1890,7 @@ void msCleanup(int signal)
 #  if PJ_VERSION >= 480
   pj_clear_initcache();
 #  endif
+  msProjectionPoolCleanup();
   pj_deallocate_grids();
   msSetPROJ_LIB( NULL, NULL );
 #endif
@@ -2267,6 +2271,212 @@ void *msSmallCalloc( size_t nCount, size_t nSize )
   return pReturn;
 }
 
+
+/************************************************************************/
+/*                        Request scoped arenas                         */
+/*                                                                      */
+/*      A simple bump allocator used to hold the many small, short      */
+/*      lived allocations made while servicing one request (CGI         */
+/*      parameters mostly).  Memory is handed out from large blocks     */
+/*      and released all at once with msArenaReset(), which avoids      */
+/*      per-allocation overhead and heap fragmentation in long lived    */
+/*      FastCGI processes.                                              */
+/*                                                                      */
+/*      The "request arena" is a process wide setting and is only       */
+/*      meant to be installed by single threaded front ends such as     */
+/*      mapserv.  When no request arena is installed the msRequest*()   */
+/*      functions fall back to the regular heap.                        */
+/************************************************************************/
+
+#define MS_ARENA_ALIGN 16
+#define MS_ARENA_ROUNDUP(n) (((n) + MS_ARENA_ALIGN - 1) & ~((size_t)MS_ARENA_ALIGN - 1))
+#define MS_ARENA_DEFAULT_BLOCKSIZE 65536
+
+typedef struct msArenaBlock {
+  struct msArenaBlock *next;
+  size_t size;  /* usable bytes in this block */
+  size_t used;
+} msArenaBlock;
+
+struct msArenaObj {
+  msArenaBlock *blocks; /* current block first, older blocks follow */
+  size_t blocksize;
+};
+
+#define MS_ARENA_BLOCK_HEADER MS_ARENA_ROUNDUP(sizeof(msArenaBlock))
+#define MS_ARENA_BLOCK_DATA(b) (((unsigned char *)(b)) + MS_ARENA_BLOCK_HEADER)
+
+static msArenaObj *requestArena = NULL;
+
+static msArenaBlock *msArenaNewBlock(size_t size)
+{
+  msArenaBlock *block = (msArenaBlock *) msSmallMalloc(MS_ARENA_BLOCK_HEADER + size);
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+  return block;
+}
+
+/*
+** Create a new arena. A blocksize of 0 selects the default.
+*/
+msArenaObj *msArenaCreate(size_t blocksize)
+{
+  msArenaObj *arena = (msArenaObj *) msSmallMalloc(sizeof(msArenaObj));
+
+  arena->blocksize = (blocksize > 0) ? MS_ARENA_ROUNDUP(blocksize) : MS_ARENA_DEFAULT_BLOCKSIZE;
+  arena->blocks = msArenaNewBlock(arena->blocksize);
+
+  return arena;
+}
+
+void *msArenaAlloc(msArenaObj *arena, size_t nSize)
+{
+  msArenaBlock *block;
+
+  if(nSize == 0)
+    return NULL;
+
+  nSize = MS_ARENA_ROUNDUP(nSize);
+
+  /* large requests get a block of their own, placed behind the current */
+  /* one so that the remaining space in the current block isn't wasted  */
+  if(nSize > arena->blocksize / 4) {
+    block = msArenaNewBlock(nSize);
+    block->used = nSize;
+    block->next = arena->blocks->next;
+    arena->blocks->next = block;
+    return MS_ARENA_BLOCK_DATA(block);
+  }
+
+  block = arena->blocks;
+  if(block->size - block->used < nSize) {
+    block = msArenaNewBlock(arena->blocksize);
+    block->next = arena->blocks;
+    arena->blocks = block;
+  }
+
+  block->used += nSize;
+  return MS_ARENA_BLOCK_DATA(block) + block->used - nSize;
+}
+
+void *msArenaCalloc(msArenaObj *arena, size_t nCount, size_t nSize)
+{
+  void *p = msArenaAlloc(arena, nCount * nSize);
+  if(p) memset(p, 0, nCount * nSize);
+  return p;
+}
+
+char *msArenaStrdup(msArenaObj *arena, const char *pszString)
+{
+  size_t len;
+  char *pszReturn;
+
+  if(pszString == NULL)
+    pszString = "";
+
+  len = strlen(pszString) + 1;
+  pszReturn = (char *) msArenaAlloc(arena, len);
+  memcpy(pszReturn, pszString, len);
+
+  return pszReturn;
+}
+
+/*
+** Returns MS_TRUE if the pointer was handed out by this arena.
+*/
+int msArenaOwns(msArenaObj *arena, const void *p)
+{
+  msArenaBlock *block;
+
+  if(arena == NULL || p == NULL)
+    return MS_FALSE;
+
+  for(block = arena->blocks; block; block = block->next) {
+    const unsigned char *data = MS_ARENA_BLOCK_DATA(block);
+    if((const unsigned char *) p >= data && (const unsigned char *) p < data + block->size)
+      return MS_TRUE;
+  }
+
+  return MS_FALSE;
+}
+
+/*
+** Release everything allocated from the arena, keeping one block around
+** for the next request.
+*/
+void msArenaReset(msArenaObj *arena)
+{
+  msArenaBlock *block, *next, *keep = NULL;
+
+  for(block = arena->blocks; block; block = next) {
+    next = block->next;
+    if(keep == NULL && block->size == arena->blocksize)
+      keep = block;
+    else
+      free(block);
+  }
+
+  if(keep == NULL)
+    keep = msArenaNewBlock(arena->blocksize);
+
+  keep->next = NULL;
+  keep->used = 0;
+  arena->blocks = keep;
+}
+
+void msArenaDestroy(msArenaObj *arena)
+{
+  msArenaBlock *block, *next;
+
+  if(arena == NULL)
+    return;
+
+  if(requestArena == arena)
+    requestArena = NULL;
+
+  for(block = arena->blocks; block; block = next) {
+    next = block->next;
+    free(block);
+  }
+  free(arena);
+}
+
+void msSetRequestArena(msArenaObj *arena)
+{
+  requestArena = arena;
+}
+
+msArenaObj *msGetRequestArena()
+{
+  return requestArena;
+}
+
+/*
+** Allocate memory with request lifetime. Memory obtained here must be
+** released with msRequestFree(), never with free().
+*/
+void *msRequestMalloc(size_t nSize)
+{
+  if(requestArena)
+    return msArenaAlloc(requestArena, nSize);
+  return msSmallMalloc(nSize);
+}
+
+char *msRequestStrdup(const char *pszString)
+{
+  if(requestArena)
+    return msArenaStrdup(requestArena, pszString);
+  return msStrdup(pszString);
+}
+
+void msRequestFree(void *p)
+{
+  if(p == NULL || msArenaOwns(requestArena, p))
+    return; /* released when the arena is reset */
+  free(p);
+}
+
 /*
 ** msBuildOnlineResource()
 **
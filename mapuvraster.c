@@ -54,6 +54,9 @@
 #define RQM_HIST_ON_CLASS         2
 #define RQM_HIST_ON_VALUE         3
 
+/* at most this many samples per axis are read for each vector cell */
+#define MSUVRASTER_MAX_OVERSAMPLE  4
+
 typedef struct {
 
   /* query cache results */
@@ -76,13 +79,14 @@ typedef struct {
 
   /* double   shape_tolerance; */
 
-  float **u; /* u values */
-  float **v; /* v values */
+  float *u; /* u values, of cell x,y at x*height+y */
+  float *v; /* v values */
+  int *cells; /* cell of each non null vector, in shape order */
   int width;
   int height;
   rectObj extent;
   int     next_shape;
-  int x, y; /* used internally in msUVRasterLayerNextShape() */
+  float   size_scale; /* UV_SIZE_SCALE */
 
 } uvRasterLayerInfo;
 
@@ -180,25 +184,13 @@ static void msUVRasterLayerInfoFree( layerObj *layer )
 
 {
   uvRasterLayerInfo *uvlinfo = (uvRasterLayerInfo *) layer->layerinfo;
-  int i;
 
   if( uvlinfo == NULL )
     return;
 
-  if (uvlinfo->u) {
-    for (i=0; i<uvlinfo->width; ++i) {
-      free(uvlinfo->u[i]);
-    }
-    free(uvlinfo->u);
-  }
-
-  if (uvlinfo->v) {
-    for (i=0; i<uvlinfo->width; ++i) {
-      free(uvlinfo->v[i]);
-    }
-    free(uvlinfo->v);
-  }
-
+  free( uvlinfo->u );
+  free( uvlinfo->v );
+  free( uvlinfo->cells );
   free( uvlinfo );
 
   layer->layerinfo = NULL;
@@ -267,12 +259,15 @@ int msUVRASTERLayerGetItems(layerObj *layer)
  * Special attribute names are used to return some UV params: uv_angle,
  * uv_length, u and v.
  **********************************************************************/
-static char **msUVRASTERGetValues(layerObj *layer, float *u, float *v)
+static char **msUVRASTERGetValues(layerObj *layer, float u, float v)
 {
+  uvRasterLayerInfo *uvlinfo = (uvRasterLayerInfo *) layer->layerinfo;
   char **values;
   int i = 0;
   char tmp[100];
-  float size_scale;
+  double angle = 0.0;
+  float length = 0.0;
+  int have_angle = MS_FALSE, have_length = MS_FALSE;
   int *itemindexes = (int*)layer->iteminfo;
 
   if(layer->numitems == 0)
@@ -281,6 +276,7 @@ static char **msUVRASTERGetValues(layerObj *layer, float *u, float *v)
   if(!layer->iteminfo)  /* Should not happen... but just in case! */
     if (msUVRASTERLayerInitItemInfo(layer) != MS_SUCCESS)
       return NULL;
+  itemindexes = (int*)layer->iteminfo;
 
   if((values = (char **)malloc(sizeof(char *)*layer->numitems)) == NULL) {
     msSetError(MS_MEMERR, NULL, "msUVRASTERGetValues()");
@@ -288,40 +284,41 @@ static char **msUVRASTERGetValues(layerObj *layer, float *u, float *v)
   }
 
   /* -------------------------------------------------------------------- */
-  /*    Determine desired size_scale.  Default to 1 if not otherwise set  */
+  /*      Only the requested items are computed, angle and length at      */
+  /*      most once.                                                      */
   /* -------------------------------------------------------------------- */
-  size_scale = 1;
-  if( CSLFetchNameValue( layer->processing, "UV_SIZE_SCALE" ) != NULL ) {
-    size_scale =
-      atof(CSLFetchNameValue( layer->processing, "UV_SIZE_SCALE" ));
-  }
-
   for(i=0; i<layer->numitems; i++) {
+    if ( (itemindexes[i] == MSUVRASTER_ANGLEINDEX ||
+          itemindexes[i] == MSUVRASTER_MINUSANGLEINDEX) && !have_angle ) {
+      angle = atan2((double)v, (double)u) * 180 / MS_PI;
+      have_angle = MS_TRUE;
+    } else if ( (itemindexes[i] == MSUVRASTER_LENGTHINDEX ||
+                 itemindexes[i] == MSUVRASTER_LENGTH2INDEX) && !have_length ) {
+      length = sqrt((u*u)+(v*v))*uvlinfo->size_scale;
+      have_length = MS_TRUE;
+    }
+
     if (itemindexes[i] == MSUVRASTER_ANGLEINDEX) {
-      snprintf(tmp, 100, "%f", (atan2((double)*v, (double)*u) * 180 / MS_PI));
+      snprintf(tmp, 100, "%f", angle);
       values[i] = msStrdup(tmp);
     } else if (itemindexes[i] == MSUVRASTER_MINUSANGLEINDEX) {
       double minus_angle;
-      minus_angle = (atan2((double)*v, (double)*u) * 180 / MS_PI)+180;
+      minus_angle = angle+180;
       if (minus_angle >= 360)
         minus_angle -= 360;
       snprintf(tmp, 100, "%f", minus_angle);
       values[i] = msStrdup(tmp);
-    } else if ( (itemindexes[i] == MSUVRASTER_LENGTHINDEX) ||
-                (itemindexes[i] == MSUVRASTER_LENGTH2INDEX) ) {
-      float length = sqrt((*u**u)+(*v**v))*size_scale;
-
-      if (itemindexes[i] == MSUVRASTER_LENGTHINDEX)
-        snprintf(tmp, 100, "%f", length);
-      else
-        snprintf(tmp, 100, "%f", length/2);
-
+    } else if (itemindexes[i] == MSUVRASTER_LENGTHINDEX) {
+      snprintf(tmp, 100, "%f", length);
+      values[i] = msStrdup(tmp);
+    } else if (itemindexes[i] == MSUVRASTER_LENGTH2INDEX) {
+      snprintf(tmp, 100, "%f", length/2);
       values[i] = msStrdup(tmp);
     } else if (itemindexes[i] == MSUVRASTER_UINDEX) {
-      snprintf(tmp, 100, "%f",*u);
+      snprintf(tmp, 100, "%f",u);
       values[i] = msStrdup(tmp);
     } else if (itemindexes[i] == MSUVRASTER_VINDEX) {
-      snprintf(tmp, 100, "%f",*v);
+      snprintf(tmp, 100, "%f",v);
       values[i] = msStrdup(tmp);
     }
   }
@@ -329,16 +326,241 @@ static char **msUVRASTERGetValues(layerObj *layer, float *u, float *v)
   return values;
 }
 
+/**********************************************************************
+ *                     msUVRASTERLoadDirect()
+ *
+ * Fill u and v (x*height+y) for the vector grid described by map_tmp
+ * straight from the bands, with a single decimated read of at most
+ * MSUVRASTER_MAX_OVERSAMPLE samples per cell and axis, averaged over
+ * each cell like RESAMPLE=AVERAGE does.  Returns MS_DONE if the layer
+ * needs the general raster drawing path (tile index, non AVERAGE
+ * resampling, rotated or flipped rasters...).
+ **********************************************************************/
+static int msUVRASTERLoadDirect(layerObj *layer, mapObj *map_tmp,
+                                int width, int height, float *u, float *v)
+{
+  mapObj *map = layer->map;
+  const char *resample = CSLFetchNameValue( layer->processing, "RESAMPLE" );
+  char szPath[MS_MAXPATHLEN], *decrypted_path;
+  GDALDatasetH hDS;
+  double adfSrcGT[6], *adfDstGT = map_tmp->gt.geotransform;
+  double dfX0, dfX1, dfY0, dfY1, dfXScale, dfYScale;
+  double adfNoData[2];
+  int bGotNoData[2], *panBands, nBands = 0, status = MS_SUCCESS;
+  int nXOff, nYOff, nXSize, nYSize, nBufXSize, nBufYSize, x, y, i;
+  float *pafBuf;
+
+  if( layer->tileindex != NULL || layer->data == NULL || layer->mask != NULL
+      || (resample != NULL && !EQUAL(resample,"AVERAGE"))
+      || adfDstGT[2] != 0.0 || adfDstGT[4] != 0.0 )
+    return MS_DONE;
+
+  msTryBuildPath3(szPath, map->mappath, map->shapepath, layer->data);
+  decrypted_path = msDecryptStringTokens( map, szPath );
+  if( decrypted_path == NULL )
+    return MS_FAILURE;
+
+  msGDALInitialize();
+  msAcquireLock( TLOCK_GDAL );
+  hDS = msGDALOpenDataset( layer, decrypted_path );
+  msFree( decrypted_path );
+  if( hDS == NULL ) {
+    /* let the general path report it, or ignore it, as configured */
+    msReleaseLock( TLOCK_GDAL );
+    return MS_DONE;
+  }
+
+  msGetGDALGeoTransform( hDS, map, layer, adfSrcGT );
+  panBands = msGetGDALBandList( layer, hDS, 2, &nBands );
+
+  if( adfSrcGT[2] != 0.0 || adfSrcGT[4] != 0.0
+      || adfSrcGT[1] <= 0.0 || adfSrcGT[5] >= 0.0
+      || panBands == NULL || nBands != 2 ) {
+    msFree( panBands );
+    msGDALReleaseDataset( layer, hDS );
+    msReleaseLock( TLOCK_GDAL );
+    return MS_DONE;
+  }
+
+  for( i = 0; i < 2; i++ )
+    adfNoData[i] = msGetGDALNoDataValue( layer,
+                                         GDALGetRasterBand( hDS, panBands[i] ),
+                                         &bGotNoData[i] );
+
+  /* -------------------------------------------------------------------- */
+  /*      Source pixel window covered by the grid, clipped to the file.   */
+  /* -------------------------------------------------------------------- */
+  dfX0 = (adfDstGT[0] - adfSrcGT[0]) / adfSrcGT[1];
+  dfX1 = (adfDstGT[0] + width * adfDstGT[1] - adfSrcGT[0]) / adfSrcGT[1];
+  dfY0 = (adfDstGT[3] - adfSrcGT[3]) / adfSrcGT[5];
+  dfY1 = (adfDstGT[3] + height * adfDstGT[5] - adfSrcGT[3]) / adfSrcGT[5];
+
+  nXOff = (int) MAX(0, floor(dfX0));
+  nYOff = (int) MAX(0, floor(dfY0));
+  nXSize = (int) MIN(GDALGetRasterXSize(hDS), ceil(dfX1)) - nXOff;
+  nYSize = (int) MIN(GDALGetRasterYSize(hDS), ceil(dfY1)) - nYOff;
+
+  if( nXSize <= 0 || nYSize <= 0 ) {
+    msFree( panBands );
+    msGDALReleaseDataset( layer, hDS );
+    msReleaseLock( TLOCK_GDAL );
+    return MS_SUCCESS;
+  }
+
+  /* never more than the file resolution */
+  nBufXSize = (int) ceil(nXSize * MSUVRASTER_MAX_OVERSAMPLE * width / (dfX1 - dfX0));
+  nBufYSize = (int) ceil(nYSize * MSUVRASTER_MAX_OVERSAMPLE * height / (dfY1 - dfY0));
+  nBufXSize = MAX(1, MIN(nXSize, nBufXSize));
+  nBufYSize = MAX(1, MIN(nYSize, nBufYSize));
+
+  if (layer->debug)
+    msDebug("msUVRASTERLoadDirect(): reading %dx%d window at %d,%d into %dx%d.\n",
+            nXSize, nYSize, nXOff, nYOff, nBufXSize, nBufYSize);
+
+  pafBuf = (float *) malloc(sizeof(float) * 2 * nBufXSize * nBufYSize);
+  if( pafBuf == NULL ) {
+    msSetError(MS_MEMERR, "Out of memory allocating %dx%d buffer.",
+               "msUVRASTERLoadDirect()", nBufXSize, nBufYSize);
+    status = MS_FAILURE;
+  } else if( GDALDatasetRasterIO( hDS, GF_Read, nXOff, nYOff, nXSize, nYSize,
+                                  pafBuf, nBufXSize, nBufYSize, GDT_Float32,
+                                  2, panBands, 0, 0, 0 ) != CE_None ) {
+    msSetError(MS_IOERR, "GDALDatasetRasterIO() failed: %s",
+               "msUVRASTERLoadDirect()", CPLGetLastErrorMsg());
+    status = MS_FAILURE;
+  }
+
+  msFree( panBands );
+  msGDALReleaseDataset( layer, hDS );
+  msReleaseLock( TLOCK_GDAL );
+
+  if( status != MS_SUCCESS ) {
+    msFree( pafBuf );
+    return status;
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Area weighted average of the buffer pixels under each cell,     */
+  /*      skipping nodata, as msAverageRasterResampler() does.            */
+  /* -------------------------------------------------------------------- */
+  dfXScale = adfDstGT[1] / adfSrcGT[1] * nBufXSize / nXSize;
+  dfYScale = adfDstGT[5] / adfSrcGT[5] * nBufYSize / nYSize;
+
+  for( x = 0; x < width; x++ ) {
+    double dfXMin = (dfX0 - nXOff) * nBufXSize / nXSize + x * dfXScale;
+    double dfXMax = MIN(nBufXSize, dfXMin + dfXScale);
+    dfXMin = MAX(0, dfXMin);
+
+    for( y = 0; y < height; y++ ) {
+      double dfYMin = (dfY0 - nYOff) * nBufYSize / nYSize + y * dfYScale;
+      double dfYMax = MIN(nBufYSize, dfYMin + dfYScale);
+      double dfUSum = 0.0, dfVSum = 0.0, dfWeightSum = 0.0;
+      int iX, iY;
+
+      dfYMin = MAX(0, dfYMin);
+
+      for( iY = (int) dfYMin; iY < dfYMax; iY++ ) {
+        double dfYWeight = MIN(iY+1,dfYMax) - MAX(iY,dfYMin);
+        float *pafU = pafBuf + iY * nBufXSize;
+        float *pafV = pafU + nBufXSize * nBufYSize;
+
+        for( iX = (int) dfXMin; iX < dfXMax; iX++ ) {
+          double dfWeight = (MIN(iX+1,dfXMax) - MAX(iX,dfXMin)) * dfYWeight;
+
+          if( (bGotNoData[0] && pafU[iX] == (float) adfNoData[0])
+              || (bGotNoData[1] && pafV[iX] == (float) adfNoData[1]) )
+            continue;
+
+          dfUSum += pafU[iX] * dfWeight;
+          dfVSum += pafV[iX] * dfWeight;
+          dfWeightSum += dfWeight;
+        }
+      }
+
+      if( dfWeightSum > 0.0 ) {
+        u[x*height+y] = (float) (dfUSum / dfWeightSum);
+        v[x*height+y] = (float) (dfVSum / dfWeightSum);
+      }
+    }
+  }
+
+  free( pafBuf );
+
+  return MS_SUCCESS;
+}
+
+/**********************************************************************
+ *                     msUVRASTERLoadDrawn()
+ *
+ * Fill u and v (x*height+y) by drawing the U/V bands into a temporary
+ * FLOAT32 image through the regular raster drawing code.
+ **********************************************************************/
+static int msUVRASTERLoadDrawn(layerObj *layer, mapObj *map_tmp,
+                               int width, int height, float *u, float *v)
+{
+  imageObj *image_tmp;
+  char   **alteredProcessing = NULL;
+  char **savedProcessing = NULL;
+  int x, y, status;
+
+  map_tmp->outputformat = (outputFormatObj *) msSmallCalloc(1,sizeof(outputFormatObj));
+  map_tmp->outputformat->bands = 2;
+  map_tmp->outputformat->name = NULL;
+  map_tmp->outputformat->driver = NULL;
+  map_tmp->outputformat->refcount = 0;
+  map_tmp->outputformat->vtable = NULL;
+  map_tmp->outputformat->device = NULL;
+  map_tmp->outputformat->renderer = MS_RENDER_WITH_RAWDATA;
+  map_tmp->outputformat->imagemode = MS_IMAGEMODE_FLOAT32;
+
+  image_tmp = msImageCreate(width, height, map_tmp->outputformat,
+                            NULL, NULL, map_tmp->resolution, map_tmp->defresolution,
+                            &(map_tmp->imagecolor));
+
+  /* Default set to AVERAGE resampling */
+  if( CSLFetchNameValue( layer->processing, "RESAMPLE" ) == NULL ) {
+    alteredProcessing = CSLDuplicate( layer->processing );
+    alteredProcessing =
+      CSLSetNameValue( alteredProcessing, "RESAMPLE",
+                       "AVERAGE");
+    savedProcessing = layer->processing;
+    layer->processing = alteredProcessing;
+  }
+
+  status = msDrawRasterLayerLow(map_tmp, layer, image_tmp, NULL );
+
+  /* restore the saved processing */
+  if (alteredProcessing != NULL) {
+    layer->processing = savedProcessing;
+    CSLDestroy(alteredProcessing);
+  }
+
+  if (status == MS_FAILURE) {
+    msFreeImage(image_tmp);
+    msSetError(MS_MISCERR, "Unable to draw raster data.", "msUVRASTERLayerWhichShapes()" );
+    return MS_FAILURE;
+  }
+
+  for (x = 0; x < width; ++x) {
+    for (y = 0; y < height; ++y) {
+      u[x*height+y] = image_tmp->img.raw_float[x + y * width];
+      v[x*height+y] = image_tmp->img.raw_float[x + y * width + width*height];
+    }
+  }
+
+  msFreeImage(image_tmp); /* we do not need the imageObj anymore */
+
+  return MS_SUCCESS;
+}
+
 int msUVRASTERLayerWhichShapes(layerObj *layer, rectObj rect, int isQuery)
 {
   uvRasterLayerInfo *uvlinfo = (uvRasterLayerInfo *) layer->layerinfo;
-  imageObj *image_tmp;
   mapObj   map_tmp;
   double map_cellsize;
   unsigned int spacing;
-  int width, height, u_src_off, v_src_off, i, x, y;
-  char   **alteredProcessing = NULL;
-  char **savedProcessing = NULL;
+  int width, height, i, status;
+  float *u, *v;
 
   if (layer->debug)
     msDebug("Entering msUVRASTERLayerWhichShapes().\n");
@@ -367,6 +589,15 @@ int msUVRASTERLayerWhichShapes(layerObj *layer, rectObj rect, int isQuery)
       atoi(CSLFetchNameValue( layer->processing, "UV_SPACING" ));
   }
 
+  /* -------------------------------------------------------------------- */
+  /*    Determine desired size_scale.  Default to 1 if not otherwise set  */
+  /* -------------------------------------------------------------------- */
+  uvlinfo->size_scale = 1;
+  if( CSLFetchNameValue( layer->processing, "UV_SIZE_SCALE" ) != NULL ) {
+    uvlinfo->size_scale =
+      atof(CSLFetchNameValue( layer->processing, "UV_SIZE_SCALE" ));
+  }
+
   width = (int)ceil(layer->map->width/spacing);
   height = (int)ceil(layer->map->height/spacing);
   map_cellsize = MS_MAX(MS_CELLSIZE(rect.minx, rect.maxx,layer->map->width),
@@ -381,15 +612,8 @@ int msUVRASTERLayerWhichShapes(layerObj *layer, rectObj rect, int isQuery)
   MS_INIT_COLOR(map_tmp.imagecolor, 255,255,255,255);
   map_tmp.resolution = layer->map->resolution;
   map_tmp.defresolution = layer->map->defresolution;
-  map_tmp.outputformat = (outputFormatObj *) msSmallCalloc(1,sizeof(outputFormatObj));
-  uvlinfo->band_count = map_tmp.outputformat->bands = 2;
-  map_tmp.outputformat->name = NULL;
-  map_tmp.outputformat->driver = NULL;
-  map_tmp.outputformat->refcount = 0;
-  map_tmp.outputformat->vtable = NULL;
-  map_tmp.outputformat->device = NULL;
-  map_tmp.outputformat->renderer = MS_RENDER_WITH_RAWDATA;
-  map_tmp.outputformat->imagemode = MS_IMAGEMODE_FLOAT32;
+  map_tmp.outputformat = NULL;
+  uvlinfo->band_count = 2;
 
   map_tmp.configoptions = layer->map->configoptions;
   map_tmp.mappath = layer->map->mappath;
@@ -420,71 +644,42 @@ int msUVRASTERLayerWhichShapes(layerObj *layer, rectObj rect, int isQuery)
 
   uvlinfo->extent = map_tmp.extent;
 
-  image_tmp = msImageCreate(width, height, map_tmp.outputformat,
-                            NULL, NULL, map_tmp.resolution, map_tmp.defresolution,
-                            &(map_tmp.imagecolor));
+  /* -------------------------------------------------------------------- */
+  /*      Sample the bands, directly when possible, otherwise through     */
+  /*      the raster drawing code.                                        */
+  /* -------------------------------------------------------------------- */
+  u = (float *) msSmallCalloc(width*height, sizeof(float));
+  v = (float *) msSmallCalloc(width*height, sizeof(float));
 
-  /* Default set to AVERAGE resampling */
-  if( CSLFetchNameValue( layer->processing, "RESAMPLE" ) == NULL ) {
-    alteredProcessing = CSLDuplicate( layer->processing );
-    alteredProcessing =
-      CSLSetNameValue( alteredProcessing, "RESAMPLE",
-                       "AVERAGE");
-    savedProcessing = layer->processing;
-    layer->processing = alteredProcessing;
-  }
+  status = msUVRASTERLoadDirect(layer, &map_tmp, width, height, u, v);
+  if (status == MS_DONE)
+    status = msUVRASTERLoadDrawn(layer, &map_tmp, width, height, u, v);
 
-  if (msDrawRasterLayerLow(&map_tmp, layer, image_tmp, NULL ) == MS_FAILURE) {
-    msSetError(MS_MISCERR, "Unable to draw raster data.", NULL, "msUVRASTERLayerWhichShapes()" );
-    return MS_FAILURE;
-  }
+  msFreeProjection(&map_tmp.projection);
 
-  /* restore the saved processing */
-  if (alteredProcessing != NULL)
-    layer->processing = savedProcessing;
-
-  /* free old query arrays */
-  if (uvlinfo->u) {
-    for (i=0; i<uvlinfo->width; ++i) {
-      free(uvlinfo->u[i]);
-    }
-    free(uvlinfo->u);
-  }
-
-  if (uvlinfo->v) {
-    for (i=0; i<uvlinfo->height; ++i) {
-      free(uvlinfo->v[i]);
-    }
-    free(uvlinfo->v);
+  if (status != MS_SUCCESS) {
+    free(u);
+    free(v);
+    return MS_FAILURE;
   }
 
   /* Update our uv layer structure */
+  free(uvlinfo->u);
+  free(uvlinfo->v);
+  free(uvlinfo->cells);
+  uvlinfo->u = u;
+  uvlinfo->v = v;
   uvlinfo->width = width;
   uvlinfo->height = height;
-  uvlinfo->query_results = width*height;
-
-  uvlinfo->u = (float **)msSmallMalloc(sizeof(float *)*width);
-  uvlinfo->v = (float **)msSmallMalloc(sizeof(float *)*width);
-
-  for (x = 0; x < width; ++x) {
-    uvlinfo->u[x] = (float *)msSmallMalloc(height * sizeof(float));
-    uvlinfo->v[x] = (float *)msSmallMalloc(height * sizeof(float));
 
-    for (y = 0; y < height; ++y) {
-      u_src_off = v_src_off = x + y * width;
-      v_src_off += width*height;
-
-      uvlinfo->u[x][y] = image_tmp->img.raw_float[u_src_off];
-      uvlinfo->v[x][y] = image_tmp->img.raw_float[v_src_off];
-
-      /* null vector? update the number of results  */
-      if (uvlinfo->u[x][y] == 0 && uvlinfo->v[x][y] == 0)
-        --uvlinfo->query_results;
-    }
+  /* index the non null vectors, so shapes are found directly */
+  uvlinfo->cells = (int *) msSmallMalloc(sizeof(int) * MS_MAX(1,width*height));
+  uvlinfo->query_results = 0;
+  for (i = 0; i < width*height; ++i) {
+    if (u[i] != 0 || v[i] != 0)
+      uvlinfo->cells[uvlinfo->query_results++] = i;
   }
 
-  msFreeImage(image_tmp); /* we do not need the imageObj anymore */
-
   uvlinfo->next_shape = 0;
 
   return MS_SUCCESS;
@@ -495,7 +690,7 @@ int msUVRASTERLayerGetShape(layerObj *layer, shapeObj *shape, resultObj *record)
   uvRasterLayerInfo *uvlinfo = (uvRasterLayerInfo *) layer->layerinfo;
   lineObj line ;
   pointObj point;
-  int i, j, k, x=0, y=0;
+  int x, y;
   long shapeindex = record->shapeindex;
 
   msFreeShape(shape);
@@ -510,14 +705,8 @@ int msUVRASTERLayerGetShape(layerObj *layer, shapeObj *shape, resultObj *record)
     return MS_FAILURE;
   }
 
-  /* loop to the next non null vector */
-  k = 0;
-  for (i=0, x=-1; i<uvlinfo->width && k<=shapeindex; ++i, ++x) {
-    for (j=0, y=-1; j<uvlinfo->height && k<=shapeindex; ++j, ++k, ++y) {
-      if (uvlinfo->u[i][j] == 0 && uvlinfo->v[i][j] == 0)
-        --k;
-    }
-  }
+  x = uvlinfo->cells[shapeindex] / uvlinfo->height;
+  y = uvlinfo->cells[shapeindex] % uvlinfo->height;
 
   point.x = Pix2Georef(x, 0, uvlinfo->width-1,
                        uvlinfo->extent.minx, uvlinfo->extent.maxx, MS_FALSE);
@@ -538,7 +727,9 @@ int msUVRASTERLayerGetShape(layerObj *layer, shapeObj *shape, resultObj *record)
   msComputeBounds( shape );
 
   shape->numvalues = layer->numitems;
-  shape->values = msUVRASTERGetValues(layer, &uvlinfo->u[x][y], &uvlinfo->v[x][y]);
+  shape->values = msUVRASTERGetValues(layer,
+                                      uvlinfo->u[uvlinfo->cells[shapeindex]],
+                                      uvlinfo->v[uvlinfo->cells[shapeindex]]);
 
   return MS_SUCCESS;
 
@@ -617,7 +808,7 @@ int msUVRASTERLayerGetExtent(layerObj *layer, rectObj *extent)
 
   msAcquireLock( TLOCK_GDAL );
   if( decrypted_path ) {
-    hDS = GDALOpen(decrypted_path, GA_ReadOnly );
+    hDS = msGDALOpenDataset( layer, decrypted_path );
     msFree( decrypted_path );
   } else
     hDS = NULL;
@@ -627,7 +818,7 @@ int msUVRASTERLayerGetExtent(layerObj *layer, rectObj *extent)
     nYSize = GDALGetRasterYSize( hDS );
     eErr = GDALGetGeoTransform( hDS, adfGeoTransform );
 
-    GDALClose( hDS );
+    msGDALReleaseDataset( layer, hDS );
   }
 
   msReleaseLock( TLOCK_GDAL );
@@ -2442,7 +2442,7 @@ int msWCSGetCoverageMetadata( layerObj *layer, coverageMetadataObj *cm )
 
     msAcquireLock( TLOCK_GDAL );
 
-    hDS = GDALOpen( decrypted_path, GA_ReadOnly );
+    hDS = msGDALOpenDataset( layer, decrypted_path );
     if( hDS == NULL ) {
       const char *cpl_error_msg = CPLGetLastErrorMsg();
 
@@ -2483,6 +2483,7 @@ int msWCSGetCoverageMetadata( layerObj *layer, coverageMetadataObj *cm )
     cm->bandcount = GDALGetRasterCount( hDS );
 
     if( cm->bandcount == 0 ) {
+      msGDALReleaseDataset( layer, hDS );
       msReleaseLock( TLOCK_GDAL );
       msSetError( MS_WCSERR, "Raster file %s has no raster bands.  This cannot be used in a layer.", "msWCSGetCoverageMetadata()", layer->data );
       return MS_FAILURE;
@@ -2509,7 +2510,7 @@ int msWCSGetCoverageMetadata( layerObj *layer, coverageMetadataObj *cm )
       cm->bandinterpretation[i-1] = GDALGetColorInterpretationName(colorInterp);
     }
 
-    GDALClose( hDS );
+    msGDALReleaseDataset( layer, hDS );
     msReleaseLock( TLOCK_GDAL );
   }
 
@@ -1820,6 +1820,524 @@ static int msWCSWriteFile20(mapObj* map, imageObj* image, wcs20ParamsObjPtr para
   return MS_SUCCESS;
 }
 
+/************************************************************************/
+/* ==================================================================== */
+/*      Streaming GeoTIFF output.                                       */
+/*                                                                      */
+/*      When a coverage is a plain window of a single GDAL file (same   */
+/*      CRS and pixel grid, no nodata, mask or tile index) and the      */
+/*      output is raw GeoTIFF, there is nothing to resample.  The       */
+/*      coverage is then written as an uncompressed, strip organized    */
+/*      GeoTIFF straight to the client, one strip at a time: the IFD    */
+/*      goes first since every strip size is known up front.  Memory    */
+/*      use is bounded by one strip and nothing is written to disk.     */
+/*      Enabled with the "wcs_streaming" layer metadata.                */
+/* ==================================================================== */
+/************************************************************************/
+
+#define MS_WCS20_STREAM_STRIP_BYTES (1024*1024)
+#define MS_WCS20_STREAM_MAX_TAGS 20
+
+typedef struct {
+  GDALDatasetH hDS;
+  int *panBands;
+  int nBands;
+  GDALDataType eDataType;
+  int nXOff, nYOff, nXSize, nYSize;
+  int nRowsPerStrip;
+  double adfGeoTransform[6];  /* of the output grid */
+  int nEPSG;
+  int bGeographic;
+  const char *pszNullValue;
+} wcs20StreamObj;
+
+typedef struct {
+  unsigned short tag;
+  unsigned short type;
+  size_t count;
+  unsigned char *values;      /* native byte order */
+  GUIntBig offset;            /* if the values do not fit in the entry */
+} wcs20TIFFTagObj;
+
+/************************************************************************/
+/*                     msWCSFreeStream20()                              */
+/************************************************************************/
+
+static void msWCSFreeStream20(layerObj *layer, wcs20StreamObj *stream)
+{
+  if(stream->hDS != NULL) {
+    msAcquireLock(TLOCK_GDAL);
+    msGDALReleaseDataset(layer, stream->hDS);
+    msReleaseLock(TLOCK_GDAL);
+  }
+  msFree(stream->panBands);
+  memset(stream, 0, sizeof(wcs20StreamObj));
+}
+
+/************************************************************************/
+/*                     msWCSPrepareStream20()                           */
+/*                                                                      */
+/*      Returns MS_SUCCESS (with the dataset open) if the coverage      */
+/*      can be streamed, MS_DONE if it has to go through the normal     */
+/*      draw and save path.  TLOCK_GDAL is not held on return, the      */
+/*      writer takes it around each strip read.                         */
+/************************************************************************/
+
+static int msWCSPrepareStream20(mapObj *map, layerObj *layer, wcs20StreamObj *stream)
+{
+  outputFormatObj *format = map->outputformat;
+  const char *value, *reason = NULL;
+  char szPath[MS_MAXPATHLEN], *decrypted_path;
+  double adfSrcGeoTransform[6], dfXOff, dfYOff;
+  int i, nBlockXSize, nBlockYSize, nRowBytes;
+
+  memset(stream, 0, sizeof(wcs20StreamObj));
+
+  value = msOWSLookupMetadata(&(layer->metadata), "CO", "streaming");
+  if(value == NULL || strcasecmp(value, "true") != 0)
+    return MS_DONE;
+
+  /* -------------------------------------------------------------------- */
+  /*      Checks that do not need the dataset.                            */
+  /* -------------------------------------------------------------------- */
+  if(!EQUAL(format->driver, "GDAL/GTiff") || !MS_RENDERER_RAWDATA(format))
+    reason = "output format is not raw GDAL/GTiff";
+  else if(format->imagemode == MS_IMAGEMODE_BYTE)
+    stream->eDataType = GDT_Byte;
+  else if(format->imagemode == MS_IMAGEMODE_INT16)
+    stream->eDataType = GDT_Int16;
+  else if(format->imagemode == MS_IMAGEMODE_FLOAT32)
+    stream->eDataType = GDT_Float32;
+  else
+    reason = "unsupported IMAGEMODE";
+
+  for(i = 0; reason == NULL && i < format->numformatoptions; i++) {
+    if(strncasecmp(format->formatoptions[i], "BAND_COUNT=", 11) != 0
+        && strncasecmp(format->formatoptions[i], "FILENAME=", 9) != 0
+        && strncasecmp(format->formatoptions[i], "NULLVALUE=", 10) != 0)
+      reason = "output format has creation options";
+  }
+  stream->pszNullValue = msGetOutputFormatOption(format, "NULLVALUE", NULL);
+
+  if(reason == NULL
+      && (layer->tileindex != NULL || layer->data == NULL || layer->mask != NULL
+          || layer->offsite.red != -1 || layer->offsite.green != -1
+          || layer->offsite.blue != -1))
+    reason = "layer is tiled, masked or has an OFFSITE color";
+
+  if(reason == NULL && msProjectionsDiffer(&(map->projection), &(layer->projection)))
+    reason = "coverage needs reprojecting";
+
+  if(reason == NULL) {
+    const char *epsg = msOWSGetEPSGProj(&(map->projection), NULL, "CO", MS_TRUE);
+    if(epsg == NULL)
+      epsg = msOWSGetEPSGProj(NULL, &(layer->metadata), "CO", MS_TRUE);
+    if(epsg != NULL && strncasecmp(epsg, "EPSG:", 5) == 0)
+      stream->nEPSG = atoi(epsg+5);
+    if(stream->nEPSG <= 0 || stream->nEPSG > 65535 || map->projection.proj == NULL)
+      reason = "output CRS has no EPSG code";
+    else
+      stream->bGeographic = pj_is_latlong(map->projection.proj);
+  }
+
+  if(reason != NULL) {
+    if(layer->debug)
+      msDebug("msWCSGetCoverage20(): not streaming, %s.\n", reason);
+    return MS_DONE;
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Open the dataset and check the output is a window of it.        */
+  /*      Failures here are left to the normal path to report.            */
+  /* -------------------------------------------------------------------- */
+  msTryBuildPath3(szPath, map->mappath, map->shapepath, layer->data);
+  decrypted_path = msDecryptStringTokens(map, szPath);
+  if(decrypted_path == NULL)
+    return MS_DONE;
+
+  msAcquireLock(TLOCK_GDAL);
+  stream->hDS = msGDALOpenDataset(layer, decrypted_path);
+  msFree(decrypted_path);
+  msReleaseLock(TLOCK_GDAL);
+  if(stream->hDS == NULL)
+    return MS_DONE;
+
+  msAcquireLock(TLOCK_GDAL);
+
+  msGetGDALGeoTransform(stream->hDS, map, layer, adfSrcGeoTransform);
+  dfXOff = (map->gt.geotransform[0] - adfSrcGeoTransform[0]) / adfSrcGeoTransform[1];
+  dfYOff = (map->gt.geotransform[3] - adfSrcGeoTransform[3]) / adfSrcGeoTransform[5];
+  stream->nXOff = (int) floor(dfXOff + 0.5);
+  stream->nYOff = (int) floor(dfYOff + 0.5);
+  stream->nXSize = map->width;
+  stream->nYSize = map->height;
+
+  if(adfSrcGeoTransform[2] != 0.0 || adfSrcGeoTransform[4] != 0.0
+      || map->gt.geotransform[2] != 0.0 || map->gt.geotransform[4] != 0.0
+      || fabs(map->gt.geotransform[1] - adfSrcGeoTransform[1]) > 1e-6 * fabs(adfSrcGeoTransform[1])
+      || fabs(map->gt.geotransform[5] - adfSrcGeoTransform[5]) > 1e-6 * fabs(adfSrcGeoTransform[5]))
+    reason = "output grid resolution differs from the source";
+  else if(fabs(dfXOff - stream->nXOff) > 1e-3 || fabs(dfYOff - stream->nYOff) > 1e-3)
+    reason = "output grid is not aligned with the source pixels";
+  else if(stream->nXOff < 0 || stream->nYOff < 0
+          || stream->nXOff + stream->nXSize > GDALGetRasterXSize(stream->hDS)
+          || stream->nYOff + stream->nYSize > GDALGetRasterYSize(stream->hDS))
+    reason = "output extends beyond the source";
+
+  if(reason == NULL) {
+    stream->panBands = msGetGDALBandList(layer, stream->hDS, format->bands, &(stream->nBands));
+    if(stream->panBands == NULL || stream->nBands != format->bands)
+      reason = "band list does not match the output format";
+    else if(stream->nBands > 256)
+      reason = "too many bands";
+  }
+
+  for(i = 0; reason == NULL && i < stream->nBands; i++) {
+    int bGotNoData = FALSE;
+    msGetGDALNoDataValue(layer, GDALGetRasterBand(stream->hDS, stream->panBands[i]), &bGotNoData);
+    if(bGotNoData)
+      reason = "source has a NODATA value";
+  }
+
+  if(reason != NULL) {
+    msReleaseLock(TLOCK_GDAL);
+    if(layer->debug)
+      msDebug("msWCSGetCoverage20(): not streaming, %s.\n", reason);
+    msResetErrorList();
+    msWCSFreeStream20(layer, stream);
+    return MS_DONE;
+  }
+
+  stream->adfGeoTransform[0] = adfSrcGeoTransform[0] + stream->nXOff * adfSrcGeoTransform[1];
+  stream->adfGeoTransform[1] = adfSrcGeoTransform[1];
+  stream->adfGeoTransform[3] = adfSrcGeoTransform[3] + stream->nYOff * adfSrcGeoTransform[5];
+  stream->adfGeoTransform[5] = adfSrcGeoTransform[5];
+
+  /* -------------------------------------------------------------------- */
+  /*      Strips of about 1MB, made of whole source blocks if possible.   */
+  /* -------------------------------------------------------------------- */
+  GDALGetBlockSize(GDALGetRasterBand(stream->hDS, stream->panBands[0]),
+                   &nBlockXSize, &nBlockYSize);
+  nRowBytes = stream->nXSize * stream->nBands * (GDALGetDataTypeSize(stream->eDataType)/8);
+  stream->nRowsPerStrip = MAX(1, MS_WCS20_STREAM_STRIP_BYTES / nRowBytes);
+  if(nBlockYSize > 0 && stream->nRowsPerStrip > nBlockYSize)
+    stream->nRowsPerStrip -= stream->nRowsPerStrip % nBlockYSize;
+  stream->nRowsPerStrip = MIN(stream->nRowsPerStrip, stream->nYSize);
+  msReleaseLock(TLOCK_GDAL);
+
+  if(layer->debug)
+    msDebug("msWCSGetCoverage20(): streaming %dx%dx%d window at %d,%d in strips of %d rows.\n",
+            stream->nXSize, stream->nYSize, stream->nBands,
+            stream->nXOff, stream->nYOff, stream->nRowsPerStrip);
+
+  return MS_SUCCESS;
+}
+
+/************************************************************************/
+/*                     msWCSAddTIFFTag20()                              */
+/************************************************************************/
+
+static int msWCSTIFFTypeSize20(int type)
+{
+  switch(type) {
+    case 2: /* ASCII */
+      return 1;
+    case 3: /* SHORT */
+      return 2;
+    case 4: /* LONG */
+      return 4;
+    default: /* DOUBLE, LONG8 */
+      return 8;
+  }
+}
+
+static void msWCSAddTIFFTag20(wcs20TIFFTagObj *tags, int *count,
+                              int tag, int type, size_t n, const void *values)
+{
+  wcs20TIFFTagObj *t = tags + (*count)++;
+
+  t->tag = (unsigned short) tag;
+  t->type = (unsigned short) type;
+  t->count = n;
+  t->values = (unsigned char *) msSmallMalloc(n * msWCSTIFFTypeSize20(type));
+  t->offset = 0;
+  if(values != NULL)
+    memcpy(t->values, values, n * msWCSTIFFTypeSize20(type));
+}
+
+static void msWCSAddTIFFShortTag20(wcs20TIFFTagObj *tags, int *count, int tag, int value)
+{
+  unsigned short v = (unsigned short) value;
+  msWCSAddTIFFTag20(tags, count, tag, 3, 1, &v);
+}
+
+static void msWCSAddTIFFLongTag20(wcs20TIFFTagObj *tags, int *count, int tag, GUInt32 value)
+{
+  msWCSAddTIFFTag20(tags, count, tag, 4, 1, &value);
+}
+
+/************************************************************************/
+/*                    msWCSWriteStreamTIFF20()                          */
+/*                                                                      */
+/*      Write a coverage prepared by msWCSPrepareStream20() to the      */
+/*      client.  The file is a BigTIFF if it could exceed 4GB.          */
+/************************************************************************/
+
+static int msWCSWriteStreamTIFF20(mapObj *map, wcs20StreamObj *stream, int multipart)
+{
+  wcs20TIFFTagObj tags[MS_WCS20_STREAM_MAX_TAGS];
+  int nTags = 0, i, nStrips, nSampleBytes, bBigTIFF, status = MS_SUCCESS;
+  int iStripOffsets, iStripByteCounts;
+  size_t nRowBytes;
+  GUIntBig nDataBytes, nOffset, nDataOffset;
+  unsigned short anShorts[256], anGeoKeys[16];
+  double adfScale[3], adfTiePoint[6];
+  bufferObj header;
+  unsigned char *pabyStrip;
+  const char *fo_filename;
+  char *default_filename = NULL;
+
+  nSampleBytes = GDALGetDataTypeSize(stream->eDataType) / 8;
+  nRowBytes = (size_t) stream->nXSize * stream->nBands * nSampleBytes;
+  nDataBytes = (GUIntBig) nRowBytes * stream->nYSize;
+  nStrips = (stream->nYSize + stream->nRowsPerStrip - 1) / stream->nRowsPerStrip;
+  bBigTIFF = nDataBytes + 16 * (GUIntBig) nStrips + 4096 > 0xFFFFFFFFU;
+
+  /* -------------------------------------------------------------------- */
+  /*      Build the tags, in ascending tag order.                         */
+  /* -------------------------------------------------------------------- */
+  msWCSAddTIFFLongTag20(tags, &nTags, 256, stream->nXSize);   /* ImageWidth */
+  msWCSAddTIFFLongTag20(tags, &nTags, 257, stream->nYSize);   /* ImageLength */
+  for(i = 0; i < stream->nBands; i++)
+    anShorts[i] = (unsigned short) (nSampleBytes * 8);
+  msWCSAddTIFFTag20(tags, &nTags, 258, 3, stream->nBands, anShorts); /* BitsPerSample */
+  msWCSAddTIFFShortTag20(tags, &nTags, 259, 1);            /* Compression: none */
+  msWCSAddTIFFShortTag20(tags, &nTags, 262,                /* Photometric */
+                         (stream->nBands == 3 && stream->eDataType == GDT_Byte) ? 2 : 1);
+  iStripOffsets = nTags;
+  msWCSAddTIFFTag20(tags, &nTags, 273, bBigTIFF ? 16 : 4, nStrips, NULL); /* StripOffsets */
+  msWCSAddTIFFShortTag20(tags, &nTags, 277, stream->nBands); /* SamplesPerPixel */
+  msWCSAddTIFFLongTag20(tags, &nTags, 278, stream->nRowsPerStrip); /* RowsPerStrip */
+  iStripByteCounts = nTags;
+  msWCSAddTIFFTag20(tags, &nTags, 279, bBigTIFF ? 16 : 4, nStrips, NULL); /* StripByteCounts */
+  msWCSAddTIFFShortTag20(tags, &nTags, 284, 1);            /* PlanarConfig: contig */
+  if(stream->nBands > 1 && !(stream->nBands == 3 && stream->eDataType == GDT_Byte)) {
+    memset(anShorts, 0, sizeof(anShorts));                 /* ExtraSamples: unspecified */
+    msWCSAddTIFFTag20(tags, &nTags, 338, 3, stream->nBands-1, anShorts);
+  }
+  for(i = 0; i < stream->nBands; i++)                      /* SampleFormat */
+    anShorts[i] = (unsigned short) (stream->eDataType == GDT_Float32 ? 3 :
+                                    stream->eDataType == GDT_Int16 ? 2 : 1);
+  msWCSAddTIFFTag20(tags, &nTags, 339, 3, stream->nBands, anShorts);
+
+  adfScale[0] = stream->adfGeoTransform[1];
+  adfScale[1] = -stream->adfGeoTransform[5];
+  adfScale[2] = 0.0;
+  msWCSAddTIFFTag20(tags, &nTags, 33550, 12, 3, adfScale);  /* ModelPixelScale */
+  memset(adfTiePoint, 0, sizeof(adfTiePoint));
+  adfTiePoint[3] = stream->adfGeoTransform[0];
+  adfTiePoint[4] = stream->adfGeoTransform[3];
+  msWCSAddTIFFTag20(tags, &nTags, 33922, 12, 6, adfTiePoint); /* ModelTiepoint */
+
+  /* GeoKeyDirectory: version 1.1.0, 3 keys */
+  anGeoKeys[0] = 1;
+  anGeoKeys[1] = 1;
+  anGeoKeys[2] = 0;
+  anGeoKeys[3] = 3;
+  anGeoKeys[4] = 1024; /* GTModelType */
+  anGeoKeys[5] = 0;
+  anGeoKeys[6] = 1;
+  anGeoKeys[7] = stream->bGeographic ? 2 : 1;
+  anGeoKeys[8] = 1025; /* GTRasterType: PixelIsArea */
+  anGeoKeys[9] = 0;
+  anGeoKeys[10] = 1;
+  anGeoKeys[11] = 1;
+  anGeoKeys[12] = stream->bGeographic ? 2048 : 3072; /* GeographicType / ProjectedCSType */
+  anGeoKeys[13] = 0;
+  anGeoKeys[14] = 1;
+  anGeoKeys[15] = (unsigned short) stream->nEPSG;
+  msWCSAddTIFFTag20(tags, &nTags, 34735, 3, 16, anGeoKeys);
+
+  if(stream->pszNullValue != NULL)                          /* GDAL_NODATA */
+    msWCSAddTIFFTag20(tags, &nTags, 42113, 2, strlen(stream->pszNullValue)+1,
+                      stream->pszNullValue);
+
+  /* -------------------------------------------------------------------- */
+  /*      Lay out header, IFD, out of line tag values and strips.         */
+  /* -------------------------------------------------------------------- */
+  nOffset = (bBigTIFF ? 16 : 8)
+            + (bBigTIFF ? 8 + 20 * nTags + 8 : 2 + 12 * nTags + 4);
+  for(i = 0; i < nTags; i++) {
+    size_t nBytes = tags[i].count * msWCSTIFFTypeSize20(tags[i].type);
+    if(nBytes > (size_t) (bBigTIFF ? 8 : 4)) {
+      tags[i].offset = nOffset;
+      nOffset += (nBytes + 7) & ~((size_t) 7);
+    }
+  }
+  nDataOffset = nOffset;
+
+  for(i = 0; i < nStrips; i++) {
+    int nRows = MIN(stream->nRowsPerStrip, stream->nYSize - i * stream->nRowsPerStrip);
+    GUIntBig nStripOffset = nDataOffset + (GUIntBig) nRowBytes * stream->nRowsPerStrip * i;
+    GUIntBig nStripBytes = (GUIntBig) nRowBytes * nRows;
+
+    if(bBigTIFF) {
+      memcpy(tags[iStripOffsets].values + i * 8, &nStripOffset, 8);
+      memcpy(tags[iStripByteCounts].values + i * 8, &nStripBytes, 8);
+    } else {
+      GUInt32 n32 = (GUInt32) nStripOffset;
+      memcpy(tags[iStripOffsets].values + i * 4, &n32, 4);
+      n32 = (GUInt32) nStripBytes;
+      memcpy(tags[iStripByteCounts].values + i * 4, &n32, 4);
+    }
+  }
+
+  /* -------------------------------------------------------------------- */
+  /*      Serialize in native byte order, declared in the header.         */
+  /* -------------------------------------------------------------------- */
+  msBufferInit(&header);
+  {
+    unsigned short nByteOrder = 1, nVersion = bBigTIFF ? 43 : 42;
+    unsigned short nEight = 8, nZero = 0;
+    GUIntBig nIFDOffset = bBigTIFF ? 16 : 8;
+    GUInt32 nIFDOffset32 = 8;
+    GUIntBig nCount64 = nTags, nNext64 = 0;
+    unsigned short nCount16 = (unsigned short) nTags;
+    GUInt32 nNext32 = 0;
+
+    msBufferAppend(&header, *((unsigned char *) &nByteOrder) ? "II" : "MM", 2);
+    msBufferAppend(&header, &nVersion, 2);
+    if(bBigTIFF) {
+      msBufferAppend(&header, &nEight, 2);
+      msBufferAppend(&header, &nZero, 2);
+      msBufferAppend(&header, &nIFDOffset, 8);
+      msBufferAppend(&header, &nCount64, 8);
+    } else {
+      msBufferAppend(&header, &nIFDOffset32, 4);
+      msBufferAppend(&header, &nCount16, 2);
+    }
+
+    for(i = 0; i < nTags; i++) {
+      unsigned char abyValue[8];
+      size_t nBytes = tags[i].count * msWCSTIFFTypeSize20(tags[i].type);
+
+      msBufferAppend(&header, &(tags[i].tag), 2);
+      msBufferAppend(&header, &(tags[i].type), 2);
+      memset(abyValue, 0, sizeof(abyValue));
+      if(bBigTIFF) {
+        GUIntBig nCount = tags[i].count;
+        msBufferAppend(&header, &nCount, 8);
+        if(tags[i].offset)
+          memcpy(abyValue, &(tags[i].offset), 8);
+        else
+          memcpy(abyValue, tags[i].values, nBytes);
+        msBufferAppend(&header, abyValue, 8);
+      } else {
+        GUInt32 nCount = (GUInt32) tags[i].count, nTagOffset = (GUInt32) tags[i].offset;
+        msBufferAppend(&header, &nCount, 4);
+        if(tags[i].offset)
+          memcpy(abyValue, &nTagOffset, 4);
+        else
+          memcpy(abyValue, tags[i].values, nBytes);
+        msBufferAppend(&header, abyValue, 4);
+      }
+    }
+    if(bBigTIFF)
+      msBufferAppend(&header, &nNext64, 8);
+    else
+      msBufferAppend(&header, &nNext32, 4);
+
+    for(i = 0; i < nTags; i++) {
+      if(tags[i].offset) {
+        size_t nBytes = tags[i].count * msWCSTIFFTypeSize20(tags[i].type);
+        unsigned char abyPad[8];
+        memset(abyPad, 0, sizeof(abyPad));
+        msBufferAppend(&header, tags[i].values, nBytes);
+        msBufferAppend(&header, abyPad, ((nBytes + 7) & ~((size_t) 7)) - nBytes);
+      }
+    }
+  }
+  for(i = 0; i < nTags; i++)
+    msFree(tags[i].values);
+  assert(header.size == nDataOffset);
+
+  /* -------------------------------------------------------------------- */
+  /*      Send the response headers and the file.                         */
+  /* -------------------------------------------------------------------- */
+  fo_filename = msGetOutputFormatOption(map->outputformat, "FILENAME", NULL);
+  if(fo_filename == NULL) {
+    default_filename = msStrdup("out.");
+    default_filename = msStringConcatenate(default_filename, MS_IMAGE_EXTENSION(map->outputformat));
+    fo_filename = default_filename;
+  }
+
+  if(multipart) {
+    msIO_fprintf(stdout, "\r\n--wcs\r\n");
+    msIO_fprintf(stdout,
+                 "Content-Type: %s\r\n"
+                 "Content-Description: coverage data\r\n"
+                 "Content-Transfer-Encoding: binary\r\n"
+                 "Content-ID: coverage/%s\r\n"
+                 "Content-Disposition: INLINE; filename=%s\r\n\r\n",
+                 MS_IMAGE_MIME_TYPE(map->outputformat), fo_filename, fo_filename);
+  } else {
+    msIO_setHeader("Content-Type", "%s", MS_IMAGE_MIME_TYPE(map->outputformat));
+    msIO_setHeader("Content-Description", "coverage data");
+    msIO_setHeader("Content-Transfer-Encoding", "binary");
+    msIO_setHeader("Content-ID", "coverage/%s", fo_filename);
+    msIO_setHeader("Content-Disposition", "INLINE; filename=%s", fo_filename);
+    msIO_sendHeaders();
+  }
+  msFree(default_filename);
+
+  if(msIO_needBinaryStdout() == MS_FAILURE) {
+    msBufferFree(&header);
+    return MS_FAILURE;
+  }
+
+  msIO_fwrite(header.data, 1, header.size, stdout);
+  msBufferFree(&header);
+
+  pabyStrip = (unsigned char *) msSmallMalloc(nRowBytes * stream->nRowsPerStrip);
+  for(i = 0; i < nStrips; i++) {
+    int nRows = MIN(stream->nRowsPerStrip, stream->nYSize - i * stream->nRowsPerStrip);
+    CPLErr eErr;
+
+    /* only the read needs the lock, a slow client must not stall GDAL */
+    msAcquireLock(TLOCK_GDAL);
+    eErr = GDALDatasetRasterIO(stream->hDS, GF_Read,
+                               stream->nXOff, stream->nYOff + i * stream->nRowsPerStrip,
+                               stream->nXSize, nRows,
+                               pabyStrip, stream->nXSize, nRows, stream->eDataType,
+                               stream->nBands, stream->panBands,
+                               stream->nBands * nSampleBytes, (int) nRowBytes,
+                               nSampleBytes);
+    msReleaseLock(TLOCK_GDAL);
+
+    if(eErr != CE_None) {
+      errorObj *ms_error;
+
+      /* part of the file is already sent, the error can only be logged */
+      msDebug("msWCSWriteStreamTIFF20(): GDALDatasetRasterIO() failed after %d of %d strips, "
+              "response truncated: %s\n", i, nStrips, CPLGetLastErrorMsg());
+      msSetError(MS_IOERR, "GDALDatasetRasterIO() failed after %d of %d strips: %s",
+                 "msWCSWriteStreamTIFF20()", i, nStrips, CPLGetLastErrorMsg());
+      ms_error = msGetErrorObj();
+      ms_error->isreported = MS_TRUE;
+      status = MS_FAILURE;
+      break;
+    }
+    msIO_fwrite(pabyStrip, 1, nRowBytes * nRows, stdout);
+  }
+  free(pabyStrip);
+
+  /* a truncated part is not closed, the client has to see it as broken */
+  if(multipart && status == MS_SUCCESS)
+    msIO_fprintf(stdout, "\r\n--wcs--\r\n");
+
+  return status;
+}
+
 /************************************************************************/
 /*                   msWCSGetRangesetAxisMetadata20()                   */
 /*                                                                      */
@@ -2214,7 +2732,7 @@ static int msWCSGetCoverageMetadata20(layerObj *layer, wcs20coverageMetadataObj
 
     msTryBuildPath3((char *)szPath,  layer->map->mappath, layer->map->shapepath, layer->data);
     msAcquireLock( TLOCK_GDAL );
-    hDS = GDALOpen( szPath, GA_ReadOnly );
+    hDS = msGDALOpenDataset( layer, szPath );
     if( hDS == NULL ) {
       msReleaseLock( TLOCK_GDAL );
       msSetError( MS_IOERR, "%s", "msWCSGetCoverageMetadata20()", CPLGetLastErrorMsg() );
@@ -2239,6 +2757,7 @@ static int msWCSGetCoverageMetadata20(layerObj *layer, wcs20coverageMetadataObj
     /* TODO nilvalues? */
 
     if( cm->numbands == 0 ) {
+      msGDALReleaseDataset( layer, hDS );
       msReleaseLock( TLOCK_GDAL );
       msSetError( MS_WCSERR, "Raster file %s has no raster bands.  This cannot be used in a layer.", "msWCSGetCoverageMetadata20()", layer->data );
       return MS_FAILURE;
@@ -2307,7 +2826,7 @@ static int msWCSGetCoverageMetadata20(layerObj *layer, wcs20coverageMetadataObj
       }
     }
 
-    GDALClose( hDS );
+    msGDALReleaseDataset( layer, hDS );
     msReleaseLock( TLOCK_GDAL );
   }
 
@@ -3113,6 +3632,116 @@ static int msWCSGetCoverage20_GetBands(mapObj *map, layerObj *layer,
   return MS_SUCCESS;
 }
 
+/************************************************************************/
+/*                msWCSGetCoverage20_WriteDocument()                    */
+/*                                                                      */
+/*      Start a multipart GetCoverage response with the GML coverage    */
+/*      description of the map's output grid.  The coverage data part   */
+/*      and the closing boundary are written by the caller.             */
+/************************************************************************/
+
+static void msWCSGetCoverage20_WriteDocument(mapObj *map, layerObj *layer,
+    wcs20coverageMetadataObjPtr cm, char *bandlist)
+{
+  xmlDocPtr psDoc = NULL;       /* document pointer */
+  xmlNodePtr psRootNode, psRangeSet, psFile, psRangeParameters;
+  xmlNsPtr psGmlNs = NULL,
+           psGmlcovNs = NULL,
+           psSweNs = NULL,
+           psXLinkNs = NULL;
+  wcs20coverageMetadataObj tmpCm;
+  char *srs_uri, *default_filename;
+  const char *filename;
+  char *file_ref, *role;
+  int length = 0, swapAxes;
+
+  /* Create Document  */
+  psDoc = xmlNewDoc(BAD_CAST "1.0");
+  psRootNode = xmlNewNode(NULL, BAD_CAST MS_WCS_GML_COVERAGETYPE_RECTIFIED_GRID_COVERAGE);
+  xmlDocSetRootElement(psDoc, psRootNode);
+
+  msWCSPrepareNamespaces20(psDoc, psRootNode, map);
+
+  psGmlNs    = xmlSearchNs(psDoc, psRootNode, BAD_CAST MS_OWSCOMMON_GML_NAMESPACE_PREFIX);
+  psGmlcovNs = xmlSearchNs(psDoc, psRootNode, BAD_CAST MS_OWSCOMMON_GMLCOV_NAMESPACE_PREFIX);
+  psSweNs    = xmlSearchNs(psDoc, psRootNode, BAD_CAST MS_OWSCOMMON_SWE_NAMESPACE_PREFIX);
+  xmlSearchNs(psDoc, psRootNode, BAD_CAST MS_OWSCOMMON_WCS_NAMESPACE_PREFIX);
+  psXLinkNs  = xmlSearchNs(psDoc, psRootNode, BAD_CAST MS_OWSCOMMON_W3C_XLINK_NAMESPACE_PREFIX);
+
+  xmlNewNsProp(psRootNode, psGmlNs, BAD_CAST "id", BAD_CAST layer->name);
+
+  xmlSetNs(psRootNode, psGmlcovNs);
+
+  srs_uri = msOWSGetProjURI(&map->projection, NULL, "CO", 1);
+
+  tmpCm = *cm;
+  tmpCm.extent = map->extent;
+  tmpCm.xsize = map->width;
+  tmpCm.ysize = map->height;
+  strlcpy(tmpCm.srs_uri, srs_uri, sizeof(tmpCm.srs_uri));
+
+  tmpCm.xresolution = map->gt.geotransform[1];
+  tmpCm.yresolution = map->gt.geotransform[5];
+
+  tmpCm.extent.minx = MIN(map->gt.geotransform[0], map->gt.geotransform[0] + map->width * tmpCm.xresolution);
+  tmpCm.extent.miny = MIN(map->gt.geotransform[3], map->gt.geotransform[3] + map->height * tmpCm.yresolution);
+  tmpCm.extent.maxx = MAX(map->gt.geotransform[0], map->gt.geotransform[0] + map->width * tmpCm.xresolution);
+  tmpCm.extent.maxy = MAX(map->gt.geotransform[3], map->gt.geotransform[3] + map->height * tmpCm.yresolution);
+
+  swapAxes = msWCSSwapAxes20(srs_uri);
+  msFree(srs_uri);
+
+  /* Setup layer information  */
+  msWCSCommon20_CreateBoundedBy(layer, &tmpCm, psGmlNs, psRootNode, &(map->projection), swapAxes);
+  msWCSCommon20_CreateDomainSet(layer, &tmpCm, psGmlNs, psRootNode, &(map->projection), swapAxes);
+
+  psRangeSet = xmlNewChild(psRootNode, psGmlNs, BAD_CAST "rangeSet", NULL);
+  psFile     = xmlNewChild(psRangeSet, psGmlNs, BAD_CAST "File", NULL);
+
+  /* TODO: wait for updated specifications */
+  psRangeParameters = xmlNewChild(psFile, psGmlNs, BAD_CAST "rangeParameters", NULL);
+
+  default_filename = msStrdup("out.");
+  default_filename = msStringConcatenate(default_filename, MS_IMAGE_EXTENSION(map->outputformat));
+
+  filename = msGetOutputFormatOption(map->outputformat, "FILENAME", default_filename);
+  length = strlen("cid:coverage/") + strlen(filename) + 1;
+  file_ref = msSmallMalloc(length);
+  strlcpy(file_ref, "cid:coverage/", length);
+  strlcat(file_ref, filename, length);
+  msFree(default_filename);
+
+  if(EQUAL(MS_IMAGE_MIME_TYPE(map->outputformat), "image/tiff")) {
+    length = strlen(MS_WCS_20_PROFILE_GML_GEOTIFF) + 1;
+    role = msSmallMalloc(length);
+    strlcpy(role, MS_WCS_20_PROFILE_GML_GEOTIFF, length);
+  } else {
+    length = strlen(MS_IMAGE_MIME_TYPE(map->outputformat)) + 1;
+    role = msSmallMalloc(length);
+    strlcpy(role, MS_IMAGE_MIME_TYPE(map->outputformat), length);
+  }
+
+  xmlNewNsProp(psRangeParameters, psXLinkNs, BAD_CAST "href", BAD_CAST file_ref);
+  xmlNewNsProp(psRangeParameters, psXLinkNs, BAD_CAST "role", BAD_CAST role);
+  xmlNewNsProp(psRangeParameters, psXLinkNs, BAD_CAST "arcrole", BAD_CAST "fileReference");
+
+  xmlNewChild(psFile, psGmlNs, BAD_CAST "fileReference", BAD_CAST file_ref);
+  xmlNewChild(psFile, psGmlNs, BAD_CAST "fileStructure", NULL);
+  xmlNewChild(psFile, psGmlNs, BAD_CAST "mimeType", BAD_CAST MS_IMAGE_MIME_TYPE(map->outputformat));
+
+  msWCSCommon20_CreateRangeType(layer, cm, bandlist, psGmlNs, psGmlcovNs, psSweNs, psXLinkNs, psRootNode);
+
+  msIO_setHeader("Content-Type","multipart/related; boundary=wcs");
+  msIO_sendHeaders();
+  msIO_printf("\r\n--wcs\r\n");
+
+  msWCSWriteDocument20(map, psDoc);
+  msFree(file_ref);
+  msFree(role);
+  xmlFreeDoc(psDoc);
+  xmlCleanupParser();
+}
+
 /************************************************************************/
 /*                   msWCSGetCoverage20()                               */
 /*                                                                      */
@@ -3128,6 +3757,7 @@ int msWCSGetCoverage20(mapObj *map, cgiRequestObj *request,
   wcs20coverageMetadataObj cm;
   imageObj *image = NULL;
   outputFormatObj *format = NULL;
+  wcs20StreamObj stream;
 
   rectObj subsets, bbox;
   projectionObj imageProj;
@@ -3468,12 +4098,15 @@ this request. Check wcs/ows_enable_request settings.", "msWCSGetCoverage20()", p
     msLayerSetProcessingKey(layer, "RESAMPLE", "NEAREST");
   }
 
-  /* since the dataset is only used in one layer, set it to be    */
-  /* closed after drawing the layer. This normally defaults to    */
-  /* DEFER and will produce a memory leak, because the dataset    */
-  /* will not be closed.                                          */
-  if( msLayerGetProcessingKey(layer, "CLOSE_CONNECTION") == NULL ) {
-    msLayerSetProcessingKey(layer, "CLOSE_CONNECTION", "NORMAL");
+  /* stream the coverage straight from the source if nothing needs resampling */
+  if (map->outputformat && msWCSPrepareStream20(map, layer, &stream) == MS_SUCCESS) {
+    if(params->multipart == MS_TRUE)
+      msWCSGetCoverage20_WriteDocument(map, layer, &cm, bandlist);
+    status = msWCSWriteStreamTIFF20(map, &stream, params->multipart);
+    msWCSFreeStream20(layer, &stream);
+    msFree(bandlist);
+    msWCSClearCoverageMetadata20(&cm);
+    return status;
   }
 
   /* create the image object  */
@@ -3587,105 +4220,8 @@ this request. Check wcs/ows_enable_request settings.", "msWCSGetCoverage20()", p
   /* GML+Image */
   /* Embed the image into multipart message */
   if(params->multipart == MS_TRUE) {
-    xmlDocPtr psDoc = NULL;       /* document pointer */
-    xmlNodePtr psRootNode, psRangeSet, psFile, psRangeParameters;
-    xmlNsPtr psGmlNs = NULL,
-             psGmlcovNs = NULL,
-             psSweNs = NULL,
-             psXLinkNs = NULL;
-    wcs20coverageMetadataObj tmpCm;
-    char *srs_uri, *default_filename;
-    const char *filename;
-    char *file_ref, *role;
-    int length = 0, swapAxes;
-
-    /* Create Document  */
-    psDoc = xmlNewDoc(BAD_CAST "1.0");
-    psRootNode = xmlNewNode(NULL, BAD_CAST MS_WCS_GML_COVERAGETYPE_RECTIFIED_GRID_COVERAGE);
-    xmlDocSetRootElement(psDoc, psRootNode);
-
-    msWCSPrepareNamespaces20(psDoc, psRootNode, map);
-
-    psGmlNs    = xmlSearchNs(psDoc, psRootNode, BAD_CAST MS_OWSCOMMON_GML_NAMESPACE_PREFIX);
-    psGmlcovNs = xmlSearchNs(psDoc, psRootNode, BAD_CAST MS_OWSCOMMON_GMLCOV_NAMESPACE_PREFIX);
-    psSweNs    = xmlSearchNs(psDoc, psRootNode, BAD_CAST MS_OWSCOMMON_SWE_NAMESPACE_PREFIX);
-    xmlSearchNs(psDoc, psRootNode, BAD_CAST MS_OWSCOMMON_WCS_NAMESPACE_PREFIX);
-    psXLinkNs  = xmlSearchNs(psDoc, psRootNode, BAD_CAST MS_OWSCOMMON_W3C_XLINK_NAMESPACE_PREFIX);
-
-    xmlNewNsProp(psRootNode, psGmlNs, BAD_CAST "id", BAD_CAST layer->name);
-
-    xmlSetNs(psRootNode, psGmlcovNs);
-
-    srs_uri = msOWSGetProjURI(&map->projection, NULL, "CO", 1);
-
-    tmpCm = cm;
-    tmpCm.extent = map->extent;
-    tmpCm.xsize = map->width;
-    tmpCm.ysize = map->height;
-    strlcpy(tmpCm.srs_uri, srs_uri, sizeof(tmpCm.srs_uri));
-
-    tmpCm.xresolution = map->gt.geotransform[1];
-    tmpCm.yresolution = map->gt.geotransform[5];
-
-    tmpCm.extent.minx = MIN(map->gt.geotransform[0], map->gt.geotransform[0] + map->width * tmpCm.xresolution);
-    tmpCm.extent.miny = MIN(map->gt.geotransform[3], map->gt.geotransform[3] + map->height * tmpCm.yresolution);
-    tmpCm.extent.maxx = MAX(map->gt.geotransform[0], map->gt.geotransform[0] + map->width * tmpCm.xresolution);
-    tmpCm.extent.maxy = MAX(map->gt.geotransform[3], map->gt.geotransform[3] + map->height * tmpCm.yresolution);
-
-    swapAxes = msWCSSwapAxes20(srs_uri);
-    msFree(srs_uri);
-
-    /* Setup layer information  */
-    msWCSCommon20_CreateBoundedBy(layer, &tmpCm, psGmlNs, psRootNode, &(map->projection), swapAxes);
-    msWCSCommon20_CreateDomainSet(layer, &tmpCm, psGmlNs, psRootNode, &(map->projection), swapAxes);
-
-    psRangeSet = xmlNewChild(psRootNode, psGmlNs, BAD_CAST "rangeSet", NULL);
-    psFile     = xmlNewChild(psRangeSet, psGmlNs, BAD_CAST "File", NULL);
-
-    /* TODO: wait for updated specifications */
-    psRangeParameters = xmlNewChild(psFile, psGmlNs, BAD_CAST "rangeParameters", NULL);
-
-    default_filename = msStrdup("out.");
-    default_filename = msStringConcatenate(default_filename, MS_IMAGE_EXTENSION(image->format));
-
-    filename = msGetOutputFormatOption(image->format, "FILENAME", default_filename);
-    length = strlen("cid:coverage/") + strlen(filename) + 1;
-    file_ref = msSmallMalloc(length);
-    strlcpy(file_ref, "cid:coverage/", length);
-    strlcat(file_ref, filename, length);
-    msFree(default_filename);
-
-    if(EQUAL(MS_IMAGE_MIME_TYPE(map->outputformat), "image/tiff")) {
-      length = strlen(MS_WCS_20_PROFILE_GML_GEOTIFF) + 1;
-      role = msSmallMalloc(length);
-      strlcpy(role, MS_WCS_20_PROFILE_GML_GEOTIFF, length);
-    } else {
-      length = strlen(MS_IMAGE_MIME_TYPE(map->outputformat)) + 1;
-      role = msSmallMalloc(length);
-      strlcpy(role, MS_IMAGE_MIME_TYPE(map->outputformat), length);
-    }
-
-    xmlNewNsProp(psRangeParameters, psXLinkNs, BAD_CAST "href", BAD_CAST file_ref);
-    xmlNewNsProp(psRangeParameters, psXLinkNs, BAD_CAST "role", BAD_CAST role);
-    xmlNewNsProp(psRangeParameters, psXLinkNs, BAD_CAST "arcrole", BAD_CAST "fileReference");
-
-    xmlNewChild(psFile, psGmlNs, BAD_CAST "fileReference", BAD_CAST file_ref);
-    xmlNewChild(psFile, psGmlNs, BAD_CAST "fileStructure", NULL);
-    xmlNewChild(psFile, psGmlNs, BAD_CAST "mimeType", BAD_CAST MS_IMAGE_MIME_TYPE(map->outputformat));
-
-    msWCSCommon20_CreateRangeType(layer, &cm, bandlist, psGmlNs, psGmlcovNs, psSweNs, psXLinkNs, psRootNode);
-
-    msIO_setHeader("Content-Type","multipart/related; boundary=wcs");
-    msIO_sendHeaders();
-    msIO_printf("\r\n--wcs\r\n");
-
-    msWCSWriteDocument20(map, psDoc);
+    msWCSGetCoverage20_WriteDocument(map, layer, &cm, bandlist);
     msWCSWriteFile20(map, image, params, 1);
-
-    msFree(file_ref);
-    msFree(role);
-    xmlFreeDoc(psDoc);
-    xmlCleanupParser();
   /* just print out the file without gml */
   } else {
     msWCSWriteFile20(map, image, params, 0);
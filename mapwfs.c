@@ -1334,7 +1334,8 @@ this request. Check wfs/ows_enable_request settings.", "msWFSDescribeFeatureType
 ** msWFSGetFeature_GMLPreamble()
 **
 ** Generate the GML preamble up to the first feature for the builtin
-** WFS GML support.
+** WFS GML support. iNumberOfFeatures is -1 when the count is not known
+** yet (streamed output), numberOfFeatures is then left out.
 */
 
 typedef struct {
@@ -1471,7 +1472,7 @@ static int msWFSGetFeature_GMLPreamble( mapObj *map,
     }
 
     if(paramsObj->pszVersion && strncmp(paramsObj->pszVersion,"1.1",3) == 0) {
-      if (iResultTypeHits == 1) {
+      if (iResultTypeHits == 1 && iNumberOfFeatures >= 0) {
         char timestring[100];
         struct tm *now;
         time_t tim=time(NULL);
@@ -1523,10 +1524,12 @@ static int msWFSGetFeature_GMLPostfix( mapObj *map,
                                        int outputformat,
                                        int maxfeatures,
                                        int iResultTypeHits,
-                                       int iNumberOfFeatures )
+                                       int iNumberOfFeatures,
+                                       int bStreamed )
 
 {
-  if (((iNumberOfFeatures==0) || (maxfeatures == 0)) && iResultTypeHits == 0) {
+  /* a streamed collection has written its (unknown) bounds up front */
+  if (((iNumberOfFeatures==0) || (maxfeatures == 0)) && iResultTypeHits == 0 && !bStreamed) {
     msIO_printf("   <gml:boundedBy>\n");
     if(outputformat == OWS_GML3)
       msIO_printf("      <gml:Null>missing</gml:Null>\n");
@@ -1552,6 +1555,65 @@ static int msWFSGetFeature_GMLPostfix( mapObj *map,
   return MS_SUCCESS;
 }
 
+/*
+** msWFSGetFeature_SendHeaders()
+**
+** Content-Type header of a GML GetFeature response.
+*/
+
+static void msWFSGetFeature_SendHeaders( mapObj *map, const char *output_mime_type )
+{
+  const char *value;
+
+  value = msOWSLookupMetadata(&(map->web.metadata), "FO", "encoding");
+  if (value)
+    msIO_setHeader("Content-Type","%s; charset=%s", output_mime_type,value);
+  else
+    msIO_setHeader("Content-Type",output_mime_type);
+  msIO_sendHeaders();
+}
+
+/*
+** msWFSGetFeature_EndStream()
+**
+** Detach the streaming GML or GeoJSON writer from the query, returns the
+** number of features it wrote.
+*/
+
+static int msWFSGetFeature_EndStream( mapObj *map )
+{
+  int (*sink)(layerObj *, shapeObj *, void *) = map->query.sink;
+  void *sinkdata = map->query.sinkdata;
+
+  map->query.sink = NULL;
+  map->query.sinkdata = NULL;
+
+  if (sink == msGeoJSONStreamWriteShape)
+    return msGeoJSONStreamEnd((geojsonWriterObj *) sinkdata);
+
+  return msGMLWFSStreamEnd((gmlWFSStreamObj *) sinkdata);
+}
+
+/*
+** msWFSGetFeature_StreamError()
+**
+** A query failed after a streamed response was started. The error can no
+** longer replace the document by an exception report: log it and mark it as
+** reported so that mapserv does not append an error page to the output.
+*/
+
+static void msWFSGetFeature_StreamError( mapObj *map )
+{
+  errorObj *ms_error = msGetErrorObj();
+  char *errors = msGetErrorString("; ");
+
+  /* the whole list, the query failure is below the msWFSGetFeature() error */
+  msDebug("msWFSGetFeature(): query failed while streaming, response truncated: %s\n",
+          errors ? errors : "");
+  msFree(errors);
+  ms_error->isreported = MS_TRUE;
+}
+
 /*
 ** msWFSGetFeature()
 */
@@ -1589,6 +1651,10 @@ int msWFSGetFeature(mapObj *map, wfsParamsObj *paramsObj, cgiRequestObj *req, ow
   int nPropertyNames = 0;
   int nQueriedLayers=0;
   layerObj *lpQueried=NULL;
+  gmlWFSStreamObj *wfsstream = NULL;
+  int bStreamed = MS_FALSE;
+  int bStreamError = MS_FALSE;
+  int nSavedQueryLayer;
 
   /*use msLayerGetShape instead of msLayerResultsGetShape of complex filter #3305
   int bComplexFilter = MS_FALSE;
@@ -2268,6 +2334,64 @@ this request. Check wfs/ows_enable_request settings.", "msWFSGetFeature()",
   if (msWFSGetFeatureApplySRS(map, paramsObj->pszSrs, paramsObj->pszVersion) == MS_FAILURE)
     return msWFSException(map, "typename", "InvalidParameterValue", paramsObj->pszVersion);
   
+  /*
+  ** Without a BBOX the layer extents are queried in the map SRS. Load it
+  ** before a streamed response is started, a bad SRS has to be reported as
+  ** an exception.
+  */
+  if (!bFilterSet && !bFeatureIdSet && !bBBOXSet && !paramsObj->pszSrs) {
+    const char *pszMapSRS = msOWSGetEPSGProj(&(map->projection), &(map->web.metadata), "FO", MS_TRUE);
+
+    if (pszMapSRS != NULL && strncmp(pszMapSRS, "EPSG:", 5) == 0) {
+
+      if( msOWSParseVersionString(paramsObj->pszVersion) >= OWS_1_1_0 )
+        status = msLoadProjectionStringEPSG(&(map->projection), pszMapSRS);
+      else
+        status = msLoadProjectionString(&(map->projection), pszMapSRS);
+
+      if (status != 0) {
+        msSetError(MS_WFSERR, "msLoadProjectionString() failed: %s",
+                   "msWFSGetFeature()", pszMapSRS);
+        return msWFSException(map, "mapserv", "NoApplicableCode",
+                              paramsObj->pszVersion);
+      }
+    }
+  }
+
+  /*
+  ** With "getfeature_streaming" plain GML and GEOJSON requests write each
+  ** feature as the query reads it instead of filling the result cache and
+  ** reading every shape a second time. The document has to be started before
+  ** querying, so query errors from here on only truncate it (see
+  ** msWFSGetFeature_StreamError()).
+  */
+  if (!bFilterSet && !bFeatureIdSet && psFormat != NULL && MS_RENDERER_GEOJSON(psFormat) &&
+      iResultTypeHits == 0 && maxfeatures != 0 &&
+      (value = msOWSLookupMetadata(&(map->web.metadata), "FO", "getfeature_streaming")) != NULL &&
+      strcasecmp(value, "true") == 0) {
+    msIO_setHeader("Content-Type", "%s", psFormat->mimetype);
+    msIO_sendHeaders();
+
+    map->query.sinkdata = msGeoJSONStreamBegin(map, psFormat, stdout);
+    map->query.sink = msGeoJSONStreamWriteShape;
+    bStreamed = MS_TRUE;
+  } else if (!bFilterSet && !bFeatureIdSet && psFormat == NULL && iResultTypeHits == 0 && maxfeatures != 0 &&
+      (value = msOWSLookupMetadata(&(map->web.metadata), "FO", "getfeature_streaming")) != NULL &&
+      strcasecmp(value, "true") == 0) {
+    msWFSGetFeature_SendHeaders(map, output_mime_type);
+
+    status = msWFSGetFeature_GMLPreamble( map, req, &gmlinfo, paramsObj,
+                                          outputformat, iResultTypeHits, -1 );
+    if(status != MS_SUCCESS) {
+      return MS_FAILURE;
+    }
+
+    wfsstream = msGMLWFSStreamBegin(map, stdout, (char *) gmlinfo.user_namespace_prefix, outputformat);
+    map->query.sink = msGMLWFSStreamWriteShape;
+    map->query.sinkdata = wfsstream;
+    bStreamed = MS_TRUE;
+  }
+
   /*
   ** Perform Query (only BBOX for now)
   */
@@ -2276,39 +2400,20 @@ this request. Check wfs/ows_enable_request settings.", "msWFSGetFeature()",
   if (!bFilterSet && !bFeatureIdSet) {
 
     if (!bBBOXSet) {
-      const char *pszMapSRS=NULL, *pszLayerSRS=NULL;
+      const char *pszLayerSRS=NULL;
       bbox = map->extent;
       map->query.type = MS_QUERY_BY_RECT; /* setup the query */
       map->query.mode = MS_QUERY_MULTIPLE;
 
       /*if srsName was given for wfs 1.1.0, It is at this point loaded into the
-        map object and should be used*/
-      if(!paramsObj->pszSrs)
-        pszMapSRS = msOWSGetEPSGProj(&(map->projection), &(map->web.metadata), "FO", MS_TRUE);
+        map object and should be used, otherwise the map SRS was loaded above*/
       for(j=0; j<map->numlayers; j++) {
         layerObj *lp;
         rectObj ext;
-        int status;
         lp = GET_LAYER(map, j);
         if (lp->status == MS_ON) {
           if (msOWSGetLayerExtent(map, lp, "FO", &ext) == MS_SUCCESS) {
 
-            if (pszMapSRS != NULL && strncmp(pszMapSRS, "EPSG:", 5) == 0) {
-
-              if( msOWSParseVersionString(paramsObj->pszVersion) >= OWS_1_1_0 )
-                status = msLoadProjectionStringEPSG(&(map->projection), pszMapSRS);
-              else
-                status = msLoadProjectionString(&(map->projection), pszMapSRS);
-
-              if (status != 0) {
-                msSetError(MS_WFSERR, "msLoadProjectionString() failed: %s",
-                           "msWFSGetFeature()", pszMapSRS);
-                return msWFSException(map, "mapserv", "NoApplicableCode",
-                                      paramsObj->pszVersion);
-              }
-
-            }
-
             /*make sure that the layer projectsion is loaded.
               It could come from a ows/wfs_srs metadata*/
             if (lp->projection.numargs == 0) {
@@ -2336,7 +2441,11 @@ this request. Check wfs/ows_enable_request settings.", "msWFSGetFeature()",
 
             if(ms_error->code != MS_NOTFOUND) {
               msSetError(MS_WFSERR, "ms_error->code not found", "msWFSGetFeature()");
-              return msWFSException(map, "mapserv", "NoApplicableCode", paramsObj->pszVersion);
+              if (!bStreamed)
+                return msWFSException(map, "mapserv", "NoApplicableCode", paramsObj->pszVersion);
+              msWFSGetFeature_StreamError(map);
+              bStreamError = MS_TRUE;
+              break;
             }
           }
         }
@@ -2367,22 +2476,39 @@ this request. Check wfs/ows_enable_request settings.", "msWFSGetFeature()",
       map->query.mode = MS_QUERY_MULTIPLE;
       map->query.rect = bbox;
 
-      if(msQueryByRect(map) != MS_SUCCESS) {
-        errorObj   *ms_error;
-        ms_error = msGetErrorObj();
+      /* when streaming query one layer at a time, to write them in the */
+      /* same order as msGMLWriteWFSQuery() does */
+      nSavedQueryLayer = map->query.layer;
+      for(j=0; j<(bStreamed ? map->numlayers : 1); j++) {
+        if (bStreamed)
+          map->query.layer = map->layerorder[j];
 
-        if(ms_error->code != MS_NOTFOUND) {
-          msSetError(MS_WFSERR, "ms_error->code not found", "msWFSGetFeature()");
-          return msWFSException(map, "mapserv", "NoApplicableCode", paramsObj->pszVersion);
+        if(msQueryByRect(map) != MS_SUCCESS) {
+          errorObj   *ms_error;
+          ms_error = msGetErrorObj();
+
+          if(ms_error->code != MS_NOTFOUND) {
+            msSetError(MS_WFSERR, "ms_error->code not found", "msWFSGetFeature()");
+            if (!bStreamed)
+              return msWFSException(map, "mapserv", "NoApplicableCode", paramsObj->pszVersion);
+            msWFSGetFeature_StreamError(map);
+            bStreamError = MS_TRUE;
+            break;
+          }
         }
       }
+      map->query.layer = nSavedQueryLayer;
     }
   }
 
   /* if no results where written (TODO: this needs to be GML2/3 specific I imagine */
-  for(j=0; j<map->numlayers; j++) {
-    if (GET_LAYER(map, j)->resultcache && GET_LAYER(map, j)->resultcache->numresults > 0) {
-      iNumberOfFeatures += GET_LAYER(map, j)->resultcache->numresults;
+  if (bStreamed) {
+    iNumberOfFeatures = msWFSGetFeature_EndStream(map);
+  } else {
+    for(j=0; j<map->numlayers; j++) {
+      if (GET_LAYER(map, j)->resultcache && GET_LAYER(map, j)->resultcache->numresults > 0) {
+        iNumberOfFeatures += GET_LAYER(map, j)->resultcache->numresults;
+      }
     }
   }
 
@@ -2392,13 +2518,8 @@ this request. Check wfs/ows_enable_request settings.", "msWFSGetFeature()",
 
   status = MS_SUCCESS;
 
-  if( psFormat == NULL ) {
-    value = msOWSLookupMetadata(&(map->web.metadata), "FO", "encoding");
-    if (value)
-      msIO_setHeader("Content-Type","%s; charset=%s", output_mime_type,value);
-    else
-      msIO_setHeader("Content-Type",output_mime_type);
-    msIO_sendHeaders();
+  if( psFormat == NULL && !bStreamed ) {
+    msWFSGetFeature_SendHeaders(map, output_mime_type);
 
     status = msWFSGetFeature_GMLPreamble( map, req, &gmlinfo, paramsObj,
                                  outputformat,
@@ -2412,11 +2533,11 @@ this request. Check wfs/ows_enable_request settings.", "msWFSGetFeature()",
   /* handle case of maxfeatures = 0 */
   /*internally use a start index that start with 0 as the first index*/
   if( psFormat == NULL ) {
-    if(maxfeatures != 0 && iResultTypeHits == 0)
+    if(maxfeatures != 0 && iResultTypeHits == 0 && !bStreamed)
       status = msGMLWriteWFSQuery(map, stdout,
                                   (char *) gmlinfo.user_namespace_prefix,
                                   outputformat);
-  } else {
+  } else if( !bStreamed ) {
     mapservObj *mapserv = msAllocMapServObj();
 
     /* Setup dummy mapserv object */
@@ -2442,13 +2563,17 @@ this request. Check wfs/ows_enable_request settings.", "msWFSGetFeature()",
   if( psFormat == NULL && status == MS_SUCCESS ) {
     msWFSGetFeature_GMLPostfix( map, req, &gmlinfo, paramsObj,
                                 outputformat,
-                                maxfeatures, iResultTypeHits, iNumberOfFeatures );
+                                maxfeatures, iResultTypeHits, iNumberOfFeatures, bStreamed );
   }
 
   /*
   ** Done! Now a bit of clean-up.
   */
 
+  /* the truncated document was closed, the error is already logged */
+  if (bStreamError)
+    return MS_FAILURE;
+
   return status;
 }
 